@@ -50,6 +50,7 @@
 #include "aql.h"
 
 static aql_adt_t adt;
+static uint8_t insert_batching;
 
 static void
 clear_handle(db_handle_t *handle)
@@ -154,7 +155,11 @@ aql_execute(db_handle_t *handle, aql_adt_t *adt)
     result = relation_select(handle, rel, adt);
     break;
   case AQL_TYPE_INSERT:
-    result = relation_insert(rel, adt->values);
+    if(insert_batching) {
+      result = relation_bulk_insert(rel, adt->values);
+    } else {
+      result = relation_insert(rel, adt->values);
+    }
     break;
 #if DB_FEATURE_JOIN
   case AQL_TYPE_JOIN:
@@ -210,6 +215,26 @@ db_query(db_handle_t *handle, const char *format, ...)
   return aql_execute(handle, &adt);
 }
 
+/* db_set_insert_batching: Let INSERT queries collect rows in a RAM
+   buffer that is written to storage in batches. See relation_bulk_insert()
+   for the durability of the buffered rows. */
+db_result_t
+db_set_insert_batching(int enable)
+{
+  insert_batching = enable;
+  if(!enable) {
+    return relation_flush();
+  }
+  return DB_OK;
+}
+
+/* db_flush: Write the rows buffered by INSERT queries to storage. */
+db_result_t
+db_flush(void)
+{
+  return relation_flush();
+}
+
 db_result_t
 db_process(db_handle_t *handle)
 {
@@ -104,6 +104,7 @@ enum token {
   MEMHASH = 46,
   RELATION = 47,
   ATTRIBUTE = 48,
+  BTREE = 49,
 
   INTEGER_VALUE = 251,
   FLOAT_VALUE = 252,
@@ -217,5 +218,7 @@ db_result_t aql_add_attribute(aql_adt_t *adt, char *name,
 db_result_t aql_add_value(aql_adt_t *adt, domain_t domain, void *value);
 db_result_t db_query(db_handle_t *handle, const char *format, ...);
 db_result_t db_process(db_handle_t *handle);
+db_result_t db_set_insert_batching(int enable);
+db_result_t db_flush(void);
 
 #endif /* !AQL_H */
@@ -178,6 +178,35 @@
 #define REMOVE_RELATION			"db-remove"
 #endif /* REMOVE_RELATION */
 
+/* The size of the buffer used for reading several rows at a time
+   in sequential scans of a relation. */
+#ifndef DB_SCAN_BUFFER_SIZE
+#define DB_SCAN_BUFFER_SIZE		256
+#endif /* DB_SCAN_BUFFER_SIZE */
+
+/* The size of the RAM buffer that collects rows inserted with
+   relation_bulk_insert() before they are appended to storage. */
+#ifndef DB_INSERT_BUFFER_SIZE
+#define DB_INSERT_BUFFER_SIZE		128
+#endif /* DB_INSERT_BUFFER_SIZE */
+
+/* The maximum number of rows in the insert buffer. */
+#ifndef DB_INSERT_BATCH_LIMIT
+#define DB_INSERT_BATCH_LIMIT		16
+#endif /* DB_INSERT_BATCH_LIMIT */
+
+/* The number of rows of the smaller relation that a hash join keeps
+   in its table at a time. The larger relation is scanned once for
+   each such part of the smaller relation. At most 255. */
+#ifndef DB_JOIN_HASH_SIZE
+#define DB_JOIN_HASH_SIZE		32
+#endif /* DB_JOIN_HASH_SIZE */
+
+/* The number of buckets in the hash join table. */
+#ifndef DB_JOIN_HASH_BUCKETS
+#define DB_JOIN_HASH_BUCKETS		16
+#endif /* DB_JOIN_HASH_BUCKETS */
+
 /*----------------------------------------------------------------------------*/
 
 /* Index options. */
@@ -206,6 +235,26 @@
 #define DB_HEAP_CACHE_LIMIT		1
 #endif /* DB_HEAP_CACHE_LIMIT */
 
+/* The maximum number of B+-tree indexes. */
+#ifndef DB_BTREE_INDEX_LIMIT
+#define DB_BTREE_INDEX_LIMIT		1
+#endif /* DB_BTREE_INDEX_LIMIT */
+
+/* The maximum number of nodes cached in the B+-tree index. */
+#ifndef DB_BTREE_CACHE_LIMIT
+#define DB_BTREE_CACHE_LIMIT		4
+#endif /* DB_BTREE_CACHE_LIMIT */
+
+/* The number of keys in a B+-tree node. */
+#ifndef DB_BTREE_NODE_SIZE
+#define DB_BTREE_NODE_SIZE		16
+#endif /* DB_BTREE_NODE_SIZE */
+
+/* The maximum number of nodes in a B+-tree index. */
+#ifndef DB_BTREE_NODE_LIMIT
+#define DB_BTREE_NODE_LIMIT		128
+#endif /* DB_BTREE_NODE_LIMIT */
+
 /*----------------------------------------------------------------------------*/
 
 /* LVM options. */
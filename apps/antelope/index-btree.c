@@ -0,0 +1,607 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *     B+-tree - An ordered index for flash memory.
+ *
+ *     The tree is stored in a single file, which begins with a small
+ *     header that is followed by fixed-size nodes. A key is inserted by
+ *     appending it into the first free slot of a node, so the entries
+ *     are unsorted within a node and most insertions write only a few
+ *     previously unwritten bytes. A node is rewritten only when it
+ *     fills up and gets split: the upper half of its entries is then
+ *     moved into a new node at the end of the file, and the separating
+ *     key is appended into the parent node.
+ *
+ *     Because each leaf is linked to the leaf that holds the next larger
+ *     keys, a range query descends to the first leaf that may contain
+ *     the lowest key of the range, and then follows the links until it
+ *     finds a key that is larger than the highest key of the range.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "lib/memb.h"
+
+#include "db-options.h"
+#include "index.h"
+#include "result.h"
+#include "storage.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/* The maximum height of the tree. */
+#define MAX_DEPTH	8
+
+#define NODE_OFFSET(id)	(sizeof(struct btree_header) + \
+			 (unsigned long)((id) - 1) * sizeof(btree_node_t))
+
+typedef int32_t btree_key_t;
+typedef uint16_t btree_node_id_t;
+
+struct btree_entry {
+  btree_key_t key;
+  /* The tuple ID plus one in a leaf, or the ID of a child node in an
+     internal node. Unused entries are zero. */
+  uint32_t ptr;
+};
+
+struct btree_node {
+  /* The next leaf in a leaf, or the child with the smallest keys
+     in an internal node. */
+  btree_node_id_t link;
+  uint8_t leaf;
+  uint8_t unused;
+  struct btree_entry entries[DB_BTREE_NODE_SIZE];
+};
+typedef struct btree_node btree_node_t;
+
+struct btree_header {
+  btree_node_id_t root;
+  btree_node_id_t node_count;
+};
+
+struct btree {
+  db_storage_id_t storage;
+  btree_node_id_t root;
+  btree_node_id_t node_count;
+};
+typedef struct btree btree_t;
+
+struct node_cache {
+  btree_t *tree;
+  btree_node_id_t node_id;
+  uint8_t count;
+  btree_node_t node;
+};
+
+/* Keep a cache of nodes read from storage. */
+static struct node_cache node_cache[DB_BTREE_CACHE_LIMIT];
+static uint8_t next_victim;
+MEMB(btrees, btree_t, DB_BTREE_INDEX_LIMIT);
+
+/* Nodes that are being split. */
+static btree_node_t left;
+static btree_node_t right;
+
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *);
+
+index_api_t index_btree = {
+  INDEX_BTREE,
+  INDEX_API_EXTERNAL | INDEX_API_RANGE_QUERIES,
+  create,
+  destroy,
+  load,
+  release,
+  insert,
+  delete,
+  get_next
+};
+
+static struct node_cache *
+get_cache(btree_t *tree, btree_node_id_t node_id)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(node_cache[i].tree == tree && node_cache[i].node_id == node_id) {
+      return &node_cache[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+invalidate_cache(btree_t *tree)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(node_cache[i].tree == tree) {
+      node_cache[i].tree = NULL;
+    }
+  }
+}
+
+static int
+count_entries(btree_node_t *node)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_NODE_SIZE; i++) {
+    if(node->entries[i].ptr == 0) {
+      break;
+    }
+  }
+  return i;
+}
+
+static struct node_cache *
+node_load(btree_t *tree, btree_node_id_t node_id)
+{
+  struct node_cache *cache;
+
+  cache = get_cache(tree, node_id);
+  if(cache != NULL) {
+    return cache;
+  }
+
+  cache = &node_cache[next_victim];
+  next_victim = (next_victim + 1) % DB_BTREE_CACHE_LIMIT;
+
+  cache->tree = NULL;
+  if(DB_ERROR(storage_read(tree->storage, &cache->node,
+                           NODE_OFFSET(node_id), sizeof(cache->node)))) {
+    PRINTF("DB: Failed to read B+-tree node %u\n", (unsigned)node_id);
+    return NULL;
+  }
+
+  cache->tree = tree;
+  cache->node_id = node_id;
+  cache->count = count_entries(&cache->node);
+
+  return cache;
+}
+
+static int
+node_write(btree_t *tree, btree_node_id_t node_id, btree_node_t *node)
+{
+  struct node_cache *cache;
+
+  if(DB_ERROR(storage_write(tree->storage, node,
+                            NODE_OFFSET(node_id), sizeof(*node)))) {
+    return 0;
+  }
+
+  cache = get_cache(tree, node_id);
+  if(cache != NULL) {
+    memcpy(&cache->node, node, sizeof(cache->node));
+    cache->count = count_entries(&cache->node);
+  }
+
+  return 1;
+}
+
+static int
+node_append(btree_t *tree, struct node_cache *cache, struct btree_entry *entry)
+{
+  unsigned long offset;
+
+  offset = NODE_OFFSET(cache->node_id) + offsetof(btree_node_t, entries) +
+           cache->count * sizeof(*entry);
+  if(DB_ERROR(storage_write(tree->storage, entry, offset, sizeof(*entry)))) {
+    return 0;
+  }
+
+  cache->node.entries[cache->count++] = *entry;
+  return 1;
+}
+
+static int
+header_write(btree_t *tree)
+{
+  struct btree_header header;
+
+  header.root = tree->root;
+  header.node_count = tree->node_count;
+
+  return !DB_ERROR(storage_write(tree->storage, &header, 0, sizeof(header)));
+}
+
+static btree_node_id_t
+node_alloc(btree_t *tree, btree_node_t *node)
+{
+  if(tree->node_count >= DB_BTREE_NODE_LIMIT) {
+    PRINTF("DB: No more B+-tree nodes available\n");
+    return 0;
+  }
+
+  if(node_write(tree, tree->node_count + 1, node) == 0) {
+    return 0;
+  }
+  tree->node_count++;
+
+  if(header_write(tree) == 0) {
+    return 0;
+  }
+
+  return tree->node_count;
+}
+
+/*
+ * Select the child of an internal node that covers the key. Separators
+ * may be duplicated, in which case the entry appended last refers to
+ * the rightmost child. If strict is set, the search stops at the first
+ * child that may contain the key instead.
+ */
+static btree_node_id_t
+find_child(struct node_cache *cache, btree_key_t key, int strict)
+{
+  struct btree_entry *entry;
+  struct btree_entry *best;
+  int i;
+
+  best = NULL;
+  for(i = 0; i < cache->count; i++) {
+    entry = &cache->node.entries[i];
+    if((strict ? entry->key < key : entry->key <= key) &&
+       (best == NULL || entry->key >= best->key)) {
+      best = entry;
+    }
+  }
+
+  return best == NULL ? cache->node.link : (btree_node_id_t)best->ptr;
+}
+
+static void
+sort_entries(struct btree_entry *entries, int count)
+{
+  struct btree_entry tmp;
+  int i, j;
+
+  /* The sort must be stable to preserve the order of duplicate keys. */
+  for(i = 1; i < count; i++) {
+    tmp = entries[i];
+    for(j = i; j > 0 && entries[j - 1].key > tmp.key; j--) {
+      entries[j] = entries[j - 1];
+    }
+    entries[j] = tmp;
+  }
+}
+
+static int
+insert_item(btree_t *tree, btree_key_t key, tuple_id_t value)
+{
+  btree_node_id_t path[MAX_DEPTH];
+  btree_node_id_t node_id;
+  btree_node_id_t right_id;
+  struct node_cache *cache;
+  struct btree_entry entry;
+  btree_key_t separator;
+  int depth;
+  int half;
+  int left_count;
+  int right_count;
+
+  /* Find the leaf for the key, and remember the path to it. */
+  for(node_id = tree->root, depth = 0;; depth++) {
+    cache = node_load(tree, node_id);
+    if(cache == NULL) {
+      return 0;
+    }
+    if(cache->node.leaf) {
+      break;
+    }
+    if(depth == MAX_DEPTH) {
+      PRINTF("DB: The B+-tree is too deep\n");
+      return 0;
+    }
+    path[depth] = node_id;
+    node_id = find_child(cache, key, 0);
+  }
+
+  entry.key = key;
+  entry.ptr = (uint32_t)value + 1;
+
+  for(;;) {
+    cache = node_load(tree, node_id);
+    if(cache == NULL) {
+      return 0;
+    }
+
+    if(cache->count < DB_BTREE_NODE_SIZE) {
+      return node_append(tree, cache, &entry);
+    }
+
+    PRINTF("DB: Split B+-tree node %u\n", (unsigned)node_id);
+
+    memcpy(&left, &cache->node, sizeof(left));
+    sort_entries(left.entries, DB_BTREE_NODE_SIZE);
+
+    half = DB_BTREE_NODE_SIZE / 2;
+    separator = left.entries[half].key;
+
+    memset(&right, 0, sizeof(right));
+    right.leaf = left.leaf;
+    if(left.leaf) {
+      /* Leaves keep all keys, so the separator stays in the right leaf. */
+      right.link = left.link;
+      right_count = DB_BTREE_NODE_SIZE - half;
+      memcpy(right.entries, &left.entries[half],
+             right_count * sizeof(entry));
+    } else {
+      /* The separator moves up, and its child becomes the leftmost
+         child of the new node. */
+      right.link = (btree_node_id_t)left.entries[half].ptr;
+      right_count = DB_BTREE_NODE_SIZE - half - 1;
+      memcpy(right.entries, &left.entries[half + 1],
+             right_count * sizeof(entry));
+    }
+    left_count = half;
+    memset(&left.entries[half], 0,
+           (DB_BTREE_NODE_SIZE - half) * sizeof(entry));
+
+    if(entry.key >= separator) {
+      right.entries[right_count] = entry;
+    } else {
+      left.entries[left_count] = entry;
+    }
+
+    right_id = node_alloc(tree, &right);
+    if(right_id == 0) {
+      return 0;
+    }
+    if(left.leaf) {
+      left.link = right_id;
+    }
+    if(node_write(tree, node_id, &left) == 0) {
+      return 0;
+    }
+
+    entry.key = separator;
+    entry.ptr = right_id;
+
+    if(depth == 0) {
+      /* The root was split; grow the tree by one level. */
+      memset(&left, 0, sizeof(left));
+      left.link = node_id;
+      left.entries[0] = entry;
+      node_id = node_alloc(tree, &left);
+      if(node_id == 0) {
+        return 0;
+      }
+      tree->root = node_id;
+      return header_write(tree);
+    }
+
+    node_id = path[--depth];
+  }
+}
+
+static db_result_t
+create(index_t *index)
+{
+  char *filename;
+  btree_t *tree;
+
+  filename = storage_generate_file("btree", sizeof(struct btree_header) +
+                         (unsigned long)DB_BTREE_NODE_LIMIT * sizeof(btree_node_t));
+  if(filename == NULL) {
+    PRINTF("DB: Failed to generate a B+-tree file\n");
+    return DB_INDEX_ERROR;
+  }
+
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    cfs_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->storage = storage_open(index->descriptor_file);
+  tree->root = 0;
+  tree->node_count = 0;
+
+  /* The tree starts out as a single, empty leaf. */
+  memset(&left, 0, sizeof(left));
+  left.leaf = 1;
+  if(tree->storage < 0 || (tree->root = node_alloc(tree, &left)) == 0) {
+    release(index);
+    cfs_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Created a B+-tree index in file \"%s\"\n",
+         index->descriptor_file);
+
+  return header_write(index->opaque_data) ? DB_OK : DB_STORAGE_ERROR;
+}
+
+static db_result_t
+destroy(index_t *index)
+{
+  if(index->opaque_data != NULL) {
+    release(index);
+  }
+  cfs_remove(index->descriptor_file);
+  return DB_OK;
+}
+
+static db_result_t
+load(index_t *index)
+{
+  btree_t *tree;
+  struct btree_header header;
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->storage = storage_open(index->descriptor_file);
+  if(tree->storage < 0 ||
+     DB_ERROR(storage_read(tree->storage, &header, 0, sizeof(header)))) {
+    release(index);
+    return DB_STORAGE_ERROR;
+  }
+
+  tree->root = header.root;
+  tree->node_count = header.node_count;
+
+  PRINTF("DB: Loaded a B+-tree index with %u nodes from file %s\n",
+         (unsigned)tree->node_count, index->descriptor_file);
+
+  return DB_OK;
+}
+
+static db_result_t
+release(index_t *index)
+{
+  btree_t *tree;
+
+  tree = index->opaque_data;
+
+  invalidate_cache(tree);
+  if(tree->storage >= 0) {
+    storage_close(tree->storage);
+  }
+  memb_free(&btrees, tree);
+  index->opaque_data = NULL;
+
+  return DB_OK;
+}
+
+static db_result_t
+insert(index_t *index, attribute_value_t *key, tuple_id_t value)
+{
+  long long_key;
+
+  long_key = db_value_to_long(key);
+
+  if(insert_item(index->opaque_data, (btree_key_t)long_key, value) == 0) {
+    PRINTF("DB: Failed to insert key %ld into a B+-tree index\n", long_key);
+    return DB_INDEX_ERROR;
+  }
+  return DB_OK;
+}
+
+static db_result_t
+delete(index_t *index, attribute_value_t *value)
+{
+  return DB_INDEX_ERROR;
+}
+
+static tuple_id_t
+get_next(index_iterator_t *iterator)
+{
+  struct iteration_cache {
+    index_iterator_t *index_iterator;
+    btree_node_id_t leaf;
+    uint8_t slot;
+    uint8_t last_leaf;
+  };
+  static struct iteration_cache cache;
+  struct node_cache *ncache;
+  struct btree_entry *entry;
+  btree_t *tree;
+  long min;
+  long max;
+
+  tree = (btree_t *)iterator->index->opaque_data;
+  min = db_value_to_long(&iterator->min_value);
+  max = db_value_to_long(&iterator->max_value);
+
+  if(cache.index_iterator != iterator || iterator->next_item_no == 0) {
+    /* Initialize the cache for a new search by descending to the
+       leftmost leaf that may contain the lowest key of the range. */
+    cache.index_iterator = iterator;
+    cache.slot = 0;
+    cache.last_leaf = 0;
+    for(cache.leaf = tree->root;;) {
+      ncache = node_load(tree, cache.leaf);
+      if(ncache == NULL) {
+        return INVALID_TUPLE;
+      }
+      if(ncache->node.leaf) {
+        break;
+      }
+      cache.leaf = find_child(ncache, min < INT32_MIN ? INT32_MIN :
+                              (btree_key_t)min, 1);
+    }
+  }
+
+  while(cache.leaf != 0) {
+    ncache = node_load(tree, cache.leaf);
+    if(ncache == NULL) {
+      return INVALID_TUPLE;
+    }
+
+    for(; cache.slot < ncache->count; cache.slot++) {
+      entry = &ncache->node.entries[cache.slot];
+      if(entry->key > max) {
+        /* The following leaves only hold larger keys. */
+        cache.last_leaf = 1;
+      } else if(entry->key >= min) {
+        cache.slot++;
+        iterator->next_item_no++;
+        PRINTF("DB: Found key %ld with value %lu\n", (long)entry->key,
+               (unsigned long)(entry->ptr - 1));
+        return (tuple_id_t)(entry->ptr - 1);
+      }
+    }
+
+    if(cache.last_leaf) {
+      break;
+    }
+    cache.leaf = ncache->node.link;
+    cache.slot = 0;
+  }
+
+  cache.leaf = 0;
+  return INVALID_TUPLE;
+}
@@ -70,6 +70,10 @@ struct variable {
   operand_type_t type;
   operand_value_t value;
   char name[LVM_MAX_NAME_LENGTH + 1];
+  /* Location of the variable in a raw row, set by lvm_bind_variable().
+     A row size of zero means that the variable is not bound. */
+  uint16_t row_offset;
+  uint8_t row_size;
 };
 typedef struct variable variable_t;
 
@@ -82,10 +86,13 @@ typedef struct derivation derivation_t;
 
 /* Registered variables for a LVM expression. Their values may be 
    changed between executions of the expression. */
-static variable_t variables[LVM_MAX_VARIABLE_ID - 1];
+static variable_t variables[LVM_MAX_VARIABLE_ID];
 
 /* Range derivations of variables that are used for index searches. */
-static derivation_t derivations[LVM_MAX_VARIABLE_ID - 1];
+static derivation_t derivations[LVM_MAX_VARIABLE_ID];
+
+/* The row that bound variables are read from during lvm_execute_row(). */
+static const unsigned char *current_row;
 
 #if DEBUG
 static void
@@ -144,6 +151,23 @@ get_type(lvm_instance_t *p)
   return node_type;
 }
 
+static long
+variable_to_long(variable_t *var)
+{
+  const unsigned char *ptr;
+
+  if(current_row == NULL || var->row_size == 0) {
+    return var->value.l;
+  }
+
+  ptr = current_row + var->row_offset;
+  if(var->row_size == 2) {
+    return (long)(ptr[0] << 8 | ptr[1]);
+  }
+  return (long)((uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 |
+                (uint32_t)ptr[2] << 8 | ptr[3]);
+}
+
 static long
 operand_to_long(operand_t *operand)
 {
@@ -156,7 +180,7 @@ operand_to_long(operand_t *operand)
     break;
 #endif /* LVM_USE_FLOATS */
   case LVM_VARIABLE:
-    return variables[operand->value.id].value.l;
+    return variable_to_long(&variables[operand->value.id]);
   default:
     return 0;
   }
@@ -403,6 +427,18 @@ lvm_execute(lvm_instance_t *p)
   return status;
 }
 
+lvm_status_t
+lvm_execute_row(lvm_instance_t *p, const unsigned char *row)
+{
+  lvm_status_t status;
+
+  current_row = row;
+  status = lvm_execute(p);
+  current_row = NULL;
+
+  return status;
+}
+
 void
 lvm_set_op(lvm_instance_t *p, operator_t op)
 {
@@ -472,6 +508,25 @@ lvm_set_variable_value(char *name, operand_value_t value)
   return TRUE;
 }
 
+lvm_status_t
+lvm_bind_variable(char *name, unsigned offset, unsigned size)
+{
+  variable_id_t id;
+
+  if(size != 2 && size != 4) {
+    return TYPE_ERROR;
+  }
+
+  id = lookup(name);
+  if(id == LVM_MAX_VARIABLE_ID || variables[id].name[0] == '\0') {
+    return INVALID_IDENTIFIER;
+  }
+
+  variables[id].row_offset = offset;
+  variables[id].row_size = size;
+  return TRUE;
+}
+
 void
 lvm_set_variable(lvm_instance_t *p, char *name)
 {
@@ -542,14 +597,10 @@ create_union(derivation_t *result, derivation_t *d1, derivation_t *d2)
   int i;
 
   for(i = 0; i < LVM_MAX_VARIABLE_ID; i++) {
-    if(!d1[i].derived && !d2[i].derived) {
+    if(!d1[i].derived || !d2[i].derived) {
+      /* A variable that is unconstrained in one of the
+         operands is unconstrained in the union. */
       continue;
-    } else if(d1[i].derived && !d2[i].derived) {
-      result[i].min.l = d1[i].min.l;
-      result[i].max.l = d1[i].max.l;
-    } else if(!d1[i].derived && d2[i].derived) {
-      result[i].min.l = d2[i].min.l;
-      result[i].max.l = d2[i].max.l;
     } else {
       /* Both derivations have been made; create a
          union of the ranges. */
@@ -583,6 +634,7 @@ static int
 derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
 {
   operator_t *operator;
+  operator_t relation;
   node_type_t type;
   operand_t operand[2];
   int i;
@@ -635,15 +687,36 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
   }
 
   /* Determine which of the operands that is the variable. */
+  relation = *operator;
   if(operand[0].type == LVM_VARIABLE) {
     if(operand[1].type == LVM_VARIABLE) {
       return DERIVATION_ERROR;
     }
     variable_id = operand[0].value.id;
     value = &operand[1].value;
-  } else {
+  } else if(operand[1].type == LVM_VARIABLE) {
     variable_id = operand[1].value.id;
     value = &operand[0].value;
+
+    /* Mirror the relation so that the variable is on the left side. */
+    switch(relation) {
+    case LVM_GE:
+      relation = LVM_LE;
+      break;
+    case LVM_GEQ:
+      relation = LVM_LEQ;
+      break;
+    case LVM_LE:
+      relation = LVM_GE;
+      break;
+    case LVM_LEQ:
+      relation = LVM_GEQ;
+      break;
+    default:
+      break;
+    }
+  } else {
+    return DERIVATION_ERROR;
   }
 
   if(variable_id >= LVM_MAX_VARIABLE_ID) {
@@ -657,7 +730,7 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
   derivation->max.l = LONG_MAX;
   derivation->min.l = LONG_MIN;
 
-  switch(*operator) {
+  switch(relation) {
   case LVM_EQ:
     derivation->max = *value;
     derivation->min = *value;
@@ -79,6 +79,43 @@ struct source_map {
 };
 
 static struct source_map source_map[AQL_ATTRIBUTE_LIMIT];
+
+#if DB_JOIN_HASH_SIZE > 255
+#error "DB_JOIN_HASH_SIZE must not exceed 255."
+#endif
+
+/*
+ * The hash join keeps the join attribute values and tuple IDs of a
+ * part of the build relation in this table. The entries of a bucket
+ * are chained through the 1-based index of the next entry.
+ */
+struct join_hash_entry {
+  long key;
+  tuple_id_t tuple_id;
+  uint8_t next;
+};
+
+static struct join_hash_entry join_hash[DB_JOIN_HASH_SIZE];
+static uint8_t join_hash_buckets[DB_JOIN_HASH_BUCKETS];
+
+/* The state of a hash join or a merge join in progress. */
+static struct {
+  relation_t *build_rel;
+  attribute_t *build_attr;
+  unsigned char *build_row;
+  unsigned build_offset;
+  relation_t *probe_rel;
+  attribute_t *probe_attr;
+  unsigned char *probe_row;
+  unsigned probe_offset;
+  /* The first build tuple that is not in the hash table, or the
+     next right tuple to compare in a merge join. */
+  tuple_id_t build_next;
+  /* The first right tuple with the current key in a merge join. */
+  tuple_id_t group_start;
+  long key;
+  uint8_t entry;
+} join_state;
 #endif /* DB_FEATURE_JOIN */
 
 static unsigned char row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
@@ -88,6 +125,14 @@ static unsigned char * const left_row = row;
 static unsigned char * const right_row = extra_row;
 static unsigned char * const join_row = result_row;
 
+/*
+ * Rows inserted with relation_bulk_insert() are collected in this
+ * buffer until they are flushed to the storage of the owning relation.
+ */
+static unsigned char insert_buffer[DB_INSERT_BUFFER_SIZE];
+static relation_t *insert_rel;
+static uint8_t insert_count;
+
 LIST(relations);
 MEMB(relations_memb, relation_t, DB_RELATION_POOL_SIZE);
 MEMB(attributes_memb, attribute_t, DB_ATTRIBUTE_POOL_SIZE);
@@ -205,6 +250,10 @@ relation_free(relation_t *rel)
 {
   attribute_t *attr;
 
+  if(rel == insert_rel) {
+    relation_flush();
+  }
+
   while((attr = list_pop(rel->attributes)) != NULL) {
     attribute_free(rel, attr);
   }
@@ -467,16 +516,21 @@ relation_remove(char *name, int remove_tuples)
     return DB_BUSY_ERROR;
   }
 
+  if(rel == insert_rel) {
+    /* The relation is dropped, so there is no need to store the rows. */
+    insert_rel = NULL;
+    insert_count = 0;
+  }
+
   result = storage_drop_relation(rel, remove_tuples);
   relation_free(rel);
   return result;
 }
 
-db_result_t
-relation_insert(relation_t *rel, attribute_value_t *values)
+static db_result_t
+build_row(relation_t *rel, attribute_value_t *values, unsigned char *record)
 {
   attribute_t *attr;
-  unsigned char record[rel->row_length];
   unsigned char *ptr;
   attribute_value_t *value;
   db_result_t result;
@@ -533,20 +587,184 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 #endif /* DEBUG */
 
     ptr += attr->element_size;
-    if(attr->index != NULL) {
+  }
+
+  PRINTF(")\n");
+
+  return DB_OK;
+}
+
+db_result_t
+relation_insert(relation_t *rel, attribute_value_t *values)
+{
+  attribute_t *attr;
+  unsigned char record[rel->row_length];
+  attribute_value_t *value;
+  db_result_t result;
+
+  result = build_row(rel, values, record);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  for(attr = list_head(rel->attributes), value = values;
+      attr != NULL;
+      attr = attr->next, value++) {
+    if(attr->index != NULL && !(attr->flags & ATTRIBUTE_FLAG_INVALID)) {
       if(DB_ERROR(index_insert(attr->index, value, rel->next_row))) {
         return DB_INDEX_ERROR;
       }
     }
   }
 
-  PRINTF(")\n");
-
   rel->cardinality++;
   rel->next_row++;
   return storage_put_row(rel, record);
 }
 
+/*
+ * Insert a tuple through the insert buffer. The buffered rows are
+ * appended to the relation with a single write, and the indexes are
+ * updated afterwards in the order of the indexed values. The rows are
+ * written when the buffer is full, when rows are inserted into another
+ * relation, when the relation is read from, and when relation_flush()
+ * is called.
+ *
+ * Rows that are still in the buffer are lost if the system restarts.
+ * Because the rows are stored before the indexes are updated, a restart
+ * during a flush can leave rows that are not indexed, but never index
+ * entries that refer to missing rows.
+ */
+db_result_t
+relation_bulk_insert(relation_t *rel, attribute_value_t *values)
+{
+  db_result_t result;
+
+  if(rel->row_length > sizeof(insert_buffer)) {
+    return relation_insert(rel, values);
+  }
+
+  if(insert_rel != rel ||
+     (insert_count + 1) * rel->row_length > sizeof(insert_buffer) ||
+     insert_count == DB_INSERT_BATCH_LIMIT) {
+    result = relation_flush();
+    if(DB_ERROR(result)) {
+      return result;
+    }
+  }
+
+  result = build_row(rel, values, insert_buffer + insert_count * rel->row_length);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  insert_rel = rel;
+  insert_count++;
+
+  return DB_OK;
+}
+
+static long
+buffered_value(attribute_t *attr, int offset, uint8_t row_no)
+{
+  attribute_value_t value;
+
+  db_phy_to_value(&value, attr,
+                  insert_buffer + row_no * insert_rel->row_length + offset);
+  return db_value_to_long(&value);
+}
+
+static db_result_t
+index_buffered_rows(attribute_t *attr, tuple_id_t first_tuple)
+{
+  uint8_t order[DB_INSERT_BATCH_LIMIT];
+  attribute_value_t value;
+  int offset;
+  int i, j;
+  uint8_t tmp;
+
+  offset = get_attribute_value_offset(insert_rel, attr);
+  if(offset < 0) {
+    return DB_IMPLEMENTATION_ERROR;
+  }
+
+  /* Sort the rows by the indexed value, so that index structures
+     are updated in key order. */
+  for(i = 0; i < insert_count; i++) {
+    tmp = i;
+    for(j = i; j > 0 &&
+          buffered_value(attr, offset, order[j - 1]) >
+          buffered_value(attr, offset, tmp); j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = tmp;
+  }
+
+  for(i = 0; i < insert_count; i++) {
+    db_phy_to_value(&value, attr, insert_buffer +
+                    order[i] * insert_rel->row_length + offset);
+    if(DB_ERROR(index_insert(attr->index, &value, first_tuple + order[i]))) {
+      return DB_INDEX_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+
+db_result_t
+relation_flush(void)
+{
+  relation_t *rel;
+  attribute_t *attr;
+  tuple_id_t first_tuple;
+  db_result_t result;
+  int opened;
+
+  rel = insert_rel;
+  if(rel == NULL || insert_count == 0) {
+    insert_rel = NULL;
+    return DB_OK;
+  }
+
+  PRINTF("DB: Flushing %u buffered rows into relation %s\n",
+         (unsigned)insert_count, rel->name);
+
+  /* The relation may have been released after the rows were inserted. */
+  opened = 0;
+  if(!RELATION_HAS_TUPLES(rel)) {
+    if(DB_ERROR(storage_load(rel))) {
+      return DB_STORAGE_ERROR;
+    }
+    opened = 1;
+  }
+
+  result = storage_put_rows(rel, insert_buffer, insert_count);
+  if(DB_SUCCESS(result)) {
+    first_tuple = rel->next_row;
+    rel->next_row += insert_count;
+    if(rel->cardinality != INVALID_TUPLE) {
+      rel->cardinality += insert_count;
+    }
+
+    for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+      if(attr->index != NULL && !(attr->flags & ATTRIBUTE_FLAG_INVALID)) {
+        if(DB_ERROR(index_buffered_rows(attr, first_tuple))) {
+          result = DB_INDEX_ERROR;
+        }
+      }
+    }
+
+    insert_rel = NULL;
+    insert_count = 0;
+  }
+
+  if(opened) {
+    storage_unload(rel);
+  }
+
+  return result;
+}
+
 static void
 aggregate(attribute_t *attr, attribute_value_t *value)
 {
@@ -630,43 +848,41 @@ generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_coun
 static void
 select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
 {
-  index_t *index;
   attribute_t *attr;
   operand_value_t min;
   operand_value_t max;
   attribute_value_t av_min;
   attribute_value_t av_max;
-  long range;
+  unsigned long range;
   unsigned long min_range;
 
-  index = NULL;
   min_range = ULONG_MAX;
 
   /* Find all indexed and derived attributes, and select the index of 
-     the attribute with the smallest range. */
+     the attribute with the smallest range. An index that cannot
+     handle the range of its attribute is skipped, so that another
+     index may be used instead. */
   for(attr = list_head(handle->rel->attributes);
       attr != NULL;
       attr = attr->next) {
     if(attr->index != NULL &&
        !LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
       range = (unsigned long)max.l - (unsigned long)min.l;
-      PRINTF("DB: The search range for attribute \"%s\" comprises %ld values\n",
+      PRINTF("DB: The search range for attribute \"%s\" comprises %lu values\n",
              attr->name, range + 1);
 
       if(range <= min_range) {
-        index = attr->index;
-        av_min.domain = av_max.domain = DOMAIN_INT;
+        av_min.domain = av_max.domain = DOMAIN_LONG;
         VALUE_LONG(&av_min) = min.l;
         VALUE_LONG(&av_max) = max.l;
-      }
-    }
-  }
 
-  if(index != NULL) {
-    /* We found a suitable index; get an iterator for it. */
-    if(index_get_iterator(&handle->index_iterator, index, 
-                          &av_min, &av_max) == DB_OK) {
-      handle->flags |= DB_HANDLE_FLAG_SEARCH_INDEX;
+        /* Get an iterator for the index, if it supports the range. */
+        if(index_get_iterator(&handle->index_iterator, attr->index,
+                              &av_min, &av_max) == DB_OK) {
+          handle->flags |= DB_HANDLE_FLAG_SEARCH_INDEX;
+          min_range = range;
+        }
+      }
     }
   }
 }
@@ -677,6 +893,7 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
   relation_t *result_rel;
   unsigned attribute_count;
   attribute_t *attr;
+  struct source_dest_map *attr_map_ptr;
 
   result_rel = handle->result_rel;
 
@@ -696,7 +913,24 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
     return DB_IMPLEMENTATION_ERROR;
   }
 
+  if(DB_ERROR(storage_cursor_init(&handle->cursor, rel))) {
+    return DB_STORAGE_ERROR;
+  }
+
   if(adt->lvm_instance != NULL) {
+    /* Resolve the predicate variables to their offsets in the source
+       row once, so that each row can be evaluated in place. */
+    for(attr_map_ptr = attr_map;
+        attr_map_ptr < attr_map + attribute_count;
+        attr_map_ptr++) {
+      if(attr_map_ptr->to_attr->domain == DOMAIN_INT ||
+         attr_map_ptr->to_attr->domain == DOMAIN_LONG) {
+        lvm_bind_variable(attr_map_ptr->to_attr->name,
+                          attr_map_ptr->from_offset,
+                          attr_map_ptr->from_attr->element_size);
+      }
+    }
+
     /* Try to establish acceptable ranges for the attribute values. */
     if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
       select_index(handle, adt->lvm_instance);
@@ -742,7 +976,6 @@ relation_process_select(void *handle_ptr)
   attribute_t *result_attr;
   unsigned char *from_ptr;
   unsigned char *to_ptr;
-  operand_value_t operand_value;
   uint8_t intbuf[2];
   attribute_value_t value;
   lvm_status_t wanted_result;
@@ -771,7 +1004,7 @@ relation_process_select(void *handle_ptr)
 
   /* Put the tuples fulfilling the given condition into a new relation.
      The tuples may be projected. */
-  result = storage_get_row(handle->rel, &handle->tuple_id, row);
+  result = storage_cursor_get_row(&handle->cursor, &handle->tuple_id, row);
   handle->tuple_id++;
   if(DB_ERROR(result)) {
     PRINTF("DB: Failed to get a row in relation %s!\n", handle->rel->name);
@@ -788,18 +1021,6 @@ relation_process_select(void *handle_ptr)
     from_ptr = row + attr_map_ptr->from_offset;
     result_attr = attr_map_ptr->to_attr;
 
-    /* Update the internal state of the PLE. */
-    if(result_attr->domain == DOMAIN_INT) {
-      operand_value.l = from_ptr[0] << 8 | from_ptr[1];
-      lvm_set_variable_value(result_attr->name, operand_value);
-    } else if(result_attr->domain == DOMAIN_LONG) {
-      operand_value.l = (uint32_t)from_ptr[0] << 24 |
-                        (uint32_t)from_ptr[1] << 16 |
-                        (uint32_t)from_ptr[2] << 8 |
-                        from_ptr[3];
-      lvm_set_variable_value(result_attr->name, operand_value);
-    }
-
     if(result_attr->flags & ATTRIBUTE_FLAG_NO_STORE) {
       /* The attribute is used just for the predicate,
          so do not copy the current value into the result. */
@@ -820,7 +1041,7 @@ relation_process_select(void *handle_ptr)
 
   /* Check whether the given predicate is true for this tuple. */
   if(adt->lvm_instance == NULL ||
-     lvm_execute(adt->lvm_instance) == wanted_result) {
+     lvm_execute_row(adt->lvm_instance, row) == wanted_result) {
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
       for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
         from_ptr = row + attr_map_ptr->from_offset;
@@ -887,6 +1108,10 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
   handle->rel = rel;
   handle->adt = adt;
 
+  if(rel == insert_rel && DB_ERROR(relation_flush())) {
+    return DB_STORAGE_ERROR;
+  }
+
   if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
     name = adt->relations[0];
     dir = DB_STORAGE;
@@ -959,6 +1184,212 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
 }
 
 #if DB_FEATURE_JOIN
+static db_result_t
+emit_join_row(db_handle_t *handle)
+{
+  unsigned char *join_next_attribute_ptr;
+  size_t element_size;
+  int i;
+
+  /* Use the source attribute map to fill in the physical representation
+     of the resulting tuple. */
+  join_next_attribute_ptr = join_row;
+
+  for(i = 0; i < handle->join_rel->attribute_count; i++) {
+    element_size = source_map[i].attr->element_size;
+
+    memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
+    join_next_attribute_ptr += element_size;
+  }
+
+  if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(handle->join_rel, join_row))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+get_join_key(attribute_t *attr, unsigned char *ptr, long *key)
+{
+  attribute_value_t value;
+
+  if(DB_ERROR(db_phy_to_value(&value, attr, ptr))) {
+    return DB_IMPLEMENTATION_ERROR;
+  }
+
+  *key = db_value_to_long(&value);
+  return DB_OK;
+}
+
+static db_result_t
+build_hash_table(void)
+{
+  static storage_cursor_t cursor;
+  struct join_hash_entry *entry;
+  tuple_id_t tuple_id;
+  db_result_t result;
+  unsigned bucket;
+  int count;
+
+  memset(join_hash_buckets, 0, sizeof(join_hash_buckets));
+
+  if(DB_ERROR(storage_cursor_init(&cursor, join_state.build_rel))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  tuple_id = join_state.build_next;
+  for(count = 0; count < DB_JOIN_HASH_SIZE; count++, tuple_id++) {
+    result = storage_cursor_get_row(&cursor, &tuple_id, join_state.build_row);
+    if(DB_ERROR(result)) {
+      return result;
+    } else if(result == DB_FINISHED) {
+      break;
+    }
+
+    entry = &join_hash[count];
+    if(DB_ERROR(get_join_key(join_state.build_attr,
+                             join_state.build_row + join_state.build_offset,
+                             &entry->key))) {
+      return DB_IMPLEMENTATION_ERROR;
+    }
+    entry->tuple_id = tuple_id;
+
+    bucket = (unsigned long)entry->key % DB_JOIN_HASH_BUCKETS;
+    entry->next = join_hash_buckets[bucket];
+    join_hash_buckets[bucket] = count + 1;
+  }
+
+  PRINTF("DB: Loaded %d rows of relation %s into the hash table\n",
+         count, join_state.build_rel->name);
+
+  join_state.build_next = tuple_id;
+  return count == 0 ? DB_FINISHED : DB_OK;
+}
+
+/*
+ * The hash join scans the probe relation once for each part of the
+ * build relation that fits in the hash table, and looks up the join
+ * attribute value of each probe row in the table.
+ */
+static db_result_t
+process_hash_join(db_handle_t *handle)
+{
+  struct join_hash_entry *entry;
+  db_result_t result;
+  tuple_id_t tuple_id;
+
+  for(;;) {
+    if(handle->flags & DB_HANDLE_FLAG_INDEX_STEP) {
+      result = storage_cursor_get_row(&handle->cursor, &handle->tuple_id,
+                                      join_state.probe_row);
+      if(DB_ERROR(result)) {
+        PRINTF("DB: Failed to get a row in relation %s!\n",
+               join_state.probe_rel->name);
+        return result;
+      } else if(result == DB_FINISHED) {
+        /* Continue with the next part of the build relation. */
+        result = build_hash_table();
+        if(result != DB_OK) {
+          return result;
+        }
+        handle->tuple_id = 0;
+        if(DB_ERROR(storage_cursor_init(&handle->cursor,
+                                        join_state.probe_rel))) {
+          return DB_STORAGE_ERROR;
+        }
+        continue;
+      }
+      handle->tuple_id++;
+
+      if(DB_ERROR(get_join_key(join_state.probe_attr,
+                               join_state.probe_row + join_state.probe_offset,
+                               &join_state.key))) {
+        return DB_IMPLEMENTATION_ERROR;
+      }
+      join_state.entry =
+        join_hash_buckets[(unsigned long)join_state.key % DB_JOIN_HASH_BUCKETS];
+      handle->flags &= ~DB_HANDLE_FLAG_INDEX_STEP;
+    }
+
+    while(join_state.entry != 0) {
+      entry = &join_hash[join_state.entry - 1];
+      join_state.entry = entry->next;
+      if(entry->key == join_state.key) {
+        tuple_id = entry->tuple_id;
+        result = storage_get_row(join_state.build_rel, &tuple_id,
+                                 join_state.build_row);
+        if(DB_ERROR(result)) {
+          return result;
+        } else if(result == DB_FINISHED) {
+          return DB_IMPLEMENTATION_ERROR;
+        }
+        return emit_join_row(handle);
+      }
+    }
+
+    handle->flags |= DB_HANDLE_FLAG_INDEX_STEP;
+  }
+}
+
+/*
+ * The merge join requires both relations to be sorted on the join
+ * attribute, which is the case for inline-indexed attributes. The
+ * right relation is rewound to the first row of the current key
+ * group whenever the left relation steps to its next row.
+ */
+static db_result_t
+process_merge_join(db_handle_t *handle)
+{
+  db_result_t result;
+  long key;
+
+  for(;;) {
+    if(handle->flags & DB_HANDLE_FLAG_INDEX_STEP) {
+      result = storage_cursor_get_row(&handle->cursor, &handle->tuple_id,
+                                      left_row);
+      if(result != DB_OK) {
+        return result;
+      }
+      handle->tuple_id++;
+
+      if(DB_ERROR(get_join_key(join_state.probe_attr,
+                               left_row + join_state.probe_offset,
+                               &join_state.key))) {
+        return DB_IMPLEMENTATION_ERROR;
+      }
+      join_state.build_next = join_state.group_start;
+      handle->flags &= ~DB_HANDLE_FLAG_INDEX_STEP;
+    }
+
+    result = storage_get_row(join_state.build_rel, &join_state.build_next,
+                             right_row);
+    if(DB_ERROR(result)) {
+      return result;
+    } else if(result == DB_FINISHED) {
+      handle->flags |= DB_HANDLE_FLAG_INDEX_STEP;
+      continue;
+    }
+
+    if(DB_ERROR(get_join_key(join_state.build_attr,
+                             right_row + join_state.build_offset, &key))) {
+      return DB_IMPLEMENTATION_ERROR;
+    }
+
+    if(key < join_state.key) {
+      join_state.group_start = ++join_state.build_next;
+    } else if(key > join_state.key) {
+      handle->flags |= DB_HANDLE_FLAG_INDEX_STEP;
+    } else {
+      join_state.build_next++;
+      return emit_join_row(handle);
+    }
+  }
+}
+
 db_result_t
 relation_process_join(void *handle_ptr)
 {
@@ -966,17 +1397,18 @@ relation_process_join(void *handle_ptr)
   db_result_t result;
   relation_t *left_rel;
   relation_t *right_rel;
-  relation_t *join_rel;
-  unsigned char *join_next_attribute_ptr;
-  size_t element_size;
   tuple_id_t right_tuple_id;
   attribute_value_t value;
-  int i;
 
   handle = (db_handle_t *)handle_ptr;
   left_rel = handle->left_rel;
   right_rel = handle->right_rel;
-  join_rel = handle->join_rel;
+
+  if(handle->flags & DB_HANDLE_FLAG_HASH_JOIN) {
+    return process_hash_join(handle);
+  } else if(handle->flags & DB_HANDLE_FLAG_MERGE_JOIN) {
+    return process_merge_join(handle);
+  }
 
   if(!(handle->flags & DB_HANDLE_FLAG_INDEX_STEP)) {
     goto inner_loop;
@@ -985,7 +1417,8 @@ relation_process_join(void *handle_ptr)
   /* Equi-join for indexed attributes only. In the outer loop, we iterate over
      each tuple in the left relation. */
   for(handle->tuple_id = 0;; handle->tuple_id++) {
-    result = storage_get_row(left_rel, &handle->tuple_id, left_row);
+    result = storage_cursor_get_row(&handle->cursor, &handle->tuple_id,
+                                    left_row);
     if(DB_ERROR(result)) {
       PRINTF("DB: Failed to get a row in left relation %s!\n", left_rel->name);
       return result;
@@ -1030,25 +1463,7 @@ inner_loop:
         return DB_IMPLEMENTATION_ERROR;
       }
 
-      /* Use the source attribute map to fill in the physical representation
-	 of the resulting tuple. */
-      join_next_attribute_ptr = join_row;
-
-      for(i = 0; i < join_rel->attribute_count; i++) {
-	element_size = source_map[i].attr->element_size;
-
-	memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
-	join_next_attribute_ptr += element_size;
-      }
-
-      if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
-        if(DB_ERROR(storage_put_row(join_rel, join_row))) {
-          return DB_STORAGE_ERROR;
-        }
-      }
-
-      handle->current_row++;
-      return DB_GOT_ROW;
+      return emit_join_row(handle);
     }
   }
 
@@ -1102,11 +1517,100 @@ generate_join_result(db_handle_t *handle)
     source_pair->from_ptr = from_ptr;
   }
 
+  if(DB_ERROR(storage_cursor_init(&handle->cursor, left_rel))) {
+    return DB_STORAGE_ERROR;
+  }
+
   handle->flags |= DB_HANDLE_FLAG_PROCESSING;
 
   return DB_OK;
 }
 
+static int
+is_inline_indexed(attribute_t *attr)
+{
+  return index_exists(attr) && ((index_t *)attr->index)->type == INDEX_INLINE;
+}
+
+static db_result_t
+select_join_method(db_handle_t *handle)
+{
+  tuple_id_t left_cardinality;
+  tuple_id_t right_cardinality;
+  int left_offset;
+  int right_offset;
+  db_result_t result;
+
+  left_cardinality = relation_cardinality(handle->left_rel);
+  right_cardinality = relation_cardinality(handle->right_rel);
+  left_offset = get_attribute_value_offset(handle->left_rel,
+                                           handle->left_join_attr);
+  right_offset = get_attribute_value_offset(handle->right_rel,
+                                            handle->right_join_attr);
+  if(left_cardinality == INVALID_TUPLE || right_cardinality == INVALID_TUPLE ||
+     left_offset < 0 || right_offset < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(is_inline_indexed(handle->left_join_attr) &&
+     is_inline_indexed(handle->right_join_attr)) {
+    /* Both relations are sorted on the join attribute. */
+    PRINTF("DB: Using a merge join\n");
+    join_state.probe_attr = handle->left_join_attr;
+    join_state.probe_offset = left_offset;
+    join_state.build_rel = handle->right_rel;
+    join_state.build_attr = handle->right_join_attr;
+    join_state.build_offset = right_offset;
+    join_state.build_next = join_state.group_start = 0;
+    handle->flags |= DB_HANDLE_FLAG_MERGE_JOIN;
+    return DB_OK;
+  }
+
+  /*
+   * An index join looks up each left row in the index of the right
+   * relation. A hash join is preferred when it needs only a single
+   * scan of each relation, or when there is no index to use.
+   */
+  if(index_exists(handle->right_join_attr) &&
+     left_cardinality > DB_JOIN_HASH_SIZE &&
+     right_cardinality > DB_JOIN_HASH_SIZE) {
+    PRINTF("DB: Using an index join\n");
+    return DB_OK;
+  }
+
+  PRINTF("DB: Using a hash join\n");
+
+  /* Build the hash table from the smaller relation. */
+  if(left_cardinality < right_cardinality) {
+    join_state.build_rel = handle->left_rel;
+    join_state.build_attr = handle->left_join_attr;
+    join_state.build_row = left_row;
+    join_state.build_offset = left_offset;
+    join_state.probe_rel = handle->right_rel;
+    join_state.probe_attr = handle->right_join_attr;
+    join_state.probe_row = right_row;
+    join_state.probe_offset = right_offset;
+  } else {
+    join_state.build_rel = handle->right_rel;
+    join_state.build_attr = handle->right_join_attr;
+    join_state.build_row = right_row;
+    join_state.build_offset = right_offset;
+    join_state.probe_rel = handle->left_rel;
+    join_state.probe_attr = handle->left_join_attr;
+    join_state.probe_row = left_row;
+    join_state.probe_offset = left_offset;
+  }
+  join_state.build_next = 0;
+  handle->flags |= DB_HANDLE_FLAG_HASH_JOIN;
+
+  if(DB_ERROR(storage_cursor_init(&handle->cursor, join_state.probe_rel))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  result = build_hash_table();
+  return DB_ERROR(result) ? result : DB_OK;
+}
+
 db_result_t
 relation_join(void *query_result, void *adt_ptr)
 {
@@ -1120,6 +1624,7 @@ relation_join(void *query_result, void *adt_ptr)
   int i;
   char *attribute_name;
   attribute_t *attr;
+  db_result_t result;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -1150,6 +1655,11 @@ relation_join(void *query_result, void *adt_ptr)
   left_rel = handle->left_rel;
   right_rel = handle->right_rel;
 
+  if((left_rel == insert_rel || right_rel == insert_rel) &&
+     DB_ERROR(relation_flush())) {
+    return DB_STORAGE_ERROR;
+  }
+
   handle->left_join_attr = relation_attribute_get(left_rel, adt->attributes[0].name);
   handle->right_join_attr = relation_attribute_get(right_rel, adt->attributes[0].name);
   if(handle->left_join_attr == NULL || handle->right_join_attr == NULL) {
@@ -1158,9 +1668,12 @@ relation_join(void *query_result, void *adt_ptr)
     return DB_RELATIONAL_ERROR;
   }
 
-  if(!index_exists(handle->right_join_attr)) {
-    PRINTF("DB: The attribute to join on is not indexed\n");
-    return DB_INDEX_ERROR;
+  if((handle->left_join_attr->domain != DOMAIN_INT &&
+      handle->left_join_attr->domain != DOMAIN_LONG) ||
+     (handle->right_join_attr->domain != DOMAIN_INT &&
+      handle->right_join_attr->domain != DOMAIN_LONG)) {
+    PRINTF("DB: The attribute to join on is not a number\n");
+    return DB_TYPE_ERROR;
   }
 
   /*
@@ -1189,7 +1702,12 @@ relation_join(void *query_result, void *adt_ptr)
     handle->ncolumns++;
   }
 
-  return generate_join_result(handle);
+  result = generate_join_result(handle);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  return select_join_method(handle);
 }
 #endif /* DB_FEATURE_JOIN */
 
@@ -1199,6 +1717,10 @@ relation_cardinality(relation_t *rel)
   tuple_id_t tuple_id;
 
 
+  if(rel == insert_rel && DB_ERROR(relation_flush())) {
+    return INVALID_TUPLE;
+  }
+
   if(rel->cardinality != INVALID_TUPLE) {
     return rel->cardinality;
   }
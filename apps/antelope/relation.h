@@ -95,6 +95,8 @@ db_result_t relation_attribute_remove(relation_t *, char *);
 db_result_t relation_set_primary_key(relation_t *, char *);
 db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
+db_result_t relation_bulk_insert(relation_t *, attribute_value_t *);
+db_result_t relation_flush(void);
 db_result_t relation_select(void *, relation_t *, void *);
 db_result_t relation_join(void *, void *);
 tuple_id_t relation_cardinality(relation_t *);
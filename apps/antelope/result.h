@@ -49,6 +49,8 @@ typedef unsigned char *tuple_t;
 #define DB_HANDLE_FLAG_INDEX_STEP	0x01
 #define DB_HANDLE_FLAG_SEARCH_INDEX	0x02
 #define DB_HANDLE_FLAG_PROCESSING	0x04
+#define DB_HANDLE_FLAG_HASH_JOIN	0x08
+#define DB_HANDLE_FLAG_MERGE_JOIN	0x10
 
 struct db_handle {
   index_iterator_t index_iterator;
@@ -61,6 +63,7 @@ struct db_handle {
   relation_t *result_rel;
   attribute_t *left_join_attr;
   attribute_t *right_join_attr;
+  storage_cursor_t cursor;
   tuple_t tuple;
   uint8_t flags;
   uint8_t ncolumns;
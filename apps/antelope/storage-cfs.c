@@ -68,6 +68,9 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+static unsigned char scan_buffer[DB_SCAN_BUFFER_SIZE];
+static storage_cursor_t *scan_owner;
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -439,11 +442,26 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 
 db_result_t
 storage_put_row(relation_t *rel, storage_row_t row)
+{
+  return storage_put_rows(rel, row, 1);
+}
+
+static void
+xor_last_bytes(relation_t *rel, storage_row_t rows, unsigned count)
+{
+  while(count-- > 0) {
+    rows += rel->row_length;
+    rows[-1] ^= ROW_XOR;
+  }
+}
+
+db_result_t
+storage_put_rows(relation_t *rel, storage_row_t rows, unsigned count)
 {
   cfs_offset_t end;
   unsigned remaining;
   int r;
-  unsigned char *last_byte;
+  unsigned char *ptr;
 #if DB_FEATURE_INTEGRITY
   int missing_bytes;
   char buf[rel->row_length];
@@ -467,24 +485,24 @@ storage_put_row(relation_t *rel, storage_row_t row)
 
   /* Ensure that last written byte is separated from 0, to make file
      lengths correct in Coffee. */
-  last_byte = row + rel->row_length - 1;
-  *last_byte ^= ROW_XOR;
+  xor_last_bytes(rel, rows, count);
 
-  remaining = rel->row_length;
+  ptr = rows;
+  remaining = count * rel->row_length;
   do {
-    r = cfs_write(rel->tuple_storage, row, remaining);
+    r = cfs_write(rel->tuple_storage, ptr, remaining);
     if(r < 0) {
       PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
+      xor_last_bytes(rel, rows, count);
       return DB_STORAGE_ERROR;
     }
-    row += r;
+    ptr += r;
     remaining -= r;
   } while(remaining > 0);
 
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  PRINTF("DB: Stored %u rows of %d bytes\n", count, rel->row_length);
 
-  *last_byte ^= ROW_XOR;
+  xor_last_bytes(rel, rows, count);
 
   return DB_OK;
 }
@@ -508,6 +526,90 @@ storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
   return DB_OK;
 }
 
+db_result_t
+storage_cursor_init(storage_cursor_t *cursor, relation_t *rel)
+{
+  if(scan_owner == cursor) {
+    scan_owner = NULL;
+  }
+
+  memset(cursor, 0, sizeof(*cursor));
+  cursor->rel = rel;
+
+  return storage_get_row_amount(rel, &cursor->row_count);
+}
+
+db_result_t
+storage_cursor_get_row(storage_cursor_t *cursor, tuple_id_t *tuple_id,
+                       storage_row_t row)
+{
+  relation_t *rel;
+  unsigned rows;
+  unsigned length;
+  unsigned char *ptr;
+  int r;
+
+  rel = cursor->rel;
+
+  if(*tuple_id >= cursor->row_count) {
+    return DB_FINISHED;
+  }
+
+  if(scan_owner != cursor || *tuple_id < cursor->first ||
+     *tuple_id >= cursor->first + cursor->count) {
+    rows = sizeof(scan_buffer) / rel->row_length;
+    if(rows == 0) {
+      /* The rows do not fit in the buffer. */
+      return storage_get_row(rel, tuple_id, row);
+    }
+
+    /* Read ahead only if the rows are accessed in sequence. */
+    if(*tuple_id != cursor->next) {
+      rows = 1;
+    } else if(rows > cursor->row_count - *tuple_id) {
+      rows = cursor->row_count - *tuple_id;
+    }
+
+    if(cfs_seek(rel->tuple_storage, *tuple_id * rel->row_length,
+                CFS_SEEK_SET) == (cfs_offset_t)-1) {
+      return DB_STORAGE_ERROR;
+    }
+
+    scan_owner = NULL;
+    ptr = scan_buffer;
+    length = rows * rel->row_length;
+    while(length > 0) {
+      r = cfs_read(rel->tuple_storage, ptr, length);
+      if(r < 0) {
+        PRINTF("DB: Reading failed on fd %d\n", rel->tuple_storage);
+        return DB_STORAGE_ERROR;
+      } else if(r == 0) {
+        break;
+      }
+      ptr += r;
+      length -= r;
+    }
+
+    rows = (ptr - scan_buffer) / rel->row_length;
+    if(rows == 0) {
+      return DB_FINISHED;
+    }
+
+    PRINTF("DB: Read %u rows ahead from relation %s\n", rows, rel->name);
+
+    scan_owner = cursor;
+    cursor->first = *tuple_id;
+    cursor->count = rows;
+  }
+
+  memcpy(row, scan_buffer + (*tuple_id - cursor->first) * rel->row_length,
+         rel->row_length);
+  row[rel->row_length - 1] ^= ROW_XOR;
+  cursor->next = *tuple_id + 1;
+
+  return DB_OK;
+}
+
 db_storage_id_t
 storage_open(const char *filename)
 {
@@ -50,6 +50,19 @@
 
 typedef unsigned char * storage_row_t;
 
+/*
+ * A cursor for scanning the rows of a relation. The number of rows is
+ * determined once when the cursor is initialized, and rows are read
+ * ahead into a buffer that is shared by all cursors.
+ */
+typedef struct storage_cursor {
+  relation_t *rel;
+  tuple_id_t row_count;
+  tuple_id_t first;
+  tuple_id_t next;
+  unsigned count;
+} storage_cursor_t;
+
 char *storage_generate_file(char *, unsigned long);
 
 db_result_t storage_load(relation_t *);
@@ -66,8 +79,13 @@ db_result_t storage_put_index(index_t *);
 
 db_result_t storage_get_row(relation_t *, tuple_id_t *, storage_row_t);
 db_result_t storage_put_row(relation_t *, storage_row_t);
+db_result_t storage_put_rows(relation_t *, storage_row_t, unsigned);
 db_result_t storage_get_row_amount(relation_t *, tuple_id_t *);
 
+db_result_t storage_cursor_init(storage_cursor_t *, relation_t *);
+db_result_t storage_cursor_get_row(storage_cursor_t *, tuple_id_t *,
+                                   storage_row_t);
+
 db_storage_id_t storage_open(const char *);
 void storage_close(db_storage_id_t);
 db_result_t storage_read(db_storage_id_t, void *, unsigned long, unsigned);
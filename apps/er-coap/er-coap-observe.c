@@ -180,6 +180,9 @@ coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
 /*---------------------------------------------------------------------------*/
 /*- Notification ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+static void notify_observers(resource_t *resource, const char *subpath,
+                             int sub_resources);
+/*---------------------------------------------------------------------------*/
 void
 coap_notify_observers(resource_t *resource)
 {
@@ -187,6 +190,17 @@ coap_notify_observers(resource_t *resource)
 }
 void
 coap_notify_observers_sub(resource_t *resource, const char *subpath)
+{
+  notify_observers(resource, subpath, 1);
+}
+/* Notifies only the observers of exactly this path, not of those below it */
+void
+coap_notify_observers_path(resource_t *resource, const char *subpath)
+{
+  notify_observers(resource, subpath, 0);
+}
+static void
+notify_observers(resource_t *resource, const char *subpath, int sub_resources)
 {
   /* build notification */
   coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
@@ -219,7 +233,7 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
     /* Do a match based on the parent/sub-resource match so that it is
        possible to do parent-node observe */
     if((obs_url_len == url_len
-        || (obs_url_len > url_len
+        || (obs_url_len > url_len && sub_resources
             && (resource->flags & HAS_SUB_RESOURCES)
             && obs->url[url_len] == '/'))
        && strncmp(url, obs->url, url_len) == 0) {
@@ -81,6 +81,7 @@ int coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port,
 
 void coap_notify_observers(resource_t *resource);
 void coap_notify_observers_sub(resource_t *resource, const char *subpath);
+void coap_notify_observers_path(resource_t *resource, const char *subpath);
 
 void coap_observe_handler(resource_t *resource, void *request,
                           void *response);
@@ -131,9 +131,9 @@ PROCESS_THREAD(ipso_button_process, ev, data)
         input_state = 1;
         counter++;
         if((edge_selection & 2) != 0) {
-          lwm2m_object_notify_observers(&button, "/0/5500");
+          lwm2m_engine_notify_changed(&button, 0, 5500);
         }
-        lwm2m_object_notify_observers(&button, "/0/5501");
+        lwm2m_engine_notify_changed(&button, 0, 5501);
 
         time = (debounce_time * CLOCK_SECOND / 1000);
         if(time < 1) {
@@ -150,7 +150,7 @@ PROCESS_THREAD(ipso_button_process, ev, data)
       } else {
         input_state = 0;
         if((edge_selection & 1) != 0) {
-          lwm2m_object_notify_observers(&button, "/0/5500");
+          lwm2m_engine_notify_changed(&button, 0, 5500);
         }
       }
     }
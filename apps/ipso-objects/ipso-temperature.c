@@ -108,11 +108,11 @@ read_temp(int32_t *value)
 
   if(*value < min_temp) {
     min_temp = *value;
-    lwm2m_object_notify_observers(&temperature, "/0/5601");
+    lwm2m_engine_notify_changed(&temperature, 0, 5601);
   }
   if(*value > max_temp) {
     max_temp = *value;
-    lwm2m_object_notify_observers(&temperature, "/0/5602");
+    lwm2m_engine_notify_changed(&temperature, 0, 5602);
   }
   return 1;
 #else /* IPSO_TEMPERATURE */
@@ -129,7 +129,7 @@ handle_periodic_timer(void *ptr)
   /* Only notify when the value has changed since last */
   if(read_temp(&v) && v != last_value) {
     last_value = v;
-    lwm2m_object_notify_observers(&temperature, "/0/5700");
+    lwm2m_engine_notify_changed(&temperature, 0, 5700);
   }
   ctimer_reset(&periodic_timer);
 }
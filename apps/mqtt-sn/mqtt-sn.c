@@ -0,0 +1,1361 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \addtogroup mqtt-sn-engine
+ * @{
+ */
+/**
+ * \file
+ *    Implementation of the Contiki MQTT-SN client
+ */
+/*---------------------------------------------------------------------------*/
+#include "mqtt-sn.h"
+#include "contiki.h"
+#include "contiki-net.h"
+#include "sys/ctimer.h"
+#include "net/ip/uiplib.h"
+#include "net/ip/simple-udp.h"
+
+#include "lib/list.h"
+#include "sys/cc.h"
+
+#include <string.h>
+#include <stdio.h>
+/*---------------------------------------------------------------------------*/
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+/*---------------------------------------------------------------------------*/
+typedef enum {
+  MQTT_SN_MSG_TYPE_CONNECT     = 0x04,
+  MQTT_SN_MSG_TYPE_CONNACK     = 0x05,
+  MQTT_SN_MSG_TYPE_REGISTER    = 0x0A,
+  MQTT_SN_MSG_TYPE_REGACK      = 0x0B,
+  MQTT_SN_MSG_TYPE_PUBLISH     = 0x0C,
+  MQTT_SN_MSG_TYPE_PUBACK      = 0x0D,
+  MQTT_SN_MSG_TYPE_PUBCOMP     = 0x0E,
+  MQTT_SN_MSG_TYPE_PUBREC      = 0x0F,
+  MQTT_SN_MSG_TYPE_PUBREL      = 0x10,
+  MQTT_SN_MSG_TYPE_SUBSCRIBE   = 0x12,
+  MQTT_SN_MSG_TYPE_SUBACK      = 0x13,
+  MQTT_SN_MSG_TYPE_UNSUBSCRIBE = 0x14,
+  MQTT_SN_MSG_TYPE_UNSUBACK    = 0x15,
+  MQTT_SN_MSG_TYPE_PINGREQ     = 0x16,
+  MQTT_SN_MSG_TYPE_PINGRESP    = 0x17,
+  MQTT_SN_MSG_TYPE_DISCONNECT  = 0x18,
+} mqtt_sn_msg_type_t;
+/*---------------------------------------------------------------------------*/
+typedef enum {
+  MQTT_SN_FLAG_DUP               = 0x80,
+  MQTT_SN_FLAG_QOS_MASK          = 0x60,
+  MQTT_SN_FLAG_RETAIN            = 0x10,
+  MQTT_SN_FLAG_WILL              = 0x08,
+  MQTT_SN_FLAG_CLEAN_SESSION     = 0x04,
+
+  MQTT_SN_FLAG_TOPIC_TYPE_MASK   = 0x03,
+  MQTT_SN_FLAG_TOPIC_NORMAL      = 0x00,
+  MQTT_SN_FLAG_TOPIC_PREDEFINED  = 0x01,
+  MQTT_SN_FLAG_TOPIC_SHORT       = 0x02,
+} mqtt_sn_flags_t;
+
+#define MQTT_SN_FLAG_QOS(qos)      (((qos) << 5) & MQTT_SN_FLAG_QOS_MASK)
+#define MQTT_SN_FLAG_GET_QOS(f)    (((f) & MQTT_SN_FLAG_QOS_MASK) >> 5)
+/*---------------------------------------------------------------------------*/
+typedef enum {
+  MQTT_SN_RC_ACCEPTED,
+  MQTT_SN_RC_CONGESTION,
+  MQTT_SN_RC_INVALID_TOPIC_ID,
+  MQTT_SN_RC_NOT_SUPPORTED,
+} mqtt_sn_return_code_t;
+/*---------------------------------------------------------------------------*/
+/* States of the entries in the outbound queue */
+typedef enum {
+  OUT_MSG_FREE,
+  OUT_MSG_WAIT_TOPIC,
+  OUT_MSG_QUEUED,
+  OUT_MSG_SENT,
+  OUT_MSG_PUBREL_SENT,
+} out_msg_state_t;
+
+#define NO_TOPIC                0xFF
+#define MQTT_SN_PROTOCOL_ID     0x01
+#define MQTT_SN_SHORT_TOPIC_LEN 2
+/*---------------------------------------------------------------------------*/
+process_event_t mqtt_sn_update_event;
+
+LIST(mqtt_sn_conn_list);
+/*---------------------------------------------------------------------------*/
+static void schedule_retry(struct mqtt_sn_connection *conn);
+static void process_queue(struct mqtt_sn_connection *conn);
+/*---------------------------------------------------------------------------*/
+static void
+call_event(struct mqtt_sn_connection *conn, mqtt_sn_event_t event,
+           void *data)
+{
+  conn->event_callback(conn, event, data);
+  process_post(conn->app_process, mqtt_sn_update_event, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+call_ack_event(struct mqtt_sn_connection *conn, mqtt_sn_event_t event,
+               uint16_t mid, uint16_t topic_id, uint8_t return_code)
+{
+  struct mqtt_sn_ack_event ack;
+
+  ack.mid = mid;
+  ack.topic_id = topic_id;
+  ack.return_code = return_code;
+  ack.qos_level = MQTT_SN_QOS_LEVEL_0;
+  call_event(conn, event, &ack);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+next_mid(struct mqtt_sn_connection *conn)
+{
+  if(++conn->mid_counter == 0) {
+    conn->mid_counter = 1;
+  }
+  return conn->mid_counter;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+put16(uint8_t *p, uint16_t v)
+{
+  *p++ = v >> 8;
+  *p++ = v & 0x00FF;
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Writes the message header for a message with a body of body_len bytes and
+ * returns a pointer to where the body goes.
+ */
+static uint8_t *
+put_header(uint8_t *buf, uint16_t body_len, uint8_t type)
+{
+  if(body_len + 2 <= 255) {
+    *buf++ = body_len + 2;
+  } else {
+    *buf++ = 0x01;
+    buf = put16(buf, body_len + 4);
+  }
+  *buf++ = type;
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_raw(struct mqtt_sn_connection *conn, const uint8_t *buf, uint16_t len)
+{
+  simple_udp_sendto_port(&conn->udp, buf, len, &conn->server_ip,
+                         conn->server_port);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends one of the short acknowledgements consisting of a message ID */
+static void
+send_mid_msg(struct mqtt_sn_connection *conn, uint8_t type, uint16_t mid)
+{
+  uint8_t buf[4];
+
+  put16(put_header(buf, 2, type), mid);
+  send_raw(conn, buf, sizeof(buf));
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_ack(struct mqtt_sn_connection *conn, uint8_t type, uint16_t topic_id,
+         uint16_t mid, uint8_t return_code)
+{
+  uint8_t buf[7];
+  uint8_t *p;
+
+  p = put_header(buf, 5, type);
+  p = put16(p, topic_id);
+  p = put16(p, mid);
+  *p = return_code;
+  send_raw(conn, buf, sizeof(buf));
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Requests are built in conn->request.buf by the caller. They are kept there
+ * until they are acknowledged so that they can be retransmitted.
+ */
+static void
+send_request(struct mqtt_sn_connection *conn, uint8_t type, uint16_t mid,
+             uint8_t length)
+{
+  conn->request.type = type;
+  conn->request.mid = mid;
+  conn->request.length = length;
+  conn->request.retries = 0;
+  conn->request.sent = clock_time();
+  send_raw(conn, conn->request.buf, length);
+  schedule_retry(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+clear_request(struct mqtt_sn_connection *conn)
+{
+  conn->request.type = 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_sn_topic *
+topic_lookup_name(struct mqtt_sn_connection *conn, const char *name)
+{
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_MAX_TOPICS; i++) {
+    if(conn->topics[i].name[0] != '\0' &&
+       strcmp(conn->topics[i].name, name) == 0) {
+      return &conn->topics[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_sn_topic *
+topic_lookup_id(struct mqtt_sn_connection *conn, uint16_t id)
+{
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_MAX_TOPICS; i++) {
+    if(conn->topics[i].registered && conn->topics[i].id == id) {
+      return &conn->topics[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+topic_in_use(struct mqtt_sn_connection *conn, uint8_t index)
+{
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    if(conn->out_queue[i].state != OUT_MSG_FREE &&
+       conn->out_queue[i].topic == index) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns a cache entry for a topic name. Entries that no queued message
+ * refers to are reused when the cache is full.
+ */
+static struct mqtt_sn_topic *
+topic_add(struct mqtt_sn_connection *conn, const char *name)
+{
+  struct mqtt_sn_topic *t;
+  uint8_t i;
+
+  t = topic_lookup_name(conn, name);
+  if(t != NULL) {
+    return t;
+  }
+
+  for(i = 0; i < MQTT_SN_MAX_TOPICS; i++) {
+    if(conn->topics[i].name[0] == '\0') {
+      break;
+    }
+  }
+  if(i == MQTT_SN_MAX_TOPICS) {
+    for(i = 0; i < MQTT_SN_MAX_TOPICS; i++) {
+      if(!topic_in_use(conn, i)) {
+        break;
+      }
+    }
+    if(i == MQTT_SN_MAX_TOPICS) {
+      return NULL;
+    }
+  }
+
+  t = &conn->topics[i];
+  t->registered = 0;
+  t->id = 0;
+  strcpy(t->name, name);
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_sn_out_msg *
+out_msg_lookup(struct mqtt_sn_connection *conn, uint16_t mid, uint8_t state)
+{
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    if(conn->out_queue[i].state == state && conn->out_queue[i].mid == mid) {
+      return &conn->out_queue[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_publish(struct mqtt_sn_connection *conn, struct mqtt_sn_out_msg *msg)
+{
+  uint8_t buf[MQTT_SN_MAX_PACKET_SIZE];
+  uint8_t *p;
+
+  p = put_header(buf, 5 + msg->payload_length, MQTT_SN_MSG_TYPE_PUBLISH);
+  *p++ = msg->flags;
+  p = put16(p, msg->topic_id);
+  p = put16(p, msg->mid);
+  memcpy(p, msg->payload, msg->payload_length);
+  p += msg->payload_length;
+  send_raw(conn, buf, p - buf);
+
+  if(MQTT_SN_FLAG_GET_QOS(msg->flags) == MQTT_SN_QOS_LEVEL_0) {
+    msg->state = OUT_MSG_FREE;
+  } else {
+    msg->state = OUT_MSG_SENT;
+    msg->sent = clock_time();
+    /* Any retransmission is a duplicate */
+    msg->flags |= MQTT_SN_FLAG_DUP;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_register(struct mqtt_sn_connection *conn, struct mqtt_sn_topic *t)
+{
+  uint16_t mid;
+  uint8_t len;
+  uint8_t *p;
+
+  len = strlen(t->name);
+  mid = next_mid(conn);
+  p = put_header(conn->request.buf, 4 + len, MQTT_SN_MSG_TYPE_REGISTER);
+  p = put16(p, 0);
+  p = put16(p, mid);
+  memcpy(p, t->name, len);
+  p += len;
+  send_request(conn, MQTT_SN_MSG_TYPE_REGISTER, mid, p - conn->request.buf);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_connect(struct mqtt_sn_connection *conn, uint8_t flags)
+{
+  uint8_t *p;
+
+  p = put_header(conn->request.buf, 4 + conn->client_id_length,
+                 MQTT_SN_MSG_TYPE_CONNECT);
+  *p++ = flags;
+  *p++ = MQTT_SN_PROTOCOL_ID;
+  p = put16(p, conn->keep_alive);
+  memcpy(p, conn->client_id, conn->client_id_length);
+  p += conn->client_id_length;
+  send_request(conn, MQTT_SN_MSG_TYPE_CONNECT, 0, p - conn->request.buf);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Called when the gateway no longer knows the topic IDs we were given, i.e.
+ * after a clean session CONNECT. Messages waiting to be sent on such topics
+ * have to wait for a new registration.
+ */
+static void
+invalidate_topics(struct mqtt_sn_connection *conn)
+{
+  struct mqtt_sn_out_msg *msg;
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_MAX_TOPICS; i++) {
+    conn->topics[i].registered = 0;
+  }
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    msg = &conn->out_queue[i];
+    if(msg->state != OUT_MSG_FREE && msg->topic != NO_TOPIC) {
+      msg->state = OUT_MSG_WAIT_TOPIC;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Messages that were sent but not acknowledged are sent again */
+static void
+requeue_unacked(struct mqtt_sn_connection *conn)
+{
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    if(conn->out_queue[i].state == OUT_MSG_SENT) {
+      conn->out_queue[i].state = OUT_MSG_QUEUED;
+      conn->out_queue[i].retries = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+connection_lost(struct mqtt_sn_connection *conn)
+{
+  PRINTF("MQTT-SN - Lost connection to gateway\n");
+  conn->state = MQTT_SN_CONN_STATE_NOT_CONNECTED;
+  clear_request(conn);
+  ctimer_stop(&conn->keep_alive_timer);
+  requeue_unacked(conn);
+  call_event(conn, MQTT_SN_EVENT_DISCONNECTED, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+keep_alive_callback(void *ptr)
+{
+  struct mqtt_sn_connection *conn = ptr;
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_CONN_STATE_CONNECTED) {
+    return;
+  }
+
+  /* A pending request already tells the gateway that we are alive */
+  if(conn->request.type == 0) {
+    p = put_header(conn->request.buf, 0, MQTT_SN_MSG_TYPE_PINGREQ);
+    send_request(conn, MQTT_SN_MSG_TYPE_PINGREQ, 0, p - conn->request.buf);
+  }
+  ctimer_restart(&conn->keep_alive_timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_timed_out(struct mqtt_sn_connection *conn)
+{
+  uint8_t type = conn->request.type;
+  uint16_t mid = conn->request.mid;
+  uint8_t i;
+
+  PRINTF("MQTT-SN - Request 0x%02x timed out\n", type);
+  clear_request(conn);
+
+  switch(type) {
+  case MQTT_SN_MSG_TYPE_CONNECT:
+    conn->state = MQTT_SN_CONN_STATE_NOT_CONNECTED;
+    call_event(conn, MQTT_SN_EVENT_TIMEOUT_ERROR, NULL);
+    break;
+  case MQTT_SN_MSG_TYPE_PINGREQ:
+    if(conn->state == MQTT_SN_CONN_STATE_AWAKE) {
+      conn->state = MQTT_SN_CONN_STATE_ASLEEP;
+      call_event(conn, MQTT_SN_EVENT_TIMEOUT_ERROR, NULL);
+    } else {
+      connection_lost(conn);
+    }
+    break;
+  case MQTT_SN_MSG_TYPE_DISCONNECT:
+    /* Whatever the gateway thinks, we are gone */
+    conn->state = conn->sleep_duration ?
+      MQTT_SN_CONN_STATE_ASLEEP : MQTT_SN_CONN_STATE_NOT_CONNECTED;
+    call_event(conn, conn->sleep_duration ?
+               MQTT_SN_EVENT_ASLEEP : MQTT_SN_EVENT_DISCONNECTED, NULL);
+    break;
+  case MQTT_SN_MSG_TYPE_REGISTER:
+    /* Drop the messages that were waiting for a topic ID */
+    for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+      if(conn->out_queue[i].state == OUT_MSG_WAIT_TOPIC) {
+        conn->out_queue[i].state = OUT_MSG_FREE;
+        call_ack_event(conn, MQTT_SN_EVENT_TIMEOUT_ERROR,
+                       conn->out_queue[i].mid, 0, 0);
+      }
+    }
+    break;
+  default:
+    call_ack_event(conn, MQTT_SN_EVENT_TIMEOUT_ERROR, mid, 0, 0);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Retransmits whatever has not been acknowledged in time */
+static void
+retry_callback(void *ptr)
+{
+  struct mqtt_sn_connection *conn = ptr;
+  struct mqtt_sn_out_msg *msg;
+  clock_time_t now = clock_time();
+  uint8_t i;
+
+  /*
+   * A sleeping client stays silent. Unacknowledged messages are sent
+   * again once it has reconnected.
+   */
+  if(conn->state == MQTT_SN_CONN_STATE_ASLEEP) {
+    return;
+  }
+
+  if(conn->request.type != 0 &&
+     now - conn->request.sent >= MQTT_SN_RETRY_TIMEOUT) {
+    if(conn->request.retries < MQTT_SN_MAX_RETRIES) {
+      conn->request.retries++;
+      conn->request.sent = now;
+      send_raw(conn, conn->request.buf, conn->request.length);
+    } else {
+      request_timed_out(conn);
+    }
+  }
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    msg = &conn->out_queue[i];
+    if((msg->state != OUT_MSG_SENT && msg->state != OUT_MSG_PUBREL_SENT) ||
+       now - msg->sent < MQTT_SN_RETRY_TIMEOUT) {
+      continue;
+    }
+    if(msg->retries >= MQTT_SN_MAX_RETRIES) {
+      msg->state = OUT_MSG_FREE;
+      call_ack_event(conn, MQTT_SN_EVENT_TIMEOUT_ERROR, msg->mid,
+                     msg->topic_id, 0);
+      continue;
+    }
+    msg->retries++;
+    if(msg->state == OUT_MSG_SENT) {
+      send_publish(conn, msg);
+    } else {
+      send_mid_msg(conn, MQTT_SN_MSG_TYPE_PUBREL, msg->mid);
+      msg->sent = now;
+    }
+  }
+
+  process_queue(conn);
+  schedule_retry(conn);
+}
+/*---------------------------------------------------------------------------*/
+/* Arms the retry timer for the earliest pending retransmission */
+static void
+schedule_retry(struct mqtt_sn_connection *conn)
+{
+  struct mqtt_sn_out_msg *msg;
+  clock_time_t now = clock_time();
+  clock_time_t next = MQTT_SN_RETRY_TIMEOUT;
+  clock_time_t elapsed;
+  uint8_t pending = 0;
+  uint8_t i;
+
+  if(conn->request.type != 0) {
+    elapsed = now - conn->request.sent;
+    next = elapsed < MQTT_SN_RETRY_TIMEOUT ?
+      MQTT_SN_RETRY_TIMEOUT - elapsed : 0;
+    pending = 1;
+  }
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    msg = &conn->out_queue[i];
+    if(msg->state == OUT_MSG_SENT || msg->state == OUT_MSG_PUBREL_SENT) {
+      elapsed = now - msg->sent;
+      if(elapsed >= MQTT_SN_RETRY_TIMEOUT) {
+        next = 0;
+      } else if(MQTT_SN_RETRY_TIMEOUT - elapsed < next) {
+        next = MQTT_SN_RETRY_TIMEOUT - elapsed;
+      }
+      pending = 1;
+    }
+  }
+
+  if(pending) {
+    ctimer_set(&conn->retry_timer, next > 0 ? next : 1, retry_callback, conn);
+  } else {
+    ctimer_stop(&conn->retry_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Registers the next topic that messages are waiting for and sends every
+ * message that is ready, unless it is being held back for a batch.
+ */
+static void
+send_queued(struct mqtt_sn_connection *conn)
+{
+  struct mqtt_sn_out_msg *msg;
+  uint8_t sent = 0;
+  uint8_t i;
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    msg = &conn->out_queue[i];
+    if(msg->state == OUT_MSG_QUEUED) {
+      send_publish(conn, msg);
+      sent = 1;
+    }
+  }
+  if(sent) {
+    schedule_retry(conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+batch_callback(void *ptr)
+{
+  struct mqtt_sn_connection *conn = ptr;
+
+  if(conn->state == MQTT_SN_CONN_STATE_CONNECTED) {
+    send_queued(conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+process_queue(struct mqtt_sn_connection *conn)
+{
+  uint8_t i;
+
+  if(conn->state != MQTT_SN_CONN_STATE_CONNECTED) {
+    return;
+  }
+
+  if(conn->request.type == 0) {
+    for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+      if(conn->out_queue[i].state == OUT_MSG_WAIT_TOPIC) {
+        send_register(conn, &conn->topics[conn->out_queue[i].topic]);
+        break;
+      }
+    }
+  }
+
+  if(MQTT_SN_BATCH_DELAY == 0) {
+    send_queued(conn);
+    return;
+  }
+
+  /* Send right away if the queue is full, otherwise when the batch is due */
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    if(conn->out_queue[i].state == OUT_MSG_FREE) {
+      break;
+    }
+  }
+  if(i == MQTT_SN_OUT_QUEUE_LENGTH) {
+    ctimer_stop(&conn->batch_timer);
+    send_queued(conn);
+  } else if(ctimer_expired(&conn->batch_timer)) {
+    ctimer_set(&conn->batch_timer, MQTT_SN_BATCH_DELAY, batch_callback, conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_connack(struct mqtt_sn_connection *conn, const uint8_t *body,
+               uint16_t len)
+{
+  if(conn->request.type != MQTT_SN_MSG_TYPE_CONNECT || len < 1) {
+    return;
+  }
+  clear_request(conn);
+
+  if(body[0] != MQTT_SN_RC_ACCEPTED) {
+    PRINTF("MQTT-SN - Connection refused with return code %u\n", body[0]);
+    conn->state = MQTT_SN_CONN_STATE_NOT_CONNECTED;
+    call_event(conn, MQTT_SN_EVENT_CONNECTION_REFUSED_ERROR, (void *)&body[0]);
+    return;
+  }
+
+  conn->state = MQTT_SN_CONN_STATE_CONNECTED;
+  conn->sleep_duration = 0;
+  ctimer_set(&conn->keep_alive_timer, conn->keep_alive * CLOCK_SECOND,
+             keep_alive_callback, conn);
+  call_event(conn, MQTT_SN_EVENT_CONNECTED, NULL);
+  process_queue(conn);
+  schedule_retry(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_regack(struct mqtt_sn_connection *conn, const uint8_t *body,
+              uint16_t len)
+{
+  struct mqtt_sn_out_msg *msg;
+  struct mqtt_sn_topic *t;
+  char name[MQTT_SN_MAX_TOPIC_LENGTH + 1];
+  uint16_t topic_id;
+  uint8_t i;
+
+  if(len < 5 || conn->request.type != MQTT_SN_MSG_TYPE_REGISTER ||
+     get16(&body[2]) != conn->request.mid) {
+    return;
+  }
+
+  if(body[4] == MQTT_SN_RC_CONGESTION) {
+    /* Keep the request, the retry timer sends it again after Tretry */
+    conn->request.sent = clock_time();
+    schedule_retry(conn);
+    return;
+  }
+
+  /* The topic name is kept in the request after the 6 byte header */
+  memcpy(name, &conn->request.buf[6], conn->request.length - 6);
+  name[conn->request.length - 6] = '\0';
+  clear_request(conn);
+
+  t = topic_lookup_name(conn, name);
+  if(t == NULL) {
+    return;
+  }
+  topic_id = get16(&body[0]);
+  if(body[4] == MQTT_SN_RC_ACCEPTED) {
+    t->id = topic_id;
+    t->registered = 1;
+  }
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    msg = &conn->out_queue[i];
+    if(msg->state != OUT_MSG_WAIT_TOPIC || &conn->topics[msg->topic] != t) {
+      continue;
+    }
+    if(body[4] == MQTT_SN_RC_ACCEPTED) {
+      msg->topic_id = topic_id;
+      msg->state = OUT_MSG_QUEUED;
+    } else {
+      msg->state = OUT_MSG_FREE;
+      call_ack_event(conn, MQTT_SN_EVENT_REJECTED_ERROR, msg->mid, 0, body[4]);
+    }
+  }
+
+  process_queue(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_register(struct mqtt_sn_connection *conn, const uint8_t *body,
+                uint16_t len)
+{
+  struct mqtt_sn_topic *t;
+  char name[MQTT_SN_MAX_TOPIC_LENGTH + 1];
+  uint16_t name_len;
+
+  if(len < 5) {
+    return;
+  }
+
+  /*
+   * The gateway registers topic names before it publishes on them to a
+   * wildcard subscription.
+   */
+  name_len = len - 4;
+  t = NULL;
+  if(name_len <= MQTT_SN_MAX_TOPIC_LENGTH) {
+    memcpy(name, &body[4], name_len);
+    name[name_len] = '\0';
+    t = topic_add(conn, name);
+  }
+  if(t == NULL) {
+    send_ack(conn, MQTT_SN_MSG_TYPE_REGACK, get16(&body[0]), get16(&body[2]),
+             MQTT_SN_RC_NOT_SUPPORTED);
+    return;
+  }
+  t->id = get16(&body[0]);
+  t->registered = 1;
+  send_ack(conn, MQTT_SN_MSG_TYPE_REGACK, t->id, get16(&body[2]),
+           MQTT_SN_RC_ACCEPTED);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_puback(struct mqtt_sn_connection *conn, const uint8_t *body,
+              uint16_t len)
+{
+  struct mqtt_sn_out_msg *msg;
+  uint16_t topic_id;
+
+  if(len < 5) {
+    return;
+  }
+  topic_id = get16(&body[0]);
+  msg = out_msg_lookup(conn, get16(&body[2]), OUT_MSG_SENT);
+  if(msg == NULL) {
+    return;
+  }
+
+  if(body[4] == MQTT_SN_RC_INVALID_TOPIC_ID && msg->topic != NO_TOPIC) {
+    /* The gateway forgot about the topic, register it again */
+    conn->topics[msg->topic].registered = 0;
+    msg->state = OUT_MSG_WAIT_TOPIC;
+    msg->retries = 0;
+    process_queue(conn);
+    return;
+  }
+
+  msg->state = OUT_MSG_FREE;
+  call_ack_event(conn, body[4] == MQTT_SN_RC_ACCEPTED ?
+                 MQTT_SN_EVENT_PUBACK : MQTT_SN_EVENT_REJECTED_ERROR,
+                 msg->mid, topic_id, body[4]);
+  process_queue(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_pubrec(struct mqtt_sn_connection *conn, const uint8_t *body,
+              uint16_t len)
+{
+  struct mqtt_sn_out_msg *msg;
+
+  if(len < 2) {
+    return;
+  }
+  msg = out_msg_lookup(conn, get16(body), OUT_MSG_SENT);
+  if(msg == NULL) {
+    msg = out_msg_lookup(conn, get16(body), OUT_MSG_PUBREL_SENT);
+    if(msg == NULL) {
+      return;
+    }
+  }
+  msg->state = OUT_MSG_PUBREL_SENT;
+  msg->retries = 0;
+  msg->sent = clock_time();
+  send_mid_msg(conn, MQTT_SN_MSG_TYPE_PUBREL, msg->mid);
+  schedule_retry(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_pubcomp(struct mqtt_sn_connection *conn, const uint8_t *body,
+               uint16_t len)
+{
+  struct mqtt_sn_out_msg *msg;
+
+  if(len < 2) {
+    return;
+  }
+  msg = out_msg_lookup(conn, get16(body), OUT_MSG_PUBREL_SENT);
+  if(msg == NULL) {
+    return;
+  }
+  msg->state = OUT_MSG_FREE;
+  call_ack_event(conn, MQTT_SN_EVENT_PUBCOMP, msg->mid, msg->topic_id,
+                 MQTT_SN_RC_ACCEPTED);
+  process_queue(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_suback(struct mqtt_sn_connection *conn, const uint8_t *body,
+              uint16_t len)
+{
+  struct mqtt_sn_ack_event suback;
+  struct mqtt_sn_topic *t;
+  uint8_t *topic;
+  uint8_t topic_len;
+
+  if(len < 6 || conn->request.type != MQTT_SN_MSG_TYPE_SUBSCRIBE ||
+     get16(&body[3]) != conn->request.mid) {
+    return;
+  }
+
+  suback.qos_level = MQTT_SN_FLAG_GET_QOS(body[0]);
+  suback.topic_id = get16(&body[1]);
+  suback.mid = conn->request.mid;
+  suback.return_code = body[5];
+
+  /*
+   * Remember the ID the gateway assigned to a topic name without wildcards,
+   * so incoming PUBLISH messages can be matched to their name.
+   */
+  topic = &conn->request.buf[5];
+  topic_len = conn->request.length - 5;
+  if(suback.return_code == MQTT_SN_RC_ACCEPTED && suback.topic_id != 0 &&
+     topic_len > MQTT_SN_SHORT_TOPIC_LEN &&
+     memchr(topic, '#', topic_len) == NULL &&
+     memchr(topic, '+', topic_len) == NULL) {
+    topic[topic_len] = '\0';
+    t = topic_add(conn, (char *)topic);
+    if(t != NULL) {
+      t->id = suback.topic_id;
+      t->registered = 1;
+    }
+  }
+
+  clear_request(conn);
+  call_event(conn, MQTT_SN_EVENT_SUBACK, &suback);
+  process_queue(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_unsuback(struct mqtt_sn_connection *conn, const uint8_t *body,
+                uint16_t len)
+{
+  if(len < 2 || conn->request.type != MQTT_SN_MSG_TYPE_UNSUBSCRIBE ||
+     get16(body) != conn->request.mid) {
+    return;
+  }
+  clear_request(conn);
+  call_ack_event(conn, MQTT_SN_EVENT_UNSUBACK, get16(body), 0,
+                 MQTT_SN_RC_ACCEPTED);
+  process_queue(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_pingresp(struct mqtt_sn_connection *conn)
+{
+  if(conn->request.type == MQTT_SN_MSG_TYPE_PINGREQ) {
+    clear_request(conn);
+  }
+
+  /* All messages buffered while we were asleep have been delivered */
+  if(conn->state == MQTT_SN_CONN_STATE_AWAKE) {
+    conn->state = MQTT_SN_CONN_STATE_ASLEEP;
+    call_event(conn, MQTT_SN_EVENT_ASLEEP, NULL);
+  } else {
+    process_queue(conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_disconnect(struct mqtt_sn_connection *conn)
+{
+  if(conn->request.type == MQTT_SN_MSG_TYPE_DISCONNECT &&
+     conn->sleep_duration > 0) {
+    clear_request(conn);
+    conn->state = MQTT_SN_CONN_STATE_ASLEEP;
+    call_event(conn, MQTT_SN_EVENT_ASLEEP, NULL);
+    return;
+  }
+
+  clear_request(conn);
+  conn->state = MQTT_SN_CONN_STATE_NOT_CONNECTED;
+  ctimer_stop(&conn->keep_alive_timer);
+  requeue_unacked(conn);
+  call_event(conn, MQTT_SN_EVENT_DISCONNECTED, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_publish(struct mqtt_sn_connection *conn, const uint8_t *body,
+               uint16_t len)
+{
+  struct mqtt_sn_message msg;
+  struct mqtt_sn_topic *t;
+  char short_name[MQTT_SN_SHORT_TOPIC_LEN + 1];
+  uint8_t flags;
+
+  if(len < 5) {
+    return;
+  }
+
+  flags = body[0];
+  msg.topic_id = get16(&body[1]);
+  msg.mid = get16(&body[3]);
+  msg.payload = &body[5];
+  msg.payload_length = len - 5;
+  msg.retain = (flags & MQTT_SN_FLAG_RETAIN) ? 1 : 0;
+  msg.qos = MQTT_SN_FLAG_GET_QOS(flags);
+  if(msg.qos > MQTT_SN_QOS_LEVEL_2) {
+    /* QoS -1 */
+    msg.qos = MQTT_SN_QOS_LEVEL_0;
+  }
+
+  switch(flags & MQTT_SN_FLAG_TOPIC_TYPE_MASK) {
+  case MQTT_SN_FLAG_TOPIC_SHORT:
+    short_name[0] = body[1];
+    short_name[1] = body[2];
+    short_name[2] = '\0';
+    msg.topic = short_name;
+    break;
+  case MQTT_SN_FLAG_TOPIC_NORMAL:
+    t = topic_lookup_id(conn, msg.topic_id);
+    if(t == NULL) {
+      if(msg.qos > MQTT_SN_QOS_LEVEL_0) {
+        send_ack(conn, MQTT_SN_MSG_TYPE_PUBACK, msg.topic_id, msg.mid,
+                 MQTT_SN_RC_INVALID_TOPIC_ID);
+      }
+      return;
+    }
+    msg.topic = t->name;
+    break;
+  default:
+    /* Predefined topic IDs are only known to the application */
+    msg.topic = NULL;
+    break;
+  }
+
+  if(msg.qos == MQTT_SN_QOS_LEVEL_2) {
+    /* Only deliver the first copy, until the gateway sends PUBREL */
+    if(msg.mid != conn->in_qos2_mid) {
+      conn->in_qos2_mid = msg.mid;
+      call_event(conn, MQTT_SN_EVENT_PUBLISH, &msg);
+    }
+    send_mid_msg(conn, MQTT_SN_MSG_TYPE_PUBREC, msg.mid);
+    return;
+  }
+
+  call_event(conn, MQTT_SN_EVENT_PUBLISH, &msg);
+
+  if(msg.qos == MQTT_SN_QOS_LEVEL_1) {
+    send_ack(conn, MQTT_SN_MSG_TYPE_PUBACK, msg.topic_id, msg.mid,
+             MQTT_SN_RC_ACCEPTED);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+udp_input(struct simple_udp_connection *c,
+          const uip_ipaddr_t *sender_addr,
+          uint16_t sender_port,
+          const uip_ipaddr_t *receiver_addr,
+          uint16_t receiver_port,
+          const uint8_t *data,
+          uint16_t datalen)
+{
+  struct mqtt_sn_connection *conn;
+  uint8_t pingresp[2];
+  uint16_t length;
+  uint8_t hdr_len;
+
+  for(conn = list_head(mqtt_sn_conn_list);
+      conn != NULL && &conn->udp != c;
+      conn = list_item_next(conn));
+  if(conn == NULL || datalen < 2) {
+    return;
+  }
+
+  /* Only the gateway we are connected to may talk to us */
+  if(sender_port != conn->server_port ||
+     !uip_ipaddr_cmp(sender_addr, &conn->server_ip)) {
+    return;
+  }
+
+  if(data[0] == 0x01) {
+    if(datalen < 4) {
+      return;
+    }
+    length = get16(&data[1]);
+    hdr_len = 4;
+  } else {
+    length = data[0];
+    hdr_len = 2;
+  }
+  if(length > datalen || length < hdr_len) {
+    PRINTF("MQTT-SN - Malformed message\n");
+    return;
+  }
+
+  data += hdr_len - 1;
+  length -= hdr_len;
+
+  switch(data[0]) {
+  case MQTT_SN_MSG_TYPE_CONNACK:
+    handle_connack(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_REGISTER:
+    handle_register(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_REGACK:
+    handle_regack(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_PUBLISH:
+    handle_publish(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_PUBACK:
+    handle_puback(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_PUBREC:
+    handle_pubrec(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_PUBREL:
+    if(length >= 2) {
+      conn->in_qos2_mid = 0;
+      send_mid_msg(conn, MQTT_SN_MSG_TYPE_PUBCOMP, get16(data + 1));
+    }
+    break;
+  case MQTT_SN_MSG_TYPE_PUBCOMP:
+    handle_pubcomp(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_SUBACK:
+    handle_suback(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_UNSUBACK:
+    handle_unsuback(conn, data + 1, length);
+    break;
+  case MQTT_SN_MSG_TYPE_PINGREQ:
+    put_header(pingresp, 0, MQTT_SN_MSG_TYPE_PINGRESP);
+    send_raw(conn, pingresp, sizeof(pingresp));
+    break;
+  case MQTT_SN_MSG_TYPE_PINGRESP:
+    handle_pingresp(conn);
+    break;
+  case MQTT_SN_MSG_TYPE_DISCONNECT:
+    handle_disconnect(conn);
+    break;
+  default:
+    PRINTF("MQTT-SN - Got unhandled message type 0x%02x\n", data[0]);
+    break;
+  }
+
+  schedule_retry(conn);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_register(struct mqtt_sn_connection *conn, struct process *app_process,
+                 char *client_id, mqtt_sn_event_callback_t event_callback)
+{
+  static uint8_t inited = 0;
+  size_t len;
+
+  len = strlen(client_id);
+  if(len < 1 || len > MQTT_SN_CLIENT_ID_MAX_LEN) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  if(!inited) {
+    mqtt_sn_update_event = process_alloc_event();
+    list_init(mqtt_sn_conn_list);
+    inited = 1;
+  }
+
+  memset(conn, 0, sizeof(struct mqtt_sn_connection));
+  conn->client_id = client_id;
+  conn->client_id_length = len;
+  conn->event_callback = event_callback;
+  conn->app_process = app_process;
+  conn->state = MQTT_SN_CONN_STATE_NOT_CONNECTED;
+
+  if(!simple_udp_register(&conn->udp, 0, NULL, 0, udp_input)) {
+    return MQTT_SN_STATUS_ERROR;
+  }
+  list_add(mqtt_sn_conn_list, conn);
+
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_connect(struct mqtt_sn_connection *conn, char *host, uint16_t port,
+                uint16_t keep_alive)
+{
+  uint8_t flags;
+
+  if(conn->state == MQTT_SN_CONN_STATE_CONNECTING ||
+     conn->state == MQTT_SN_CONN_STATE_CONNECTED) {
+    return MQTT_SN_STATUS_OK;
+  }
+  if(conn->request.type != 0 &&
+     conn->request.type != MQTT_SN_MSG_TYPE_PINGREQ) {
+    return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+  }
+
+  if(uiplib_ipaddrconv(host, &conn->server_ip) == 0) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  conn->server_port = port;
+  conn->keep_alive = keep_alive;
+
+  /* Sleeping clients resume their session, everybody else starts afresh */
+  if(conn->state == MQTT_SN_CONN_STATE_ASLEEP ||
+     conn->state == MQTT_SN_CONN_STATE_AWAKE) {
+    flags = 0;
+  } else {
+    flags = MQTT_SN_FLAG_CLEAN_SESSION;
+    invalidate_topics(conn);
+  }
+
+  conn->state = MQTT_SN_CONN_STATE_CONNECTING;
+  send_connect(conn, flags);
+
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+void
+mqtt_sn_disconnect(struct mqtt_sn_connection *conn)
+{
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_CONN_STATE_CONNECTED) {
+    return;
+  }
+
+  ctimer_stop(&conn->keep_alive_timer);
+  conn->state = MQTT_SN_CONN_STATE_DISCONNECTING;
+  conn->sleep_duration = 0;
+  p = put_header(conn->request.buf, 0, MQTT_SN_MSG_TYPE_DISCONNECT);
+  send_request(conn, MQTT_SN_MSG_TYPE_DISCONNECT, 0, p - conn->request.buf);
+}
+/*---------------------------------------------------------------------------*/
+static mqtt_sn_status_t
+subscription_request(struct mqtt_sn_connection *conn, uint8_t type,
+                     uint16_t *mid, char *topic, uint8_t flags)
+{
+  uint16_t topic_len;
+  uint16_t new_mid;
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_CONN_STATE_CONNECTED) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+  topic_len = strlen(topic);
+  if(topic_len == 0 || topic_len > MQTT_SN_MAX_TOPIC_LENGTH) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  /* Only one request at a time, as in the MQTT engine */
+  if(conn->request.type != 0) {
+    return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+  }
+
+  if(topic_len == MQTT_SN_SHORT_TOPIC_LEN) {
+    flags |= MQTT_SN_FLAG_TOPIC_SHORT;
+  }
+
+  new_mid = next_mid(conn);
+  p = put_header(conn->request.buf, 3 + topic_len, type);
+  *p++ = flags;
+  p = put16(p, new_mid);
+  memcpy(p, topic, topic_len);
+  p += topic_len;
+  send_request(conn, type, new_mid, p - conn->request.buf);
+
+  if(mid != NULL) {
+    *mid = new_mid;
+  }
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_subscribe(struct mqtt_sn_connection *conn, uint16_t *mid, char *topic,
+                  mqtt_sn_qos_level_t qos_level)
+{
+  return subscription_request(conn, MQTT_SN_MSG_TYPE_SUBSCRIBE, mid, topic,
+                              MQTT_SN_FLAG_QOS(qos_level));
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_unsubscribe(struct mqtt_sn_connection *conn, uint16_t *mid,
+                    char *topic)
+{
+  return subscription_request(conn, MQTT_SN_MSG_TYPE_UNSUBSCRIBE, mid, topic,
+                              0);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_publish(struct mqtt_sn_connection *conn, uint16_t *mid, char *topic,
+                uint8_t *payload, uint16_t payload_size,
+                mqtt_sn_qos_level_t qos_level, mqtt_sn_retain_t retain)
+{
+  struct mqtt_sn_out_msg *msg = NULL;
+  struct mqtt_sn_topic *t;
+  uint16_t topic_len;
+  uint8_t i;
+
+  if(conn->state == MQTT_SN_CONN_STATE_NOT_CONNECTED ||
+     conn->state == MQTT_SN_CONN_STATE_DISCONNECTING) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+
+  topic_len = strlen(topic);
+  if(payload_size > MQTT_SN_MAX_PAYLOAD || qos_level > MQTT_SN_QOS_LEVEL_2 ||
+     topic_len == 0 || topic_len > MQTT_SN_MAX_TOPIC_LENGTH) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  for(i = 0; i < MQTT_SN_OUT_QUEUE_LENGTH; i++) {
+    if(conn->out_queue[i].state == OUT_MSG_FREE) {
+      msg = &conn->out_queue[i];
+      break;
+    }
+  }
+  if(msg == NULL) {
+    return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+  }
+
+  msg->flags = MQTT_SN_FLAG_QOS(qos_level);
+  if(retain == MQTT_SN_RETAIN_ON) {
+    msg->flags |= MQTT_SN_FLAG_RETAIN;
+  }
+
+  if(topic_len == MQTT_SN_SHORT_TOPIC_LEN) {
+    msg->flags |= MQTT_SN_FLAG_TOPIC_SHORT;
+    msg->topic = NO_TOPIC;
+    msg->topic_id = ((uint8_t)topic[0] << 8) | (uint8_t)topic[1];
+    msg->state = OUT_MSG_QUEUED;
+  } else {
+    t = topic_add(conn, topic);
+    if(t == NULL) {
+      return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+    }
+    msg->topic = t - conn->topics;
+    if(t->registered) {
+      msg->topic_id = t->id;
+      msg->state = OUT_MSG_QUEUED;
+    } else {
+      msg->state = OUT_MSG_WAIT_TOPIC;
+    }
+  }
+
+  msg->mid = qos_level > MQTT_SN_QOS_LEVEL_0 ? next_mid(conn) : 0;
+  msg->retries = 0;
+  msg->payload_length = payload_size;
+  memcpy(msg->payload, payload, payload_size);
+
+  if(mid != NULL) {
+    *mid = msg->mid;
+  }
+
+  process_queue(conn);
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+void
+mqtt_sn_flush(struct mqtt_sn_connection *conn)
+{
+  if(conn->state == MQTT_SN_CONN_STATE_CONNECTED) {
+    ctimer_stop(&conn->batch_timer);
+    send_queued(conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_sleep(struct mqtt_sn_connection *conn, uint16_t duration)
+{
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_CONN_STATE_CONNECTED) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+  if(duration == 0) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  if(conn->request.type != 0) {
+    return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+  }
+
+  /* Get rid of whatever is ready before going to sleep */
+  mqtt_sn_flush(conn);
+
+  ctimer_stop(&conn->keep_alive_timer);
+  conn->state = MQTT_SN_CONN_STATE_DISCONNECTING;
+  conn->sleep_duration = duration;
+  p = put_header(conn->request.buf, 2, MQTT_SN_MSG_TYPE_DISCONNECT);
+  p = put16(p, duration);
+  send_request(conn, MQTT_SN_MSG_TYPE_DISCONNECT, 0, p - conn->request.buf);
+
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_wake(struct mqtt_sn_connection *conn)
+{
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_CONN_STATE_ASLEEP) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+
+  conn->state = MQTT_SN_CONN_STATE_AWAKE;
+  p = put_header(conn->request.buf, conn->client_id_length,
+                 MQTT_SN_MSG_TYPE_PINGREQ);
+  memcpy(p, conn->client_id, conn->client_id_length);
+  p += conn->client_id_length;
+  send_request(conn, MQTT_SN_MSG_TYPE_PINGREQ, 0, p - conn->request.buf);
+
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
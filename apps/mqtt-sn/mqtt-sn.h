@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \addtogroup apps
+ * @{
+ *
+ * \defgroup mqtt-sn-engine An implementation of an MQTT-SN v1.2 client
+ * @{
+ *
+ * MQTT-SN is a variant of MQTT for sensor networks. It runs over UDP instead
+ * of TCP and replaces topic names in PUBLISH messages with two-byte topic IDs,
+ * which makes it considerably cheaper in terms of airtime and RAM than
+ * keeping a TCP connection to a broker alive.
+ *
+ * This client talks directly to a configured MQTT-SN gateway (or a broker
+ * with MQTT-SN support); gateway discovery is not implemented. The API
+ * follows the one of the MQTT engine in apps/mqtt:
+ *
+ * - Topic names are registered with the gateway on first use and the
+ *   returned topic IDs are cached. Two-character topic names are sent as
+ *   short topic names and need no registration.
+ * - QoS 0, 1 and 2 are supported in both directions. Messages that need an
+ *   acknowledgement are retransmitted after MQTT_SN_RETRY_TIMEOUT.
+ * - Published messages go through a small queue. With a non-zero
+ *   MQTT_SN_BATCH_DELAY they are held back and sent back-to-back, so that a
+ *   duty-cycled radio wakes up once per batch rather than once per message.
+ * - Sleeping clients are supported through mqtt_sn_sleep() and
+ *   mqtt_sn_wake().
+ *
+ * The protocol specification can be found at http://mqtt.org
+ */
+/**
+ * \file
+ *    Header file for the Contiki MQTT-SN client
+ */
+/*---------------------------------------------------------------------------*/
+#ifndef MQTT_SN_H_
+#define MQTT_SN_H_
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "contiki-net.h"
+#include "sys/ctimer.h"
+#include "net/ip/uip.h"
+#include "net/ip/simple-udp.h"
+
+#include <stdint.h>
+/*---------------------------------------------------------------------------*/
+/* Configuration */
+#ifdef MQTT_SN_CONF_MAX_TOPICS
+#define MQTT_SN_MAX_TOPICS MQTT_SN_CONF_MAX_TOPICS
+#else
+#define MQTT_SN_MAX_TOPICS 8
+#endif
+
+#ifdef MQTT_SN_CONF_MAX_TOPIC_LENGTH
+#define MQTT_SN_MAX_TOPIC_LENGTH MQTT_SN_CONF_MAX_TOPIC_LENGTH
+#else
+#define MQTT_SN_MAX_TOPIC_LENGTH 32
+#endif
+
+/* Number of PUBLISH messages that can be queued or awaiting an ACK */
+#ifdef MQTT_SN_CONF_OUT_QUEUE_LENGTH
+#define MQTT_SN_OUT_QUEUE_LENGTH MQTT_SN_CONF_OUT_QUEUE_LENGTH
+#else
+#define MQTT_SN_OUT_QUEUE_LENGTH 4
+#endif
+
+#ifdef MQTT_SN_CONF_MAX_PAYLOAD
+#define MQTT_SN_MAX_PAYLOAD MQTT_SN_CONF_MAX_PAYLOAD
+#else
+#define MQTT_SN_MAX_PAYLOAD 64
+#endif
+
+/* How long QoS 0 messages are held back to be sent in one batch */
+#ifdef MQTT_SN_CONF_BATCH_DELAY
+#define MQTT_SN_BATCH_DELAY MQTT_SN_CONF_BATCH_DELAY
+#else
+#define MQTT_SN_BATCH_DELAY 0
+#endif
+
+/* Tretry and Nretry of the specification */
+#ifdef MQTT_SN_CONF_RETRY_TIMEOUT
+#define MQTT_SN_RETRY_TIMEOUT MQTT_SN_CONF_RETRY_TIMEOUT
+#else
+#define MQTT_SN_RETRY_TIMEOUT (CLOCK_SECOND * 10)
+#endif
+
+#ifdef MQTT_SN_CONF_MAX_RETRIES
+#define MQTT_SN_MAX_RETRIES MQTT_SN_CONF_MAX_RETRIES
+#else
+#define MQTT_SN_MAX_RETRIES 3
+#endif
+
+#define MQTT_SN_CLIENT_ID_MAX_LEN 23
+#define MQTT_SN_DEFAULT_PORT      1884
+
+/* Largest message we ever build: PUBLISH with a full payload */
+#define MQTT_SN_MAX_PACKET_SIZE   (9 + MQTT_SN_MAX_PAYLOAD)
+
+/* Requests carry at most a topic name (REGISTER) or the client ID (CONNECT) */
+#if MQTT_SN_MAX_TOPIC_LENGTH > MQTT_SN_CLIENT_ID_MAX_LEN
+#define MQTT_SN_REQUEST_BUF_SIZE  (6 + MQTT_SN_MAX_TOPIC_LENGTH)
+#else
+#define MQTT_SN_REQUEST_BUF_SIZE  (6 + MQTT_SN_CLIENT_ID_MAX_LEN)
+#endif
+/*---------------------------------------------------------------------------*/
+extern process_event_t mqtt_sn_update_event;
+
+/* Forward declaration */
+struct mqtt_sn_connection;
+
+typedef enum {
+  MQTT_SN_RETAIN_OFF,
+  MQTT_SN_RETAIN_ON,
+} mqtt_sn_retain_t;
+
+typedef enum {
+  MQTT_SN_QOS_LEVEL_0,
+  MQTT_SN_QOS_LEVEL_1,
+  MQTT_SN_QOS_LEVEL_2,
+} mqtt_sn_qos_level_t;
+
+/**
+ * \brief MQTT-SN engine events
+ */
+typedef enum {
+  MQTT_SN_EVENT_CONNECTED,
+  MQTT_SN_EVENT_DISCONNECTED,
+  MQTT_SN_EVENT_ASLEEP,
+
+  MQTT_SN_EVENT_SUBACK,
+  MQTT_SN_EVENT_UNSUBACK,
+  MQTT_SN_EVENT_PUBLISH,
+  MQTT_SN_EVENT_PUBACK,
+  MQTT_SN_EVENT_PUBCOMP,
+
+  /* Errors */
+  MQTT_SN_EVENT_ERROR = 0x80,
+  MQTT_SN_EVENT_CONNECTION_REFUSED_ERROR,
+  MQTT_SN_EVENT_TIMEOUT_ERROR,
+  MQTT_SN_EVENT_REJECTED_ERROR,
+} mqtt_sn_event_t;
+
+typedef enum {
+  MQTT_SN_STATUS_OK,
+
+  MQTT_SN_STATUS_OUT_QUEUE_FULL,
+
+  /* Errors */
+  MQTT_SN_STATUS_ERROR = 0x80,
+  MQTT_SN_STATUS_NOT_CONNECTED_ERROR,
+  MQTT_SN_STATUS_INVALID_ARGS_ERROR,
+} mqtt_sn_status_t;
+
+typedef enum {
+  MQTT_SN_CONN_STATE_NOT_CONNECTED,
+  MQTT_SN_CONN_STATE_CONNECTING,
+  MQTT_SN_CONN_STATE_CONNECTED,
+  MQTT_SN_CONN_STATE_DISCONNECTING,
+  MQTT_SN_CONN_STATE_ASLEEP,
+  MQTT_SN_CONN_STATE_AWAKE,
+} mqtt_sn_conn_state_t;
+/*---------------------------------------------------------------------------*/
+/* A topic name and the ID the gateway assigned to it */
+struct mqtt_sn_topic {
+  uint16_t id;
+  uint8_t registered;
+  char name[MQTT_SN_MAX_TOPIC_LENGTH + 1];
+};
+
+/* This is the MQTT-SN message that is exposed to the end user. */
+struct mqtt_sn_message {
+  uint16_t mid;
+  uint16_t topic_id;
+  /* NULL if the topic ID is not known to the client */
+  const char *topic;
+  mqtt_sn_qos_level_t qos;
+  uint8_t retain;
+
+  const uint8_t *payload;
+  uint16_t payload_length;
+};
+
+/*
+ * Passed along with SUBACK/UNSUBACK, PUBACK and PUBCOMP events. Return code
+ * is the one sent by the gateway, 0 meaning accepted.
+ */
+struct mqtt_sn_ack_event {
+  uint16_t mid;
+  uint16_t topic_id;
+  uint8_t return_code;
+  mqtt_sn_qos_level_t qos_level;
+};
+
+/* A PUBLISH that is queued or waiting for its acknowledgement */
+struct mqtt_sn_out_msg {
+  uint8_t state;
+  uint8_t flags;
+  uint8_t retries;
+  uint8_t topic;
+  uint16_t topic_id;
+  uint16_t mid;
+  clock_time_t sent;
+  uint16_t payload_length;
+  uint8_t payload[MQTT_SN_MAX_PAYLOAD];
+};
+
+/*
+ * The single outstanding request other than PUBLISH: CONNECT, REGISTER,
+ * SUBSCRIBE, UNSUBSCRIBE, PINGREQ or DISCONNECT.
+ */
+struct mqtt_sn_request {
+  uint8_t type;
+  uint8_t retries;
+  uint16_t mid;
+  clock_time_t sent;
+  uint8_t length;
+  uint8_t buf[MQTT_SN_REQUEST_BUF_SIZE];
+};
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief           MQTT-SN event callback function
+ * \param c         A pointer to a MQTT-SN connection
+ * \param event     The event number
+ * \param data      Event specific data
+ *
+ * The callback is called for each event on the connection, such as it
+ * getting connected or a message being received. data points to a
+ * struct mqtt_sn_message for MQTT_SN_EVENT_PUBLISH and to a
+ * struct mqtt_sn_ack_event for acknowledgements.
+ */
+typedef void (*mqtt_sn_event_callback_t)(struct mqtt_sn_connection *c,
+                                         mqtt_sn_event_t event,
+                                         void *data);
+
+struct mqtt_sn_connection {
+  /* Used by the list interface, must be first in the struct */
+  struct mqtt_sn_connection *next;
+
+  char *client_id;
+  uint8_t client_id_length;
+
+  mqtt_sn_conn_state_t state;
+  mqtt_sn_event_callback_t event_callback;
+  struct process *app_process;
+
+  uint16_t keep_alive;
+  uint16_t sleep_duration;
+  struct ctimer keep_alive_timer;
+  uint8_t waiting_for_pingresp;
+
+  struct ctimer retry_timer;
+  struct ctimer batch_timer;
+
+  uint16_t mid_counter;
+
+  struct mqtt_sn_topic topics[MQTT_SN_MAX_TOPICS];
+
+  struct mqtt_sn_request request;
+  struct mqtt_sn_out_msg out_queue[MQTT_SN_OUT_QUEUE_LENGTH];
+
+  /* Incoming QoS 2 message awaiting PUBREL */
+  uint16_t in_qos2_mid;
+
+  /* UDP related information */
+  uip_ipaddr_t server_ip;
+  uint16_t server_port;
+  struct simple_udp_connection udp;
+};
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Initializes a MQTT-SN connection.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param app_process A pointer to the application process handling the
+ *        connection.
+ * \param client_id A pointer to the client ID.
+ * \param event_callback Callback function for events on the connection.
+ * \return MQTT_SN_STATUS_OK or MQTT_SN_STATUS_INVALID_ARGS_ERROR
+ */
+mqtt_sn_status_t mqtt_sn_register(struct mqtt_sn_connection *conn,
+                                  struct process *app_process,
+                                  char *client_id,
+                                  mqtt_sn_event_callback_t event_callback);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Connects to a MQTT-SN gateway.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param host IPv6 address of the gateway.
+ * \param port UDP port of the gateway, usually MQTT_SN_DEFAULT_PORT.
+ * \param keep_alive Keep alive time in seconds.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * Also used by a sleeping client to return to the active state.
+ */
+mqtt_sn_status_t mqtt_sn_connect(struct mqtt_sn_connection *conn,
+                                 char *host,
+                                 uint16_t port,
+                                 uint16_t keep_alive);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Disconnects from the gateway.
+ * \param conn A pointer to the MQTT-SN connection.
+ */
+void mqtt_sn_disconnect(struct mqtt_sn_connection *conn);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Subscribes to a topic.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer where the message ID is stored, may be NULL.
+ * \param topic The topic name, wildcards are allowed.
+ * \param qos_level Maximum QoS level for the subscription.
+ * \return MQTT_SN_STATUS_OK or some error status
+ */
+mqtt_sn_status_t mqtt_sn_subscribe(struct mqtt_sn_connection *conn,
+                                   uint16_t *mid,
+                                   char *topic,
+                                   mqtt_sn_qos_level_t qos_level);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Unsubscribes from a topic.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer where the message ID is stored, may be NULL.
+ * \param topic The topic name.
+ * \return MQTT_SN_STATUS_OK or some error status
+ */
+mqtt_sn_status_t mqtt_sn_unsubscribe(struct mqtt_sn_connection *conn,
+                                     uint16_t *mid,
+                                     char *topic);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Publishes to a topic.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer where the message ID is stored, may be NULL.
+ * \param topic The topic name. It is registered with the gateway on first
+ *        use unless it is two characters long.
+ * \param payload A pointer to the payload.
+ * \param payload_size Payload size, at most MQTT_SN_MAX_PAYLOAD.
+ * \param qos_level Quality Of Service level to use.
+ * \param retain Whether the gateway should retain the message.
+ * \return MQTT_SN_STATUS_OK or some error status
+ *
+ * The payload is copied, so the buffer may be reused once this function
+ * returns. Messages published while the client is asleep are kept until it
+ * is connected again.
+ */
+mqtt_sn_status_t mqtt_sn_publish(struct mqtt_sn_connection *conn,
+                                 uint16_t *mid,
+                                 char *topic,
+                                 uint8_t *payload,
+                                 uint16_t payload_size,
+                                 mqtt_sn_qos_level_t qos_level,
+                                 mqtt_sn_retain_t retain);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Sends all queued messages without waiting for the batch delay.
+ * \param conn A pointer to the MQTT-SN connection.
+ */
+void mqtt_sn_flush(struct mqtt_sn_connection *conn);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Tells the gateway that the client goes to sleep.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param duration Sleep duration in seconds. The gateway buffers messages
+ *        for the client for this long.
+ * \return MQTT_SN_STATUS_OK or some error status
+ */
+mqtt_sn_status_t mqtt_sn_sleep(struct mqtt_sn_connection *conn,
+                               uint16_t duration);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Fetches the messages the gateway buffered while asleep.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \return MQTT_SN_STATUS_OK or some error status
+ *
+ * The buffered messages are delivered as MQTT_SN_EVENT_PUBLISH events,
+ * followed by MQTT_SN_EVENT_ASLEEP when the gateway has sent them all.
+ */
+mqtt_sn_status_t mqtt_sn_wake(struct mqtt_sn_connection *conn);
+
+#define mqtt_sn_connected(conn) \
+  ((conn)->state == MQTT_SN_CONN_STATE_CONNECTED ? 1 : 0)
+/*---------------------------------------------------------------------------*/
+#endif /* MQTT_SN_H_ */
+/*---------------------------------------------------------------------------*/
+/**
+ * @}
+ * @}
+ */
@@ -59,6 +59,10 @@
 #include "lib/list.h"
 #include "sys/cc.h"
 
+#if MQTT_OUT_QUEUE_CFS
+#include "cfs/cfs.h"
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -128,6 +132,29 @@ typedef enum {
 #define INCREMENT_MID(conn)   (conn)->mid_counter += 2
 #define MQTT_STRING_LENGTH(s) (((s)->length) == 0 ? 0 : (MQTT_STRING_LEN_SIZE + (s)->length))
 /*---------------------------------------------------------------------------*/
+/*
+ * Each entry in the outbound queue is a header followed by the serialised
+ * PUBLISH packet. Headers are not aligned inside the ring buffer and are
+ * therefore always accessed through memcpy(). A header with len == 0 marks
+ * the point where the writer wrapped around to the start of the buffer.
+ */
+typedef enum {
+  OUT_ENTRY_QUEUED,
+  OUT_ENTRY_SENT,
+  OUT_ENTRY_RELEASING,  /* QoS 2, got PUBREC, PUBREL not completed */
+  OUT_ENTRY_DONE,
+} out_entry_state_t;
+
+struct out_entry_hdr {
+  uint16_t len;
+  uint16_t mid;
+  uint8_t qos;
+  uint8_t state;
+};
+
+#define OUT_ENTRY_HDR_SIZE sizeof(struct out_entry_hdr)
+#define MQTT_PUBREL_SIZE   4
+/*---------------------------------------------------------------------------*/
 /* Protothread send macros */
 #define PT_MQTT_WRITE_BYTES(conn, data, len)                                   \
   while(write_bytes(conn, data, len)) {                                        \
@@ -209,6 +236,22 @@ reset_defaults(struct mqtt_connection *conn)
 
   reset_packet(&conn->in_packet);
   conn->out_buffer_sent = 0;
+  conn->deferred_event = PROCESS_EVENT_NONE;
+}
+/*---------------------------------------------------------------------------*/
+static void requeue_unacked(struct mqtt_connection *conn);
+/*---------------------------------------------------------------------------*/
+static void
+reset_out_queue(struct mqtt_connection *conn, const char *client_id)
+{
+  memset(&conn->out_queue, 0, sizeof(conn->out_queue));
+
+#if MQTT_OUT_QUEUE_CFS
+  /* Messages left over from a previous run have stale message IDs */
+  snprintf(conn->out_queue.cfs_name, MQTT_OUT_QUEUE_CFS_NAME_LEN, "mq%.10s",
+           client_id);
+  cfs_remove(conn->out_queue.cfs_name);
+#endif
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -216,6 +259,10 @@ abort_connection(struct mqtt_connection *conn)
 {
   conn->out_buffer_ptr = conn->out_buffer;
   conn->out_queue_full = 0;
+  conn->deferred_event = PROCESS_EVENT_NONE;
+
+  /* Unacknowledged messages are sent again after reconnecting */
+  requeue_unacked(conn);
 
   /* Reset outgoing packet */
   memset(&conn->out_packet, 0, sizeof(conn->out_packet));
@@ -272,6 +319,383 @@ send_out_buffer(struct mqtt_connection *conn)
 }
 /*---------------------------------------------------------------------------*/
 static void
+read_entry_hdr(struct mqtt_out_queue *q, uint16_t offset,
+               struct out_entry_hdr *hdr)
+{
+  memcpy(hdr, &q->buf[offset], OUT_ENTRY_HDR_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_entry_hdr(struct mqtt_out_queue *q, uint16_t offset,
+                const struct out_entry_hdr *hdr)
+{
+  memcpy(&q->buf[offset], hdr, OUT_ENTRY_HDR_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns the offset of the entry stored at or after offset, following the
+ * wrap-around marker if there is one.
+ */
+static uint16_t
+entry_offset(struct mqtt_out_queue *q, uint16_t offset)
+{
+  struct out_entry_hdr hdr;
+
+  if(MQTT_OUT_QUEUE_SIZE - offset < OUT_ENTRY_HDR_SIZE) {
+    return 0;
+  }
+  read_entry_hdr(q, offset, &hdr);
+  if(hdr.len == 0) {
+    return 0;
+  }
+  return offset;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Reserves room for an entry of the given total size. Returns the offset of
+ * the reserved area or -1 if the queue is too full.
+ */
+static int
+alloc_entry(struct mqtt_out_queue *q, uint16_t size)
+{
+  struct out_entry_hdr marker;
+  uint16_t offset;
+
+  if(q->entries == 0) {
+    q->head = q->tail = 0;
+    q->send_offset = 0;
+  }
+
+  if(q->entries == 0 || q->head > q->tail) {
+    if(MQTT_OUT_QUEUE_SIZE - q->head >= size) {
+      offset = q->head;
+    } else if(size < q->tail) {
+      /* Wrap around, leaving a marker if there is room for one */
+      if(MQTT_OUT_QUEUE_SIZE - q->head >= OUT_ENTRY_HDR_SIZE) {
+        memset(&marker, 0, sizeof(marker));
+        write_entry_hdr(q, q->head, &marker);
+      }
+      offset = 0;
+    } else {
+      return -1;
+    }
+  } else if(q->tail - q->head > size) {
+    offset = q->head;
+  } else {
+    return -1;
+  }
+
+  q->head = offset + size;
+  q->entries++;
+  q->unsent++;
+  return offset;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_inflight *
+inflight_lookup(struct mqtt_out_queue *q, uint16_t mid)
+{
+  uint8_t i;
+
+  for(i = 0; i < q->inflight_count; i++) {
+    if(q->inflight[i].mid == mid) {
+      return &q->inflight[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+inflight_remove(struct mqtt_out_queue *q, struct mqtt_inflight *inflight)
+{
+  q->inflight_count--;
+  *inflight = q->inflight[q->inflight_count];
+}
+/*---------------------------------------------------------------------------*/
+#if MQTT_OUT_QUEUE_CFS
+/*
+ * Spilled entries are stored in the file as their queue header followed by
+ * the packet, in the order they were published.
+ */
+static int
+spill_entry(struct mqtt_out_queue *q, const struct out_entry_hdr *hdr,
+            const uint8_t *fhdr, uint8_t fhdr_len,
+            const char *topic, uint16_t topic_length,
+            const uint8_t *payload, uint16_t payload_size)
+{
+  uint8_t vhdr[MQTT_STRING_LEN_SIZE];
+  uint8_t mid[MQTT_MID_SIZE];
+  int fd;
+  int ok;
+
+  fd = cfs_open(q->cfs_name, CFS_WRITE | CFS_APPEND);
+  if(fd < 0) {
+    return 0;
+  }
+
+  vhdr[0] = topic_length >> 8;
+  vhdr[1] = topic_length & 0x00FF;
+  mid[0] = hdr->mid >> 8;
+  mid[1] = hdr->mid & 0x00FF;
+
+  ok = cfs_write(fd, hdr, OUT_ENTRY_HDR_SIZE) == OUT_ENTRY_HDR_SIZE &&
+    cfs_write(fd, fhdr, fhdr_len) == fhdr_len &&
+    cfs_write(fd, vhdr, sizeof(vhdr)) == sizeof(vhdr) &&
+    cfs_write(fd, topic, topic_length) == topic_length &&
+    (hdr->qos == MQTT_QOS_LEVEL_0 ||
+     cfs_write(fd, mid, sizeof(mid)) == sizeof(mid)) &&
+    cfs_write(fd, payload, payload_size) == payload_size;
+  cfs_close(fd);
+
+  if(ok) {
+    q->cfs_entries++;
+  }
+  return ok;
+}
+/*---------------------------------------------------------------------------*/
+static void
+refill_from_cfs(struct mqtt_out_queue *q)
+{
+  struct out_entry_hdr hdr;
+  uint16_t head;
+  int offset;
+  int fd;
+
+  if(q->cfs_entries == 0) {
+    return;
+  }
+
+  fd = cfs_open(q->cfs_name, CFS_READ);
+  if(fd < 0) {
+    return;
+  }
+
+  while(q->cfs_entries > 0) {
+    if(cfs_seek(fd, q->cfs_read_pos, CFS_SEEK_SET) != q->cfs_read_pos ||
+       cfs_read(fd, &hdr, OUT_ENTRY_HDR_SIZE) != OUT_ENTRY_HDR_SIZE) {
+      PRINTF("MQTT - Error reading spilled message, dropping queue file\n");
+      q->cfs_entries = 0;
+      break;
+    }
+    head = q->head;
+    offset = alloc_entry(q, OUT_ENTRY_HDR_SIZE + hdr.len);
+    if(offset < 0) {
+      break;
+    }
+    if(cfs_read(fd, &q->buf[offset + OUT_ENTRY_HDR_SIZE], hdr.len) != hdr.len) {
+      PRINTF("MQTT - Error reading spilled message, dropping queue file\n");
+      q->head = head;
+      q->entries--;
+      q->unsent--;
+      q->cfs_entries = 0;
+      break;
+    }
+    write_entry_hdr(q, offset, &hdr);
+    q->cfs_read_pos += OUT_ENTRY_HDR_SIZE + hdr.len;
+    q->cfs_entries--;
+  }
+  cfs_close(fd);
+
+  if(q->cfs_entries == 0) {
+    cfs_remove(q->cfs_name);
+    q->cfs_read_pos = 0;
+  }
+}
+#endif /* MQTT_OUT_QUEUE_CFS */
+/*---------------------------------------------------------------------------*/
+/* Frees completed entries at the tail of the queue */
+static void
+release_entries(struct mqtt_out_queue *q)
+{
+  struct out_entry_hdr hdr;
+
+  while(q->entries > 0) {
+    q->tail = entry_offset(q, q->tail);
+    read_entry_hdr(q, q->tail, &hdr);
+    if(hdr.state != OUT_ENTRY_DONE) {
+      break;
+    }
+    q->tail += OUT_ENTRY_HDR_SIZE + hdr.len;
+    q->entries--;
+  }
+
+#if MQTT_OUT_QUEUE_CFS
+  refill_from_cfs(q);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_entry_state(struct mqtt_out_queue *q, uint16_t offset,
+                out_entry_state_t state)
+{
+  struct out_entry_hdr hdr;
+
+  read_entry_hdr(q, offset, &hdr);
+  hdr.state = state;
+  write_entry_hdr(q, offset, &hdr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+complete_entry(struct mqtt_out_queue *q, struct mqtt_inflight *inflight)
+{
+  set_entry_state(q, inflight->offset, OUT_ENTRY_DONE);
+  inflight_remove(q, inflight);
+  release_entries(q);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Marks every entry that has not been completed as unsent again, with the DUP
+ * flag set for QoS > 0. Called when the TCP connection goes away so that the
+ * messages are resent to the broker when the connection is re-established.
+ * QoS 2 messages that already got their PUBREC are not published again, but
+ * their PUBREL is resent (MQTT 3.1.1, section 4.4).
+ */
+static void
+requeue_unacked(struct mqtt_connection *conn)
+{
+  struct mqtt_out_queue *q = &conn->out_queue;
+  struct out_entry_hdr hdr;
+  struct mqtt_inflight *inflight;
+  uint16_t offset;
+  uint16_t i;
+
+  q->inflight_count = 0;
+  q->send_offset = 0;
+  q->unsent = 0;
+
+  offset = q->tail;
+  for(i = 0; i < q->entries; i++) {
+    offset = entry_offset(q, offset);
+    read_entry_hdr(q, offset, &hdr);
+    if(hdr.state == OUT_ENTRY_RELEASING) {
+      inflight = &q->inflight[q->inflight_count++];
+      inflight->mid = hdr.mid;
+      inflight->offset = offset;
+      inflight->state = MQTT_QOS_STATE_PUBREL_PENDING;
+    } else if(hdr.state != OUT_ENTRY_DONE) {
+      if(hdr.state == OUT_ENTRY_SENT && hdr.qos > MQTT_QOS_LEVEL_0) {
+        q->buf[offset + OUT_ENTRY_HDR_SIZE] |= MQTT_FHDR_DUP_FLAG;
+      }
+      hdr.state = OUT_ENTRY_QUEUED;
+      write_entry_hdr(q, offset, &hdr);
+      q->unsent++;
+    }
+    offset += OUT_ENTRY_HDR_SIZE + hdr.len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Copies pending PUBRELs and as many queued PUBLISH packets as the in-flight
+ * window and the TCP output buffer allow into the output buffer, then hands
+ * the buffer to TCP in one go.
+ */
+static void
+flush_out_queue(struct mqtt_connection *conn)
+{
+  struct mqtt_out_queue *q = &conn->out_queue;
+  struct out_entry_hdr hdr;
+  struct mqtt_inflight *inflight;
+  uint16_t offset;
+  uint16_t space;
+  uint16_t copy_bytes;
+  uint16_t n;
+  uint8_t notify_app = 0;
+  uint8_t i;
+
+  for(i = 0; i < q->inflight_count; i++) {
+    inflight = &q->inflight[i];
+    if(inflight->state != MQTT_QOS_STATE_PUBREL_PENDING) {
+      continue;
+    }
+    if(&conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr <
+       MQTT_PUBREL_SIZE) {
+      break;
+    }
+    *conn->out_buffer_ptr++ = MQTT_FHDR_MSG_TYPE_PUBREL | MQTT_FHDR_QOS_LEVEL_1;
+    *conn->out_buffer_ptr++ = MQTT_MID_SIZE;
+    *conn->out_buffer_ptr++ = inflight->mid >> 8;
+    *conn->out_buffer_ptr++ = inflight->mid & 0x00FF;
+    inflight->state = MQTT_QOS_STATE_WAIT_PUBCOMP;
+  }
+
+  /*
+   * Everything up to the first queued entry has already been sent, and only
+   * that entry may have been partially copied to the output buffer.
+   */
+  offset = q->tail;
+  for(n = 0; n < q->entries && q->unsent > 0; n++) {
+    offset = entry_offset(q, offset);
+    read_entry_hdr(q, offset, &hdr);
+    if(hdr.state != OUT_ENTRY_QUEUED) {
+      offset += OUT_ENTRY_HDR_SIZE + hdr.len;
+      continue;
+    }
+
+    space = &conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr;
+    if(space == 0) {
+      break;
+    }
+
+    if(q->send_offset == 0 && hdr.qos > MQTT_QOS_LEVEL_0) {
+      if(q->inflight_count == MQTT_MAX_INFLIGHT) {
+        DBG("MQTT - In-flight window full\n");
+        break;
+      }
+      inflight = &q->inflight[q->inflight_count++];
+      inflight->mid = hdr.mid;
+      inflight->offset = offset;
+      inflight->state = MQTT_QOS_STATE_NO_ACK;
+    }
+
+    copy_bytes = MIN(space, hdr.len - q->send_offset);
+    memcpy(conn->out_buffer_ptr,
+           &q->buf[offset + OUT_ENTRY_HDR_SIZE + q->send_offset],
+           copy_bytes);
+    conn->out_buffer_ptr += copy_bytes;
+    q->send_offset += copy_bytes;
+
+    if(q->send_offset < hdr.len) {
+      /* The rest goes out once this buffer has been acknowledged */
+      break;
+    }
+
+    if(hdr.qos == MQTT_QOS_LEVEL_0) {
+      hdr.state = OUT_ENTRY_DONE;
+      notify_app = 1;
+    } else {
+      hdr.state = OUT_ENTRY_SENT;
+    }
+    write_entry_hdr(q, offset, &hdr);
+    offset += OUT_ENTRY_HDR_SIZE + hdr.len;
+    q->send_offset = 0;
+    q->unsent--;
+  }
+
+  /* There will be no PUBACK for QoS 0 messages, notify the app right away */
+  if(notify_app) {
+    process_post(conn->app_process, mqtt_update_event, NULL);
+  }
+
+  release_entries(q);
+  send_out_buffer(conn);
+}
+/*---------------------------------------------------------------------------*/
+static int
+out_queue_pending(struct mqtt_out_queue *q)
+{
+  uint8_t i;
+
+  if(q->unsent > 0) {
+    return 1;
+  }
+  for(i = 0; i < q->inflight_count; i++) {
+    if(q->inflight[i].state == MQTT_QOS_STATE_PUBREL_PENDING) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
 string_to_mqtt_string(struct mqtt_string *mqtt_string, char *string)
 {
   if(mqtt_string == NULL) {
@@ -624,94 +1048,6 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
 }
 /*---------------------------------------------------------------------------*/
 static
-PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
-{
-  PT_BEGIN(pt);
-
-  DBG("MQTT - Sending publish message! topic %s topic_length %i\n",
-      conn->out_packet.topic,
-      conn->out_packet.topic_length);
-  DBG("MQTT - Buffer space is %i \n",
-      &conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr);
-
-  /* Set up FHDR */
-  conn->out_packet.fhdr = MQTT_FHDR_MSG_TYPE_PUBLISH |
-    conn->out_packet.qos << 1;
-  if(conn->out_packet.retain == MQTT_RETAIN_ON) {
-    conn->out_packet.fhdr |= MQTT_FHDR_RETAIN_FLAG;
-  }
-  conn->out_packet.remaining_length = MQTT_STRING_LEN_SIZE +
-    conn->out_packet.topic_length +
-    conn->out_packet.payload_size;
-  if(conn->out_packet.qos > MQTT_QOS_LEVEL_0) {
-    conn->out_packet.remaining_length += MQTT_MID_SIZE;
-  }
-  encode_remaining_length(conn->out_packet.remaining_length_enc,
-                          &conn->out_packet.remaining_length_enc_bytes,
-                          conn->out_packet.remaining_length);
-  if(conn->out_packet.remaining_length_enc_bytes > 4) {
-    call_event(conn, MQTT_EVENT_PROTOCOL_ERROR, NULL);
-    PRINTF("MQTT - Error, remaining length > 4 bytes\n");
-    PT_EXIT(pt);
-  }
-
-  /* Write Fixed Header */
-  PT_MQTT_WRITE_BYTE(conn, conn->out_packet.fhdr);
-  PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.remaining_length_enc,
-                      conn->out_packet.remaining_length_enc_bytes);
-  /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length & 0x00FF));
-  PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.topic,
-                      conn->out_packet.topic_length);
-  if(conn->out_packet.qos > MQTT_QOS_LEVEL_0) {
-    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
-    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
-  }
-  /* Write Payload */
-  PT_MQTT_WRITE_BYTES(conn,
-                      conn->out_packet.payload,
-                      conn->out_packet.payload_size);
-
-  send_out_buffer(conn);
-  timer_set(&conn->t, RESPONSE_WAIT_TIMEOUT);
-
-  /*
-   * If QoS is zero then wait until the message has been sent, since there is
-   * no ACK to wait for.
-   *
-   * Also notify the app will not be notified via PUBACK or PUBCOMP
-   */
-  if(conn->out_packet.qos == 0) {
-    process_post(conn->app_process, mqtt_update_event, NULL);
-  } else if(conn->out_packet.qos == 1) {
-    /* Wait for PUBACK */
-    reset_packet(&conn->in_packet);
-    PT_WAIT_UNTIL(pt, conn->out_packet.qos_state == MQTT_QOS_STATE_GOT_ACK ||
-                  timer_expired(&conn->t));
-    if(timer_expired(&conn->t)) {
-      DBG("Timeout waiting for PUBACK\n");
-    }
-    if(conn->in_packet.mid != conn->out_packet.mid) {
-      DBG("MQTT - Warning, got PUBACK with none matching MID. Currently there "
-          "is no support for several concurrent PUBLISH messages.\n");
-    }
-  } else if(conn->out_packet.qos == 2) {
-    DBG("MQTT - QoS not implemented yet.\n");
-    /* Should wait for PUBREC, send PUBREL and then wait for PUBCOMP */
-  }
-
-  reset_packet(&conn->in_packet);
-
-  /* This is clear after the entire transaction is complete */
-  conn->out_queue_full = 0;
-
-  DBG("MQTT - Publish Enqueued\n");
-
-  PT_END(pt);
-}
-/*---------------------------------------------------------------------------*/
-static
 PT_THREAD(pingreq_pt(struct pt *pt, struct mqtt_connection *conn))
 {
   PT_BEGIN(pt);
@@ -761,6 +1097,11 @@ handle_connack(struct mqtt_connection *conn)
   /* Always reset packet before callback since it might be used directly */
   conn->state = MQTT_CONN_STATE_CONNECTED_TO_BROKER;
   call_event(conn, MQTT_EVENT_CONNECTED, NULL);
+
+  /* Resend whatever was left in the queue from a previous connection */
+  if(out_queue_pending(&conn->out_queue)) {
+    process_post(&mqtt_process, mqtt_do_publish_event, conn);
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -815,16 +1156,73 @@ handle_unsuback(struct mqtt_connection *conn)
   call_event(conn, MQTT_EVENT_UNSUBACK, &conn->in_packet.mid);
 }
 /*---------------------------------------------------------------------------*/
+static uint16_t
+read_in_packet_mid(struct mqtt_connection *conn)
+{
+  return (conn->in_packet.payload[0] << 8) | (conn->in_packet.payload[1]);
+}
+/*---------------------------------------------------------------------------*/
 static void
 handle_puback(struct mqtt_connection *conn)
 {
+  struct mqtt_inflight *inflight;
+
   DBG("MQTT - Got PUBACK\n");
 
-  conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
-  conn->in_packet.mid = (conn->in_packet.payload[0] << 8) |
-    (conn->in_packet.payload[1]);
+  conn->in_packet.mid = read_in_packet_mid(conn);
+
+  inflight = inflight_lookup(&conn->out_queue, conn->in_packet.mid);
+  if(inflight == NULL) {
+    DBG("MQTT - Warning, got PUBACK with unknown MID %u\n",
+        conn->in_packet.mid);
+    return;
+  }
+  complete_entry(&conn->out_queue, inflight);
 
   call_event(conn, MQTT_EVENT_PUBACK, &conn->in_packet.mid);
+  process_post(&mqtt_process, mqtt_do_publish_event, conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_pubrec(struct mqtt_connection *conn)
+{
+  struct mqtt_inflight *inflight;
+
+  DBG("MQTT - Got PUBREC\n");
+
+  conn->in_packet.mid = read_in_packet_mid(conn);
+
+  inflight = inflight_lookup(&conn->out_queue, conn->in_packet.mid);
+  if(inflight == NULL) {
+    DBG("MQTT - Warning, got PUBREC with unknown MID %u\n",
+        conn->in_packet.mid);
+    return;
+  }
+  inflight->state = MQTT_QOS_STATE_PUBREL_PENDING;
+  set_entry_state(&conn->out_queue, inflight->offset, OUT_ENTRY_RELEASING);
+
+  process_post(&mqtt_process, mqtt_do_publish_event, conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_pubcomp(struct mqtt_connection *conn)
+{
+  struct mqtt_inflight *inflight;
+
+  DBG("MQTT - Got PUBCOMP\n");
+
+  conn->in_packet.mid = read_in_packet_mid(conn);
+
+  inflight = inflight_lookup(&conn->out_queue, conn->in_packet.mid);
+  if(inflight == NULL) {
+    DBG("MQTT - Warning, got PUBCOMP with unknown MID %u\n",
+        conn->in_packet.mid);
+    return;
+  }
+  complete_entry(&conn->out_queue, inflight);
+
+  call_event(conn, MQTT_EVENT_PUBCOMP, &conn->in_packet.mid);
+  process_post(&mqtt_process, mqtt_do_publish_event, conn);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -1059,6 +1457,12 @@ tcp_input(struct tcp_socket *s,
   case MQTT_FHDR_MSG_TYPE_PUBACK:
     handle_puback(conn);
     break;
+  case MQTT_FHDR_MSG_TYPE_PUBREC:
+    handle_pubrec(conn);
+    break;
+  case MQTT_FHDR_MSG_TYPE_PUBCOMP:
+    handle_pubcomp(conn);
+    break;
   case MQTT_FHDR_MSG_TYPE_SUBACK:
     handle_suback(conn);
     break;
@@ -1069,10 +1473,8 @@ tcp_input(struct tcp_socket *s,
     handle_pingresp(conn);
     break;
 
-  /* QoS 2 not implemented yet */
-  case MQTT_FHDR_MSG_TYPE_PUBREC:
+  /* QoS 2 is not implemented for incoming PUBLISH messages */
   case MQTT_FHDR_MSG_TYPE_PUBREL:
-  case MQTT_FHDR_MSG_TYPE_PUBCOMP:
     call_event(conn, MQTT_EVENT_NOT_IMPLEMENTED_ERROR, NULL);
     PRINTF("MQTT - Got unhandled MQTT Message Type '%i'",
            (conn->in_packet.fhdr & 0xF0));
@@ -1131,6 +1533,13 @@ tcp_event(struct tcp_socket *s, void *ptr, tcp_socket_event_t event)
     if(conn->socket.output_data_len == 0) {
       conn->out_buffer_sent = 1;
       conn->out_buffer_ptr = conn->out_buffer;
+
+      if(conn->deferred_event != PROCESS_EVENT_NONE) {
+        process_post(&mqtt_process, conn->deferred_event, conn);
+        conn->deferred_event = PROCESS_EVENT_NONE;
+      } else if(out_queue_pending(&conn->out_queue)) {
+        process_post(&mqtt_process, mqtt_do_publish_event, conn);
+      }
     }
 
     ctimer_restart(&conn->keep_alive_timer);
@@ -1221,6 +1630,9 @@ PROCESS_THREAD(mqtt_process, ev, data)
               conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
           PT_MQTT_WAIT_SEND();
         }
+      } else if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        /* Queued PUBLISH messages are being sent, retry on their TCP ACK */
+        conn->deferred_event = mqtt_do_subscribe_event;
       }
     }
     if(ev == mqtt_do_unsubscribe_event) {
@@ -1234,19 +1646,22 @@ PROCESS_THREAD(mqtt_process, ev, data)
               conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
           PT_MQTT_WAIT_SEND();
         }
+      } else if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        /* Queued PUBLISH messages are being sent, retry on their TCP ACK */
+        conn->deferred_event = mqtt_do_unsubscribe_event;
       }
     }
     if(ev == mqtt_do_publish_event) {
       conn = data;
       DBG("MQTT - Got mqtt_do_publish_mqtt_event!\n");
 
+      /*
+       * Anything that is not flushed now is picked up again when the current
+       * output buffer has been acknowledged.
+       */
       if(conn->out_buffer_sent == 1 &&
          conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
-        PT_INIT(&conn->out_proto_thread);
-        while(publish_pt(&conn->out_proto_thread, conn) < PT_EXITED &&
-              conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
-          PT_MQTT_WAIT_SEND();
-        }
+        flush_out_queue(conn);
       }
     }
   }
@@ -1296,6 +1711,7 @@ mqtt_register(struct mqtt_connection *conn, struct process *app_process,
   conn->auto_reconnect = 1;
   conn->max_segment_size = max_segment_size;
   reset_defaults(conn);
+  reset_out_queue(conn, client_id);
 
   mqtt_init();
   list_add(mqtt_conn_list, conn);
@@ -1415,28 +1831,92 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
              uint8_t *payload, uint32_t payload_size,
              mqtt_qos_level_t qos_level, mqtt_retain_t retain)
 {
+  struct mqtt_out_queue *q = &conn->out_queue;
+  struct out_entry_hdr hdr;
+  uint8_t fhdr[MQTT_FHDR_SIZE + MQTT_MAX_REMAINING_LENGTH_BYTES];
+  uint8_t fhdr_len;
+  uint32_t remaining_length;
+  uint16_t topic_length;
+  uint8_t *ptr;
+  int offset;
+
   if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
     return MQTT_STATUS_NOT_CONNECTED_ERROR;
   }
 
   DBG("MQTT - Call to mqtt_publish...\n");
 
-  /* Currently don't have a queue, so only one item at a time */
-  if(conn->out_queue_full) {
+  if(qos_level > MQTT_QOS_LEVEL_2 || payload_size >= MQTT_OUT_QUEUE_SIZE) {
+    return MQTT_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  topic_length = strlen(topic);
+  remaining_length = MQTT_STRING_LEN_SIZE + topic_length + payload_size;
+  if(qos_level > MQTT_QOS_LEVEL_0) {
+    remaining_length += MQTT_MID_SIZE;
+  }
+
+  fhdr[0] = MQTT_FHDR_MSG_TYPE_PUBLISH | qos_level << 1;
+  if(retain == MQTT_RETAIN_ON) {
+    fhdr[0] |= MQTT_FHDR_RETAIN_FLAG;
+  }
+  encode_remaining_length(&fhdr[MQTT_FHDR_SIZE], &fhdr_len, remaining_length);
+  fhdr_len += MQTT_FHDR_SIZE;
+
+  /* The whole message must fit in the queue at once */
+  if(OUT_ENTRY_HDR_SIZE + fhdr_len + remaining_length >= MQTT_OUT_QUEUE_SIZE) {
+    DBG("MQTT - Message too large for the outbound queue\n");
+    return MQTT_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  hdr.len = fhdr_len + remaining_length;
+  hdr.mid = qos_level > MQTT_QOS_LEVEL_0 ? INCREMENT_MID(conn) : 0;
+  hdr.qos = qos_level;
+  hdr.state = OUT_ENTRY_QUEUED;
+
+#if MQTT_OUT_QUEUE_CFS
+  /* Keep the order: once spilling, everything goes through the file */
+  if(q->cfs_entries > 0) {
+    offset = -1;
+  } else
+#endif
+  {
+    offset = alloc_entry(q, OUT_ENTRY_HDR_SIZE + hdr.len);
+  }
+
+  if(offset < 0) {
+#if MQTT_OUT_QUEUE_CFS
+    if(spill_entry(q, &hdr, fhdr, fhdr_len, topic, topic_length,
+                   payload, payload_size)) {
+      DBG("MQTT - Spilled to CFS!\n");
+      if(mid != NULL) {
+        *mid = hdr.mid;
+      }
+      return MQTT_STATUS_OK;
+    }
+#endif
     DBG("MQTT - Not accepted!\n");
     return MQTT_STATUS_OUT_QUEUE_FULL;
   }
-  conn->out_queue_full = 1;
   DBG("MQTT - Accepted!\n");
 
-  conn->out_packet.mid = INCREMENT_MID(conn);
-  conn->out_packet.retain = retain;
-  conn->out_packet.topic = topic;
-  conn->out_packet.topic_length = strlen(topic);
-  conn->out_packet.payload = payload;
-  conn->out_packet.payload_size = payload_size;
-  conn->out_packet.qos = qos_level;
-  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  write_entry_hdr(q, offset, &hdr);
+  ptr = &q->buf[offset + OUT_ENTRY_HDR_SIZE];
+  memcpy(ptr, fhdr, fhdr_len);
+  ptr += fhdr_len;
+  *ptr++ = topic_length >> 8;
+  *ptr++ = topic_length & 0x00FF;
+  memcpy(ptr, topic, topic_length);
+  ptr += topic_length;
+  if(qos_level > MQTT_QOS_LEVEL_0) {
+    *ptr++ = hdr.mid >> 8;
+    *ptr++ = hdr.mid & 0x00FF;
+  }
+  memcpy(ptr, payload, payload_size);
+
+  if(mid != NULL) {
+    *mid = hdr.mid;
+  }
 
   process_post(&mqtt_process, mqtt_do_publish_event, conn);
   return MQTT_STATUS_OK;
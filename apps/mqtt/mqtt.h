@@ -35,7 +35,8 @@
  * \defgroup mqtt-engine An implementation of MQTT v3.1
  * @{
  *
- * This application is an engine for MQTT v3.1. It supports QoS Levels 0 and 1.
+ * This application is an engine for MQTT v3.1. It supports QoS Levels 0 and 1,
+ * and QoS level 2 for messages published by the client.
  *
  * MQTT is a Client Server publish/subscribe messaging transport protocol.
  * It is light weight, open, simple, and designed so as to be easy to implement.
@@ -61,7 +62,7 @@
  *  -- "Exactly once" (2), where message are assured to arrive exactly once.
  *  This level could be used, for example, with billing systems where duplicate
  *  or lost messages could lead to incorrect charges being applied. This QoS
- *  level is currently not supported in this implementation.
+ *  level is currently only supported for outgoing PUBLISH messages.
  *
  * - A small transport overhead and protocol exchanges minimized to reduce
  *   network traffic.
@@ -118,6 +119,43 @@
 #define MQTT_PROTOCOL_NAME "MQIsdp"
 #define MQTT_TOPIC_MAX_LENGTH 128
 /*---------------------------------------------------------------------------*/
+/*
+ * Outbound PUBLISH queue configuration.
+ *
+ * Every PUBLISH is serialised into a per-connection ring buffer of
+ * MQTT_OUT_QUEUE_SIZE bytes when mqtt_publish() is called. The queue is
+ * flushed into the TCP output buffer so that several PUBLISH packets can share
+ * a segment. Up to MQTT_MAX_INFLIGHT QoS 1/2 messages may be awaiting their
+ * PUBACK/PUBCOMP at the same time.
+ *
+ * The ring buffer is part of struct mqtt_connection, so every connection
+ * holds MQTT_OUT_QUEUE_SIZE bytes of RAM on top of its TCP buffers. Set
+ * MQTT_CONF_OUT_QUEUE_SIZE to fit the largest PUBLISH the application sends.
+ *
+ * If MQTT_OUT_QUEUE_CFS is set, messages that do not fit in the ring buffer
+ * are spilled to a CFS file and moved into RAM as space becomes available.
+ */
+#ifdef MQTT_CONF_OUT_QUEUE_SIZE
+#define MQTT_OUT_QUEUE_SIZE MQTT_CONF_OUT_QUEUE_SIZE
+#else
+#define MQTT_OUT_QUEUE_SIZE 512
+#endif
+
+#ifdef MQTT_CONF_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT MQTT_CONF_MAX_INFLIGHT
+#else
+#define MQTT_MAX_INFLIGHT 4
+#endif
+
+#ifdef MQTT_CONF_OUT_QUEUE_CFS
+#define MQTT_OUT_QUEUE_CFS MQTT_CONF_OUT_QUEUE_CFS
+#else
+#define MQTT_OUT_QUEUE_CFS 0
+#endif
+
+/* Room for "mq" + 10 characters of the client ID + termination */
+#define MQTT_OUT_QUEUE_CFS_NAME_LEN 13
+/*---------------------------------------------------------------------------*/
 /*
  * Debug configuration, this is similar but not exactly like the Debugging
  * System discussion at https://github.com/contiki-os/contiki/wiki.
@@ -151,6 +189,7 @@ typedef enum {
   MQTT_EVENT_UNSUBACK,
   MQTT_EVENT_PUBLISH,
   MQTT_EVENT_PUBACK,
+  MQTT_EVENT_PUBCOMP,
 
   /* Errors */
   MQTT_EVENT_ERROR = 0x80,
@@ -183,7 +222,10 @@ typedef enum {
   MQTT_QOS_STATE_NO_ACK,
   MQTT_QOS_STATE_GOT_ACK,
 
-  /* Expand for QoS 2 */
+  /* QoS 2: PUBREC received, PUBREL still has to be sent */
+  MQTT_QOS_STATE_PUBREL_PENDING,
+  /* QoS 2: PUBREL sent, waiting for PUBCOMP */
+  MQTT_QOS_STATE_WAIT_PUBCOMP,
 } mqtt_qos_state_t;
 /*---------------------------------------------------------------------------*/
 /*
@@ -284,6 +326,36 @@ struct mqtt_out_packet {
   mqtt_qos_state_t qos_state;
   mqtt_retain_t retain;
 };
+
+/*
+ * A QoS 1/2 PUBLISH that has been handed to TCP and not yet been acknowledged
+ * by the broker. The offset refers to its entry in the outbound queue, which
+ * is retained until the handshake completes.
+ */
+struct mqtt_inflight {
+  uint16_t mid;
+  uint16_t offset;
+  mqtt_qos_state_t state;
+};
+
+/* Ring buffer of serialised PUBLISH packets waiting to be (re)sent. */
+struct mqtt_out_queue {
+  uint8_t buf[MQTT_OUT_QUEUE_SIZE];
+  uint16_t head;
+  uint16_t tail;
+  uint16_t send_offset;
+  uint16_t entries;
+  uint16_t unsent;
+
+  struct mqtt_inflight inflight[MQTT_MAX_INFLIGHT];
+  uint8_t inflight_count;
+
+#if MQTT_OUT_QUEUE_CFS
+  char cfs_name[MQTT_OUT_QUEUE_CFS_NAME_LEN];
+  uint32_t cfs_read_pos;
+  uint16_t cfs_entries;
+#endif
+};
 /*---------------------------------------------------------------------------*/
 /**
  * \brief           MQTT event callback function
@@ -338,6 +410,8 @@ struct mqtt_connection {
 
   /* Used for communication between MQTT API and APP */
   uint8_t out_queue_full;
+  /* SUBSCRIBE or UNSUBSCRIBE waiting for the output buffer to be ACKed */
+  process_event_t deferred_event;
   struct process *app_process;
 
   /* Outgoing data related */
@@ -345,6 +419,7 @@ struct mqtt_connection {
   uint8_t out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE];
   uint8_t out_buffer_sent;
   struct mqtt_out_packet out_packet;
+  struct mqtt_out_queue out_queue;
   struct pt out_proto_thread;
   uint32_t out_write_pos;
   uint16_t max_segment_size;
@@ -443,7 +518,7 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
  * \param topic A pointer to the topic to subscribe to.
  * \param payload A pointer to the topic payload.
  * \param payload_size Payload size.
- * \param qos_level Quality Of Service level to use. Currently supports 0, 1.
+ * \param qos_level Quality Of Service level to use. Supports 0, 1 and 2.
  * \param retain If the RETAIN flag is set to 1, in a PUBLISH Packet sent by a
  *        Client to a Server, the Server MUST store the Application Message
  *        and its QoS, so that it can be delivered to future subscribers whose
@@ -451,6 +526,13 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
  * \return MQTT_STATUS_OK or some error status
  *
  * This function publishes to a topic on a MQTT broker.
+ *
+ * The message is copied into the connection's outbound queue, so topic and
+ * payload may be reused as soon as this function returns. The assigned
+ * message ID is written to \e mid and is passed along with the
+ * MQTT_EVENT_PUBACK (QoS 1) or MQTT_EVENT_PUBCOMP (QoS 2) event.
+ * MQTT_STATUS_OUT_QUEUE_FULL is returned if the queue cannot hold the
+ * message; MQTT_STATUS_INVALID_ARGS_ERROR if it could never fit.
  */
 mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            uint16_t *mid,
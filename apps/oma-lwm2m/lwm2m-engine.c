@@ -47,6 +47,7 @@
 #include "lwm2m-device.h"
 #include "lwm2m-plain-text.h"
 #include "lwm2m-json.h"
+#include "lwm2m-senml-cbor.h"
 #include "rest-engine.h"
 #include "er-coap-constants.h"
 #include "er-coap-engine.h"
@@ -79,6 +80,12 @@
 #define MAX_OBJECTS 10
 #endif /* LWM2M_ENGINE_CONF_MAX_OBJECTS */
 
+#ifdef LWM2M_ENGINE_CONF_MAX_OBSERVE_ATTRIBUTES
+#define MAX_OBSERVE_ATTRIBUTES LWM2M_ENGINE_CONF_MAX_OBSERVE_ATTRIBUTES
+#else /* LWM2M_ENGINE_CONF_MAX_OBSERVE_ATTRIBUTES */
+#define MAX_OBSERVE_ATTRIBUTES 4
+#endif /* LWM2M_ENGINE_CONF_MAX_OBSERVE_ATTRIBUTES */
+
 #define REMOTE_PORT        UIP_HTONS(COAP_DEFAULT_PORT)
 #define BS_REMOTE_PORT     UIP_HTONS(5685)
 
@@ -100,6 +107,34 @@ static uint8_t has_registration_server_info = 0;
 static uint8_t registered = 0;
 static uint8_t bootstrapped = 0; /* bootstrap made... */
 
+/* Resource id used for attributes set on a whole instance */
+#define OBSERVE_INSTANCE        0xffff
+#define OBSERVE_ALL_RESOURCES   0xffffffffUL
+
+#define OBSERVE_FLAG_USED       1
+#define OBSERVE_FLAG_PENDING    2
+#define OBSERVE_FLAG_HAS_VALUE  4
+
+/* Notification attributes (pmin/pmax/st) and state of an observed path */
+typedef struct observe_attr {
+  uint16_t object_id;
+  uint16_t instance_id;
+  uint16_t resource_id;
+  uint16_t pmin;
+  uint16_t pmax;
+  uint8_t flags;
+  int32_t step;
+  int32_t last_value;
+  unsigned long last_sent;
+  /* Resource indices changed since the last instance notification */
+  uint32_t changed;
+} observe_attr_t;
+
+static observe_attr_t observe_attrs[MAX_OBSERVE_ATTRIBUTES];
+static struct ctimer observe_timer;
+/* The attributes of the notification currently being generated */
+static const observe_attr_t *notifying;
+
 void lwm2m_device_init(void);
 void lwm2m_security_init(void);
 void lwm2m_server_init(void);
@@ -587,6 +622,330 @@ get_resource(const lwm2m_instance_t *instance, lwm2m_context_t *context)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static observe_attr_t *
+find_observe_attr(uint16_t object_id, uint16_t instance_id,
+                  uint16_t resource_id)
+{
+  int i;
+  for(i = 0; i < MAX_OBSERVE_ATTRIBUTES; i++) {
+    if((observe_attrs[i].flags & OBSERVE_FLAG_USED) &&
+       observe_attrs[i].object_id == object_id &&
+       observe_attrs[i].instance_id == instance_id &&
+       observe_attrs[i].resource_id == resource_id) {
+      return &observe_attrs[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static observe_attr_t *
+alloc_observe_attr(uint16_t object_id, uint16_t instance_id,
+                   uint16_t resource_id)
+{
+  observe_attr_t *a;
+  int i;
+
+  a = find_observe_attr(object_id, instance_id, resource_id);
+  if(a != NULL) {
+    return a;
+  }
+  for(i = 0; i < MAX_OBSERVE_ATTRIBUTES; i++) {
+    if((observe_attrs[i].flags & OBSERVE_FLAG_USED) == 0) {
+      a = &observe_attrs[i];
+      memset(a, 0, sizeof(observe_attr_t));
+      a->flags = OBSERVE_FLAG_USED;
+      a->object_id = object_id;
+      a->instance_id = instance_id;
+      a->resource_id = resource_id;
+      a->last_sent = clock_seconds();
+      return a;
+    }
+  }
+  PRINTF("lwm2m: no space for observe attributes\n");
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static const lwm2m_resource_t *
+lookup_resource(const lwm2m_object_t *object, uint16_t instance_id,
+                uint16_t resource_id, lwm2m_context_t *context)
+{
+  memset(context, 0, sizeof(lwm2m_context_t));
+  context->object_id = object->id;
+  context->object_instance_id = instance_id;
+  context->resource_id = resource_id;
+  return get_resource(get_instance(object, context, 3), context);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Read the value of a numeric resource as fix point (floatfix and callback
+ * resources) or as integer (integer and boolean resources).
+ */
+static int
+get_numeric_value(const lwm2m_object_t *object, const observe_attr_t *a,
+                  int32_t *value, int *is_fix)
+{
+  const lwm2m_resource_t *resource;
+  lwm2m_context_t context;
+  uint8_t text[16];
+  int b, len;
+
+  resource = lookup_resource(object, a->instance_id, a->resource_id, &context);
+  *is_fix = 0;
+  if(lwm2m_object_is_resource_int(resource)) {
+    return lwm2m_object_get_resource_int(resource, &context, value);
+  }
+  if(lwm2m_object_is_resource_floatfix(resource)) {
+    *is_fix = 1;
+    return lwm2m_object_get_resource_floatfix(resource, &context, value);
+  }
+  if(lwm2m_object_is_resource_boolean(resource) &&
+     lwm2m_object_get_resource_boolean(resource, &context, &b)) {
+    *value = b;
+    return 1;
+  }
+  if(lwm2m_object_is_resource_callback(resource) &&
+     resource->value.callback.read != NULL) {
+    /* Let the callback render the value as plain text and parse it back */
+    context.writer = &lwm2m_plain_text_writer;
+    len = resource->value.callback.read(&context, text, sizeof(text));
+    if(len > 0 && len < sizeof(text) &&
+       lwm2m_plain_text_read_float32fix(text, len, value,
+                                        LWM2M_FLOAT32_BITS) > 0) {
+      *is_fix = 1;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_notification(const lwm2m_object_t *object, observe_attr_t *a,
+                  uint16_t instance_id, uint16_t resource_id)
+{
+  const observe_attr_t *previous;
+  char path[14];
+  int32_t value;
+  int is_fix;
+
+  if(resource_id == OBSERVE_INSTANCE) {
+    snprintf(path, sizeof(path), "/%u", instance_id);
+  } else {
+    snprintf(path, sizeof(path), "/%u/%u", instance_id, resource_id);
+  }
+  PRINTF("lwm2m: notify %s%s\n", object->path, path);
+
+  if(a != NULL) {
+    /* Update the state first as resource callbacks may report changes */
+    a->flags &= ~OBSERVE_FLAG_PENDING;
+    a->last_sent = clock_seconds();
+    if(resource_id != OBSERVE_INSTANCE &&
+       get_numeric_value(object, a, &value, &is_fix)) {
+      a->last_value = value;
+      a->flags |= OBSERVE_FLAG_HAS_VALUE;
+    }
+  }
+
+  /*
+   * An instance notification only goes to the observers of the instance.
+   * The observers of its resources get their own notifications, and would
+   * otherwise get each change twice.
+   */
+  previous = notifying;
+  notifying = a;
+  if(resource_id == OBSERVE_INSTANCE) {
+    coap_notify_observers_path(lwm2m_object_get_coap_resource(object), path);
+  } else {
+    lwm2m_object_notify_observers(object, path);
+  }
+  notifying = previous;
+
+  if(a != NULL) {
+    a->changed = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Send the notifications that are due according to pmin/pmax and schedule
+ * the timer for the next one.
+ */
+static void
+check_observe_attrs(void *ptr)
+{
+  const lwm2m_object_t *object;
+  unsigned long now, elapsed, wait, next;
+  observe_attr_t *a;
+  int i;
+
+  now = clock_seconds();
+  next = 0;
+  for(i = 0; i < MAX_OBSERVE_ATTRIBUTES; i++) {
+    a = &observe_attrs[i];
+    if((a->flags & OBSERVE_FLAG_USED) == 0) {
+      continue;
+    }
+    elapsed = now - a->last_sent;
+    if(((a->flags & OBSERVE_FLAG_PENDING) && elapsed >= a->pmin) ||
+       (a->pmax > 0 && elapsed >= a->pmax)) {
+      object = lwm2m_engine_get_object(a->object_id);
+      if(object == NULL) {
+        a->flags = 0;
+        continue;
+      }
+      if((a->flags & OBSERVE_FLAG_PENDING) == 0) {
+        /* pmax expired - report the full state */
+        a->changed = OBSERVE_ALL_RESOURCES;
+      }
+      send_notification(object, a, a->instance_id, a->resource_id);
+      elapsed = 0;
+    }
+
+    if(a->flags & OBSERVE_FLAG_PENDING) {
+      wait = a->pmin - elapsed;
+    } else if(a->pmax > 0) {
+      wait = a->pmax - elapsed;
+    } else {
+      continue;
+    }
+    if(next == 0 || wait < next) {
+      next = wait;
+    }
+  }
+
+  if(next > 0) {
+    ctimer_set(&observe_timer, next * CLOCK_SECOND, check_observe_attrs, NULL);
+  } else {
+    ctimer_stop(&observe_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+has_changed_by_step(const lwm2m_object_t *object, const observe_attr_t *a)
+{
+  int32_t value, diff;
+  int is_fix;
+
+  if(a->step == 0 || (a->flags & OBSERVE_FLAG_HAS_VALUE) == 0 ||
+     !get_numeric_value(object, a, &value, &is_fix)) {
+    return 1;
+  }
+  diff = value > a->last_value ? value - a->last_value : a->last_value - value;
+  if(is_fix) {
+    return diff >= a->step;
+  }
+  return (int64_t)diff * LWM2M_FLOAT32_FRAC >= a->step;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_engine_notify_changed(const lwm2m_object_t *object,
+                            uint16_t instance_id, uint16_t resource_id)
+{
+  lwm2m_context_t context;
+  observe_attr_t instance_changes;
+  observe_attr_t *a;
+  uint32_t changed;
+
+  a = find_observe_attr(object->id, instance_id, resource_id);
+  if(a == NULL) {
+    /* No attributes - notify right away */
+    send_notification(object, NULL, instance_id, resource_id);
+  } else if(has_changed_by_step(object, a)) {
+    a->flags |= OBSERVE_FLAG_PENDING;
+  }
+
+  changed = 0;
+  if(lookup_resource(object, instance_id, resource_id, &context) != NULL &&
+     context.resource_index < 32) {
+    changed = 1UL << context.resource_index;
+  }
+  a = find_observe_attr(object->id, instance_id, OBSERVE_INSTANCE);
+  if(a != NULL) {
+    a->changed |= changed;
+    a->flags |= OBSERVE_FLAG_PENDING;
+  } else if(changed != 0) {
+    /* No attributes - notify the observers of the instance right away */
+    memset(&instance_changes, 0, sizeof(instance_changes));
+    instance_changes.object_id = object->id;
+    instance_changes.instance_id = instance_id;
+    instance_changes.resource_id = OBSERVE_INSTANCE;
+    instance_changes.changed = changed;
+    send_notification(object, &instance_changes, instance_id,
+                      OBSERVE_INSTANCE);
+  }
+
+  check_observe_attrs(NULL);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * @brief  Handle Write-Attributes (PUT with pmin/pmax/st query and no payload)
+ *
+ * @return 1 if the request was a Write-Attributes request, 0 otherwise
+ */
+static int
+write_attributes(void *request, void *response,
+                 const lwm2m_object_t *object,
+                 const lwm2m_instance_t *instance,
+                 lwm2m_context_t *context, int depth)
+{
+  const uint8_t *data;
+  const char *pmin, *pmax, *st;
+  int pmin_len, pmax_len, st_len;
+  uint16_t resource_id;
+  observe_attr_t *a;
+  int32_t value;
+  int is_fix;
+
+  pmin_len = REST.get_query_variable(request, "pmin", &pmin);
+  pmax_len = REST.get_query_variable(request, "pmax", &pmax);
+  st_len = REST.get_query_variable(request, "st", &st);
+  if((pmin_len <= 0 && pmax_len <= 0 && st_len <= 0) ||
+     REST.get_request_payload(request, &data) > 0) {
+    return 0;
+  }
+
+  if(depth == 3) {
+    if(get_resource(instance, context) == NULL) {
+      REST.set_response_status(response, NOT_FOUND_4_04);
+      return 1;
+    }
+    resource_id = context->resource_id;
+  } else {
+    resource_id = OBSERVE_INSTANCE;
+  }
+
+  a = alloc_observe_attr(object->id, context->object_instance_id, resource_id);
+  if(a == NULL) {
+    REST.set_response_status(response, SERVICE_UNAVAILABLE_5_03);
+    return 1;
+  }
+
+  if(pmin_len > 0) {
+    lwm2m_plain_text_read_int((const uint8_t *)pmin, pmin_len, &value);
+    a->pmin = value < 0 ? 0 : value;
+  }
+  if(pmax_len > 0) {
+    lwm2m_plain_text_read_int((const uint8_t *)pmax, pmax_len, &value);
+    a->pmax = value < 0 ? 0 : value;
+  }
+  if(st_len > 0 && resource_id != OBSERVE_INSTANCE) {
+    lwm2m_plain_text_read_float32fix((const uint8_t *)st, st_len, &value,
+                                     LWM2M_FLOAT32_BITS);
+    a->step = value < 0 ? -value : value;
+  }
+  PRINTF("lwm2m: attributes %u/%u/%u pmin:%u pmax:%u st:%" PRId32 "\n",
+         object->id, context->object_instance_id, resource_id,
+         a->pmin, a->pmax, a->step);
+
+  if(resource_id != OBSERVE_INSTANCE &&
+     get_numeric_value(object, a, &value, &is_fix)) {
+    a->last_value = value;
+    a->flags |= OBSERVE_FLAG_HAS_VALUE;
+  }
+  check_observe_attrs(NULL);
+
+  REST.set_response_status(response, CHANGED_2_04);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 /**
  * @brief Write a list of object instances as a CoRE Link-format list
  */
@@ -654,7 +1013,7 @@ static int
 write_rd_json_data(const lwm2m_context_t *context,
                    const lwm2m_object_t *object,
                    const lwm2m_instance_t *instance,
-                   char *buffer, size_t size)
+                   char *buffer, size_t size, uint32_t mask)
 {
   const lwm2m_resource_t *resource;
   const char *s = "";
@@ -667,6 +1026,9 @@ write_rd_json_data(const lwm2m_context_t *context,
   }
 
   for(i = 0, len = 0; i < instance->count; i++) {
+    if(i < 32 && (mask & (1UL << i)) == 0) {
+      continue;
+    }
     resource = &instance->resources[i];
     len = 0;
     if(lwm2m_object_is_resource_string(resource)) {
@@ -743,6 +1105,83 @@ write_rd_json_data(const lwm2m_context_t *context,
   return rdlen;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * @brief Write the resources of an instance as a SenML CBOR pack
+ */
+static int
+write_rd_senml_cbor_data(const lwm2m_context_t *context,
+                         const lwm2m_instance_t *instance,
+                         uint8_t *buffer, size_t size, uint32_t mask)
+{
+  const lwm2m_writer_t *writer = &lwm2m_senml_cbor_record_writer;
+  const lwm2m_resource_t *resource;
+  lwm2m_context_t ctx;
+  size_t len, rdlen;
+  int i;
+
+  rdlen = lwm2m_senml_cbor_write_pack_start(buffer, size);
+  if(rdlen == 0) {
+    return -1;
+  }
+
+  ctx = *context;
+  for(i = 0; i < instance->count; i++) {
+    if(i < 32 && (mask & (1UL << i)) == 0) {
+      continue;
+    }
+    resource = &instance->resources[i];
+    ctx.resource_id = resource->id;
+    ctx.resource_index = i;
+    len = 0;
+    if(lwm2m_object_is_resource_string(resource)) {
+      const uint8_t *value;
+      value = lwm2m_object_get_resource_string(resource, &ctx);
+      if(value != NULL) {
+        len = writer->write_string(&ctx, &buffer[rdlen], size - rdlen,
+                                   (const char *)value,
+                                   lwm2m_object_get_resource_strlen(resource,
+                                                                    &ctx));
+        if(len == 0) {
+          return -1;
+        }
+      }
+    } else if(lwm2m_object_is_resource_int(resource)) {
+      int32_t value;
+      if(lwm2m_object_get_resource_int(resource, &ctx, &value)) {
+        len = writer->write_int(&ctx, &buffer[rdlen], size - rdlen, value);
+        if(len == 0) {
+          return -1;
+        }
+      }
+    } else if(lwm2m_object_is_resource_floatfix(resource)) {
+      int32_t value;
+      if(lwm2m_object_get_resource_floatfix(resource, &ctx, &value)) {
+        len = writer->write_float32fix(&ctx, &buffer[rdlen], size - rdlen,
+                                       value, LWM2M_FLOAT32_BITS);
+        if(len == 0) {
+          return -1;
+        }
+      }
+    } else if(lwm2m_object_is_resource_boolean(resource)) {
+      int value;
+      if(lwm2m_object_get_resource_boolean(resource, &ctx, &value)) {
+        len = writer->write_boolean(&ctx, &buffer[rdlen], size - rdlen,
+                                    value);
+        if(len == 0) {
+          return -1;
+        }
+      }
+    }
+    rdlen += len;
+  }
+
+  len = lwm2m_senml_cbor_write_pack_end(&buffer[rdlen], size - rdlen);
+  if(len == 0) {
+    return -1;
+  }
+  return rdlen + len;
+}
+/*---------------------------------------------------------------------------*/
 /**
  * @brief  Set the writer pointer to the proper writer based on the Accept: header
  *
@@ -766,6 +1205,9 @@ lwm2m_engine_select_writer(lwm2m_context_t *context, unsigned int accept)
     case APPLICATION_JSON:
       context->writer = &lwm2m_json_writer;
       break;
+    case LWM2M_SENML_CBOR:
+      context->writer = &lwm2m_senml_cbor_writer;
+      break;
     default:
       PRINTF("Unknown Accept type %u, using LWM2M plain text\n", accept);
       context->writer = &lwm2m_plain_text_writer;
@@ -793,6 +1235,9 @@ lwm2m_engine_select_reader(lwm2m_context_t *context, unsigned int content_format
     case TEXT_PLAIN:
       context->reader = &lwm2m_plain_text_reader;
       break;
+    case LWM2M_SENML_CBOR:
+      context->reader = &lwm2m_senml_cbor_reader;
+      break;
     default:
       PRINTF("Unknown content type %u, using LWM2M plain text\n", accept);
       context->reader = &lwm2m_plain_text_reader;
@@ -962,6 +1407,25 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
     return;
   }
 
+  if(method == METHOD_PUT && depth > 1 &&
+     write_attributes(request, response, object, instance, &context, depth)) {
+    return;
+  }
+
+  if(method == METHOD_GET && depth > 1) {
+    uint32_t observe;
+    observe_attr_t *a;
+    if(coap_get_header_observe(request, &observe) && observe == 1) {
+      /* Cancelled observation - release the attributes of the path */
+      a = find_observe_attr(object->id, context.object_instance_id,
+                            depth == 3 ? context.resource_id :
+                            OBSERVE_INSTANCE);
+      if(a != NULL) {
+        a->flags = 0;
+      }
+    }
+  }
+
   if(depth == 3) {
     const lwm2m_resource_t *resource = get_resource(instance, &context);
     size_t content_len = 0;
@@ -975,13 +1439,11 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
       if(lwm2m_object_is_resource_callback(resource)) {
         if(resource->value.callback.write != NULL) {
           /* pick a reader ??? */
-          if(format == LWM2M_TEXT_PLAIN) {
-            /* a string */
+          if(format == LWM2M_TEXT_PLAIN || format == LWM2M_SENML_CBOR) {
+            /* plain text is a string, SenML CBOR is parsed by the reader */
             const uint8_t *data;
             int plen = REST.get_request_payload(request, &data);
-            context.reader = &lwm2m_plain_text_reader;
             PRINTF("PUT Callback with data: '%.*s'\n", plen, data);
-            /* no specific reader for plain text */
             content_len = resource->value.callback.write(&context, data, plen,
                                                     buffer, preferred_size);
             PRINTF("content_len:%u\n", (unsigned int)content_len);
@@ -1067,12 +1529,34 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
       REST.set_response_status(response, NOT_FOUND_4_04);
     } else {
       int rdlen;
+      uint32_t mask;
+      uint32_t observe;
+
+      mask = OBSERVE_ALL_RESOURCES;
+      if(notifying != NULL && notifying->object_id == object->id &&
+         notifying->instance_id == instance->id &&
+         notifying->resource_id == OBSERVE_INSTANCE) {
+        /* Notification - only report the resources that changed */
+        mask = notifying->changed;
+      } else if(coap_get_header_observe(request, &observe) && observe == 0) {
+        /* New observer of the instance - restart tracking changes */
+        observe_attr_t *a;
+        a = find_observe_attr(object->id, instance->id, OBSERVE_INSTANCE);
+        if(a != NULL) {
+          a->changed = 0;
+          a->last_sent = clock_seconds();
+        }
+      }
+
       if(accept == APPLICATION_LINK_FORMAT) {
         rdlen = write_rd_link_data(object, instance,
                                    (char *)buffer, preferred_size);
+      } else if(accept == LWM2M_SENML_CBOR) {
+        rdlen = write_rd_senml_cbor_data(&context, instance,
+                                         buffer, preferred_size, mask);
       } else {
         rdlen = write_rd_json_data(&context, object, instance,
-                                   (char *)buffer, preferred_size);
+                                   (char *)buffer, preferred_size, mask);
       }
       if(rdlen < 0) {
         PRINTF("Failed to generate instance response\n");
@@ -1082,6 +1566,8 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
       REST.set_response_payload(response, buffer, rdlen);
       if(accept == APPLICATION_LINK_FORMAT) {
         REST.set_header_content_type(response, REST.type.APPLICATION_LINK_FORMAT);
+      } else if(accept == LWM2M_SENML_CBOR) {
+        REST.set_header_content_type(response, LWM2M_SENML_CBOR);
       } else {
         REST.set_header_content_type(response, LWM2M_JSON);
       }
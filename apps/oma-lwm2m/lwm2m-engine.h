@@ -51,6 +51,7 @@
 
 /* LWM2M / CoAP Content-Formats */
 typedef enum {
+  LWM2M_SENML_CBOR = 112,
   LWM2M_TEXT_PLAIN = 1541,
   LWM2M_TLV        = 1542,
   LWM2M_JSON       = 1543,
@@ -68,6 +69,15 @@ const lwm2m_object_t *lwm2m_engine_get_object(uint16_t id);
 
 int lwm2m_engine_register_object(const lwm2m_object_t *object);
 
+/*
+ * Report that the value of a resource has changed. Observers are notified
+ * according to the pmin/pmax/st attributes set by the server; without
+ * attributes the observers of the resource are notified right away.
+ * Observers of the instance only receive the resources that changed.
+ */
+void lwm2m_engine_notify_changed(const lwm2m_object_t *object,
+                                 uint16_t instance_id, uint16_t resource_id);
+
 void lwm2m_engine_handler(const lwm2m_object_t *object,
                           void *request, void *response,
                           uint8_t *buffer, uint16_t preferred_size,
@@ -0,0 +1,609 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M SenML CBOR reader / writer
+ *
+ *         Resources are encoded as SenML records (RFC 8428) in CBOR, using
+ *         the integer map labels of the CBOR representation. Compared to
+ *         the JSON writer a typical integer resource, including its base
+ *         name, shrinks from about 25 to 16 bytes.
+ */
+
+#include "lwm2m-object.h"
+#include "lwm2m-senml-cbor.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* CBOR major types */
+#define CBOR_UINT       0
+#define CBOR_NINT       1
+#define CBOR_BYTES      2
+#define CBOR_TEXT       3
+#define CBOR_ARRAY      4
+#define CBOR_MAP        5
+#define CBOR_SIMPLE     7
+
+#define CBOR_INDEFINITE 31
+#define CBOR_FALSE      20
+#define CBOR_TRUE       21
+#define CBOR_FLOAT16    25
+#define CBOR_FLOAT32    26
+#define CBOR_FLOAT64    27
+#define CBOR_BREAK      0xff
+
+/* SenML CBOR labels */
+#define SENML_BASE_NAME  -2
+#define SENML_NAME       0
+#define SENML_VALUE      2
+#define SENML_STRING     3
+#define SENML_BOOLEAN    4
+
+/* The next record of a pack is its first and carries the base name */
+static uint8_t base_name_pending;
+
+/*---------------------------------------------------------------------------*/
+static size_t
+cbor_write_head(uint8_t *outbuf, size_t outlen, uint8_t major, uint32_t value)
+{
+  major <<= 5;
+  if(value < 24) {
+    if(outlen < 1) {
+      return 0;
+    }
+    outbuf[0] = major | value;
+    return 1;
+  }
+  if(value <= 0xff) {
+    if(outlen < 2) {
+      return 0;
+    }
+    outbuf[0] = major | 24;
+    outbuf[1] = value;
+    return 2;
+  }
+  if(value <= 0xffff) {
+    if(outlen < 3) {
+      return 0;
+    }
+    outbuf[0] = major | 25;
+    outbuf[1] = value >> 8;
+    outbuf[2] = value & 0xff;
+    return 3;
+  }
+  if(outlen < 5) {
+    return 0;
+  }
+  outbuf[0] = major | 26;
+  outbuf[1] = value >> 24;
+  outbuf[2] = (value >> 16) & 0xff;
+  outbuf[3] = (value >> 8) & 0xff;
+  outbuf[4] = value & 0xff;
+  return 5;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Read the head of a CBOR data item. For floats the value is the raw bit
+ * pattern. Returns the length of the head or 0 on error.
+ */
+static size_t
+cbor_read_head(const uint8_t *inbuf, size_t len, uint8_t *major,
+               uint8_t *info, uint64_t *value)
+{
+  size_t n, i;
+
+  if(len < 1) {
+    return 0;
+  }
+  *major = inbuf[0] >> 5;
+  *info = inbuf[0] & 0x1f;
+  if(*info < 24 || *info == CBOR_INDEFINITE) {
+    *value = *info;
+    return 1;
+  }
+  if(*info > 27) {
+    return 0;
+  }
+  n = 1 << (*info - 24);
+  if(len < n + 1) {
+    return 0;
+  }
+  *value = 0;
+  for(i = 1; i <= n; i++) {
+    *value = (*value << 8) | inbuf[i];
+  }
+  return n + 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write the start of a record up to the value label. The first record of
+ * a pack, and a single record, carry the object instance path as base
+ * name ("/3/0/"), so that the name of each record is the resource ID.
+ */
+static size_t
+write_name(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+           int pack, int label)
+{
+  char base_name[14];
+  char name[6];
+  size_t len, n;
+  int bnlen;
+  int nlen;
+
+  len = 0;
+  if(pack) {
+    /* Array with a single record */
+    n = cbor_write_head(outbuf, outlen, CBOR_ARRAY, 1);
+    if(n == 0) {
+      return 0;
+    }
+    len += n;
+  }
+  bnlen = 0;
+  if(pack || base_name_pending) {
+    bnlen = snprintf(base_name, sizeof(base_name), "/%u/%u/",
+                     ctx->object_id, ctx->object_instance_id);
+    if(bnlen <= 0 || bnlen >= sizeof(base_name)) {
+      return 0;
+    }
+  }
+  nlen = snprintf(name, sizeof(name), "%u", ctx->resource_id);
+  if(nlen <= 0 || nlen >= sizeof(name) ||
+     outlen - len < nlen + 4 + (bnlen > 0 ? bnlen + 2 : 0)) {
+    return 0;
+  }
+  outbuf[len++] = (CBOR_MAP << 5) | (bnlen > 0 ? 3 : 2);
+  if(bnlen > 0) {
+    outbuf[len++] = (CBOR_NINT << 5) | (-1 - SENML_BASE_NAME);
+    len += cbor_write_head(&outbuf[len], outlen - len, CBOR_TEXT, bnlen);
+    memcpy(&outbuf[len], base_name, bnlen);
+    len += bnlen;
+    base_name_pending = 0;
+  }
+  outbuf[len++] = (CBOR_UINT << 5) | SENML_NAME;
+  len += cbor_write_head(&outbuf[len], outlen - len, CBOR_TEXT, nlen);
+  memcpy(&outbuf[len], name, nlen);
+  len += nlen;
+  outbuf[len++] = (CBOR_UINT << 5) | label;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_int_value(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                int pack, int32_t value)
+{
+  size_t len, n;
+
+  len = write_name(ctx, outbuf, outlen, pack, SENML_VALUE);
+  if(len == 0) {
+    return 0;
+  }
+  if(value < 0) {
+    n = cbor_write_head(&outbuf[len], outlen - len, CBOR_NINT,
+                        (uint32_t)(-(value + 1)));
+  } else {
+    n = cbor_write_head(&outbuf[len], outlen - len, CBOR_UINT, value);
+  }
+  return n == 0 ? 0 : len + n;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_float32fix_value(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                       size_t outlen, int pack, int32_t value, int bits)
+{
+  uint32_t v, mantissa, rest, half;
+  size_t len;
+  int p, e;
+
+  if((value & ((1L << bits) - 1)) == 0) {
+    /* No fraction - an integer is both smaller and exact */
+    return write_int_value(ctx, outbuf, outlen, pack, value >> bits);
+  }
+
+  len = write_name(ctx, outbuf, outlen, pack, SENML_VALUE);
+  if(len == 0 || outlen - len < 5) {
+    return 0;
+  }
+
+  v = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  for(p = 31; (v & (1UL << p)) == 0; p--);
+  e = p - bits + 127;
+  if(p > 23) {
+    /* Round to nearest, ties to even */
+    mantissa = v >> (p - 23);
+    rest = v & ((1UL << (p - 23)) - 1);
+    half = 1UL << (p - 24);
+    if(rest > half || (rest == half && (mantissa & 1))) {
+      mantissa++;
+      if(mantissa == (1UL << 24)) {
+        mantissa >>= 1;
+        e++;
+      }
+    }
+  } else {
+    mantissa = v << (23 - p);
+  }
+  mantissa &= 0x7fffff;
+
+  outbuf[len++] = (CBOR_SIMPLE << 5) | CBOR_FLOAT32;
+  outbuf[len++] = (value < 0 ? 0x80 : 0) | (e >> 1);
+  outbuf[len++] = ((e & 1) << 7) | (mantissa >> 16);
+  outbuf[len++] = (mantissa >> 8) & 0xff;
+  outbuf[len++] = mantissa & 0xff;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_string_value(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                   size_t outlen, int pack, const char *value,
+                   size_t stringlen)
+{
+  size_t len, n;
+
+  len = write_name(ctx, outbuf, outlen, pack, SENML_STRING);
+  if(len == 0) {
+    return 0;
+  }
+  n = cbor_write_head(&outbuf[len], outlen - len, CBOR_TEXT, stringlen);
+  if(n == 0 || outlen - len - n < stringlen) {
+    return 0;
+  }
+  len += n;
+  memcpy(&outbuf[len], value, stringlen);
+  return len + stringlen;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_boolean_value(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                    size_t outlen, int pack, int value)
+{
+  size_t len;
+
+  len = write_name(ctx, outbuf, outlen, pack, SENML_BOOLEAN);
+  if(len == 0 || len >= outlen) {
+    return 0;
+  }
+  outbuf[len++] = (CBOR_SIMPLE << 5) | (value ? CBOR_TRUE : CBOR_FALSE);
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_int(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+          int32_t value)
+{
+  return write_int_value(ctx, outbuf, outlen, 1, value);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_string(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+             const char *value, size_t stringlen)
+{
+  return write_string_value(ctx, outbuf, outlen, 1, value, stringlen);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_float32fix(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                 int32_t value, int bits)
+{
+  return write_float32fix_value(ctx, outbuf, outlen, 1, value, bits);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_boolean(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+              int value)
+{
+  return write_boolean_value(ctx, outbuf, outlen, 1, value);
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_writer_t lwm2m_senml_cbor_writer = {
+  write_int,
+  write_string,
+  write_float32fix,
+  write_boolean
+};
+/*---------------------------------------------------------------------------*/
+static size_t
+write_record_int(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                 int32_t value)
+{
+  return write_int_value(ctx, outbuf, outlen, 0, value);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_record_string(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                    size_t outlen, const char *value, size_t stringlen)
+{
+  return write_string_value(ctx, outbuf, outlen, 0, value, stringlen);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_record_float32fix(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                        size_t outlen, int32_t value, int bits)
+{
+  return write_float32fix_value(ctx, outbuf, outlen, 0, value, bits);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_record_boolean(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                     size_t outlen, int value)
+{
+  return write_boolean_value(ctx, outbuf, outlen, 0, value);
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_writer_t lwm2m_senml_cbor_record_writer = {
+  write_record_int,
+  write_record_string,
+  write_record_float32fix,
+  write_record_boolean
+};
+/*---------------------------------------------------------------------------*/
+size_t
+lwm2m_senml_cbor_write_pack_start(uint8_t *outbuf, size_t outlen)
+{
+  if(outlen < 1) {
+    return 0;
+  }
+  /* Indefinite length array - the number of records is not known yet */
+  outbuf[0] = (CBOR_ARRAY << 5) | CBOR_INDEFINITE;
+  base_name_pending = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+size_t
+lwm2m_senml_cbor_write_pack_end(uint8_t *outbuf, size_t outlen)
+{
+  if(outlen < 1) {
+    return 0;
+  }
+  outbuf[0] = CBOR_BREAK;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Find the value with the specified label in the first record of a SenML
+ * pack. Returns the offset of the value or -1 if not found.
+ */
+static int
+find_value(const uint8_t *inbuf, size_t len, int label)
+{
+  uint8_t major, info;
+  uint64_t value;
+  size_t pos, n;
+  uint32_t count;
+  int key;
+
+  pos = 0;
+  n = cbor_read_head(inbuf, len, &major, &info, &value);
+  if(n > 0 && major == CBOR_ARRAY) {
+    pos += n;
+    n = cbor_read_head(&inbuf[pos], len - pos, &major, &info, &value);
+  }
+  if(n == 0 || major != CBOR_MAP) {
+    return -1;
+  }
+  pos += n;
+  count = info == CBOR_INDEFINITE ? UINT32_MAX : (uint32_t)value;
+
+  while(count-- > 0 && pos < len && inbuf[pos] != CBOR_BREAK) {
+    n = cbor_read_head(&inbuf[pos], len - pos, &major, &info, &value);
+    if(n == 0) {
+      return -1;
+    }
+    pos += n;
+    if(major == CBOR_UINT) {
+      key = (int)value;
+    } else if(major == CBOR_NINT) {
+      key = -1 - (int)value;
+    } else {
+      return -1;
+    }
+    if(key == label) {
+      return pos;
+    }
+
+    /* Skip the value */
+    n = cbor_read_head(&inbuf[pos], len - pos, &major, &info, &value);
+    if(n == 0) {
+      return -1;
+    }
+    pos += n;
+    if(major == CBOR_BYTES || major == CBOR_TEXT) {
+      if(info == CBOR_INDEFINITE || value > len - pos) {
+        return -1;
+      }
+      pos += value;
+    } else if(major != CBOR_UINT && major != CBOR_NINT &&
+              major != CBOR_SIMPLE) {
+      /* Nested items are never used in SenML records */
+      return -1;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Convert an IEEE 754 float with the specified number of exponent and
+ * mantissa bits to fix point. Subnormal numbers are rounded to zero.
+ */
+static int
+float_to_fix(uint64_t raw, int ebits, int mbits, int32_t *value, int bits)
+{
+  uint64_t mantissa;
+  int e, sign, shift;
+
+  e = (raw >> mbits) & ((1 << ebits) - 1);
+  sign = (raw >> (ebits + mbits)) & 1;
+  if(e == (1 << ebits) - 1) {
+    /* Infinity or NaN */
+    return 0;
+  }
+  if(e == 0) {
+    *value = 0;
+    return 1;
+  }
+  mantissa = (raw & ((1ULL << mbits) - 1)) | (1ULL << mbits);
+  shift = e - ((1 << (ebits - 1)) - 1) - mbits + bits;
+  if(shift > 0) {
+    if(shift + mbits > 30) {
+      /* Does not fit */
+      return 0;
+    }
+    mantissa <<= shift;
+  } else if(-shift > mbits) {
+    mantissa = 0;
+  } else {
+    mantissa >>= -shift;
+  }
+  *value = sign ? -(int32_t)mantissa : (int32_t)mantissa;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_number(const uint8_t *inbuf, size_t len, int32_t *value, int bits)
+{
+  uint8_t major, info;
+  uint64_t raw;
+  size_t n;
+  int pos, ok;
+
+  pos = find_value(inbuf, len, SENML_VALUE);
+  if(pos < 0) {
+    return 0;
+  }
+  n = cbor_read_head(&inbuf[pos], len - pos, &major, &info, &raw);
+  if(n == 0) {
+    return 0;
+  }
+  if((major == CBOR_UINT || major == CBOR_NINT) &&
+     raw > (uint64_t)(INT32_MAX >> bits)) {
+    /* Does not fit after the fix point shift */
+    ok = 0;
+  } else if(major == CBOR_UINT) {
+    *value = (int32_t)(raw << bits);
+    ok = 1;
+  } else if(major == CBOR_NINT) {
+    *value = (int32_t)((-1 - (int64_t)raw) * ((int64_t)1 << bits));
+    ok = 1;
+  } else if(major == CBOR_SIMPLE && info == CBOR_FLOAT16) {
+    ok = float_to_fix(raw, 5, 10, value, bits);
+  } else if(major == CBOR_SIMPLE && info == CBOR_FLOAT32) {
+    ok = float_to_fix(raw, 8, 23, value, bits);
+  } else if(major == CBOR_SIMPLE && info == CBOR_FLOAT64) {
+    ok = float_to_fix(raw, 11, 52, value, bits);
+  } else {
+    ok = 0;
+  }
+  return ok ? pos + n : 0;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_int(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+         int32_t *value)
+{
+  return read_number(inbuf, len, value, 0);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_string(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+            uint8_t *value, size_t stringlen)
+{
+  uint8_t major, info;
+  uint64_t slen;
+  size_t n;
+  int pos;
+
+  pos = find_value(inbuf, len, SENML_STRING);
+  if(pos < 0) {
+    return 0;
+  }
+  n = cbor_read_head(&inbuf[pos], len - pos, &major, &info, &slen);
+  if(n == 0 || major != CBOR_TEXT || info == CBOR_INDEFINITE ||
+     slen > len - pos - n) {
+    return 0;
+  }
+  if(stringlen <= slen) {
+    /* The outbuffer can not contain the full string including ending zero */
+    return 0;
+  }
+  memcpy(value, &inbuf[pos + n], slen);
+  value[slen] = '\0';
+  return slen;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_float32fix(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+                int32_t *value, int bits)
+{
+  return read_number(inbuf, len, value, bits);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_boolean(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+             int *value)
+{
+  int pos;
+
+  pos = find_value(inbuf, len, SENML_BOOLEAN);
+  if(pos < 0 || pos >= len) {
+    return 0;
+  }
+  if(inbuf[pos] == ((CBOR_SIMPLE << 5) | CBOR_TRUE)) {
+    *value = 1;
+  } else if(inbuf[pos] == ((CBOR_SIMPLE << 5) | CBOR_FALSE)) {
+    *value = 0;
+  } else {
+    return 0;
+  }
+  return pos + 1;
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_reader_t lwm2m_senml_cbor_reader = {
+  read_int,
+  read_string,
+  read_float32fix,
+  read_boolean
+};
+/*---------------------------------------------------------------------------*/
+/** @} */
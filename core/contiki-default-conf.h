@@ -205,6 +205,17 @@
 #define NBR_TABLE_CONF_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* With pairwise link-layer keys, size the expanded-key caches of the
+   software AES drivers for one key per neighbor plus the group key. */
+#if LLSEC802154_CONF_PAIRWISE_KEYS
+#ifndef AES_128_TTABLE_CONF_KEY_CACHE_SIZE
+#define AES_128_TTABLE_CONF_KEY_CACHE_SIZE (NBR_TABLE_CONF_MAX_NEIGHBORS + 1)
+#endif /* AES_128_TTABLE_CONF_KEY_CACHE_SIZE */
+#ifndef NATIVE_AES_128_CONF_KEY_CACHE_SIZE
+#define NATIVE_AES_128_CONF_KEY_CACHE_SIZE (NBR_TABLE_CONF_MAX_NEIGHBORS + 1)
+#endif /* NATIVE_AES_128_CONF_KEY_CACHE_SIZE */
+#endif /* LLSEC802154_CONF_PAIRWISE_KEYS */
+
 /* UIP_CONF_ND6_SEND_RA enables standard IPv6 Router Advertisement.
  * We enable it by default when IPv6 is used without RPL. */
 #ifndef UIP_CONF_ND6_SEND_RA
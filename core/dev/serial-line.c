@@ -32,7 +32,7 @@
 #include "dev/serial-line.h"
 #include <string.h> /* for memcpy() */
 
-#include "lib/ringbuf.h"
+#include "lib/ringbuf16.h"
 
 #ifdef SERIAL_LINE_CONF_BUFSIZE
 #define BUFSIZE SERIAL_LINE_CONF_BUFSIZE
@@ -40,16 +40,18 @@
 #define BUFSIZE 128
 #endif /* SERIAL_LINE_CONF_BUFSIZE */
 
-#if (BUFSIZE & (BUFSIZE - 1)) != 0
-#error SERIAL_LINE_CONF_BUFSIZE must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
+#if (BUFSIZE & (BUFSIZE - 1)) != 0 || BUFSIZE > 32768
+#error SERIAL_LINE_CONF_BUFSIZE must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...)
+#error no larger than 32768.
 #error Change SERIAL_LINE_CONF_BUFSIZE in contiki-conf.h.
 #endif
 
 #define IGNORE_CHAR(c) (c == 0x0d)
 #define END 0x0a
 
-static struct ringbuf rxbuf;
+static struct ringbuf16 rxbuf;
 static uint8_t rxbuf_data[BUFSIZE];
+static uint8_t overflow; /* Buffer overflow: ignore until END */
 
 PROCESS(serial_line_process, "Serial driver");
 
@@ -59,22 +61,20 @@ process_event_t serial_line_event_message;
 int
 serial_line_input_byte(unsigned char c)
 {
-  static uint8_t overflow = 0; /* Buffer overflow: ignore until END */
-  
   if(IGNORE_CHAR(c)) {
     return 0;
   }
 
   if(!overflow) {
     /* Add character */
-    if(ringbuf_put(&rxbuf, c) == 0) {
+    if(ringbuf16_put(&rxbuf, c) == 0) {
       /* Buffer overflow: ignore the rest of the line */
       overflow = 1;
     }
   } else {
     /* Buffer overflowed:
      * Only (try to) add terminator characters, otherwise skip */
-    if(c == END && ringbuf_put(&rxbuf, c) != 0) {
+    if(c == END && ringbuf16_put(&rxbuf, c) != 0) {
       overflow = 0;
     }
   }
@@ -84,6 +84,53 @@ serial_line_input_byte(unsigned char c)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+int
+serial_line_input_block(const uint8_t *data, int len)
+{
+  const uint8_t *end = data + len;
+  const uint8_t *run;
+  int n;
+
+  if(len <= 0) {
+    return 0;
+  }
+
+  while(data < end) {
+    if(overflow) {
+      /* Skip to the next terminator and (try to) add it */
+      data = memchr(data, END, end - data);
+      if(data == NULL) {
+        break;
+      }
+      if(ringbuf16_put(&rxbuf, END) != 0) {
+        overflow = 0;
+      }
+      data++;
+      continue;
+    }
+
+    /* Add the run of characters up to the next ignored one */
+    run = data;
+    while(data < end && !IGNORE_CHAR(*data)) {
+      data++;
+    }
+    n = ringbuf16_put_block(&rxbuf, run, data - run);
+    if(n < data - run) {
+      /* Buffer overflow: drop the character that did not fit and
+         ignore the rest of the line */
+      overflow = 1;
+      data = run + n + 1;
+    } else if(data < end) {
+      /* Skip the ignored character */
+      data++;
+    }
+  }
+
+  /* Wake up consumer process once for the whole block */
+  process_poll(&serial_line_process);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(serial_line_process, ev, data)
 {
   static char buf[BUFSIZE];
@@ -96,7 +143,7 @@ PROCESS_THREAD(serial_line_process, ev, data)
 
   while(1) {
     /* Fill application buffer until newline or empty */
-    int c = ringbuf_get(&rxbuf);
+    int c = ringbuf16_get(&rxbuf);
     
     if(c == -1) {
       /* Buffer empty, wait for poll */
@@ -131,7 +178,7 @@ PROCESS_THREAD(serial_line_process, ev, data)
 void
 serial_line_init(void)
 {
-  ringbuf_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
+  ringbuf16_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
   process_start(&serial_line_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
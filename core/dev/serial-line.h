@@ -69,6 +69,22 @@ extern process_event_t serial_line_event_message;
 
 int serial_line_input_byte(unsigned char c);
 
+/**
+ * Get a block of input from the serial driver.
+ *
+ * This function is the block equivalent of serial_line_input_byte()
+ * and is meant to be called from drivers that receive data in bulk,
+ * e.g. from a UART DMA half- or full-transfer interrupt. The data is
+ * copied into the serial line buffer in runs rather than one byte at
+ * a time, and the serial line process is polled once per block.
+ *
+ * \param data A pointer to the data that is received.
+ * \param len The number of bytes received.
+ *
+ * \return Non-zero if the CPU should be powered up, zero otherwise.
+ */
+int serial_line_input_block(const uint8_t *data, int len);
+
 void serial_line_init(void);
 
 PROCESS_NAME(serial_line_process);
@@ -59,8 +59,16 @@ uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
 #define SLIP_STATISTICS(statement) statement
 #endif
 
-/* Must be at least one byte larger than UIP_BUFSIZE! */
+/* Must be at least one byte larger than UIP_BUFSIZE! A larger buffer
+   lets block input (slip_input_block()) queue several frames. */
+#ifdef SLIP_CONF_RX_BUFSIZE
+#if SLIP_CONF_RX_BUFSIZE > 65535
+#error SLIP_CONF_RX_BUFSIZE must fit in 16 bits
+#endif
+#define RX_BUFSIZE SLIP_CONF_RX_BUFSIZE
+#else /* SLIP_CONF_RX_BUFSIZE */
 #define RX_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN + 16)
+#endif /* SLIP_CONF_RX_BUFSIZE */
 
 enum {
   STATE_TWOPACKETS = 0,	/* We have 2 packets and drop incoming data. */
@@ -157,6 +165,53 @@ rxbuf_init(void)
   state = STATE_OK;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Unescape rxbuf[from, to) into outbuf at offset len, copying the runs
+ * between escape characters with memcpy(). The escape state is carried
+ * in *esc so that a packet can be unescaped in two pieces when it wraps
+ * around the end of rxbuf. Returns the new length of outbuf, or -1 if
+ * the packet does not fit in blen bytes.
+ */
+static int
+unslip(uint8_t *outbuf, int len, uint16_t blen,
+       uint16_t from, uint16_t to, int *esc)
+{
+  const uint8_t *p = &rxbuf[from];
+  const uint8_t *end = &rxbuf[to];
+  const uint8_t *q;
+  int n;
+
+  while(p < end) {
+    if(*esc) {
+      *esc = 0;
+      if(*p == SLIP_ESC_ESC || *p == SLIP_ESC_END) {
+        if(len >= blen) {
+          return -1;
+        }
+        outbuf[len++] = *p == SLIP_ESC_ESC ? SLIP_ESC : SLIP_END;
+      }
+      p++;
+      continue;
+    }
+    q = memchr(p, SLIP_ESC, end - p);
+    if(q == NULL) {
+      q = end;
+    }
+    n = q - p;
+    if(len + n > blen) {
+      return -1;
+    }
+    memcpy(&outbuf[len], p, n);
+    len += n;
+    if(q < end) {
+      *esc = 1;
+      q++;
+    }
+    p = q;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
 /* Upper half does the polling. */
 static uint16_t
 slip_poll_handler(uint8_t *outbuf, uint16_t blen)
@@ -209,81 +264,23 @@ slip_poll_handler(uint8_t *outbuf, uint16_t blen)
    * If pkt_end != begin it will not change again.
    */
   if(begin != pkt_end) {
-    uint16_t len;
+    int len;
     uint16_t cur_next_free;
-    uint16_t cur_ptr;
+    uint8_t *p;
     int esc = 0;
 
     if(begin < pkt_end) {
-      uint16_t i;
-      len = 0;
-      for(i = begin; i < pkt_end; ++i) {
-        if(len > blen) {
-          len = 0;
-          break;
-        }
-        if (esc) {
-          if(rxbuf[i] == SLIP_ESC_ESC) {
-            outbuf[len] = SLIP_ESC;
-            len++;
-          } else if(rxbuf[i] == SLIP_ESC_END) {
-            outbuf[len] = SLIP_END;
-            len++;
-          }
-          esc = 0;
-        } else if(rxbuf[i] == SLIP_ESC) {
-          esc = 1;
-        } else {
-          outbuf[len] = rxbuf[i];
-          len++;
-        }
-      }
+      len = unslip(outbuf, 0, blen, begin, pkt_end, &esc);
     } else {
-      uint16_t i;
-      len = 0;
-      for(i = begin; i < RX_BUFSIZE; ++i) {
-        if(len > blen) {
-          len = 0;
-          break;
-        }
-        if (esc) {
-          if(rxbuf[i] == SLIP_ESC_ESC) {
-            outbuf[len] = SLIP_ESC;
-            len++;
-          } else if(rxbuf[i] == SLIP_ESC_END) {
-            outbuf[len] = SLIP_END;
-            len++;
-          }
-          esc = 0;
-        } else if(rxbuf[i] == SLIP_ESC) {
-          esc = 1;
-        } else {
-          outbuf[len] = rxbuf[i];
-          len++;
-        }
-      }
-      for(i = 0; i < pkt_end; ++i) {
-        if(len > blen) {
-          len = 0;
-          break;
-        }
-        if (esc) {
-          if(rxbuf[i] == SLIP_ESC_ESC) {
-            outbuf[len] = SLIP_ESC;
-            len++;
-          } else if(rxbuf[i] == SLIP_ESC_END) {
-            outbuf[len] = SLIP_END;
-            len++;
-          }
-          esc = 0;
-        } else if(rxbuf[i] == SLIP_ESC) {
-          esc = 1;
-        } else {
-          outbuf[len] = rxbuf[i];
-          len++;
-        }
+      len = unslip(outbuf, 0, blen, begin, RX_BUFSIZE, &esc);
+      if(len >= 0) {
+        len = unslip(outbuf, len, blen, 0, pkt_end, &esc);
       }
     }
+    if(len < 0) {
+      /* Too long for outbuf */
+      len = 0;
+    }
 
     /* Remove data from buffer together with the copied packet. */
     pkt_end = pkt_end + 1;
@@ -291,23 +288,23 @@ slip_poll_handler(uint8_t *outbuf, uint16_t blen)
       pkt_end = 0;
     }
     if(pkt_end != next_free) {
+      /* Look for the end of another buffered packet. */
       cur_next_free = next_free;
-      cur_ptr = pkt_end;
-      while(cur_ptr != cur_next_free) {
-        if(rxbuf[cur_ptr] == SLIP_END) {
-          uint16_t tmp_begin = pkt_end;
-          pkt_end = cur_ptr;
-          begin = tmp_begin;
-          /* One more packet is buffered, need to be polled again! */
-          process_poll(&slip_process);
-          break;
-        }
-        cur_ptr++;
-        if(cur_ptr == RX_BUFSIZE) {
-          cur_ptr = 0;
+      if(pkt_end < cur_next_free) {
+        p = memchr(&rxbuf[pkt_end], SLIP_END, cur_next_free - pkt_end);
+      } else {
+        p = memchr(&rxbuf[pkt_end], SLIP_END, RX_BUFSIZE - pkt_end);
+        if(p == NULL) {
+          p = memchr(rxbuf, SLIP_END, cur_next_free);
         }
       }
-      if(cur_ptr == cur_next_free) {
+      if(p != NULL) {
+        uint16_t tmp_begin = pkt_end;
+        pkt_end = p - rxbuf;
+        begin = tmp_begin;
+        /* One more packet is buffered, need to be polled again! */
+        process_poll(&slip_process);
+      } else {
         /* no more pending full packet found */
         begin = pkt_end;
       }
@@ -455,3 +452,47 @@ slip_input_byte(unsigned char c)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+slip_input_block(const uint8_t *data, int len)
+{
+  const uint8_t *end = data + len;
+  const uint8_t *p;
+  uint16_t space;
+  int n, first;
+  int poll = 0;
+
+  while(data < end) {
+    /*
+     * Plain data bytes in state STATE_OK are copied into rxbuf in runs.
+     * Everything else (SLIP_END, SLIP_ESC, the states after them and
+     * the "CLIENT" handshake) goes through slip_input_byte().
+     */
+    if(state == STATE_OK && rxbuf[begin] != 'C' &&
+       !(begin == next_free && *data == 'C')) {
+      for(p = data; p < end && *p != SLIP_END && *p != SLIP_ESC; p++);
+      n = p - data;
+
+      /* Keep one byte free so that next_free never reaches begin. */
+      space = (begin + RX_BUFSIZE - next_free - 1) % RX_BUFSIZE;
+      if(n > space) {
+        /* Let slip_input_byte() handle the overflow. */
+        n = space;
+      }
+      if(n > 0) {
+        first = RX_BUFSIZE - next_free;
+        if(first > n) {
+          first = n;
+        }
+        memcpy(&rxbuf[next_free], data, first);
+        memcpy(rxbuf, data + first, n - first);
+        next_free = (next_free + n) % RX_BUFSIZE;
+        data += n;
+        continue;
+      }
+    }
+    poll |= slip_input_byte(*data++);
+  }
+
+  return poll;
+}
+/*---------------------------------------------------------------------------*/
@@ -62,6 +62,23 @@ uint8_t slip_send(void);
  */
 int slip_input_byte(unsigned char c);
 
+/**
+ * Input a block of SLIP bytes.
+ *
+ * This function is the block equivalent of slip_input_byte(), for
+ * drivers that receive data in bulk, e.g. from a UART DMA half- or
+ * full-transfer interrupt. Runs of data between SLIP_END and SLIP_ESC
+ * characters are copied into the receive buffer with memcpy(). The
+ * function can be called from an interrupt context, but not
+ * concurrently with slip_input_byte().
+ *
+ * \param data A pointer to the data that is to be passed to the SLIP driver
+ * \param len The number of bytes
+ *
+ * \return Non-zero if the CPU should be powered up, zero otherwise.
+ */
+int slip_input_block(const uint8_t *data, int len);
+
 uint8_t slip_write(const void *ptr, int len);
 
 /* Did we receive any bytes lately? */
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         AES-128 with 32-bit table lookups (T-tables).
+ *
+ *         Each round is computed with 16 lookups into a 1 kbyte table
+ *         and 32-bit XORs, instead of byte-wise SubBytes, ShiftRows
+ *         and MixColumns. The expanded keys of the last
+ *         AES_128_TTABLE_KEY_CACHE_SIZE keys are cached, so that
+ *         switching between a few keys, as link-layer security does
+ *         for every frame, does not run the key expansion each time.
+ *
+ *         This implementation is not constant-time: the table indices
+ *         depend on the key and the data, so an attacker who can
+ *         observe cache timing may recover the key. Prefer a hardware
+ *         AES driver where such attacks are a concern.
+ *
+ *         Select it with
+ *         \code
+ *         #define AES_128_CONF aes_128_ttable_driver
+ *         \endcode
+ */
+
+#ifndef AES_128_TTABLE_H_
+#define AES_128_TTABLE_H_
+
+#include "lib/aes-128.h"
+
+#ifdef AES_128_TTABLE_CONF_KEY_CACHE_SIZE
+#define AES_128_TTABLE_KEY_CACHE_SIZE AES_128_TTABLE_CONF_KEY_CACHE_SIZE
+#else /* AES_128_TTABLE_CONF_KEY_CACHE_SIZE */
+#define AES_128_TTABLE_KEY_CACHE_SIZE 2
+#endif /* AES_128_TTABLE_CONF_KEY_CACHE_SIZE */
+
+extern const struct aes_128_driver aes_128_ttable_driver;
+
+#endif /* AES_128_TTABLE_H_ */
@@ -176,6 +176,25 @@ aes_128_set_padded_key(uint8_t *key, uint8_t key_len)
   AES_128.set_key(block);
 }
 /*---------------------------------------------------------------------------*/
+void
+aes_128_encrypt2(uint8_t *block1, uint8_t *block2)
+{
+  if(AES_128.encrypt2) {
+    AES_128.encrypt2(block1, block2);
+  } else {
+    AES_128.encrypt(block1);
+    AES_128.encrypt(block2);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+aes_128_forget_key(const uint8_t *key)
+{
+  if(AES_128.forget_key) {
+    AES_128.forget_key(key);
+  }
+}
+/*---------------------------------------------------------------------------*/
 const struct aes_128_driver aes_128_driver = {
   set_key,
   encrypt
@@ -65,6 +65,23 @@ struct aes_128_driver {
    * \brief Encrypts.
    */
   void (* encrypt)(uint8_t *plaintext_and_result);
+
+  /**
+   * \brief Encrypts two blocks with the current key.
+   *
+   *        Optional; may be NULL. Drivers that can work on two blocks
+   *        in parallel provide it, see aes_128_encrypt2().
+   */
+  void (* encrypt2)(uint8_t *block1, uint8_t *block2);
+
+  /**
+   * \brief Drops a key from the key cache of the driver.
+   *
+   *        Optional; may be NULL. Drivers that keep the expanded keys
+   *        of past keys provide it, see aes_128_forget_key(). If the
+   *        key is the current one, it must be set again before use.
+   */
+  void (* forget_key)(const uint8_t *key);
 };
 
 /**
@@ -72,6 +89,16 @@ struct aes_128_driver {
  */
 void aes_128_set_padded_key(uint8_t *key, uint8_t key_len);
 
+/**
+ * \brief Encrypts two blocks, using AES_128.encrypt2 if available
+ */
+void aes_128_encrypt2(uint8_t *block1, uint8_t *block2);
+
+/**
+ * \brief Drops a key that is no longer used from the AES_128 key cache
+ */
+void aes_128_forget_key(const uint8_t *key);
+
 extern const struct aes_128_driver AES_128;
 
 #endif /* AES_128_H_ */
@@ -51,92 +51,76 @@ static void
 set_iv(uint8_t *iv,
     uint8_t flags,
     const uint8_t *nonce,
-    uint8_t counter)
+    uint16_t counter)
 {
   iv[0] = flags;
   memcpy(iv + 1, nonce, CCM_STAR_NONCE_LENGTH);
-  iv[14] = 0;
+  iv[14] = counter >> 8;
   iv[15] = counter;
 }
 /*---------------------------------------------------------------------------*/
-/* XORs the block m[pos] ... m[pos + 15] with K_{counter} */
+/* XORs up to one block of src into dst */
 static void
-ctr_step(const uint8_t *nonce,
-    uint8_t pos,
-    uint8_t *m_and_result,
-    uint8_t m_len,
-    uint8_t counter)
+xor_block(uint8_t *dst, const uint8_t *src, uint32_t len)
 {
-  uint8_t a[AES_128_BLOCK_SIZE];
   uint8_t i;
-  
-  set_iv(a, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter);
-  AES_128.encrypt(a);
-  
-  for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-    m_and_result[pos + i] ^= a[i];
+
+  if(len > AES_128_BLOCK_SIZE) {
+    len = AES_128_BLOCK_SIZE;
+  }
+  for(i = 0; i < len; i++) {
+    dst[i] ^= src[i];
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Feeds the associated data into the CBC-MAC state x */
 static void
-mic(const uint8_t *nonce,
-    const uint8_t *m, uint8_t m_len,
-    const uint8_t *a, uint8_t a_len,
-    uint8_t *result,
-    uint8_t mic_len)
+mic_a(uint8_t *x, const uint8_t *a, uint16_t a_len)
 {
-  uint8_t x[AES_128_BLOCK_SIZE];
-  uint8_t pos;
-  uint8_t i;
-  
-  set_iv(x, CCM_STAR_AUTH_FLAGS(a_len, mic_len), nonce, m_len);
+  uint32_t pos;
+  uint8_t hdr_len;
+
+  /* length encoding of RFC 3610, section 2.2 */
+  if(a_len < 0xFF00) {
+    x[0] ^= a_len >> 8;
+    x[1] ^= a_len;
+    hdr_len = 2;
+  } else {
+    x[0] ^= 0xFF;
+    x[1] ^= 0xFE;
+    x[4] ^= a_len >> 8;
+    x[5] ^= a_len;
+    hdr_len = 6;
+  }
+  pos = AES_128_BLOCK_SIZE - hdr_len;
+  xor_block(x + hdr_len, a, a_len < pos ? a_len : pos);
   AES_128.encrypt(x);
-  
-  if(a_len) {
-    x[1] = x[1] ^ a_len;
-    for(i = 2; (i - 2 < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-      x[i] ^= a[i - 2];
-    }
-    
+
+  for(; pos < a_len; pos += AES_128_BLOCK_SIZE) {
+    xor_block(x, a + pos, a_len - pos);
     AES_128.encrypt(x);
-    
-    pos = 14;
-    while(pos < a_len) {
-      for(i = 0; (pos + i < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= a[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
   }
-  
-  if(m_len) {
-    pos = 0;
-    while(pos < m_len) {
-      for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= m[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
-  }
-  
-  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
-  
-  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
+/* Encryption without authentication, two key stream blocks at a time */
 static void
-ctr(const uint8_t *nonce, uint8_t *m, uint8_t m_len)
+ctr(const uint8_t *nonce, uint8_t *m, uint16_t m_len)
 {
-  uint8_t pos;
-  uint8_t counter;
-  
-  pos = 0;
+  uint8_t s1[AES_128_BLOCK_SIZE];
+  uint8_t s2[AES_128_BLOCK_SIZE];
+  uint32_t pos;
+  uint16_t counter;
+
   counter = 1;
-  while(pos < m_len) {
-    ctr_step(nonce, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
+  for(pos = 0; pos < m_len; pos += 2 * AES_128_BLOCK_SIZE) {
+    set_iv(s1, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+    set_iv(s2, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+    aes_128_encrypt2(s1, s2);
+    xor_block(m + pos, s1, m_len - pos);
+    if(m_len - pos > AES_128_BLOCK_SIZE) {
+      xor_block(m + pos + AES_128_BLOCK_SIZE, s2,
+          m_len - pos - AES_128_BLOCK_SIZE);
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -146,28 +130,63 @@ set_key(const uint8_t *key)
   AES_128.set_key(key);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * The CBC-MAC and the CTR key stream are computed together, so that
+ * each AES call of the MAC is paired with one of the key stream via
+ * aes_128_encrypt2(). When decrypting, the MAC runs over the
+ * plaintext, so the key stream is kept one block ahead.
+ */
 static void
 aead(const uint8_t* nonce,
-    uint8_t* m, uint8_t m_len,
-    const uint8_t* a, uint8_t a_len,
+    uint8_t* m, uint16_t m_len,
+    const uint8_t* a, uint16_t a_len,
     uint8_t *result, uint8_t mic_len,
     int forward)
 {
-  if(!forward) {
-    /* decrypt */
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t s[AES_128_BLOCK_SIZE];
+  uint8_t s0[AES_128_BLOCK_SIZE];
+  uint32_t pos;
+  uint16_t counter;
+
+  if(!mic_len) {
     ctr(nonce, m, m_len);
+    return;
+  }
+
+  set_iv(x, CCM_STAR_AUTH_FLAGS(a_len, mic_len), nonce, m_len);
+  set_iv(s0, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  aes_128_encrypt2(x, s0);
+
+  if(a_len) {
+    mic_a(x, a, a_len);
   }
-  
-  mic(nonce,
-    m, m_len,
-    a, a_len,
-    result,
-    mic_len);
-  
+
+  counter = 1;
   if(forward) {
-    /* encrypt */
-    ctr(nonce, m, m_len);
+    for(pos = 0; pos < m_len; pos += AES_128_BLOCK_SIZE) {
+      xor_block(x, m + pos, m_len - pos);
+      set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+      aes_128_encrypt2(x, s);
+      xor_block(m + pos, s, m_len - pos);
+    }
+  } else if(m_len) {
+    set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+    AES_128.encrypt(s);
+    for(pos = 0; pos < m_len; pos += AES_128_BLOCK_SIZE) {
+      xor_block(m + pos, s, m_len - pos);
+      xor_block(x, m + pos, m_len - pos);
+      if(m_len - pos > AES_128_BLOCK_SIZE) {
+        set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+        aes_128_encrypt2(x, s);
+      } else {
+        AES_128.encrypt(x);
+      }
+    }
   }
+
+  xor_block(x, s0, mic_len);
+  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
 const struct ccm_star_driver ccm_star_driver = {
@@ -65,14 +65,16 @@ struct ccm_star_driver {
    * \brief         Combines authentication and encryption.
    * \param nonce   The nonce to use. CCM_STAR_NONCE_LENGTH bytes long.
    * \param m       message to encrypt or decrypt
+   * \param m_len   Length of m in bytes
    * \param a       Additional authenticated data
+   * \param a_len   Length of a in bytes
    * \param result  The generated MIC will be put here
    * \param mic_len The size of the MIC to be generated. <= 16.
    * \param forward != 0 if used in forward direction.
    */
   void (* aead)(const uint8_t* nonce,
-      uint8_t* m, uint8_t m_len,
-      const uint8_t* a, uint8_t a_len,
+      uint8_t* m, uint16_t m_len,
+      const uint8_t* a, uint16_t a_len,
       uint8_t *result, uint8_t mic_len,
       int forward);
 };
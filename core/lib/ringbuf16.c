@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Ring buffer library with 16-bit indices
+ */
+
+#include "lib/ringbuf16.h"
+#include <sys/cc.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+void
+ringbuf16_init(struct ringbuf16 *r, uint8_t *dataptr, uint16_t size)
+{
+  r->data = dataptr;
+  r->mask = size - 1;
+  r->put_ptr = 0;
+  r->get_ptr = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_put(struct ringbuf16 *r, uint8_t c)
+{
+  /* See ringbuf_put() for a discussion of the races involved. The
+     same reasoning applies here, given that the 16-bit indices can be
+     accessed atomically (see ringbuf16.h). */
+  if(((r->put_ptr - CC_ACCESS_NOW(uint16_t, r->get_ptr)) & r->mask) ==
+     r->mask) {
+    return 0;
+  }
+  CC_ACCESS_NOW(uint8_t, r->data[r->put_ptr]) = c;
+  CC_ACCESS_NOW(uint16_t, r->put_ptr) = (r->put_ptr + 1) & r->mask;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_put_block(struct ringbuf16 *r, const uint8_t *data, int len)
+{
+  uint16_t put, space, n;
+
+  put = r->put_ptr;
+  space = r->mask - ((put - CC_ACCESS_NOW(uint16_t, r->get_ptr)) & r->mask);
+  if(len > space) {
+    len = space;
+  }
+  if(len <= 0) {
+    return 0;
+  }
+
+  /* Copy up to the end of the array, then wrap around to its start. */
+  n = r->mask + 1 - put;
+  if(n > len) {
+    n = len;
+  }
+  memcpy(&r->data[put], data, n);
+  memcpy(r->data, data + n, len - n);
+
+  /* Publish the new bytes only after they have been copied. */
+  CC_ACCESS_NOW(uint16_t, r->put_ptr) = (put + len) & r->mask;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_get(struct ringbuf16 *r)
+{
+  uint8_t c;
+
+  if(((CC_ACCESS_NOW(uint16_t, r->put_ptr) - r->get_ptr) & r->mask) > 0) {
+    c = CC_ACCESS_NOW(uint8_t, r->data[r->get_ptr]);
+    CC_ACCESS_NOW(uint16_t, r->get_ptr) = (r->get_ptr + 1) & r->mask;
+    return c;
+  } else {
+    return -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_get_block(struct ringbuf16 *r, uint8_t *buf, int len)
+{
+  uint16_t get, avail, n;
+
+  get = r->get_ptr;
+  avail = (CC_ACCESS_NOW(uint16_t, r->put_ptr) - get) & r->mask;
+  if(len > avail) {
+    len = avail;
+  }
+  if(len <= 0) {
+    return 0;
+  }
+
+  n = r->mask + 1 - get;
+  if(n > len) {
+    n = len;
+  }
+  memcpy(buf, &r->data[get], n);
+  memcpy(buf + n, r->data, len - n);
+
+  /* Release the space only after the bytes have been copied out. */
+  CC_ACCESS_NOW(uint16_t, r->get_ptr) = (get + len) & r->mask;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_size(struct ringbuf16 *r)
+{
+  return r->mask + 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_elements(struct ringbuf16 *r)
+{
+  return (r->put_ptr - r->get_ptr) & r->mask;
+}
+/*---------------------------------------------------------------------------*/
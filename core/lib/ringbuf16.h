@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Header file for the 16-bit ring buffer library
+ */
+
+/** \addtogroup lib
+ * @{ */
+
+/**
+ * \defgroup ringbuf16 Ring buffer library with 16-bit indices
+ * @{
+ *
+ * A variant of the \ref ringbuf "ring buffer library" for buffers
+ * larger than 128 bytes. Sizes up to 32768 bytes are supported and
+ * data can be moved in and out of the buffer in blocks, which makes
+ * it suitable for being fed from UART DMA transfer-complete
+ * interrupts.
+ *
+ * As with the ringbuf library, one producer and one consumer may
+ * use the buffer concurrently, e.g. an interrupt handler and a
+ * process. This requires the indices to be read and written
+ * atomically. The indices are always kept smaller than the size of
+ * the buffer, so on 8-bit CPUs this holds for buffers of at most
+ * 256 bytes; on 16- and 32-bit CPUs it holds for all sizes.
+ *
+ */
+
+#ifndef RINGBUF16_H_
+#define RINGBUF16_H_
+
+#include "contiki-conf.h"
+
+/**
+ * \brief      Structure that holds the state of a ring buffer.
+ *
+ *             This structure holds the state of a ring buffer. The
+ *             actual buffer needs to be defined separately. This
+ *             struct is an opaque structure with no user-visible
+ *             elements.
+ *
+ */
+struct ringbuf16 {
+  uint8_t *data;
+  uint16_t mask;
+  uint16_t put_ptr, get_ptr;
+};
+
+/**
+ * \brief      Initialize a ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \param a    A pointer to an array to hold the data in the buffer
+ * \param size_power_of_two The size of the ring buffer, which must be a power of two
+ *
+ *             This function initiates a ring buffer. The data in the
+ *             buffer is stored in an external array, to which a
+ *             pointer must be supplied. The size of the ring buffer
+ *             must be a power of two and cannot be larger than 32768
+ *             bytes. One byte of the array is always left unused, so
+ *             the buffer holds at most size_power_of_two - 1 bytes.
+ *
+ */
+void    ringbuf16_init(struct ringbuf16 *r, uint8_t *a,
+                       uint16_t size_power_of_two);
+
+/**
+ * \brief      Insert a byte into the ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \param c    The byte to be written to the buffer
+ * \return     Non-zero if there data could be written, or zero if the buffer was full.
+ *
+ *             This function inserts a byte into the ring buffer. It
+ *             is safe to call this function from an interrupt
+ *             handler.
+ *
+ */
+int     ringbuf16_put(struct ringbuf16 *r, uint8_t c);
+
+/**
+ * \brief      Insert a block of bytes into the ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \param data A pointer to the bytes to be written to the buffer
+ * \param len  The number of bytes to write
+ * \return     The number of bytes that were written, which is less than len if the buffer filled up.
+ *
+ *             This function copies as much as fits of a block of
+ *             bytes into the ring buffer, using at most two memcpy()
+ *             calls. It is safe to call this function from an
+ *             interrupt handler.
+ *
+ */
+int     ringbuf16_put_block(struct ringbuf16 *r, const uint8_t *data,
+                            int len);
+
+/**
+ * \brief      Get a byte from the ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \return     The data from the buffer, or -1 if the buffer was empty
+ *
+ *             This function removes a byte from the ring buffer. It
+ *             is safe to call this function from an interrupt
+ *             handler.
+ *
+ */
+int     ringbuf16_get(struct ringbuf16 *r);
+
+/**
+ * \brief      Get a block of bytes from the ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \param buf  A pointer to where the bytes are to be copied
+ * \param len  The maximum number of bytes to read
+ * \return     The number of bytes that were read.
+ *
+ *             This function removes up to len bytes from the ring
+ *             buffer. It is safe to call this function from an
+ *             interrupt handler.
+ *
+ */
+int     ringbuf16_get_block(struct ringbuf16 *r, uint8_t *buf, int len);
+
+/**
+ * \brief      Get the size of a ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \return     The size of the buffer.
+ */
+int     ringbuf16_size(struct ringbuf16 *r);
+
+/**
+ * \brief      Get the number of elements currently in the ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \return     The number of elements in the buffer.
+ */
+int     ringbuf16_elements(struct ringbuf16 *r);
+
+#endif /* RINGBUF16_H_ */
+
+/** @}*/
+/** @}*/
@@ -161,6 +161,22 @@ int strncasecmp(const char *s1, const char *s2, size_t n);
 #define RESOLV_SUPPORTS_RECORD_EXPIRATION 1
 #endif
 
+/* The time to cache a failed lookup for, and a name that does not exist
+ * when the server gave no SOA record to take the time from. */
+#ifndef RESOLV_CONF_NEGATIVE_TTL
+#define RESOLV_CONF_NEGATIVE_TTL 30
+#endif
+
+/* The longest time to cache a name that does not exist */
+#ifndef RESOLV_CONF_MAX_NEGATIVE_TTL
+#define RESOLV_CONF_MAX_NEGATIVE_TTL 300
+#endif
+
+/* The longest time to cache an address, whatever its TTL */
+#ifndef RESOLV_CONF_MAX_TTL
+#define RESOLV_CONF_MAX_TTL 86400UL
+#endif
+
 #if RESOLV_CONF_SUPPORTS_MDNS && !RESOLV_VERIFY_ANSWER_NAMES
 #error RESOLV_CONF_SUPPORTS_MDNS cannot be set without RESOLV_CONF_VERIFY_ANSWER_NAMES
 #endif
@@ -181,6 +197,7 @@ int strncasecmp(const char *s1, const char *s2, size_t n);
 
 #define DNS_TYPE_A      1
 #define DNS_TYPE_CNAME  5
+#define DNS_TYPE_SOA    6
 #define DNS_TYPE_PTR   12
 #define DNS_TYPE_MX    15
 #define DNS_TYPE_TXT   16
@@ -256,7 +273,11 @@ struct namemap {
   uint8_t tmr;
   uint16_t id;
   uint8_t retries;
-  uint8_t seqno;
+  /* Index + 1 of the next entry in the hash bucket, 0 for none */
+  uint8_t hash_next;
+  uint16_t hash;
+  /* Value of lru_clock when the entry was last used */
+  uint16_t lru;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
   unsigned long expiration;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
@@ -275,9 +296,23 @@ struct namemap {
 #define RESOLV_ENTRIES UIP_CONF_RESOLV_ENTRIES
 #endif /* UIP_CONF_RESOLV_ENTRIES */
 
+/* The number of hash buckets for looking up names */
+#ifdef RESOLV_CONF_HASH_SIZE
+#define RESOLV_HASH_SIZE RESOLV_CONF_HASH_SIZE
+#else
+#define RESOLV_HASH_SIZE RESOLV_ENTRIES
+#endif
+
+#if RESOLV_ENTRIES > 254
+#error UIP_CONF_RESOLV_ENTRIES must be at most 254
+#endif
+
 static struct namemap names[RESOLV_ENTRIES];
 
-static uint8_t seqno;
+/* Index + 1 of the first entry in each hash bucket, 0 for none */
+static uint8_t name_table[RESOLV_HASH_SIZE];
+
+static uint16_t lru_clock;
 
 static struct uip_udp_conn *resolv_conn = NULL;
 
@@ -646,6 +681,185 @@ try_next_server(struct namemap *namemapptr)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/** \internal
+ * Hashes a name, ignoring the case of letters.
+ */
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash = 0;
+
+  while(*name) {
+    /* Folds the case of letters, and of nothing that may be in a name */
+    hash = hash * 31 + (*name++ | 0x20);
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Finds the entry for a name, or returns NULL.
+ */
+static struct namemap *
+namemap_lookup(const char *name)
+{
+  uint16_t hash;
+  uint8_t i;
+
+  hash = name_hash(name);
+  for(i = name_table[hash % RESOLV_HASH_SIZE]; i != 0;
+      i = names[i - 1].hash_next) {
+    if(names[i - 1].hash == hash && strcasecmp(names[i - 1].name, name) == 0) {
+      return &names[i - 1];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Gives an entry a name and adds it to the hash table.
+ */
+static void
+namemap_link(struct namemap *namemapptr, const char *name)
+{
+  uint8_t *head;
+
+  strncpy(namemapptr->name, name, sizeof(namemapptr->name) - 1);
+  namemapptr->name[sizeof(namemapptr->name) - 1] = 0;
+  namemapptr->hash = name_hash(namemapptr->name);
+  head = &name_table[namemapptr->hash % RESOLV_HASH_SIZE];
+  namemapptr->hash_next = *head;
+  *head = namemapptr - names + 1;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Removes an entry from the hash table, if it is there.
+ */
+static void
+namemap_unlink(struct namemap *namemapptr)
+{
+  uint8_t *link;
+  uint8_t i;
+
+  i = namemapptr - names + 1;
+  for(link = &name_table[namemapptr->hash % RESOLV_HASH_SIZE]; *link != 0;
+      link = &names[*link - 1].hash_next) {
+    if(*link == i) {
+      *link = namemapptr->hash_next;
+      namemapptr->hash_next = 0;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+namemap_touch(struct namemap *namemapptr)
+{
+  namemapptr->lru = lru_clock++;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Returns an entry that is not in use or has expired, or NULL.
+ */
+static struct namemap *
+namemap_free(void)
+{
+  uint8_t i;
+
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    if((names[i].state == STATE_UNUSED)
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+       || ((names[i].state == STATE_DONE || names[i].state == STATE_ERROR) &&
+           clock_seconds() > names[i].expiration)
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+      ) {
+      return &names[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Returns the entry to use for a new name: a free one if there is any,
+ * otherwise the least recently used one, preferring the entries that
+ * are not being resolved.
+ */
+static struct namemap *
+namemap_alloc(void)
+{
+  struct namemap *namemapptr, *lru, *lru_resolving;
+  uint8_t i;
+
+  namemapptr = namemap_free();
+  if(namemapptr != NULL) {
+    return namemapptr;
+  }
+
+  lru = lru_resolving = NULL;
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    namemapptr = &names[i];
+    if(namemapptr->state == STATE_NEW || namemapptr->state == STATE_ASKING) {
+      if(lru_resolving == NULL ||
+         (uint16_t)(lru_clock - namemapptr->lru) >
+         (uint16_t)(lru_clock - lru_resolving->lru)) {
+        lru_resolving = namemapptr;
+      }
+    } else if(lru == NULL ||
+              (uint16_t)(lru_clock - namemapptr->lru) >
+              (uint16_t)(lru_clock - lru->lru)) {
+      lru = namemapptr;
+    }
+  }
+  return lru != NULL ? lru : lru_resolving;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Reads a 32-bit value in network byte order.
+ */
+static uint32_t
+get32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Returns the time to cache the non-existence of a name for, taken from
+ * the SOA record in the authority section (RFC 2308). The answers and
+ * authority records start at queryptr.
+ */
+static uint32_t
+negative_ttl(unsigned char *queryptr, uint8_t nanswers, uint8_t nauthrr)
+{
+  const unsigned char *end = (unsigned char *)uip_appdata + uip_datalen();
+  unsigned char *rr;
+  uint32_t ttl, minimum;
+
+  for(nauthrr += nanswers; nauthrr > 0; --nauthrr) {
+    rr = skip_name(queryptr);
+    if(rr + 10 > end) {
+      break;
+    }
+    queryptr = rr + 10 + ((rr[8] << 8) | rr[9]);
+    if(nanswers > 0) {
+      --nanswers;
+    } else if(((rr[0] << 8) | rr[1]) == DNS_TYPE_SOA) {
+      ttl = get32(rr + 4);
+      /* Skip MNAME and RNAME to the SERIAL, ..., MINIMUM fields */
+      rr = skip_name(skip_name(rr + 10));
+      if(rr + 20 > end) {
+        break;
+      }
+      minimum = get32(rr + 16);
+      if(minimum < ttl) {
+        ttl = minimum;
+      }
+      return ttl < RESOLV_CONF_MAX_NEGATIVE_TTL ?
+        ttl : RESOLV_CONF_MAX_NEGATIVE_TTL;
+    }
+  }
+  return RESOLV_CONF_NEGATIVE_TTL;
+}
+/*---------------------------------------------------------------------------*/
 /** \internal
  * Runs through the list of names to see if there are any that have
  * not yet been queried and, if so, sends out a query.
@@ -682,8 +896,8 @@ check_entries(void)
               namemapptr->state = STATE_ERROR;
 
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-              /* Keep the "not found" error valid for 30 seconds */
-              namemapptr->expiration = clock_seconds() + 30;
+              /* Keep the "not found" error valid for a while */
+              namemapptr->expiration = clock_seconds() + RESOLV_CONF_NEGATIVE_TTL;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
               resolv_found(namemapptr->name, NULL);
@@ -898,11 +1112,6 @@ newdata(void)
 
 /** ANSWER HANDLING SECTION **************************************************/
 
-  if(nanswers == 0) {
-    /* Skip responses with no answers. */
-    return;
-  }
-
 #if RESOLV_CONF_SUPPORTS_MDNS
   if(UIP_UDP_BUF->srcport == UIP_HTONS(MDNS_PORT) &&
      hdr->id == 0) {
@@ -910,6 +1119,11 @@ newdata(void)
      * because we can't use the `id` field. We will look up the
      * appropriate request in a later step. */
 
+    if(nanswers == 0) {
+      /* Skip responses with no answers. */
+      return;
+    }
+
     i = -1;
     namemapptr = NULL;
   } else
@@ -936,13 +1150,20 @@ newdata(void)
     namemapptr->err = hdr->flags2 & DNS_FLAG2_ERR_MASK;
 
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-    /* If we remain in the error state, keep it cached for 30 seconds. */
-    namemapptr->expiration = clock_seconds() + 30;
+    /* If we remain in the error state, keep it cached for a while. */
+    namemapptr->expiration = clock_seconds() + RESOLV_CONF_NEGATIVE_TTL;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
     /* Check for error. If so, call callback to inform. */
     if(namemapptr->err != 0) {
       namemapptr->state = STATE_ERROR;
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+      if(namemapptr->err == DNS_FLAG2_ERR_NAME) {
+        /* The name does not exist: cache that as long as the server says */
+        namemapptr->expiration = clock_seconds() +
+          negative_ttl(queryptr, nanswers, uip_ntohs(hdr->numauthrr));
+      }
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
       resolv_found(namemapptr->name, NULL);
       return;
     }
@@ -987,48 +1208,37 @@ newdata(void)
 #if RESOLV_CONF_SUPPORTS_MDNS
     if(UIP_UDP_BUF->srcport == UIP_HTONS(MDNS_PORT) &&
        hdr->id == 0) {
-      int8_t available_i = RESOLV_ENTRIES;
+      static char name[RESOLV_CONF_MAX_DOMAIN_NAME_SIZE + 1];
 
       DEBUG_PRINTF("resolver: MDNS query.\n");
 
       /* For MDNS, we need to actually look up the name we
        * are looking for.
        */
-      for(i = 0; i < RESOLV_ENTRIES; ++i) {
-        namemapptr = &names[i];
-        if(dns_name_isequal(queryptr, namemapptr->name, uip_appdata)) {
-          break;
-        }
-        if((namemapptr->state == STATE_UNUSED)
-#if RESOLV_SUPPORTS_RECORD_EXPIRATION
-          || (namemapptr->state == STATE_DONE && clock_seconds() > namemapptr->expiration)
-#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
-        ) {
-          available_i = i;
-        }
+      if(!decode_name(queryptr, name, uip_appdata)) {
+        DEBUG_PRINTF("resolver: MDNS name too big to cache.\n");
+        namemapptr = NULL;
+        goto skip_to_next_answer;
       }
-      if(i == RESOLV_ENTRIES) {
+      namemapptr = namemap_lookup(name);
+      if(namemapptr == NULL) {
         DEBUG_PRINTF("resolver: Unsolicited MDNS response.\n");
-        i = available_i;
-        namemapptr = &names[i];
-        if(!decode_name(queryptr, namemapptr->name, uip_appdata)) {
-          DEBUG_PRINTF("resolver: MDNS name too big to cache.\n");
-          namemapptr = NULL;
+        namemapptr = namemap_free();
+        if(namemapptr == NULL) {
+          DEBUG_PRINTF
+            ("resolver: Not enough room to keep track of unsolicited MDNS answer.\n");
+
+          if(strcasecmp(name, resolv_hostname) == 0) {
+            /* Oh snap, they say they are us! We had better report them... */
+            resolv_found(resolv_hostname, (uip_ipaddr_t *) ans->ipaddr);
+          }
           goto skip_to_next_answer;
         }
+        namemap_unlink(namemapptr);
+        memset(namemapptr, 0, sizeof(*namemapptr));
+        namemap_link(namemapptr, name);
+        namemap_touch(namemapptr);
       }
-      if(i == RESOLV_ENTRIES) {
-        DEBUG_PRINTF
-          ("resolver: Not enough room to keep track of unsolicited MDNS answer.\n");
-
-        if(dns_name_isequal(queryptr, resolv_hostname, uip_appdata)) {
-          /* Oh snap, they say they are us! We had better report them... */
-          resolv_found(resolv_hostname, (uip_ipaddr_t *) ans->ipaddr);
-        }
-        namemapptr = NULL;
-        goto skip_to_next_answer;
-      }
-      namemapptr = &names[i];
 
     } else
 #endif /* RESOLV_CONF_SUPPORTS_MDNS */
@@ -1050,8 +1260,18 @@ newdata(void)
 
     namemapptr->state = STATE_DONE;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-    namemapptr->expiration = ans->ttl[1] + (ans->ttl[0] << 8);
-    namemapptr->expiration += clock_seconds();
+    {
+      uint32_t ttl = ((uint32_t)uip_ntohs(ans->ttl[0]) << 16) |
+                     uip_ntohs(ans->ttl[1]);
+
+      /* TTLs with the top bit set are taken as 0, see RFC 2181 */
+      if(ttl & 0x80000000UL) {
+        ttl = 0;
+      } else if(ttl > RESOLV_CONF_MAX_TTL) {
+        ttl = RESOLV_CONF_MAX_TTL;
+      }
+      namemapptr->expiration = clock_seconds() + ttl;
+    }
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
     uip_ipaddr_copy(&namemapptr->ipaddr, (uip_ipaddr_t *) ans->ipaddr);
@@ -1076,6 +1296,13 @@ newdata(void)
     if(try_next_server(namemapptr)) {
       namemapptr->state = STATE_ASKING;
       process_post(&resolv_process, PROCESS_EVENT_TIMER, NULL);
+    } else {
+      /* No server has an address for the name. */
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+      namemapptr->expiration = clock_seconds() +
+        negative_ttl(queryptr, 0, uip_ntohs(hdr->numauthrr));
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+      resolv_found(namemapptr->name, NULL);
     }
   }
 
@@ -1162,6 +1389,7 @@ PROCESS_THREAD(resolv_process, ev, data)
   PROCESS_BEGIN();
 
   memset(names, 0, sizeof(names));
+  memset(name_table, 0, sizeof(name_table));
 
   resolv_event_found = process_alloc_event();
 
@@ -1269,50 +1497,39 @@ remove_trailing_dots(const char *name) {
 void
 resolv_query(const char *name)
 {
-  uint8_t i;
-
-  uint8_t lseq, lseqi;
-
-  register struct namemap *nameptr = 0;
+  register struct namemap *nameptr;
 
   init();
-  
-  lseq = lseqi = 0;
 
   /* Remove trailing dots, if present. */
   name = remove_trailing_dots(name);
 
-  for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    nameptr = &names[i];
-    if(0 == strcasecmp(nameptr->name, name)) {
-      break;
-    }
-    if((nameptr->state == STATE_UNUSED)
-#if RESOLV_SUPPORTS_RECORD_EXPIRATION
-      || (nameptr->state == STATE_DONE && clock_seconds() > nameptr->expiration)
-#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+  nameptr = namemap_lookup(name);
+  if(nameptr != NULL &&
+     (nameptr->state == STATE_NEW || nameptr->state == STATE_ASKING)
+#if RESOLV_CONF_SUPPORTS_MDNS
+     && (nameptr->is_probe != 0) == ((mdns_state == MDNS_STATE_PROBING) &&
+                                     (0 == strcmp(name, resolv_hostname)))
+#endif /* RESOLV_CONF_SUPPORTS_MDNS */
     ) {
-      lseqi = i;
-      lseq = 255;
-    } else if(seqno - nameptr->seqno > lseq) {
-      lseq = seqno - nameptr->seqno;
-      lseqi = i;
-    }
+    /* The answer to the query that is already out will do. */
+    PRINTF("resolver: Already querying \"%s\".\n", name);
+    namemap_touch(nameptr);
+    return;
   }
 
-  if(i == RESOLV_ENTRIES) {
-    i = lseqi;
-    nameptr = &names[i];
+  if(nameptr == NULL) {
+    nameptr = namemap_alloc();
   }
 
   PRINTF("resolver: Starting query for \"%s\".\n", name);
 
+  namemap_unlink(nameptr);
   memset(nameptr, 0, sizeof(*nameptr));
 
-  strncpy(nameptr->name, name, sizeof(nameptr->name));
+  namemap_link(nameptr, name);
   nameptr->state = STATE_NEW;
-  nameptr->seqno = seqno;
-  ++seqno;
+  namemap_touch(nameptr);
 
 #if RESOLV_CONF_SUPPORTS_MDNS
   {
@@ -1350,8 +1567,6 @@ resolv_lookup(const char *name, uip_ipaddr_t ** ipaddr)
 {
   resolv_status_t ret = RESOLV_STATUS_UNCACHED;
 
-  uint8_t i;
-
   struct namemap *nameptr;
 
   /* Remove trailing dots, if present. */
@@ -1373,42 +1588,37 @@ resolv_lookup(const char *name, uip_ipaddr_t ** ipaddr)
   }
 #endif /* UIP_CONF_LOOPBACK_INTERFACE */
 
-  /* Walk through the list to see if the name is in there. */
-  for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    nameptr = &names[i];
-
-    if(strcasecmp(name, nameptr->name) == 0) {
-      switch (nameptr->state) {
-      case STATE_DONE:
-        ret = RESOLV_STATUS_CACHED;
+  /* See if the name is in the cache. */
+  nameptr = namemap_lookup(name);
+  if(nameptr != NULL) {
+    namemap_touch(nameptr);
+    switch (nameptr->state) {
+    case STATE_DONE:
+      ret = RESOLV_STATUS_CACHED;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-        if(clock_seconds() > nameptr->expiration) {
-          ret = RESOLV_STATUS_EXPIRED;
-        }
+      if(clock_seconds() > nameptr->expiration) {
+        ret = RESOLV_STATUS_EXPIRED;
+      }
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
-        break;
-      case STATE_NEW:
-      case STATE_ASKING:
-        ret = RESOLV_STATUS_RESOLVING;
-        break;
-      /* Almost certainly a not-found error from server */
-      case STATE_ERROR:
-        ret = RESOLV_STATUS_NOT_FOUND;
+      break;
+    case STATE_NEW:
+    case STATE_ASKING:
+      ret = RESOLV_STATUS_RESOLVING;
+      break;
+    /* Almost certainly a not-found error from server */
+    case STATE_ERROR:
+      ret = RESOLV_STATUS_NOT_FOUND;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-        if(clock_seconds() > nameptr->expiration) {
-          ret = RESOLV_STATUS_UNCACHED;
-        }
-#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
-        break;
+      if(clock_seconds() > nameptr->expiration) {
+        ret = RESOLV_STATUS_UNCACHED;
       }
-
-      if(ipaddr) {
-        *ipaddr = &nameptr->ipaddr;
-      }
-
-      /* Break out of for loop. */
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
       break;
     }
+
+    if(ipaddr) {
+      *ipaddr = &nameptr->ipaddr;
+    }
   }
 
 #if VERBOSE_DEBUG
@@ -58,6 +58,10 @@ call_event(struct tcp_socket *s, tcp_socket_event_t event)
 static void
 senddata(struct tcp_socket *s)
 {
+#if UIP_TCP_SEND_WINDOW > 1
+  /* uIP sends and retransmits the data in the output buffer, which is
+     the send buffer of the connection. */
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   int len = MIN(s->output_data_max_seg, uip_mss());
 
   if(s->output_senddata_len > 0) {
@@ -65,11 +69,17 @@ senddata(struct tcp_socket *s)
     s->output_data_send_nxt = len;
     uip_send(s->output_data_ptr, len);
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 static void
 acked(struct tcp_socket *s)
 {
+#if UIP_TCP_SEND_WINDOW > 1
+  /* uIP has already removed the acknowledged data from the buffer. */
+  s->output_data_len = s->sndbuf.len;
+  call_event(s, TCP_SOCKET_DATA_SENT);
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   if(s->output_senddata_len > 0) {
     /* Copy the data in the outputbuf down and update outputbufptr and
        outputbuf_lastsent */
@@ -95,6 +105,7 @@ acked(struct tcp_socket *s)
 
     call_event(s, TCP_SOCKET_DATA_SENT);
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -163,6 +174,7 @@ appcall(void *state)
 	  s->flags &= ~TCP_SOCKET_FLAGS_LISTENING;
           s->output_data_max_seg = uip_mss();
 	  tcp_markconn(uip_conn, s);
+	  s->c = uip_conn;
 	  call_event(s, TCP_SOCKET_CONNECTED);
 	  break;
 	}
@@ -175,6 +187,9 @@ appcall(void *state)
     if(s == NULL) {
       uip_abort();
     } else {
+#if UIP_TCP_SEND_WINDOW > 1
+      uip_tcp_sndbuf_attach(uip_conn, &s->sndbuf);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       if(uip_newdata()) {
         newdata(s);
       }
@@ -276,6 +291,9 @@ tcp_socket_register(struct tcp_socket *s, void *ptr,
   s->output_data_len = 0;
   s->output_data_ptr = output_databuf;
   s->output_data_maxlen = output_databuf_len;
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_tcp_sndbuf_init(&s->sndbuf, output_databuf, output_databuf_len);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   s->input_callback = input_callback;
   s->event_callback = event_callback;
   list_add(socketlist, s);
@@ -349,12 +367,22 @@ tcp_socket_send(struct tcp_socket *s,
 
   len = MIN(datalen, s->output_data_maxlen - s->output_data_len);
 
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_tcp_sndbuf_write(&s->sndbuf, data, len);
+  s->output_data_len = s->sndbuf.len;
+
+  /* Have uIP send the data right away if the connection is up. */
+  if(s->c != NULL && s->c->sndbuf == &s->sndbuf) {
+    tcpip_poll_tcp(s->c);
+  }
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   memcpy(&s->output_data_ptr[s->output_data_len], data, len);
   s->output_data_len += len;
 
   if(s->output_senddata_len == 0) {
     s->output_senddata_len = s->output_data_len;
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   return len;
 }
@@ -387,6 +415,9 @@ tcp_socket_unregister(struct tcp_socket *s)
   tcp_socket_unlisten(s);
   if(s->c != NULL) {
     tcp_attach(s->c, NULL);
+#if UIP_TCP_SEND_WINDOW > 1
+    uip_tcp_sndbuf_attach(s->c, NULL);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   }
   list_remove(socketlist, s);
   return 1;
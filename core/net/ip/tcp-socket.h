@@ -99,6 +99,9 @@ struct tcp_socket {
   uint16_t output_data_send_nxt;
   uint16_t output_senddata_len;
   uint16_t output_data_max_seg;
+#if UIP_TCP_SEND_WINDOW > 1
+  struct uip_tcp_sndbuf sndbuf;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   uint8_t flags;
   uint16_t listen_port;
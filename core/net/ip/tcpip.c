@@ -170,6 +170,22 @@ start_periodic_tcp_timer(void)
 }
 #endif /* UIP_TCP || UIP_CONF_IP_FORWARD */
 /*---------------------------------------------------------------------------*/
+#if NETSTACK_CONF_WITH_IPV6 && UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+static void
+send_window(struct uip_conn *conn)
+{
+  /* uIP produces one packet at a time, so the rest of a connection's
+     send window is sent after the packet that opened it. */
+  while(conn != NULL && uip_tcp_sndbuf_window(conn) > 0) {
+    uip_tcp_send_segment(conn);
+    if(uip_len == 0) {
+      break;
+    }
+    tcpip_ipv6_output();
+  }
+}
+#endif /* NETSTACK_CONF_WITH_IPV6 && UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 static void
 check_for_tcp_syn(void)
 {
@@ -215,6 +231,9 @@ packet_input(void)
 #endif /* NETSTACK_CONF_WITH_IPV6 */
 #endif /* UIP_CONF_TCP_SPLIT */
     }
+#if NETSTACK_CONF_WITH_IPV6 && UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+    send_window(uip_conn);
+#endif /* NETSTACK_CONF_WITH_IPV6 && UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -406,7 +425,7 @@ eventhandler(process_event_t ev, process_data_t data)
       for(cptr = &uip_udp_conns[0];
           cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
         if(cptr->appstate.p == p) {
-          cptr->lport = 0;
+          uip_udp_remove(cptr);
         }
       }
     }
@@ -429,6 +448,9 @@ eventhandler(process_event_t ev, process_data_t data)
           uip_periodic(i);
 #if NETSTACK_CONF_WITH_IPV6
           tcpip_ipv6_output();
+#if UIP_TCP_SEND_WINDOW > 1
+          send_window(&uip_conns[i]);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 #else
           if(uip_len > 0) {
             PRINTF("tcpip_output from periodic len %d\n", uip_len);
@@ -486,6 +508,9 @@ eventhandler(process_event_t ev, process_data_t data)
       uip_poll_conn(data);
 #if NETSTACK_CONF_WITH_IPV6
       tcpip_ipv6_output();
+#if UIP_TCP_SEND_WINDOW > 1
+      send_window(data);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 #else /* NETSTACK_CONF_WITH_IPV6 */
       if(uip_len > 0) {
         PRINTF("tcpip_output from tcp poll len %d\n", uip_len);
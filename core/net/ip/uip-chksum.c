@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ *         Internet checksum computation and incremental update.
+ */
+
+#include "net/ip/uip.h"
+#include "net/ip/uip-chksum.h"
+
+#include <stdint.h>
+
+/*
+ * On CPUs with 32-bit (or wider) pointers, the checksum is summed 32
+ * bits at a time into a 64-bit accumulator. Smaller CPUs sum 16-bit
+ * words into a 32-bit accumulator. In both cases the carries are
+ * collected in the upper half of the accumulator and folded back in
+ * once at the end, instead of after every word.
+ */
+#ifdef UIP_CONF_CHKSUM_WIDE
+#define CHKSUM_WIDE UIP_CONF_CHKSUM_WIDE
+#else /* UIP_CONF_CHKSUM_WIDE */
+#define CHKSUM_WIDE (UINTPTR_MAX > 0xffffUL)
+#endif /* UIP_CONF_CHKSUM_WIDE */
+
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum_add16(uint16_t a, uint16_t b)
+{
+  a += b;
+  if(a < b) {
+    a++;      /* carry */
+  }
+  return a;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum_update(uint16_t chksum, uint16_t oldsum, uint16_t newsum)
+{
+  uint16_t sum;
+
+  sum = uip_chksum_add16((uint16_t)~uip_ntohs(chksum), (uint16_t)~oldsum);
+  sum = uip_chksum_add16(sum, newsum);
+  return uip_htons((uint16_t)~sum);
+}
+/*---------------------------------------------------------------------------*/
+#if ! UIP_ARCH_CHKSUM_ADD
+#if CHKSUM_WIDE
+typedef uint64_t chksum_acc_t;
+typedef uint32_t chksum_word_t;
+#else /* CHKSUM_WIDE */
+typedef uint32_t chksum_acc_t;
+typedef uint16_t chksum_word_t;
+#endif /* CHKSUM_WIDE */
+
+/*
+ * Sum the data as 16-bit words in host byte order. The data must
+ * start on an even address. The result is in host byte order as
+ * well, i.e., byte swapped with respect to the checksum on little
+ * endian CPUs.
+ */
+static uint16_t
+sum_aligned(const uint8_t *data, uint16_t len)
+{
+  chksum_acc_t acc;
+  const chksum_word_t *w;
+  uint16_t t;
+
+  acc = 0;
+
+#if CHKSUM_WIDE
+  if(((uintptr_t)data & 2) && len >= 2) {
+    acc += *(const uint16_t *)data;
+    data += 2;
+    len -= 2;
+  }
+#endif /* CHKSUM_WIDE */
+
+  w = (const chksum_word_t *)data;
+  while(len >= 8 * sizeof(chksum_word_t)) {
+    acc += w[0];
+    acc += w[1];
+    acc += w[2];
+    acc += w[3];
+    acc += w[4];
+    acc += w[5];
+    acc += w[6];
+    acc += w[7];
+    w += 8;
+    len -= 8 * sizeof(chksum_word_t);
+  }
+  while(len >= sizeof(chksum_word_t)) {
+    acc += *w++;
+    len -= sizeof(chksum_word_t);
+  }
+  data = (const uint8_t *)w;
+
+#if CHKSUM_WIDE
+  if(len >= 2) {
+    acc += *(const uint16_t *)data;
+    data += 2;
+    len -= 2;
+  }
+#endif /* CHKSUM_WIDE */
+
+  if(len == 1) {
+    /* Pad the last byte with a zero byte. */
+    t = 0;
+    *(uint8_t *)&t = *data;
+    acc += t;
+  }
+
+  while(acc >> 16) {
+    acc = (acc & 0xffff) + (acc >> 16);
+  }
+  return (uint16_t)acc;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+
+  if(len == 0) {
+    return sum;
+  }
+
+  if((uintptr_t)data & 1) {
+    /* Sum from the next even address. Each word then has its bytes
+       swapped, so we swap the result back and add the first byte
+       as the high byte of a word (RFC 1071, section 2(B)). */
+    t = uip_ntohs(sum_aligned(data + 1, len - 1));
+    t = (uint16_t)((t << 8) | (t >> 8));
+    t = uip_chksum_add16(t, (uint16_t)(data[0] << 8));
+  } else {
+    t = uip_ntohs(sum_aligned(data, len));
+  }
+
+  /* Return sum in host byte order. */
+  return uip_chksum_add16(sum, t);
+}
+#endif /* UIP_ARCH_CHKSUM_ADD */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ *         Internet checksum (RFC 1071) computation and incremental
+ *         checksum update (RFC 1624).
+ *
+ *         The one's complement sum is computed a machine word at a
+ *         time. A CPU can provide its own uip_chksum_add() by
+ *         defining UIP_ARCH_CHKSUM_ADD to 1, in which case the
+ *         generic version in uip-chksum.c is not compiled.
+ */
+
+#ifndef UIP_CHKSUM_H_
+#define UIP_CHKSUM_H_
+
+#include "contiki-conf.h"
+
+/**
+ * Add a block of data to a 16-bit one's complement sum.
+ *
+ * The data is summed as a sequence of 16-bit big endian words; an
+ * odd trailing byte is padded with a zero byte. The data pointer
+ * does not need to be aligned.
+ *
+ * \param sum The sum to add to, in host byte order.
+ * \param data Pointer to the data.
+ * \param len Length of the data, in bytes.
+ * \return The updated sum in host byte order.
+ */
+uint16_t uip_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len);
+
+/**
+ * Add two 16-bit one's complement numbers.
+ */
+uint16_t uip_chksum_add16(uint16_t a, uint16_t b);
+
+/**
+ * Update a checksum field after some of the covered data changed.
+ *
+ * This implements equation 3 of RFC 1624: HC' = ~(~HC + ~m + m'),
+ * which lets a packet that has had a few header fields rewritten
+ * keep its checksum without summing the whole packet again. A
+ * checksum that was wrong before the update is still wrong after
+ * it.
+ *
+ * \param chksum The checksum field of the packet, in network byte
+ * order.
+ * \param oldsum The one's complement sum of the old contents of the
+ * changed fields, in host byte order.
+ * \param newsum The one's complement sum of the new contents of the
+ * changed fields, in host byte order.
+ * \return The new checksum field, in network byte order.
+ */
+uint16_t uip_chksum_update(uint16_t chksum, uint16_t oldsum, uint16_t newsum);
+
+#endif /* UIP_CHKSUM_H_ */
@@ -427,6 +427,23 @@ void uip_setipid(uint16_t id);
 #define uip_poll_conn(conn) do { uip_conn = conn;       \
     uip_process(UIP_POLL_REQUEST); } while (0)
 
+#if UIP_TCP_SEND_WINDOW > 1
+/**
+ * Send the next segment from the send buffer of a connection.
+ *
+ * uip_process() produces one packet per call. After the packet
+ * produced by an event has been sent, this macro is used to send the
+ * remaining segments that fit in the connection's send window, for as
+ * long as uip_tcp_sndbuf_window() is non-zero.
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ *
+ * \hideinitializer
+ */
+#define uip_tcp_send_segment(conn) do { uip_conn = conn;  \
+    uip_process(UIP_TCP_SEND_SEGMENT); } while (0)
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
 #endif /* UIP_TCP */
 
 #if UIP_UDP
@@ -639,6 +656,56 @@ struct uip_conn *uip_connect(const uip_ipaddr_t *ripaddr, uint16_t port);
  */
 CCIF void uip_send(const void *data, int len);
 
+#if UIP_TCP_SEND_WINDOW > 1
+struct uip_tcp_sndbuf;
+
+/**
+ * Initialize a TCP send buffer.
+ *
+ * \param buf A pointer to the send buffer.
+ * \param data The memory to be used for queued data.
+ * \param size The size of the memory.
+ */
+void uip_tcp_sndbuf_init(struct uip_tcp_sndbuf *buf, uint8_t *data,
+                         uint16_t size);
+
+/**
+ * Attach a send buffer to an established connection.
+ *
+ * From now on, uIP sends the data queued in the buffer and
+ * retransmits it by itself: the application must not use uip_send()
+ * on the connection and is not called with uip_rexmit(). The
+ * application should not close the connection before the buffer has
+ * drained.
+ *
+ * \param conn A pointer to the connection.
+ * \param buf A pointer to the send buffer, or NULL to detach it.
+ */
+void uip_tcp_sndbuf_attach(struct uip_conn *conn, struct uip_tcp_sndbuf *buf);
+
+/**
+ * Queue data in a TCP send buffer.
+ *
+ * \param buf A pointer to the send buffer.
+ * \param data A pointer to the data.
+ * \param len The length of the data.
+ * \return The number of bytes queued, which is less than len if the
+ * buffer is full.
+ */
+uint16_t uip_tcp_sndbuf_write(struct uip_tcp_sndbuf *buf, const void *data,
+                              uint16_t len);
+
+/**
+ * The number of bytes of a connection's send buffer that can be sent
+ * right now.
+ *
+ * \param conn A pointer to the connection.
+ * \return The length of the next segment, or zero if the window is
+ * full or no data is waiting.
+ */
+uint16_t uip_tcp_sndbuf_window(struct uip_conn *conn);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
 /**
  * The length of any incoming data that is currently available (if available)
  * in the uip_appdata buffer.
@@ -874,7 +941,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH_SIZE
+#define uip_udp_remove(conn) uip_udp_bind_port(conn, 0)
+#else /* UIP_CONN_HASH_SIZE */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_CONN_HASH_SIZE */
 
 /**
  * Bind a UDP connection to a local port.
@@ -886,7 +957,27 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH_SIZE
+#define uip_udp_bind(conn, port) uip_udp_bind_port(conn, port)
+
+/**
+ * Set the local port of a UDP connection and update the connection
+ * hash table.
+ *
+ * This function is used by uip_udp_bind() and uip_udp_remove() when
+ * UIP_CONF_CONN_HASH_SIZE is set. The local port of a UDP connection
+ * must not be changed directly in that case.
+ *
+ * \param conn A pointer to the uip_udp_conn structure for the
+ * connection.
+ *
+ * \param port The local port number, in network byte order, or zero
+ * to remove the connection.
+ */
+void uip_udp_bind_port(struct uip_udp_conn *conn, uint16_t port);
+#else /* UIP_CONN_HASH_SIZE */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_CONN_HASH_SIZE */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1340,6 +1431,37 @@ extern uint16_t uip_urglen, uip_surglen;
 }
 #endif /*NETSTACK_CONF_WITH_IPV6*/
 
+#if UIP_TCP_SEND_WINDOW > 1
+/**
+ * Send buffer of a uIP TCP connection.
+ *
+ * The buffer holds the data queued by the application, starting with
+ * the oldest unacknowledged byte. uIP sends the data in segments of
+ * at most the connection's MSS, keeps up to UIP_TCP_SEND_WINDOW
+ * segments in flight, retransmits lost segments from the buffer and
+ * removes data from the buffer as it is acknowledged. Apart from the
+ * data pointer and size, all fields are maintained by uIP.
+ *
+ * While a send buffer is attached, the snd_nxt field of the
+ * connection holds the oldest unacknowledged sequence number and the
+ * len field the number of bytes in flight.
+ */
+struct uip_tcp_sndbuf {
+  uint8_t *data;         /**< The buffer memory. */
+  uint16_t size;         /**< The size of the buffer memory. */
+  uint16_t head;         /**< Position of the oldest queued byte; the
+                              memory is used as a ring. */
+  uint16_t len;          /**< Number of queued bytes, including those in flight. */
+  uint16_t high;         /**< Number of queued bytes that have been sent. */
+  uint16_t wnd;          /**< The window last advertised by the peer. */
+  uint16_t rtt_end;      /**< End of the segment timed for RTT estimation,
+                              or zero. */
+  uint8_t rtt_ticks;     /**< Timer pulses since the timed segment was sent. */
+  uint8_t cwnd;          /**< Congestion window, in segments. */
+  uint8_t dupacks;       /**< Number of duplicate ACKs received. */
+};
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
 /**
  * Representation of a uIP TCP connection.
  *
@@ -1370,6 +1492,9 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
                               segment sent. */
+#if UIP_TCP_SEND_WINDOW > 1
+  struct uip_tcp_sndbuf *sndbuf; /**< The send buffer, or NULL. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   uip_tcp_appstate_t appstate; /** The application state. */
 };
@@ -1602,6 +1727,11 @@ void uip_process(uint8_t flag);
 #if UIP_UDP
 #define UIP_UDP_TIMER     5
 #endif /* UIP_UDP */
+#if UIP_TCP_SEND_WINDOW > 1
+#define UIP_TCP_SEND_SEGMENT 6  /* Tells uIP that the next segment of a
+                                   connection's send buffer should be
+                                   sent. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
 /* The TCP states used in the uip_conn->tcpstateflags. */
 #define UIP_CLOSED      0
@@ -435,6 +435,27 @@ void uip_log(char *msg);
 #define UIP_LISTENPORTS (UIP_CONF_MAX_LISTENPORTS)
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of buckets in the hash tables used to look up the
+ * connection of an incoming packet.
+ *
+ * With the default of zero, incoming packets are matched against all
+ * UDP connections, TCP connections and listening ports in turn. Builds
+ * with many connections can set this to have uIP keep hash tables of
+ * TCP connections by local port, remote port and remote address, and
+ * of UDP connections and listening ports by local port. Each bucket
+ * uses 2 bytes per table, and each connection or listening port 2
+ * bytes more. The hash tables are only kept by the IPv6 stack; the
+ * IPv4 stack accepts the option and keeps searching linearly.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONN_HASH_SIZE
+#define UIP_CONN_HASH_SIZE (UIP_CONF_CONN_HASH_SIZE)
+#else /* UIP_CONF_CONN_HASH_SIZE */
+#define UIP_CONN_HASH_SIZE 0
+#endif /* UIP_CONF_CONN_HASH_SIZE */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -500,6 +521,39 @@ void uip_log(char *msg);
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+/**
+ * The maximum number of unacknowledged TCP segments per connection.
+ *
+ * With the default of one segment, the application must regenerate
+ * its data when a segment is retransmitted. With a larger window,
+ * connections that have a send buffer attached (see
+ * uip_tcp_sndbuf_attach()) send several segments back to back and
+ * have their data retransmitted by uIP from the buffer. Send buffers
+ * are only implemented by the IPv6 stack.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEND_WINDOW
+#define UIP_TCP_SEND_WINDOW (UIP_CONF_TCP_SEND_WINDOW)
+#else
+#define UIP_TCP_SEND_WINDOW 1
+#endif
+
+#if UIP_TCP_SEND_WINDOW > 1 && !NETSTACK_CONF_WITH_IPV6
+#error "UIP_CONF_TCP_SEND_WINDOW > 1 requires NETSTACK_CONF_WITH_IPV6"
+#endif
+
+/**
+ * The number of duplicate ACKs after which a segment in a send
+ * buffer is retransmitted without waiting for the retransmission
+ * timer.
+ */
+#ifdef UIP_CONF_TCP_DUPACK_THRESHOLD
+#define UIP_TCP_DUPACK_THRESHOLD (UIP_CONF_TCP_DUPACK_THRESHOLD)
+#else
+#define UIP_TCP_DUPACK_THRESHOLD 3
+#endif
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
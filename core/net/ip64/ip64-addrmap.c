@@ -32,7 +32,6 @@
 #include "ip64-addrmap.h"
 
 #include "lib/memb.h"
-#include "lib/list.h"
 
 #include "ip64-conf.h"
 
@@ -40,51 +39,244 @@
 
 #include <string.h>
 
+/*
+ * The address mappings are kept in two hash tables: one keyed on the
+ * (IPv6 address/port, IPv4 address/port, protocol) tuple, used for
+ * packets going out of the IPv6 network, and one keyed on the mapped
+ * port, used for packets coming in from the IPv4 network.
+ *
+ * Expired mappings are removed by a timer wheel with WHEEL_SLOTS
+ * slots of one second each. A mapping sits in the slot that is
+ * processed at or after the time it expires. When a slot is
+ * processed, expired mappings are removed and the others, whose
+ * lifetime was extended or which expire more than one revolution
+ * ahead, are moved to a later slot. Each lookup therefore only
+ * touches the mappings of the slots that have come due since the
+ * last lookup, instead of all mappings.
+ */
 #ifdef IP64_ADDRMAP_CONF_ENTRIES
 #define NUM_ENTRIES IP64_ADDRMAP_CONF_ENTRIES
 #else /* IP64_ADDRMAP_CONF_ENTRIES */
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
+#ifdef IP64_ADDRMAP_CONF_HASH_SIZE
+#define HASH_SIZE IP64_ADDRMAP_CONF_HASH_SIZE
+#else /* IP64_ADDRMAP_CONF_HASH_SIZE */
+#define HASH_SIZE NUM_ENTRIES
+#endif /* IP64_ADDRMAP_CONF_HASH_SIZE */
+
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#define WHEEL_SLOTS IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+#define WHEEL_SLOTS 64
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+
+/* Slots and slot offsets, which go up to WHEEL_SLOTS, are kept in
+   uint8_t */
+#if WHEEL_SLOTS > 255
+#error "IP64_ADDRMAP_CONF_WHEEL_SLOTS must not exceed 255"
+#endif /* WHEEL_SLOTS > 255 */
+
+#define WHEEL_TICK CLOCK_SECOND
+
 MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
-LIST(entrylist);
+static struct ip64_addrmap_entry *entrylist;
+static struct ip64_addrmap_entry *tuple_hash[HASH_SIZE];
+static struct ip64_addrmap_entry *port_hash[HASH_SIZE];
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+static uint8_t wheel_pos;
+static clock_time_t wheel_last;
+
+static struct ip64_addrmap_stats stats;
 
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
 static uint16_t mapped_port = FIRST_MAPPED_PORT;
 
-#define printf(...)
-
 /*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_list(void)
 {
-  return list_head(entrylist);
+  return entrylist;
+}
+/*---------------------------------------------------------------------------*/
+const struct ip64_addrmap_stats *
+ip64_addrmap_get_stats(void)
+{
+  return &stats;
 }
 /*---------------------------------------------------------------------------*/
 void
 ip64_addrmap_init(void)
 {
   memb_init(&entrymemb);
-  list_init(entrylist);
+  entrylist = NULL;
+  memset(tuple_hash, 0, sizeof(tuple_hash));
+  memset(port_hash, 0, sizeof(port_hash));
+  memset(wheel, 0, sizeof(wheel));
+  wheel_pos = 0;
+  wheel_last = clock_time();
+  memset(&stats, 0, sizeof(stats));
   mapped_port = FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
+#define ROTATE(h) (uint16_t)(((h) << 5) | ((h) >> 11))
+
+static uint16_t
+tuple_index(const uip_ip6addr_t *ip6addr, uint16_t ip6port,
+            const uip_ip4addr_t *ip4addr, uint16_t ip4port,
+            uint8_t protocol)
+{
+  uint16_t h;
+  int i;
+
+  h = protocol;
+  for(i = 0; i < 8; i++) {
+    h = ROTATE(h) ^ ip6addr->u16[i];
+  }
+  h = ROTATE(h) ^ ip4addr->u16[0];
+  h = ROTATE(h) ^ ip4addr->u16[1];
+  h = ROTATE(h) ^ ip6port;
+  h = ROTATE(h) ^ ip4port;
+  return h % HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+entry_tuple_index(const struct ip64_addrmap_entry *m)
+{
+  return tuple_index(&m->ip6addr, m->ip6port, &m->ip4addr, m->ip4port,
+                     m->protocol);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+port_index(uint16_t port)
+{
+  return port % HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Return how many slots ahead of the current one a mapping should be
+ * put in the timer wheel: the first slot that is processed at or
+ * after the time the mapping expires, or the current slot (a full
+ * revolution ahead) if the mapping expires later than that.
+ */
+static uint8_t
+wheel_offset(struct ip64_addrmap_entry *m)
+{
+  clock_time_t remaining;
+
+  if(timer_expired(&m->timer)) {
+    return 1;
+  }
+  remaining = timer_remaining(&m->timer) + (clock_time() - wheel_last);
+  if(remaining >= (clock_time_t)(WHEEL_SLOTS - 1) * WHEEL_TICK) {
+    return WHEEL_SLOTS;
+  }
+  return remaining / WHEEL_TICK + 1;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+wheel_current_offset(struct ip64_addrmap_entry *m)
+{
+  return (m->wheel_slot + WHEEL_SLOTS - wheel_pos - 1) % WHEEL_SLOTS + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(struct ip64_addrmap_entry *m, uint8_t offset)
+{
+  m->wheel_slot = (wheel_pos + offset) % WHEEL_SLOTS;
+  m->wheel_next = wheel[m->wheel_slot];
+  wheel[m->wheel_slot] = m;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(struct ip64_addrmap_entry *m)
+{
+  struct ip64_addrmap_entry **p;
+
+  for(p = &wheel[m->wheel_slot]; *p != NULL; p = &(*p)->wheel_next) {
+    if(*p == m) {
+      *p = m->wheel_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Unlink a mapping from the hash tables and the list of mappings and
+ * free it. The caller takes care of the timer wheel.
+ */
+static void
+remove_entry(struct ip64_addrmap_entry *m)
+{
+  struct ip64_addrmap_entry **p;
+
+  for(p = &tuple_hash[entry_tuple_index(m)]; *p != NULL;
+      p = &(*p)->tuple_next) {
+    if(*p == m) {
+      *p = m->tuple_next;
+      break;
+    }
+  }
+  for(p = &port_hash[port_index(m->mapped_port)]; *p != NULL;
+      p = &(*p)->port_next) {
+    if(*p == m) {
+      *p = m->port_next;
+      break;
+    }
+  }
+
+  if(m->prev != NULL) {
+    m->prev->next = m->next;
+  } else {
+    entrylist = m->next;
+  }
+  if(m->next != NULL) {
+    m->next->prev = m->prev;
+  }
+
+  memb_free(&entrymemb, m);
+  stats.flows--;
+}
+/*---------------------------------------------------------------------------*/
 static void
 check_age(void)
 {
-  struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry *m, *next;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-  m = list_head(entrylist);
-  while(m != NULL) {
-    if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
-      m = list_head(entrylist);
-    } else {
-      m = list_item_next(m);
+  if(clock_time() - wheel_last >= (clock_time_t)WHEEL_SLOTS * WHEEL_TICK) {
+    /* We have not been called for a full revolution of the wheel, so
+       every slot is due. Sort all mappings into the wheel again,
+       starting from the current time. */
+    memset(wheel, 0, sizeof(wheel));
+    wheel_last = clock_time();
+    for(m = entrylist; m != NULL; m = next) {
+      next = m->next;
+      if(timer_expired(&m->timer)) {
+        remove_entry(m);
+        stats.expired++;
+      } else {
+        wheel_add(m, wheel_offset(m));
+      }
+    }
+    return;
+  }
+
+  /* Process the slots that have come due since the last call. */
+  while(clock_time() - wheel_last >= WHEEL_TICK) {
+    wheel_last += WHEEL_TICK;
+    wheel_pos = (wheel_pos + 1) % WHEEL_SLOTS;
+    m = wheel[wheel_pos];
+    wheel[wheel_pos] = NULL;
+    for(; m != NULL; m = next) {
+      next = m->wheel_next;
+      if(timer_expired(&m->timer)) {
+        remove_entry(m);
+        stats.expired++;
+      } else {
+        wheel_add(m, wheel_offset(m));
+      }
     }
   }
 }
@@ -95,13 +287,11 @@ recycle(void)
   /* Find the oldest recyclable mapping and remove it. */
   struct ip64_addrmap_entry *m, *oldest;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
+  /* This is only done when the table is full, so a linear search is
+     good enough. */
 
   oldest = NULL;
-  for(m = list_head(entrylist);
-      m != NULL;
-      m = list_item_next(m)) {
+  for(m = entrylist; m != NULL; m = m->next) {
     if(m->flags & FLAGS_RECYCLABLE) {
       if(oldest == NULL) {
         oldest = m;
@@ -117,8 +307,9 @@ recycle(void)
   /* If we found an oldest recyclable entry, remove it and return
      non-zero. */
   if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
+    wheel_remove(oldest);
+    remove_entry(oldest);
+    stats.recycled++;
     return 1;
   }
 
@@ -134,21 +325,16 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
 {
   struct ip64_addrmap_entry *m;
 
-  printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
-	 uip_htons(ip6port));
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
-    printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
-	   m->protocol, protocol,
-	   m->ip4port, ip4port,
-	   m->ip6port, ip6port,
-	   uip_ip4addr_cmp(&m->ip4addr, ip4addr),
-	   uip_ip6addr_cmp(&m->ip6addr, ip6addr));
+  for(m = tuple_hash[tuple_index(ip6addr, ip6port, ip4addr, ip4port,
+                                 protocol)];
+      m != NULL; m = m->tuple_next) {
     if(m->protocol == protocol &&
        m->ip4port == ip4port &&
        m->ip6port == ip6port &&
        uip_ip4addr_cmp(&m->ip4addr, ip4addr) &&
-       uip_ip6addr_cmp(&m->ip6addr, ip6addr)) {
+       uip_ip6addr_cmp(&m->ip6addr, ip6addr) &&
+       !timer_expired(&m->timer)) {
       m->ip6to4++;
       return m;
     }
@@ -156,21 +342,31 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static struct ip64_addrmap_entry *
+lookup_port(uint16_t port)
+{
+  struct ip64_addrmap_entry *m;
+
+  for(m = port_hash[port_index(port)]; m != NULL; m = m->port_next) {
+    if(m->mapped_port == port) {
+      return m;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
 
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
-    printf("mapped port %d %d, protocol %d %d\n",
-	   m->mapped_port, mapped_port,
-	   m->protocol, protocol);
-    if(m->mapped_port == mapped_port &&
-       m->protocol == protocol) {
-      m->ip4to6++;
-      return m;
-    }
+  m = lookup_port(mapped_port);
+  if(m != NULL &&
+     m->protocol == protocol &&
+     !timer_expired(&m->timer)) {
+    m->ip4to6++;
+    return m;
   }
   return NULL;
 }
@@ -190,6 +386,7 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
+  uint16_t i;
 
   check_age();
   m = memb_alloc(&entrymemb);
@@ -211,27 +408,39 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     m->ip4to6 = 0;
     timer_set(&m->timer, 0);
 
-    /* Pick a new, unused local port. First make sure that the
-       mapped_port number does not belong to any active connection. If
-       so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    /* Pick a new, unused local port. If the mapped_port number
+       belongs to an active mapping, we keep picking a new one until
+       we find a free one. */
+    while(lookup_port(mapped_port) != NULL) {
+      increase_mapped_port();
     }
     m->mapped_port = mapped_port;
     increase_mapped_port();
 
-    list_add(entrylist, m);
+    i = entry_tuple_index(m);
+    m->tuple_next = tuple_hash[i];
+    tuple_hash[i] = m;
+    i = port_index(m->mapped_port);
+    m->port_next = port_hash[i];
+    port_hash[i] = m;
+
+    m->prev = NULL;
+    m->next = entrylist;
+    if(entrylist != NULL) {
+      entrylist->prev = m;
+    }
+    entrylist = m;
+
+    wheel_add(m, wheel_offset(m));
+
+    stats.created++;
+    stats.flows++;
+    if(stats.flows > stats.max_flows) {
+      stats.max_flows = stats.flows;
+    }
     return m;
   }
+  stats.dropped++;
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
@@ -239,8 +448,19 @@ void
 ip64_addrmap_set_lifetime(struct ip64_addrmap_entry *e,
                           clock_time_t time)
 {
+  uint8_t offset;
+
   if(e != NULL) {
     timer_set(&e->timer, time);
+
+    /* A mapping that is in a slot that comes due before it expires
+       is moved when that slot is processed, so we only need to move
+       it now if its new lifetime is shorter. */
+    offset = wheel_offset(e);
+    if(offset < wheel_current_offset(e)) {
+      wheel_remove(e);
+      wheel_add(e, offset);
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
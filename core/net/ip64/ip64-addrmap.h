@@ -38,6 +38,10 @@
 
 struct ip64_addrmap_entry {
   struct ip64_addrmap_entry *next;
+  struct ip64_addrmap_entry *prev;
+  struct ip64_addrmap_entry *tuple_next;
+  struct ip64_addrmap_entry *port_next;
+  struct ip64_addrmap_entry *wheel_next;
   struct timer timer;
   uip_ip6addr_t ip6addr;
   uip_ip4addr_t ip4addr;
@@ -47,6 +51,21 @@ struct ip64_addrmap_entry {
   uint16_t ip4port;
   uint8_t protocol;
   uint8_t flags;
+  uint8_t wheel_slot;
+};
+
+/**
+ * Address mapping statistics, see ip64_addrmap_get_stats().
+ */
+struct ip64_addrmap_stats {
+  uint16_t flows;     /**< Number of address mappings in use. */
+  uint16_t max_flows; /**< Highest number of mappings in use at once. */
+  uint32_t created;   /**< Number of mappings created. */
+  uint32_t expired;   /**< Number of mappings removed because they expired. */
+  uint32_t recycled;  /**< Number of recyclable mappings evicted to make
+                           room for a new one. */
+  uint32_t dropped;   /**< Number of mappings that could not be created
+                           because the table was full. */
 };
 
 #define FLAGS_NONE       0
@@ -100,4 +119,9 @@ void ip64_addrmap_set_recycleble(struct ip64_addrmap_entry *e);
  * Obtain the list of all address mappings.
  */
 struct ip64_addrmap_entry *ip64_addrmap_list(void);
+
+/**
+ * Obtain the address mapping statistics.
+ */
+const struct ip64_addrmap_stats *ip64_addrmap_get_stats(void);
 #endif /* IP64_ADDRMAP_H */
@@ -45,4 +45,14 @@
  * optional configuration parameter. The default value is set in ip64.h 
  */
 /* #define IP64_CONF_DHCP                      1 */
+
+/*
+ * The size of the NAT64 address mapping table, the number of buckets
+ * in its hash tables, and the number of one-second slots in the timer
+ * wheel that ages it out (at most 255). The defaults are 32, the
+ * number of entries, and 64.
+ */
+/* #define IP64_ADDRMAP_CONF_ENTRIES           32 */
+/* #define IP64_ADDRMAP_CONF_HASH_SIZE         32 */
+/* #define IP64_ADDRMAP_CONF_WHEEL_SLOTS       64 */
 #endif /* IP64_CONF_H */
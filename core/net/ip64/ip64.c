@@ -63,6 +63,7 @@
 #include "net/ipv6/uip-ds6.h"
 #include "ip64-ipv4-dhcp.h"
 #include "contiki-net.h"
+#include "net/ip/uip-chksum.h"
 
 #include "net/ip/uip-debug.h"
 
@@ -269,42 +270,11 @@ ip64_set_ipv6_address(const uip_ip6addr_t *addr)
 }
 /*---------------------------------------------------------------------------*/
 static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
-{
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {	/* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-    dataptr += 2;
-  }
-
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-  }
-
-  /* Return sum in host byte order. */
-  return sum;
-}
-/*---------------------------------------------------------------------------*/
-static uint16_t
 ipv4_checksum(struct ipv4_hdr *hdr)
 {
   uint16_t sum;
 
-  sum = chksum(0, (uint8_t *)hdr, IPV4_HDRLEN);
+  sum = uip_chksum_add(0, (uint8_t *)hdr, IPV4_HDRLEN);
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
 /*---------------------------------------------------------------------------*/
@@ -323,14 +293,15 @@ ipv4_transport_checksum(const uint8_t *packet, uint16_t len, uint8_t proto)
     /* IP protocol and length fields. This addition cannot carry. */
     sum = transport_layer_len + proto;
     /* Sum IP source and destination addresses. */
-    sum = chksum(sum, (uint8_t *)&v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t));
+    sum = uip_chksum_add(sum, (uint8_t *)&v4hdr->srcipaddr,
+                         2 * sizeof(uip_ip4addr_t));
   } else {
     /* ping replies' checksums are calculated over the icmp-part only */
     sum = 0;
   }
 
   /* Sum transport layer header and data. */
-  sum = chksum(sum, &packet[IPV4_HDRLEN], transport_layer_len);
+  sum = uip_chksum_add(sum, &packet[IPV4_HDRLEN], transport_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -349,15 +320,36 @@ ipv6_transport_checksum(const uint8_t *packet, uint16_t len, uint8_t proto)
   /* IP protocol and length fields. This addition cannot carry. */
   sum = transport_layer_len + proto;
   /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&v6hdr->srcipaddr, sizeof(uip_ip6addr_t));
-  sum = chksum(sum, (uint8_t *)&v6hdr->destipaddr, sizeof(uip_ip6addr_t));
+  sum = uip_chksum_add(sum, (uint8_t *)&v6hdr->srcipaddr, sizeof(uip_ip6addr_t));
+  sum = uip_chksum_add(sum, (uint8_t *)&v6hdr->destipaddr, sizeof(uip_ip6addr_t));
 
   /* Sum transport layer header and data. */
-  sum = chksum(sum, &packet[IPV6_HDRLEN], transport_layer_len);
+  sum = uip_chksum_add(sum, &packet[IPV6_HDRLEN], transport_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Update the TCP or UDP checksum of a translated packet, instead of
+ * summing the whole packet again (RFC 1624). Only the addresses of
+ * the pseudo-header and one of the port numbers differ between the
+ * original and the translated packet: the length and protocol
+ * fields of the IPv4 and IPv6 pseudo-headers are the same.
+ */
+static uint16_t
+transport_checksum_update(uint16_t chksum,
+                          const uint8_t *oldaddrs, uint16_t oldaddrslen,
+                          uint16_t oldport,
+                          const uint8_t *newaddrs, uint16_t newaddrslen,
+                          uint16_t newport)
+{
+  uint16_t oldsum, newsum;
+
+  oldsum = uip_chksum_add(uip_ntohs(oldport), oldaddrs, oldaddrslen);
+  newsum = uip_chksum_add(uip_ntohs(newport), newaddrs, newaddrslen);
+  return uip_chksum_update(chksum, oldsum, newsum);
+}
+/*---------------------------------------------------------------------------*/
 int
 ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
 	  uint8_t *resultpacket)
@@ -369,6 +361,8 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   struct icmpv4_hdr *icmpv4hdr;
   struct icmpv6_hdr *icmpv6hdr;
   uint16_t ipv6len, ipv4len;
+  uint16_t srcport;
+  uint8_t recompute_chksum;
   struct ip64_addrmap_entry *m;
 
   v6hdr = (struct ipv6_hdr *)ipv6packet;
@@ -392,6 +386,12 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   icmpv4hdr = (struct icmpv4_hdr *)&resultpacket[IPV4_HDRLEN];
   icmpv6hdr = (struct icmpv6_hdr *)&ipv6packet[IPV6_HDRLEN];
 
+  /* The TCP and UDP checksums are updated with the changes we make
+     to the pseudo-header and the source port, unless the payload is
+     rewritten as well. */
+  srcport = udphdr->srcport;
+  recompute_chksum = 0;
+
   /* Translate the IPv6 header into an IPv4 header. */
 
   /* First the basics: the IPv4 version, header length, type of
@@ -425,14 +425,10 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
     PRINTF("ip64_6to4: TCP header\n");
     v4hdr->proto = IP_PROTO_TCP;
 
-    /* Compute and check the TCP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
-    if(ipv6_transport_checksum(ipv6packet, ipv6len,
-                               IP_PROTO_TCP) != 0xffff) {
-      PRINTF("Bad TCP checksum, dropping packet\n");
-    }
-
+    /* The TCP checksum is not verified here: since it is updated
+       incrementally, a packet with a bad checksum will still have a
+       bad checksum after translation and is dropped by the
+       receiver. */
     break;
 
   case IP_PROTO_UDP:
@@ -446,13 +442,7 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
                       ipv6len - IPV6_HDRLEN - sizeof(struct udp_hdr),
                       (uint8_t *)udphdr + sizeof(struct udp_hdr),
                       BUFSIZE - IPV4_HDRLEN - sizeof(struct udp_hdr));
-    }
-    /* Compute and check the UDP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
-    if(ipv6_transport_checksum(ipv6packet, ipv6len,
-                               IP_PROTO_UDP) != 0xffff) {
-      PRINTF("Bad UDP checksum, dropping packet\n");
+      recompute_chksum = 1;
     }
     break;
 
@@ -619,14 +609,26 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
      field. */
   switch(v4hdr->proto) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum =
+      transport_checksum_update(tcphdr->tcpchksum,
+                                (uint8_t *)&v6hdr->srcipaddr,
+                                2 * sizeof(uip_ip6addr_t), srcport,
+                                (uint8_t *)&v4hdr->srcipaddr,
+                                2 * sizeof(uip_ip4addr_t), udphdr->srcport);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_UDP));
+    if(recompute_chksum || udphdr->udpchksum == 0) {
+      udphdr->udpchksum = 0;
+      udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
+                                                    IP_PROTO_UDP));
+    } else {
+      udphdr->udpchksum =
+        transport_checksum_update(udphdr->udpchksum,
+                                  (uint8_t *)&v6hdr->srcipaddr,
+                                  2 * sizeof(uip_ip6addr_t), srcport,
+                                  (uint8_t *)&v4hdr->srcipaddr,
+                                  2 * sizeof(uip_ip4addr_t), udphdr->srcport);
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
@@ -658,6 +660,8 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
   struct icmpv4_hdr *icmpv4hdr;
   struct icmpv6_hdr *icmpv6hdr;
   uint16_t ipv4len, ipv6len, ipv6_packet_len;
+  uint16_t destport;
+  uint8_t recompute_chksum;
   struct ip64_addrmap_entry *m;
 
   v6hdr = (struct ipv6_hdr *)resultpacket;
@@ -690,6 +694,11 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
   icmpv4hdr = (struct icmpv4_hdr *)&ipv4packet[IPV4_HDRLEN];
   icmpv6hdr = (struct icmpv6_hdr *)&resultpacket[IPV6_HDRLEN];
 
+  /* As in ip64_6to4(), the TCP and UDP checksums are updated rather
+     than recomputed unless the payload is rewritten. */
+  destport = udphdr->destport;
+  recompute_chksum = 0;
+
   ipv6len = ipv4len - IPV4_HDRLEN + IPV6_HDRLEN;
   ipv6_packet_len = ipv6len - IPV6_HDRLEN;
 
@@ -741,7 +750,7 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
       v6hdr->len[0] = ipv6_packet_len >> 8;
       v6hdr->len[1] = ipv6_packet_len & 0xff;
       ipv6len = ipv6_packet_len + IPV6_HDRLEN;
-
+      recompute_chksum = 1;
     }
     break;
 
@@ -854,16 +863,29 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
      field. */
   switch(v6hdr->nxthdr) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum =
+      transport_checksum_update(tcphdr->tcpchksum,
+                                (uint8_t *)&v4hdr->srcipaddr,
+                                2 * sizeof(uip_ip4addr_t), destport,
+                                (uint8_t *)&v6hdr->srcipaddr,
+                                2 * sizeof(uip_ip6addr_t), udphdr->destport);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_UDP));
+    /* IPv4 UDP packets may be sent without a checksum, but IPv6 UDP
+       packets must have one. */
+    if(recompute_chksum || udphdr->udpchksum == 0) {
+      udphdr->udpchksum = 0;
+      udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
+                                                    ipv6len,
+                                                    IP_PROTO_UDP));
+    } else {
+      udphdr->udpchksum =
+        transport_checksum_update(udphdr->udpchksum,
+                                  (uint8_t *)&v4hdr->srcipaddr,
+                                  2 * sizeof(uip_ip4addr_t), destport,
+                                  (uint8_t *)&v6hdr->srcipaddr,
+                                  2 * sizeof(uip_ip6addr_t), udphdr->destport);
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
@@ -501,6 +501,16 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
 
   return conn;
 }
+/*---------------------------------------------------------------------------*/
+#if UIP_CONN_HASH_SIZE
+/* The IPv4 stack looks connections up linearly, so there is no hash
+   table to update. */
+void
+uip_udp_bind_port(struct uip_udp_conn *conn, uint16_t port)
+{
+  conn->lport = port;
+}
+#endif /* UIP_CONN_HASH_SIZE */
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
 void
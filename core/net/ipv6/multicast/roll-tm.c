@@ -195,12 +195,14 @@ struct trickle_param {
 /*---------------------------------------------------------------------------*/
 /* Sliding Windows */
 struct sliding_window {
+  struct sliding_window *next;  /* Next window in the same hash bucket */
   seed_id_t seed_id;
   int16_t lower_bound;          /* lolipop */
   int16_t upper_bound;          /* lolipop */
   int16_t min_listed;           /* lolipop */
   uint8_t flags;                /* Is used, Trickle param, Is listed */
   uint8_t count;
+  LIST_STRUCT(msgs);            /* Buffered messages, by ascending seq. val */
 };
 
 #define SLIDING_WINDOW_U_BIT 0x80       /* Is used */
@@ -225,7 +227,6 @@ struct sliding_window {
  * w: pointer to a sliding window
  */
 #define SLIDING_WINDOW_IS_USED_CLR(w) ((w)->flags &= ~SLIDING_WINDOW_U_BIT)
-#define window_free(w) SLIDING_WINDOW_IS_USED_CLR(w)
 
 /**
  * \brief Set 'Is Seen' bit for window w
@@ -266,6 +267,7 @@ struct sliding_window {
 /*---------------------------------------------------------------------------*/
 /* Multicast Packet Buffers */
 struct mcast_packet {
+  struct mcast_packet *next;    /* Next message in the same window */
 #if ROLL_TM_SHORT_SEEDS
   /* Short seeds are stored inside the message */
   seed_id_t seed_id;
@@ -275,12 +277,11 @@ struct mcast_packet {
   uint16_t buff_len;
   uint16_t seq_val;             /* host-byte order */
   struct sliding_window *sw;    /* Pointer to the SW this packet belongs to */
-  uint8_t flags;                /* Is-Used, Must Send, Is Listed */
+  uint8_t flags;                /* Must Send, Is Listed */
   uint8_t buff[UIP_BUFSIZE - UIP_LLH_LEN];
 };
 
 /* Flag bits */
-#define MCAST_PACKET_U_BIT       0x80   /* Is Used */
 #define MCAST_PACKET_S_BIT       0x20   /* Must Send Next Pass */
 #define MCAST_PACKET_L_BIT       0x10   /* Is listed in ICMP message */
 
@@ -299,23 +300,6 @@ struct mcast_packet {
 #define MCAST_PACKET_TTL(p) \
     (((struct uip_ip_hdr *)(p)->buff)->ttl)
 
-/**
- * \brief Set 'Is Used' bit for packet p
- * p: pointer to a packet buffer
- */
-#define MCAST_PACKET_USED_SET(p) ((p)->flags |= MCAST_PACKET_U_BIT)
-
-/**
- * \brief Clear 'Is Used' bit for packet p
- * p: pointer to a packet buffer
- */
-#define MCAST_PACKET_USED_CLR(p) ((p)->flags &= ~MCAST_PACKET_U_BIT)
-
-/**
- * \brief Is Occupied buffer location p
- */
-#define MCAST_PACKET_IS_USED(p) ((p)->flags & MCAST_PACKET_U_BIT)
-
 /**
  * \brief Must we send this message this pass?
  */
@@ -350,12 +334,6 @@ struct mcast_packet {
  * p: pointer to a struct mcast_packet
  */
 #define MCAST_PACKET_LISTED_CLR(p) ((p)->flags &= ~MCAST_PACKET_L_BIT)
-
-/**
- * \brief Free a multicast packet buffer
- * p: pointer to a struct mcast_packet
- */
-#define MCAST_PACKET_FREE(p) ((p)->flags = 0)
 /*---------------------------------------------------------------------------*/
 /* Sequence Lists in Multicast Trickle ICMP messages */
 struct sequence_list_header {
@@ -442,7 +420,11 @@ static struct roll_tm_stats stats;
 /*---------------------------------------------------------------------------*/
 static struct trickle_param t[2];
 static struct sliding_window windows[ROLL_TM_WINS];
-static struct mcast_packet buffered_msgs[ROLL_TM_BUFF_NUM];
+MEMB(buffered_msgs, struct mcast_packet, ROLL_TM_BUFF_NUM);
+
+/* Seed ID -> sliding window index, one chain per bucket */
+#define WINDOW_HASH_SIZE ROLL_TM_WINS
+static struct sliding_window *window_hash[WINDOW_HASH_SIZE];
 /*---------------------------------------------------------------------------*/
 /* Temporary Stores */
 /*---------------------------------------------------------------------------*/
@@ -470,7 +452,7 @@ extern uint16_t uip_slen;
 /*---------------------------------------------------------------------------*/
 static void icmp_input(void);
 static void icmp_output(void);
-static void window_update_bounds(void);
+static void buffer_free(struct mcast_packet *);
 static void reset_trickle_timer(uint8_t);
 static void handle_timer(void *);
 /*---------------------------------------------------------------------------*/
@@ -538,6 +520,7 @@ handle_timer(void *ptr)
   struct trickle_param *param;
   clock_time_t diff_last;       /* Time diff from last pass */
   clock_time_t diff_start;      /* Time diff from interval start */
+  struct mcast_packet *next;
   uint8_t m;
 
   param = (struct trickle_param *)ptr;
@@ -573,10 +556,15 @@ handle_timer(void *ptr)
      (unsigned long)diff_last, (unsigned long)diff_start);
 
   /* Handle all buffered messages */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)
-       && (SLIDING_WINDOW_GET_M(locmpptr->sw) == m)) {
+  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
+      iterswptr--) {
+    if(!SLIDING_WINDOW_IS_USED(iterswptr) ||
+       SLIDING_WINDOW_GET_M(iterswptr) != m) {
+      continue;
+    }
+    for(locmpptr = list_head(iterswptr->msgs); locmpptr != NULL;
+        locmpptr = next) {
+      next = list_item_next(locmpptr);
 
       /*
        * if()
@@ -604,17 +592,10 @@ handle_timer(void *ptr)
                      TRICKLE_ACTIVE(param));
 
       if(locmpptr->dwell > TRICKLE_DWELL(param)) {
-        locmpptr->sw->count--;
         PRINTF("ROLL TM: M=%u Free Packet %u (%lu > %lu), Window now at %u\n",
                m, locmpptr->seq_val, locmpptr->dwell,
-               TRICKLE_DWELL(param), locmpptr->sw->count);
-        if(locmpptr->sw->count == 0) {
-          PRINTF("ROLL TM: M=%u Free Window ", m);
-          PRINT_SEED(&locmpptr->sw->seed_id);
-          PRINTF("\n");
-          window_free(locmpptr->sw);
-        }
-        MCAST_PACKET_FREE(locmpptr);
+               TRICKLE_DWELL(param), locmpptr->sw->count - 1);
+        buffer_free(locmpptr);
       } else if(MCAST_PACKET_TTL(locmpptr) > 0) {
         /* Handle multicast transmissions */
         if(locmpptr->active < TRICKLE_ACTIVE(param) &&
@@ -646,8 +627,6 @@ handle_timer(void *ptr)
   param->inconsistency = 0;
   param->c = 0;
 
-  window_update_bounds();
-
   /* Temporarily store 'now' in t_next */
   param->t_next = clock_time();
   if(param->t_next >= param->t_end) {
@@ -682,6 +661,19 @@ reset_trickle_timer(uint8_t index)
   ctimer_set(&t[index].ct, t[index].t_next, handle_timer, (void *)&t[index]);
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t
+window_hash_index(seed_id_t *s, uint8_t m)
+{
+  uint8_t *p;
+  uint8_t h;
+
+  h = m;
+  for(p = (uint8_t *)s; p < (uint8_t *)s + sizeof(seed_id_t); p++) {
+    h = (h << 1) + (h >> 7) + *p;
+  }
+  return h % WINDOW_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_allocate()
 {
@@ -692,17 +684,46 @@ window_allocate()
       iterswptr->lower_bound = -1;
       iterswptr->upper_bound = -1;
       iterswptr->min_listed = -1;
+      LIST_STRUCT_INIT(iterswptr, msgs);
       return iterswptr;
     }
   }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Make window w, with its Seed ID and M set, visible to window_lookup() */
+static void
+window_index(struct sliding_window *w)
+{
+  struct sliding_window **bucket;
+
+  bucket = &window_hash[window_hash_index(&w->seed_id,
+                                          SLIDING_WINDOW_GET_M(w))];
+  w->next = *bucket;
+  *bucket = w;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_free(struct sliding_window *w)
+{
+  struct sliding_window **prev;
+
+  for(prev = &window_hash[window_hash_index(&w->seed_id,
+                                            SLIDING_WINDOW_GET_M(w))];
+      *prev != NULL; prev = &(*prev)->next) {
+    if(*prev == w) {
+      *prev = w->next;
+      break;
+    }
+  }
+  SLIDING_WINDOW_IS_USED_CLR(w);
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_lookup(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
+  for(iterswptr = window_hash[window_hash_index(s, m)]; iterswptr != NULL;
+      iterswptr = iterswptr->next) {
     VERBOSE_PRINTF("ROLL TM: M=%u (%u) ", SLIDING_WINDOW_GET_M(iterswptr), m);
     VERBOSE_PRINT_SEED(&iterswptr->seed_id);
     VERBOSE_PRINTF("\n");
@@ -714,33 +735,52 @@ window_lookup(seed_id_t *s, uint8_t m)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Add message p to its window, keeping the window's list ordered by sequence
+ * value. The lower bound of a window is always the head of its list, the
+ * upper bound is the highest value ever seen while the window is in use
+ */
 static void
-window_update_bounds()
+buffer_insert(struct mcast_packet *p)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    iterswptr->lower_bound = -1;
-  }
+  struct sliding_window *w = p->sw;
+  struct mcast_packet *prev = NULL;
+  struct mcast_packet *next;
 
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      iterswptr = locmpptr->sw;
-      VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
-                     iterswptr->lower_bound, iterswptr->upper_bound,
-                     locmpptr->seq_val);
-      if(iterswptr->lower_bound < 0
-         || SEQ_VAL_IS_LT(locmpptr->seq_val, iterswptr->lower_bound)) {
-        iterswptr->lower_bound = locmpptr->seq_val;
-      }
-      if(iterswptr->upper_bound < 0 ||
-         SEQ_VAL_IS_GT(locmpptr->seq_val, iterswptr->upper_bound)) {
-        iterswptr->upper_bound = locmpptr->seq_val;
-      }
+  for(next = list_head(w->msgs); next != NULL; next = list_item_next(next)) {
+    if(SEQ_VAL_IS_GT(next->seq_val, p->seq_val)) {
+      break;
     }
+    prev = next;
+  }
+  list_insert(w->msgs, prev, p);
+  w->count++;
+
+  w->lower_bound = ((struct mcast_packet *)list_head(w->msgs))->seq_val;
+  if(w->count == 1 || SEQ_VAL_IS_GT(p->seq_val, w->upper_bound)) {
+    w->upper_bound = p->seq_val;
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Release message p. Its window is released with its last message */
+static void
+buffer_free(struct mcast_packet *p)
+{
+  struct sliding_window *w = p->sw;
+
+  list_remove(w->msgs, p);
+  memb_free(&buffered_msgs, p);
+  w->count--;
+  if(w->count == 0) {
+    PRINTF("ROLL TM: Free Window ");
+    PRINT_SEED(&w->seed_id);
+    PRINTF(" M=%u\n", SLIDING_WINDOW_GET_M(w));
+    window_free(w);
+    return;
+  }
+  w->lower_bound = ((struct mcast_packet *)list_head(w->msgs))->seq_val;
+}
+/*---------------------------------------------------------------------------*/
 static struct mcast_packet *
 buffer_reclaim()
 {
@@ -754,7 +794,7 @@ buffer_reclaim()
     }
   }
 
-  if(largest->count == 1) {
+  if(largest->count <= 1) {
     /* Can't reclaim last entry for a window and this is the largest window */
     return NULL;
   }
@@ -763,36 +803,15 @@ buffer_reclaim()
   PRINT_SEED(&largest->seed_id);
   PRINTF(" M=%u, count was %u\n",
          SLIDING_WINDOW_GET_M(largest), largest->count);
-  /* Find the packet at the lowest bound for the largest window */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == largest) &&
-       SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
-      rv = locmpptr;
-      PRINTF("ROLL TM: Reclaim seq. val %u\n", locmpptr->seq_val);
-      MCAST_PACKET_FREE(rv);
-      largest->count--;
-      window_update_bounds();
-      VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
-                     largest->lower_bound, largest->upper_bound);
-      return rv;
-    }
-  }
 
-  /* oops */
-  return NULL;
-}
-/*---------------------------------------------------------------------------*/
-static struct mcast_packet *
-buffer_allocate()
-{
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(!MCAST_PACKET_IS_USED(locmpptr)) {
-      return locmpptr;
-    }
-  }
-  return NULL;
+  /* The packet at the lowest bound for the largest window heads its list */
+  rv = list_head(largest->msgs);
+  PRINTF("ROLL TM: Reclaim seq. val %u\n", rv->seq_val);
+  buffer_free(rv);
+  VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
+                 largest->lower_bound, largest->upper_bound);
+
+  return memb_alloc(&buffered_msgs);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -832,18 +851,15 @@ icmp_output()
 
       buffer = (uint8_t *)sl + sizeof(struct sequence_list_header);
 
-      for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-          locmpptr >= buffered_msgs; locmpptr--) {
-        if(MCAST_PACKET_IS_USED(locmpptr) &&
-           locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
-          if(locmpptr->sw == iterswptr) {
-            sl->seq_len++;
-            PRINTF(", %u", locmpptr->seq_val);
-            *buffer = (uint8_t)(locmpptr->seq_val >> 8);
-            buffer++;
-            *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
-            buffer++;
-          }
+      for(locmpptr = list_head(iterswptr->msgs); locmpptr != NULL;
+          locmpptr = list_item_next(locmpptr)) {
+        if(locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
+          sl->seq_len++;
+          PRINTF(", %u", locmpptr->seq_val);
+          *buffer = (uint8_t)(locmpptr->seq_val >> 8);
+          buffer++;
+          *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
+          buffer++;
         }
       }
       PRINTF(", Len=%u\n", sl->seq_len);
@@ -978,12 +994,10 @@ accept(uint8_t in)
       UIP_MCAST6_STATS_ADD(mcast_dropped);
       return UIP_MCAST6_DROP;
     }
-    for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-        locmpptr >= buffered_msgs; locmpptr--) {
-      if(MCAST_PACKET_IS_USED(locmpptr) &&
-         locmpptr->sw == locswptr &&
-         SLIDING_WINDOW_GET_M(locmpptr->sw) == m &&
-         SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
+    for(locmpptr = list_head(locswptr->msgs); locmpptr != NULL &&
+        !SEQ_VAL_IS_GT(locmpptr->seq_val, seq_val);
+        locmpptr = list_item_next(locmpptr)) {
+      if(SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
         /* Seen before , drop */
         PRINTF("ROLL TM: Seen before\n");
         UIP_MCAST6_STATS_ADD(mcast_dropped);
@@ -1008,7 +1022,7 @@ accept(uint8_t in)
   }
 
   /* Allocate a buffer */
-  locmpptr = buffer_allocate();
+  locmpptr = memb_alloc(&buffered_msgs);
   if(!locmpptr) {
     PRINTF("ROLL TM: Buffer allocation failed, reclaiming\n");
     locmpptr = buffer_reclaim();
@@ -1020,9 +1034,9 @@ accept(uint8_t in)
     PRINTF("ROLL TM: Buffer reclaim failed\n");
     if(locswptr->count == 0) {
       window_free(locswptr);
-      UIP_MCAST6_STATS_ADD(mcast_dropped);
-      return UIP_MCAST6_DROP;
     }
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
   }
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
@@ -1032,37 +1046,28 @@ accept(uint8_t in)
 
   /* We have a window and we have a buffer. Accept this message */
   /* Set the seed ID and correct M for this window */
-  SLIDING_WINDOW_M_CLR(locswptr);
-  if(m) {
-    SLIDING_WINDOW_M_SET(locswptr);
+  if(!SLIDING_WINDOW_IS_USED(locswptr)) {
+    SLIDING_WINDOW_M_CLR(locswptr);
+    if(m) {
+      SLIDING_WINDOW_M_SET(locswptr);
+    }
+    SLIDING_WINDOW_IS_USED_SET(locswptr);
+    seed_id_cpy(&locswptr->seed_id, seed_ptr);
+    window_index(locswptr);
   }
-  SLIDING_WINDOW_IS_USED_SET(locswptr);
-  seed_id_cpy(&locswptr->seed_id, seed_ptr);
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
   PRINTF(" M=%u, count=%u\n",
          SLIDING_WINDOW_GET_M(locswptr), locswptr->count);
 
-  /* If this window was previously empty, set its lower bound to this packet */
-  if(locswptr->count == 0) {
-    locswptr->lower_bound = seq_val;
-    VERBOSE_PRINTF("ROLL TM: New Lower Bound %u\n", locswptr->lower_bound);
-  }
-
-  /* If this is a new Seq Num, update the window upper bound */
-  if(locswptr->count == 0 || SEQ_VAL_IS_GT(seq_val, locswptr->upper_bound)) {
-    locswptr->upper_bound = seq_val;
-    VERBOSE_PRINTF("ROLL TM: New Upper Bound %u\n", locswptr->upper_bound);
-  }
-
-  locswptr->count++;
-
   memset(locmpptr, 0, sizeof(struct mcast_packet));
   memcpy(&locmpptr->buff, UIP_IP_BUF, uip_len);
   locmpptr->sw = locswptr;
   locmpptr->buff_len = uip_len;
   locmpptr->seq_val = seq_val;
-  MCAST_PACKET_USED_SET(locmpptr);
+
+  /* Insert in order and update the window bounds */
+  buffer_insert(locmpptr);
 
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
@@ -1136,16 +1141,16 @@ icmp_input()
 
   ROLL_TM_STATS_ADD(icmp_in);
 
-  /* Reset Is-Listed bit for all windows */
+  /* Reset Is-Listed bit for all windows and their cached packets */
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     SLIDING_WINDOW_LISTED_CLR(iterswptr);
-  }
-
-  /* Reset Is-Listed bit for all cached packets */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    MCAST_PACKET_LISTED_CLR(locmpptr);
+    if(SLIDING_WINDOW_IS_USED(iterswptr)) {
+      for(locmpptr = list_head(iterswptr->msgs); locmpptr != NULL;
+          locmpptr = list_item_next(locmpptr)) {
+        MCAST_PACKET_LISTED_CLR(locmpptr);
+      }
+    }
   }
 
   locslhptr = (struct sequence_list_header *)UIP_ICMP_PAYLOAD;
@@ -1222,23 +1227,22 @@ icmp_input()
 
           inconsistency = 1;
           /* Check if the advertised sequence is in our buffer */
-          for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-              locmpptr >= buffered_msgs; locmpptr--) {
-            if(MCAST_PACKET_IS_USED(locmpptr) && locmpptr->sw == locswptr) {
-              if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
-
-                inconsistency = 0;
-                MCAST_PACKET_LISTED_SET(locmpptr);
-                PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
-
-                /* Update lowest seq. num listed for this window
-                 * We need this to check for "we have new" */
-                if(locswptr->min_listed == -1 ||
-                   SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
-                  locswptr->min_listed = val;
-                }
-                break;
+          for(locmpptr = list_head(locswptr->msgs); locmpptr != NULL &&
+              !SEQ_VAL_IS_GT(locmpptr->seq_val, val);
+              locmpptr = list_item_next(locmpptr)) {
+            if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
+
+              inconsistency = 0;
+              MCAST_PACKET_LISTED_SET(locmpptr);
+              PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
+
+              /* Update lowest seq. num listed for this window
+               * We need this to check for "we have new" */
+              if(locswptr->min_listed == -1 ||
+                 SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
+                locswptr->min_listed = val;
               }
+              break;
             }
           }
           if(inconsistency) {
@@ -1265,10 +1269,13 @@ icmp_input()
 
   /* Check for "We have new */
   PRINTF("ROLL TM: ICMPv6 In, Check our buffer\n");
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      locswptr = locmpptr->sw;
+  for(locswptr = &windows[ROLL_TM_WINS - 1]; locswptr >= windows;
+      locswptr--) {
+    if(!SLIDING_WINDOW_IS_USED(locswptr)) {
+      continue;
+    }
+    for(locmpptr = list_head(locswptr->msgs); locmpptr != NULL;
+        locmpptr = list_item_next(locmpptr)) {
       PRINTF("ROLL TM: ICMPv6 In, ");
       PRINTF("Check %u, Seed L: %u, This L: %u Min L: %d\n",
              locmpptr->seq_val, SLIDING_WINDOW_IS_LISTED(locswptr),
@@ -1414,7 +1421,8 @@ init()
   PRINTF("ROLL TM: ROLL Multicast - Draft #%u\n", ROLL_TM_VER);
 
   memset(windows, 0, sizeof(windows));
-  memset(buffered_msgs, 0, sizeof(buffered_msgs));
+  memset(window_hash, 0, sizeof(window_hash));
+  memb_init(&buffered_msgs);
   memset(t, 0, sizeof(t));
 
   ROLL_TM_STATS_INIT();
@@ -1428,6 +1436,7 @@ init()
     iterswptr->lower_bound = -1;
     iterswptr->upper_bound = -1;
     iterswptr->min_listed = -1;
+    LIST_STRUCT_INIT(iterswptr, msgs);
   }
 
   TIMER_CONFIGURE(0);
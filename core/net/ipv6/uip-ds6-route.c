@@ -305,27 +305,24 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
 #endif /* (UIP_CONF_MAX_ROUTES != 0) */
 }
 /*---------------------------------------------------------------------------*/
-uip_ds6_route_t *
-uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
-		  uip_ipaddr_t *nexthop)
-{
 #if (UIP_CONF_MAX_ROUTES != 0)
+/*
+ * The first npinned entries of pinned, the routes added earlier in the
+ * same batch, are never dropped to make room for the new route.
+ */
+static uip_ds6_route_t *
+route_add(uip_ipaddr_t *ipaddr, uint8_t length, uip_ipaddr_t *nexthop,
+          const uip_lladdr_t *nexthop_lladdr,
+          uip_ds6_route_t **pinned, int npinned)
+{
   uip_ds6_route_t *r;
   struct uip_ds6_route_neighbor_route *nbrr;
+  int i;
 
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
 
-  /* Get link-layer address of next hop, make sure it is in neighbor table */
-  const uip_lladdr_t *nexthop_lladdr = uip_ds6_nbr_lladdr_from_ipaddr(nexthop);
-  if(nexthop_lladdr == NULL) {
-    PRINTF("uip_ds6_route_add: neighbor link-local address unknown for ");
-    PRINT6ADDR(nexthop);
-    PRINTF("\n");
-    return NULL;
-  }
-
   /* First make sure that we don't add a route twice. If we find an
      existing route for our destination, we'll delete the old
      one first. */
@@ -357,6 +354,11 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
          least recently used route is the first route on the list. */
       oldest = list_tail(routelist);
 #endif
+      for(i = 0; oldest != NULL && i < npinned; i++) {
+        if(pinned[i] == oldest) {
+          oldest = NULL;
+        }
+      }
       if(oldest == NULL) {
         return NULL;
       }
@@ -456,11 +458,64 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
   return r;
+}
+#endif /* (UIP_CONF_MAX_ROUTES != 0) */
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
+		  uip_ipaddr_t *nexthop)
+{
+#if (UIP_CONF_MAX_ROUTES != 0)
+  /* Get link-layer address of next hop, make sure it is in neighbor table */
+  const uip_lladdr_t *nexthop_lladdr = uip_ds6_nbr_lladdr_from_ipaddr(nexthop);
+  if(nexthop_lladdr == NULL) {
+    PRINTF("uip_ds6_route_add: neighbor link-local address unknown for ");
+    PRINT6ADDR(nexthop);
+    PRINTF("\n");
+    return NULL;
+  }
+
+  return route_add(ipaddr, length, nexthop, nexthop_lladdr, NULL, 0);
 
 #else /* (UIP_CONF_MAX_ROUTES != 0) */
   return NULL;
 #endif /* (UIP_CONF_MAX_ROUTES != 0) */
 }
+/*---------------------------------------------------------------------------*/
+/*
+ * Adds routes to count destinations through the same next hop, e.g.
+ * the targets of one DAO, resolving the next hop only once. routes[i]
+ * is set to the entry for ipaddrs[i], or NULL if it could not be added.
+ * Routes of the batch are not evicted to make room for later ones, so
+ * all non-NULL entries of routes stay valid.
+ * Returns the number of routes added.
+ */
+int
+uip_ds6_route_add_batch(uip_ipaddr_t *ipaddrs, const uint8_t *lengths,
+                        int count, uip_ipaddr_t *nexthop,
+                        uip_ds6_route_t **routes)
+{
+  int added;
+  int i;
+#if (UIP_CONF_MAX_ROUTES != 0)
+  const uip_lladdr_t *nexthop_lladdr = uip_ds6_nbr_lladdr_from_ipaddr(nexthop);
+#endif /* (UIP_CONF_MAX_ROUTES != 0) */
+
+  added = 0;
+  for(i = 0; i < count; i++) {
+    routes[i] = NULL;
+#if (UIP_CONF_MAX_ROUTES != 0)
+    if(nexthop_lladdr != NULL) {
+      routes[i] = route_add(&ipaddrs[i], lengths[i], nexthop, nexthop_lladdr,
+                            routes, i);
+    }
+#endif /* (UIP_CONF_MAX_ROUTES != 0) */
+    if(routes[i] != NULL) {
+      added++;
+    }
+  }
+  return added;
+}
 
 /*---------------------------------------------------------------------------*/
 void
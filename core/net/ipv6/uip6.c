@@ -74,6 +74,7 @@
 #include "sys/cc.h"
 #include "net/ip/uip.h"
 #include "net/ip/uip_arch.h"
+#include "net/ip/uip-chksum.h"
 #include "net/ip/uipopt.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/uip-nd6.h"
@@ -318,41 +319,10 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
-static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
-{
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {   /* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
-    dataptr += 2;
-  }
-
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
-  }
-
-  /* Return sum in host byte order. */
-  return sum;
-}
-/*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
 {
-  return uip_htons(chksum(0, (uint8_t *)data, len));
+  return uip_htons(uip_chksum_add(0, (uint8_t *)data, len));
 }
 /*---------------------------------------------------------------------------*/
 #ifndef UIP_ARCH_IPCHKSUM
@@ -361,7 +331,7 @@ uip_ipchksum(void)
 {
   uint16_t sum;
 
-  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  sum = uip_chksum_add(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
   PRINTF("uip_ipchksum: sum 0x%04x\n", sum);
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -391,11 +361,12 @@ upper_layer_chksum(uint8_t proto)
   /* IP protocol and length fields. This addition cannot carry. */
   sum = upper_layer_len + proto;
   /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+  sum = uip_chksum_add(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr,
+                       2 * sizeof(uip_ipaddr_t));
 
   /* Sum TCP header and data. */
-  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
-               upper_layer_len);
+  sum = uip_chksum_add(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
+                       upper_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -424,6 +395,121 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_CONN_HASH_SIZE
+/*
+ * The connection hash tables chain the entries of uip_conns[],
+ * uip_udp_conns[] and uip_listenports[] by index. TCP connections are
+ * hashed on their local port, remote port and remote address, which
+ * only uIP sets. Closed connections are left in their chain until the
+ * entry is reused, and lookups skip them. UDP connections may have
+ * their remote port and address changed by the application and may
+ * leave them unspecified, so they are hashed on their local port only
+ * and chained in index order, which keeps the first match the same as
+ * with a linear search.
+ */
+#define HASH_NONE 0xffff
+
+#if UIP_TCP
+static uint16_t tcp_hash_head[UIP_CONN_HASH_SIZE];
+static uint16_t tcp_hash_next[UIP_CONNS];
+static uint16_t listen_hash_head[UIP_CONN_HASH_SIZE];
+static uint16_t listen_hash_next[UIP_LISTENPORTS];
+#endif /* UIP_TCP */
+#if UIP_UDP
+static uint16_t udp_hash_head[UIP_CONN_HASH_SIZE];
+static uint16_t udp_hash_next[UIP_UDP_CONNS];
+#endif /* UIP_UDP */
+/*---------------------------------------------------------------------------*/
+static uint16_t
+conn_hash(uint16_t lport, uint16_t rport, const uip_ipaddr_t *ripaddr)
+{
+  uint16_t h;
+  int i;
+
+  h = lport ^ rport;
+  if(ripaddr != NULL) {
+    for(i = 0; i < 8; i++) {
+      h = (h << 5) + (h >> 11) + ripaddr->u16[i];
+    }
+  }
+  return (h ^ (h >> 8)) % UIP_CONN_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+/* Unlink entry i from the chain starting at head, if it is there. */
+static void
+hash_unlink(uint16_t *head, uint16_t *next, uint16_t i)
+{
+  while(*head != HASH_NONE) {
+    if(*head == i) {
+      *head = next[i];
+      next[i] = HASH_NONE;
+      return;
+    }
+    head = &next[*head];
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Link entry i into the chain starting at head, in index order. */
+static void
+hash_link(uint16_t *head, uint16_t *next, uint16_t i)
+{
+  while(*head != HASH_NONE && *head < i) {
+    head = &next[*head];
+  }
+  next[i] = *head;
+  *head = i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+conn_hash_init(void)
+{
+  int c;
+
+  for(c = 0; c < UIP_CONN_HASH_SIZE; ++c) {
+#if UIP_TCP
+    tcp_hash_head[c] = HASH_NONE;
+    listen_hash_head[c] = HASH_NONE;
+#endif /* UIP_TCP */
+#if UIP_UDP
+    udp_hash_head[c] = HASH_NONE;
+#endif /* UIP_UDP */
+  }
+#if UIP_TCP
+  for(c = 0; c < UIP_CONNS; ++c) {
+    tcp_hash_next[c] = HASH_NONE;
+  }
+  for(c = 0; c < UIP_LISTENPORTS; ++c) {
+    listen_hash_next[c] = HASH_NONE;
+  }
+#endif /* UIP_TCP */
+#if UIP_UDP
+  for(c = 0; c < UIP_UDP_CONNS; ++c) {
+    udp_hash_next[c] = HASH_NONE;
+  }
+#endif /* UIP_UDP */
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+/* Called before the connection's ports and remote address are
+   changed, with the connection's old values still in place. */
+static void
+tcp_hash_remove(struct uip_conn *conn)
+{
+  hash_unlink(&tcp_hash_head[conn_hash(conn->lport, conn->rport,
+                                       &conn->ripaddr)],
+              tcp_hash_next, conn - uip_conns);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_hash_add(struct uip_conn *conn)
+{
+  hash_link(&tcp_hash_head[conn_hash(conn->lport, conn->rport,
+                                     &conn->ripaddr)],
+            tcp_hash_next, conn - uip_conns);
+}
+#endif /* UIP_TCP */
+#endif /* UIP_CONN_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -452,6 +538,10 @@ uip_init(void)
   }
 #endif /* UIP_UDP */
 
+#if UIP_CONN_HASH_SIZE
+  conn_hash_init();
+#endif /* UIP_CONN_HASH_SIZE */
+
 #if UIP_IPV6_MULTICAST
   UIP_MCAST6.init();
 #endif
@@ -501,6 +591,10 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
 
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_remove(conn);
+#endif /* UIP_CONN_HASH_SIZE */
+
   conn->tcpstateflags = UIP_SYN_SENT;
 
   conn->snd_nxt[0] = iss[0];
@@ -517,6 +611,9 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
 
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
+#if UIP_TCP_SEND_WINDOW > 1
+  conn->sndbuf = NULL;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
   conn->sa = 0;
@@ -524,6 +621,9 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_add(conn);
+#endif /* UIP_CONN_HASH_SIZE */
 
   return conn;
 }
@@ -586,7 +686,11 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
 
+#if UIP_CONN_HASH_SIZE
+  uip_udp_bind_port(conn, UIP_HTONS(lastport));
+#else /* UIP_CONN_HASH_SIZE */
   conn->lport = UIP_HTONS(lastport);
+#endif /* UIP_CONN_HASH_SIZE */
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -597,6 +701,23 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
 
   return conn;
 }
+/*---------------------------------------------------------------------------*/
+#if UIP_CONN_HASH_SIZE
+void
+uip_udp_bind_port(struct uip_udp_conn *conn, uint16_t port)
+{
+  uint16_t i = conn - uip_udp_conns;
+
+  if(conn->lport != 0) {
+    hash_unlink(&udp_hash_head[conn_hash(conn->lport, 0, NULL)],
+                udp_hash_next, i);
+  }
+  conn->lport = port;
+  if(port != 0) {
+    hash_link(&udp_hash_head[conn_hash(port, 0, NULL)], udp_hash_next, i);
+  }
+}
+#endif /* UIP_CONN_HASH_SIZE */
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP
@@ -607,6 +728,10 @@ uip_unlisten(uint16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == port) {
       uip_listenports[c] = 0;
+#if UIP_CONN_HASH_SIZE
+      hash_unlink(&listen_hash_head[conn_hash(port, 0, NULL)],
+                  listen_hash_next, c);
+#endif /* UIP_CONN_HASH_SIZE */
       return;
     }
   }
@@ -619,6 +744,10 @@ uip_listen(uint16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == 0) {
       uip_listenports[c] = port;
+#if UIP_CONN_HASH_SIZE
+      hash_link(&listen_hash_head[conn_hash(port, 0, NULL)],
+                listen_hash_next, c);
+#endif /* UIP_CONN_HASH_SIZE */
       return;
     }
   }
@@ -850,8 +979,157 @@ uip_add_rcv_nxt(uint16_t n)
   uip_conn->rcv_nxt[2] = uip_acc32[2];
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
+/*---------------------------------------------------------------------------*/
+static void
+uip_rtt_estimate(struct uip_conn *conn, signed char m)
+{
+  /* This is taken directly from VJs original code in his paper */
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
 #endif
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+#define SND_OFFSET_NONE 0xffff
+
+/* Offset into the send buffer of the data in the segment being sent,
+   or SND_OFFSET_NONE if the segment carries no buffered data. */
+static uint16_t snd_offset = SND_OFFSET_NONE;
+/*---------------------------------------------------------------------------*/
+/* Copy len bytes, starting offset bytes after the oldest queued byte,
+   out of the ring of a send buffer. */
+static void
+sndbuf_copy(struct uip_tcp_sndbuf *buf, uint16_t offset, uint8_t *dst,
+            uint16_t len)
+{
+  uint16_t pos;
+  uint16_t n;
+
+  pos = buf->head + offset;
+  if(pos >= buf->size) {
+    pos -= buf->size;
+  }
+  n = MIN(len, buf->size - pos);
+  memcpy(dst, &buf->data[pos], n);
+  memcpy(&dst[n], buf->data, len - n);
+}
+/*---------------------------------------------------------------------------*/
+/* Copy the next segment of the connection's send buffer into the
+   packet buffer and account for it as being in flight. Returns the
+   length of the segment, or zero if nothing can be sent. */
+static uint16_t
+sndbuf_next(struct uip_conn *conn)
+{
+  struct uip_tcp_sndbuf *buf = conn->sndbuf;
+  uint16_t len;
+
+  len = uip_tcp_sndbuf_window(conn);
+  if(len > 0) {
+    sndbuf_copy(buf, conn->len, uip_sappdata, len);
+    snd_offset = conn->len;
+    conn->len += len;
+    if(conn->len > buf->high) {
+      buf->high = conn->len;
+    }
+    /* Time one segment at a time, but never a retransmitted one. */
+    if(buf->rtt_end == 0 && conn->nrtx == 0) {
+      buf->rtt_end = conn->len;
+      buf->rtt_ticks = 0;
+    }
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Copy the oldest unacknowledged segment of the connection's send
+   buffer into the packet buffer. Returns the length of the segment. */
+static uint16_t
+sndbuf_rexmit(struct uip_conn *conn)
+{
+  uint16_t len;
+
+  len = MIN(conn->len, conn->mss);
+  sndbuf_copy(conn->sndbuf, 0, uip_sappdata, len);
+  snd_offset = 0;
+  conn->sndbuf->rtt_end = 0;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Process the acknowledgment number and window of an incoming segment
+   on a connection with a send buffer. Sets UIP_ACKDATA if new data was
+   acknowledged. Returns non-zero if the oldest segment should be
+   retransmitted because of duplicate ACKs. */
+static uint8_t
+sndbuf_ack(struct uip_conn *conn)
+{
+  struct uip_tcp_sndbuf *buf = conn->sndbuf;
+  uint32_t acked;
+  uint16_t wnd;
+  uint8_t rexmit;
+
+  acked = (((uint32_t)UIP_TCP_BUF->ackno[0] << 24) |
+           ((uint32_t)UIP_TCP_BUF->ackno[1] << 16) |
+           ((uint32_t)UIP_TCP_BUF->ackno[2] << 8) |
+           UIP_TCP_BUF->ackno[3]) -
+          (((uint32_t)conn->snd_nxt[0] << 24) |
+           ((uint32_t)conn->snd_nxt[1] << 16) |
+           ((uint32_t)conn->snd_nxt[2] << 8) |
+           conn->snd_nxt[3]);
+  wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+  rexmit = 0;
+
+  if(acked > 0 && acked <= buf->high) {
+    uip_add32(conn->snd_nxt, (uint16_t)acked);
+    conn->snd_nxt[0] = uip_acc32[0];
+    conn->snd_nxt[1] = uip_acc32[1];
+    conn->snd_nxt[2] = uip_acc32[2];
+    conn->snd_nxt[3] = uip_acc32[3];
+
+    /* Drop the acknowledged data from the buffer. */
+    buf->len -= acked;
+    buf->head += acked;
+    if(buf->head >= buf->size) {
+      buf->head -= buf->size;
+    }
+    buf->high -= acked;
+    conn->len = acked < conn->len ? conn->len - acked : 0;
+
+    if(buf->rtt_end > 0) {
+      if(acked >= buf->rtt_end) {
+        uip_rtt_estimate(conn, buf->rtt_ticks);
+        buf->rtt_end = 0;
+      } else {
+        buf->rtt_end -= acked;
+      }
+    }
+
+    if(buf->cwnd < UIP_TCP_SEND_WINDOW) {
+      ++buf->cwnd;
+    }
+    buf->dupacks = 0;
+    conn->nrtx = 0;
+    conn->timer = conn->rto;
+    uip_flags = UIP_ACKDATA;
+  } else if(acked == 0 && uip_len == 0 && wnd == buf->wnd &&
+            uip_outstanding(conn) &&
+            (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0) {
+    /* A duplicate ACK signals that a segment has been lost while
+       later ones got through. */
+    if(++buf->dupacks == UIP_TCP_DUPACK_THRESHOLD) {
+      buf->cwnd = buf->cwnd > 2 ? buf->cwnd / 2 : 1;
+      rexmit = 1;
+    }
+  }
+  buf->wnd = wnd;
+  return rexmit;
+}
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 
 /**
  * \brief Process the options in Destination and Hop By Hop extension headers
@@ -946,6 +1224,9 @@ uip_process(uint8_t flag)
   uint8_t opt;
   register struct uip_conn *uip_connr = uip_conn;
 #endif /* UIP_TCP */
+#if UIP_CONN_HASH_SIZE
+  uint16_t i;
+#endif /* UIP_CONN_HASH_SIZE */
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
     goto udp_send;
@@ -971,6 +1252,11 @@ uip_process(uint8_t flag)
     }
     goto drop;
 #endif /* UIP_TCP */
+#if UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+    /* Check if we were invoked to send more of a send buffer. */
+  } else if(flag == UIP_TCP_SEND_SEGMENT) {
+    goto sndbuf_send;
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
     /* Check if we were invoked because of the perodic timer fireing. */
   } else if(flag == UIP_TIMER) {
     /* Reset the length variables. */
@@ -1006,6 +1292,12 @@ uip_process(uint8_t flag)
        * in which case we retransmit.
        */
       if(uip_outstanding(uip_connr)) {
+#if UIP_TCP_SEND_WINDOW > 1
+        if(uip_connr->sndbuf != NULL && uip_connr->sndbuf->rtt_end > 0 &&
+           uip_connr->sndbuf->rtt_ticks < 0x7f) {
+          ++uip_connr->sndbuf->rtt_ticks;
+        }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         if(uip_connr->timer-- == 0) {
           if(uip_connr->nrtx == UIP_MAXRTX ||
              ((uip_connr->tcpstateflags == UIP_SYN_SENT ||
@@ -1054,6 +1346,20 @@ uip_process(uint8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 
           case UIP_ESTABLISHED:
+#if UIP_TCP_SEND_WINDOW > 1
+            if(uip_connr->sndbuf != NULL) {
+              /*
+               * With a send buffer, we go back to the oldest
+               * unacknowledged byte and resend from the buffer,
+               * starting over with a window of one segment.
+               */
+              uip_connr->len = 0;
+              uip_connr->sndbuf->cwnd = 1;
+              uip_connr->sndbuf->dupacks = 0;
+              uip_connr->sndbuf->rtt_end = 0;
+              goto sndbuf_send;
+            }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
             /*
              * In the ESTABLISHED state, we call upon the application
              * to do the actual retransmit after which we jump into
@@ -1503,9 +1809,17 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_CONN_HASH_SIZE
+  /* Only the connections bound to the destination port need to be
+     checked. */
+  for(i = udp_hash_head[conn_hash(UIP_UDP_BUF->destport, 0, NULL)];
+      i != HASH_NONE; i = udp_hash_next[i]) {
+    uip_udp_conn = &uip_udp_conns[i];
+#else /* UIP_CONN_HASH_SIZE */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
+#endif /* UIP_CONN_HASH_SIZE */
     /* If the local UDP port is non-zero, the connection is considered
        to be used. If so, the local port number is checked against the
        destination port number in the received packet. If the two port
@@ -1607,8 +1921,16 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH_SIZE
+  for(i = tcp_hash_head[conn_hash(UIP_TCP_BUF->destport,
+                                  UIP_TCP_BUF->srcport,
+                                  &UIP_IP_BUF->srcipaddr)];
+      i != HASH_NONE; i = tcp_hash_next[i]) {
+    uip_connr = &uip_conns[i];
+#else /* UIP_CONN_HASH_SIZE */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_CONN_HASH_SIZE */
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
@@ -1627,7 +1949,12 @@ uip_process(uint8_t flag)
 
   tmp16 = UIP_TCP_BUF->destport;
   /* Next, check listening connections. */
+#if UIP_CONN_HASH_SIZE
+  for(c = listen_hash_head[conn_hash(tmp16, 0, NULL)];
+      c != HASH_NONE; c = listen_hash_next[c]) {
+#else /* UIP_CONN_HASH_SIZE */
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
+#endif /* UIP_CONN_HASH_SIZE */
     if(tmp16 == uip_listenports[c]) {
       goto found_listen;
     }
@@ -1722,15 +2049,24 @@ uip_process(uint8_t flag)
     goto drop;
   }
   uip_conn = uip_connr;
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_remove(uip_connr);
+#endif /* UIP_CONN_HASH_SIZE */
 
   /* Fill in the necessary fields for the new connection. */
   uip_connr->rto = uip_connr->timer = UIP_RTO;
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_connr->sndbuf = NULL;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   uip_connr->lport = UIP_TCP_BUF->destport;
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_add(uip_connr);
+#endif /* UIP_CONN_HASH_SIZE */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
   uip_connr->snd_nxt[0] = iss[0];
@@ -1856,7 +2192,21 @@ uip_process(uint8_t flag)
   /* Next, check if the incoming segment acknowledges any outstanding
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
-     retransmission timer. */
+     retransmission timer. Connections with a send buffer may have
+     several segments in flight, so these accept partial ACKs and
+     count duplicate ones. */
+#if UIP_TCP_SEND_WINDOW > 1
+  if(uip_connr->sndbuf != NULL &&
+     (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+    if((UIP_TCP_BUF->flags & TCP_ACK) && sndbuf_ack(uip_connr)) {
+      /* Fast retransmit. */
+      UIP_STAT(++uip_stat.tcp.rexmit);
+      uip_len = sndbuf_rexmit(uip_connr) + UIP_TCPIP_HLEN;
+      UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+      goto tcp_send_noopts;
+    }
+  } else
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1872,18 +2222,7 @@ uip_process(uint8_t flag)
 
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-        signed char m;
-        m = uip_connr->rto - uip_connr->timer;
-        /* This is taken directly from VJs original code in his paper */
-        m = m - (uip_connr->sa >> 3);
-        uip_connr->sa += m;
-        if(m < 0) {
-          m = -m;
-        }
-        m = m - (uip_connr->sv >> 2);
-        uip_connr->sv += m;
-        uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+        uip_rtt_estimate(uip_connr, uip_connr->rto - uip_connr->timer);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -2104,6 +2443,27 @@ uip_process(uint8_t flag)
         goto tcp_send_nodata;
       }
 
+#if UIP_TCP_SEND_WINDOW > 1
+      /* With a send buffer, the data is taken from the buffer rather
+         than from uip_send(). */
+      if(uip_connr->sndbuf != NULL) {
+        uip_slen = 0;
+        sndbuf_send:
+        tmp16 = sndbuf_next(uip_connr);
+        if(tmp16 > 0) {
+          uip_len = tmp16 + UIP_TCPIP_HLEN;
+          UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+          goto tcp_send_noopts;
+        }
+        if(uip_flags & UIP_NEWDATA) {
+          uip_len = UIP_TCPIP_HLEN;
+          UIP_TCP_BUF->flags = TCP_ACK;
+          goto tcp_send_noopts;
+        }
+        goto drop;
+      }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
 
@@ -2249,10 +2609,28 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->ackno[2] = uip_connr->rcv_nxt[2];
   UIP_TCP_BUF->ackno[3] = uip_connr->rcv_nxt[3];
 
-  UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
-  UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
-  UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
-  UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_SEND_WINDOW > 1
+  if(uip_connr->sndbuf != NULL &&
+     (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+    /* Segments from the send buffer start at their offset in the
+       buffer, and all other segments follow the data in flight. */
+    uip_add32(uip_connr->snd_nxt, snd_offset != SND_OFFSET_NONE ?
+              snd_offset : uip_connr->len);
+    UIP_TCP_BUF->seqno[0] = uip_acc32[0];
+    UIP_TCP_BUF->seqno[1] = uip_acc32[1];
+    UIP_TCP_BUF->seqno[2] = uip_acc32[2];
+    UIP_TCP_BUF->seqno[3] = uip_acc32[3];
+  } else
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+  {
+    UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
+    UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
+    UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
+    UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+  }
+#if UIP_TCP_SEND_WINDOW > 1
+  snd_offset = SND_OFFSET_NONE;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   UIP_TCP_BUF->srcport  = uip_connr->lport;
   UIP_TCP_BUF->destport = uip_connr->rport;
@@ -2348,4 +2726,80 @@ uip_send(const void *data, int len)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+void
+uip_tcp_sndbuf_init(struct uip_tcp_sndbuf *buf, uint8_t *data, uint16_t size)
+{
+  memset(buf, 0, sizeof(struct uip_tcp_sndbuf));
+  buf->data = data;
+  buf->size = size;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_tcp_sndbuf_attach(struct uip_conn *conn, struct uip_tcp_sndbuf *buf)
+{
+  conn->sndbuf = buf;
+  if(buf != NULL) {
+    buf->high = 0;
+    buf->wnd = conn->mss;
+    buf->rtt_end = 0;
+    buf->cwnd = UIP_TCP_SEND_WINDOW;
+    buf->dupacks = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_tcp_sndbuf_write(struct uip_tcp_sndbuf *buf, const void *data, uint16_t len)
+{
+  uint16_t pos;
+  uint16_t n;
+
+  if(len > buf->size - buf->len) {
+    len = buf->size - buf->len;
+  }
+  pos = buf->head + buf->len;
+  if(pos >= buf->size) {
+    pos -= buf->size;
+  }
+  n = MIN(len, buf->size - pos);
+  memcpy(&buf->data[pos], data, n);
+  memcpy(buf->data, (const uint8_t *)data + n, len - n);
+  buf->len += len;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_tcp_sndbuf_window(struct uip_conn *conn)
+{
+  struct uip_tcp_sndbuf *buf = conn->sndbuf;
+  uint32_t limit;
+
+  if(buf == NULL || buf->len <= conn->len ||
+     (conn->tcpstateflags & UIP_TS_MASK) != UIP_ESTABLISHED) {
+    return 0;
+  }
+
+  /* The data in flight is limited both by the congestion window and by
+     the window advertised by the peer. A zero window is probed with a
+     single segment, as without a send buffer. */
+  limit = (uint32_t)buf->cwnd * conn->mss;
+  if(buf->wnd == 0) {
+    limit = conn->mss;
+  } else if(limit > buf->wnd) {
+    limit = buf->wnd;
+  }
+  if(conn->len >= limit) {
+    return 0;
+  }
+  limit -= conn->len;
+  if(limit > buf->len - conn->len) {
+    limit = buf->len - conn->len;
+  }
+  if(limit > conn->mss) {
+    limit = conn->mss;
+  }
+  return limit;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
 /** @} */
@@ -98,6 +98,35 @@ link_stats_is_fresh(const struct link_stats *stats)
       && stats->freshness >= FRESHNESS_TARGET;
 }
 /*---------------------------------------------------------------------------*/
+/* For how long will the statistics stay fresh if the link is not used? */
+clock_time_t
+link_stats_fresh_for(const struct link_stats *stats)
+{
+  clock_time_t left;
+  clock_time_t aged;
+  uint8_t freshness;
+
+  if(!link_stats_is_fresh(stats)) {
+    return 0;
+  }
+
+  /* Until the last Tx expires... */
+  left = FRESHNESS_EXPIRATION_TIME - (clock_time() - stats->last_tx_time);
+
+  /* ...or until periodic() has halved the counter below the target */
+  if(timer_expired(&periodic_timer.etimer.timer)) {
+    aged = 0;
+  } else {
+    aged = timer_remaining(&periodic_timer.etimer.timer);
+  }
+  for(freshness = stats->freshness >> 1; freshness >= FRESHNESS_TARGET;
+      freshness >>= 1) {
+    aged += 60 * CLOCK_SECOND * FRESHNESS_HALF_LIFE;
+  }
+
+  return MIN(left, aged);
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 guess_etx_from_rssi(const struct link_stats *stats)
 {
@@ -54,6 +54,8 @@ struct link_stats {
 const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
 /* Are the statistics fresh? */
 int link_stats_is_fresh(const struct link_stats *stats);
+/* For how long will the statistics stay fresh if the link is not used? */
+clock_time_t link_stats_fresh_for(const struct link_stats *stats);
 
 /* Initializes link-stats module */
 void link_stats_init(void);
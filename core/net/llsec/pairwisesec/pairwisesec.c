@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         802.15.4 security implementation, which uses pairwise keys
+ */
+
+/**
+ * \addtogroup pairwisesec
+ * @{
+ */
+
+#include "net/llsec/pairwisesec/pairwisesec.h"
+#include "net/llsec/anti-replay.h"
+#include "net/llsec/llsec802154.h"
+#include "net/llsec/ccm-star-packetbuf.h"
+#include "net/mac/frame802154.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/nbr-table.h"
+#include "net/linkaddr.h"
+#include "lib/ccm-star.h"
+#include "lib/aes-128.h"
+#include <string.h>
+
+#ifdef PAIRWISESEC_CONF_DECORATED_FRAMER
+#define DECORATED_FRAMER PAIRWISESEC_CONF_DECORATED_FRAMER
+#else /* PAIRWISESEC_CONF_DECORATED_FRAMER */
+#define DECORATED_FRAMER framer_802154
+#endif /* PAIRWISESEC_CONF_DECORATED_FRAMER */
+
+extern const struct framer DECORATED_FRAMER;
+
+#ifdef PAIRWISESEC_CONF_SEC_LVL
+#define SEC_LVL         PAIRWISESEC_CONF_SEC_LVL
+#else /* PAIRWISESEC_CONF_SEC_LVL */
+#define SEC_LVL         2
+#endif /* PAIRWISESEC_CONF_SEC_LVL */
+
+#define WITH_ENCRYPTION (SEC_LVL & (1 << 2))
+#define MIC_LEN         LLSEC802154_MIC_LEN(SEC_LVL)
+
+#ifdef PAIRWISESEC_CONF_GROUP_KEY
+#define PAIRWISESEC_GROUP_KEY PAIRWISESEC_CONF_GROUP_KEY
+#else /* PAIRWISESEC_CONF_GROUP_KEY */
+#define PAIRWISESEC_GROUP_KEY { 0x00 , 0x01 , 0x02 , 0x03 , \
+                                0x04 , 0x05 , 0x06 , 0x07 , \
+                                0x08 , 0x09 , 0x0A , 0x0B , \
+                                0x0C , 0x0D , 0x0E , 0x0F }
+#endif /* PAIRWISESEC_CONF_GROUP_KEY */
+
+#define KEY_LENGTH      16
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else /* DEBUG */
+#define PRINTF(...)
+#endif /* DEBUG */
+
+#if LLSEC802154_USES_AUX_HEADER && SEC_LVL && LLSEC802154_USES_FRAME_COUNTER
+
+#define FLAG_HAS_KEY    0x01
+#define FLAG_SEEN       0x02
+
+struct pairwisesec_neighbor {
+  struct anti_replay_info anti_replay_info;
+  uint8_t key[KEY_LENGTH];
+  uint8_t flags;
+};
+
+/* network-wide CCM* key for broadcast frames */
+static const uint8_t group_key[KEY_LENGTH] = PAIRWISESEC_GROUP_KEY;
+NBR_TABLE(struct pairwisesec_neighbor, neighbors);
+
+/*
+ * The key CCM* was last set to. Frames exchanged with the same
+ * neighbor in a row do not call set_key at all; switching between
+ * neighbors hits the expanded-key cache of the AES driver, which
+ * LLSEC802154_CONF_PAIRWISE_KEYS sizes to the neighbor table.
+ */
+static uint8_t current_key[KEY_LENGTH];
+static uint8_t current_key_valid;
+
+/*---------------------------------------------------------------------------*/
+static void
+use_key(const uint8_t *key)
+{
+  if(current_key_valid && memcmp(current_key, key, KEY_LENGTH) == 0) {
+    return;
+  }
+  memcpy(current_key, key, KEY_LENGTH);
+  current_key_valid = 1;
+  CCM_STAR.set_key(key);
+}
+/*---------------------------------------------------------------------------*/
+/* Wipes a key that is no longer used, also from the AES key cache */
+static void
+forget_key(uint8_t *key)
+{
+  if(current_key_valid && memcmp(current_key, key, KEY_LENGTH) == 0) {
+    current_key_valid = 0;
+  }
+  aes_128_forget_key(key);
+  memset(key, 0, KEY_LENGTH);
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the key shared with addr, or NULL if there is none */
+static const uint8_t *
+get_key(const linkaddr_t *addr)
+{
+  struct pairwisesec_neighbor *n;
+
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    return group_key;
+  }
+  n = nbr_table_get_from_lladdr(neighbors, addr);
+  if(!n || !(n->flags & FLAG_HAS_KEY)) {
+    return NULL;
+  }
+  return n->key;
+}
+/*---------------------------------------------------------------------------*/
+int
+pairwisesec_set_key(const linkaddr_t *addr, const uint8_t *key)
+{
+  struct pairwisesec_neighbor *n;
+
+  n = nbr_table_get_from_lladdr(neighbors, addr);
+  if(!n) {
+    n = nbr_table_add_lladdr(neighbors, addr, NBR_TABLE_REASON_LLSEC, NULL);
+    if(!n) {
+      PRINTF("pairwisesec: could not add neighbor\n");
+      return 0;
+    }
+    n->flags = 0;
+  }
+  /* Neighbors with a key must not be evicted */
+  if(!nbr_table_lock(neighbors, n)) {
+    if(!(n->flags & FLAG_SEEN)) {
+      nbr_table_remove(neighbors, n);
+    }
+    PRINTF("pairwisesec: could not lock\n");
+    return 0;
+  }
+  if((n->flags & FLAG_HAS_KEY) && memcmp(n->key, key, KEY_LENGTH) != 0) {
+    forget_key(n->key);
+  }
+  memcpy(n->key, key, KEY_LENGTH);
+  n->flags |= FLAG_HAS_KEY;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+pairwisesec_remove_key(const linkaddr_t *addr)
+{
+  struct pairwisesec_neighbor *n;
+
+  n = nbr_table_get_from_lladdr(neighbors, addr);
+  if(!n) {
+    return;
+  }
+  if(n->flags & FLAG_HAS_KEY) {
+    forget_key(n->key);
+    n->flags &= ~FLAG_HAS_KEY;
+  }
+  /*
+   * The entry of a neighbor we received from stays locked, so that its
+   * anti-replay information survives until a key is installed again.
+   */
+  if(!(n->flags & FLAG_SEEN)) {
+    nbr_table_remove(neighbors, n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+aead(uint8_t hdrlen, int forward)
+{
+  uint8_t totlen;
+  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+  uint8_t *m;
+  uint8_t m_len;
+  uint8_t *a;
+  uint8_t a_len;
+  uint8_t *result;
+  uint8_t generated_mic[MIC_LEN];
+  uint8_t *mic;
+
+  ccm_star_packetbuf_set_nonce(nonce, forward);
+  totlen = packetbuf_totlen();
+  a = packetbuf_hdrptr();
+#if WITH_ENCRYPTION
+  a_len = hdrlen;
+  m = a + a_len;
+  m_len = totlen - hdrlen;
+#else /* WITH_ENCRYPTION */
+  a_len = totlen;
+  m = NULL;
+  m_len = 0;
+#endif /* WITH_ENCRYPTION */
+
+  mic = a + totlen;
+  result = forward ? mic : generated_mic;
+
+  CCM_STAR.aead(nonce,
+      m, m_len,
+      a, a_len,
+      result, MIC_LEN,
+      forward);
+
+  if(forward) {
+    packetbuf_set_datalen(packetbuf_datalen() + MIC_LEN);
+    return 1;
+  } else {
+    return (memcmp(generated_mic, mic, MIC_LEN) == 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_security_header(void)
+{
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+  packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, SEC_LVL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send(mac_callback_t sent, void *ptr)
+{
+  if(!get_key(packetbuf_addr(PACKETBUF_ADDR_RECEIVER))) {
+    PRINTF("pairwisesec: no key for receiver\n");
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+    return;
+  }
+  add_security_header();
+  anti_replay_set_counter();
+  NETSTACK_MAC.send(sent, ptr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+create(void)
+{
+  int result;
+  const uint8_t *key;
+
+  key = get_key(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  if(!key) {
+    return FRAMER_FAILED;
+  }
+
+  result = DECORATED_FRAMER.create();
+  if(result == FRAMER_FAILED) {
+    return result;
+  }
+
+  use_key(key);
+  aead(result, 1);
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse(void)
+{
+  int result;
+  const linkaddr_t *sender;
+  const uint8_t *key;
+  struct pairwisesec_neighbor *n;
+
+  result = DECORATED_FRAMER.parse();
+  if(result == FRAMER_FAILED) {
+    return result;
+  }
+
+  if(packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL) != SEC_LVL) {
+    PRINTF("pairwisesec: received frame with wrong security level\n");
+    return FRAMER_FAILED;
+  }
+  sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  if(linkaddr_cmp(sender, &linkaddr_node_addr)) {
+    PRINTF("pairwisesec: frame from ourselves\n");
+    return FRAMER_FAILED;
+  }
+
+  key = packetbuf_holds_broadcast() ? group_key : get_key(sender);
+  if(!key) {
+    PRINTF("pairwisesec: no key for sender\n");
+    return FRAMER_FAILED;
+  }
+
+  packetbuf_set_datalen(packetbuf_datalen() - MIC_LEN);
+
+  use_key(key);
+  if(!aead(result, 0)) {
+    PRINTF("pairwisesec: received unauthentic frame %lu\n",
+        anti_replay_get_counter());
+    return FRAMER_FAILED;
+  }
+
+  n = nbr_table_get_from_lladdr(neighbors, sender);
+  if(!n) {
+    n = nbr_table_add_lladdr(neighbors, sender, NBR_TABLE_REASON_LLSEC, NULL);
+    if(!n) {
+      PRINTF("pairwisesec: could not get nbr_table_item\n");
+      return FRAMER_FAILED;
+    }
+    n->flags = 0;
+
+    /* As in noncoresec, locking avoids replays after eviction. */
+    if(!nbr_table_lock(neighbors, n)) {
+      nbr_table_remove(neighbors, n);
+      PRINTF("pairwisesec: could not lock\n");
+      return FRAMER_FAILED;
+    }
+  }
+
+  if(!(n->flags & FLAG_SEEN)) {
+    anti_replay_init_info(&n->anti_replay_info);
+    n->flags |= FLAG_SEEN;
+  } else if(anti_replay_was_replayed(&n->anti_replay_info)) {
+    PRINTF("pairwisesec: received replayed frame %lu\n",
+        anti_replay_get_counter());
+    return FRAMER_FAILED;
+  }
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
+{
+  NETSTACK_NETWORK.input();
+}
+/*---------------------------------------------------------------------------*/
+static int
+length(void)
+{
+  add_security_header();
+  return DECORATED_FRAMER.length() + MIC_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  current_key_valid = 0;
+  nbr_table_register(neighbors, NULL);
+}
+/*---------------------------------------------------------------------------*/
+const struct llsec_driver pairwisesec_driver = {
+  "pairwisesec",
+  init,
+  send,
+  input
+};
+/*---------------------------------------------------------------------------*/
+const struct framer pairwisesec_framer = {
+  length,
+  create,
+  parse
+};
+/*---------------------------------------------------------------------------*/
+#endif /* LLSEC802154_USES_AUX_HEADER && SEC_LVL && LLSEC802154_USES_FRAME_COUNTER */
+
+/** @} */
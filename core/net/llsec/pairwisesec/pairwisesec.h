@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         802.15.4 security implementation, which uses pairwise keys
+ */
+
+/**
+ * \addtogroup llsec
+ * @{
+ */
+
+/**
+ * \defgroup pairwisesec LLSEC driver using pairwise keys (PAIRWISESEC)
+ *
+ * 802.15.4 security with a key per link. Unicast frames are secured
+ * with the key shared with the receiver, broadcast frames with a
+ * network-wide group key. Keys are installed by the application, for
+ * instance after a key exchange, with pairwisesec_set_key().
+ *
+ * @{
+ */
+
+#ifndef PAIRWISESEC_H_
+#define PAIRWISESEC_H_
+
+#include "net/llsec/llsec.h"
+#include "net/linkaddr.h"
+
+/**
+ * \brief      Installs the key shared with a neighbor
+ * \param addr Link-layer address of the neighbor
+ * \param key  The 16-byte key
+ * \retval 1   The key was installed
+ * \retval 0   The neighbor table is full
+ */
+int pairwisesec_set_key(const linkaddr_t *addr, const uint8_t *key);
+
+/**
+ * \brief      Removes the key shared with a neighbor
+ *
+ *             Frames from and to the neighbor are dropped until a new
+ *             key is installed. The key is wiped, also from the key
+ *             cache of the AES driver. The anti-replay information is
+ *             kept, and the neighbor stays locked in the neighbor table
+ *             for it, so that frames received under the old key cannot
+ *             be replayed once a key is installed again.
+ */
+void pairwisesec_remove_key(const linkaddr_t *addr);
+
+extern const struct llsec_driver pairwisesec_driver;
+extern const struct framer pairwisesec_framer;
+
+#endif /* PAIRWISESEC_H_ */
+
+/** @} */
+/** @} */
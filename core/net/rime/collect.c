@@ -65,20 +65,58 @@ static const struct packetbuf_attrlist attributes[] =
   };
 
 
-/* The recent_packets list holds the sequence number, the originator,
-   and the connection for packets that have been recently
-   forwarded. This list is maintained to avoid forwarding duplicate
-   packets. */
-#define NUM_RECENT_PACKETS 16
+/* The sources table holds, for each originator that we have recently
+   received packets from, a window of the sequence numbers seen. It is
+   used to avoid forwarding or delivering duplicate packets and to
+   count lost packets. Entries are found through a hash table on the
+   originator address and are recycled in least recently used
+   order. */
+#ifdef COLLECT_CONF_MAX_SOURCES
+#define MAX_SOURCES COLLECT_CONF_MAX_SOURCES
+#else /* COLLECT_CONF_MAX_SOURCES */
+#define MAX_SOURCES 16
+#endif /* COLLECT_CONF_MAX_SOURCES */
+
+#ifdef COLLECT_CONF_SOURCE_HASH_SIZE
+#define SOURCE_HASH_SIZE COLLECT_CONF_SOURCE_HASH_SIZE
+#else /* COLLECT_CONF_SOURCE_HASH_SIZE */
+#define SOURCE_HASH_SIZE 8
+#endif /* COLLECT_CONF_SOURCE_HASH_SIZE */
+
+#if (SOURCE_HASH_SIZE & (SOURCE_HASH_SIZE - 1)) != 0
+#error COLLECT_CONF_SOURCE_HASH_SIZE must be a power of two
+#endif
+
+#define SEQNO_SPACE  (1 << COLLECT_PACKET_ID_BITS)
+#define SEQNO_MASK   (SEQNO_SPACE - 1)
+/* The window covers at most a quarter of the sequence number space,
+   i.e. half of the part that is used after wrapping. */
+#define SEQNO_WINDOW (SEQNO_SPACE / 4 < 32 ? SEQNO_SPACE / 4 : 32)
 
-struct recent_packet {
+struct source {
+  struct source *next;
   struct collect_conn *conn;
   linkaddr_t originator;
-  uint8_t eseqno;
+  /* Bit i is set if sequence number last - i has been seen. */
+  uint32_t window;
+  struct collect_source_stats stats;
+  uint16_t lru;
+  uint8_t last;
 };
 
-static struct recent_packet recent_packets[NUM_RECENT_PACKETS];
-static uint8_t recent_packet_ptr;
+static struct source sources[MAX_SOURCES];
+static struct source *source_table[SOURCE_HASH_SIZE];
+static uint16_t source_clock;
+
+#ifdef COLLECT_CONF_BATCH_DELAY
+#define BATCH_DELAY COLLECT_CONF_BATCH_DELAY
+#else /* COLLECT_CONF_BATCH_DELAY */
+#define BATCH_DELAY (CLOCK_SECOND / 8)
+#endif /* COLLECT_CONF_BATCH_DELAY */
+
+/* Queuebufs left free when collecting a batch, so that the sink can
+   still send ACKs. */
+#define BATCH_MIN_FREE_QUEUEBUFS 2
 
 
 /* This is the header of data packets. The header comtains the routing
@@ -903,20 +941,246 @@ send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
   stats.acksent++;
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t
+source_hash(const linkaddr_t *addr)
+{
+  uint8_t h = 0;
+  int i;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + addr->u8[i];
+  }
+  return h & (SOURCE_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static struct source *
+source_find(struct collect_conn *tc, const linkaddr_t *originator)
+{
+  struct source *s;
+
+  for(s = source_table[source_hash(originator)]; s != NULL; s = s->next) {
+    if(s->conn == tc && linkaddr_cmp(&s->originator, originator)) {
+      return s;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+source_remove(struct source *s)
+{
+  struct source **sp;
+
+  for(sp = &source_table[source_hash(&s->originator)]; *sp != NULL;
+      sp = &(*sp)->next) {
+    if(*sp == s) {
+      *sp = s->next;
+      break;
+    }
+  }
+  s->conn = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct source *
+source_new(struct collect_conn *tc, const linkaddr_t *originator)
+{
+  struct source *s, *oldest;
+  uint8_t h;
+  int i;
+
+  /* Use a free entry if there is one, otherwise the one that has been
+     unused for the longest time. */
+  oldest = &sources[0];
+  for(i = 0; i < MAX_SOURCES; i++) {
+    s = &sources[i];
+    if(s->conn == NULL) {
+      oldest = s;
+      break;
+    }
+    if((uint16_t)(source_clock - s->lru) >
+       (uint16_t)(source_clock - oldest->lru)) {
+      oldest = s;
+    }
+  }
+  s = oldest;
+  if(s->conn != NULL) {
+    source_remove(s);
+  }
+
+  memset(s, 0, sizeof(struct source));
+  s->conn = tc;
+  linkaddr_copy(&s->originator, originator);
+  h = source_hash(originator);
+  s->next = source_table[h];
+  source_table[h] = s;
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sources_remove_conn(struct collect_conn *tc)
+{
+  int i;
+
+  for(i = 0; i < MAX_SOURCES; i++) {
+    if(sources[i].conn == tc) {
+      source_remove(&sources[i]);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Return how far sequence number a is ahead of b. Sequence numbers wrap
+   from SEQNO_SPACE - 1 to SEQNO_SPACE / 2 (see collect_send()), so two
+   numbers in the upper half are compared modulo SEQNO_SPACE / 2. */
+static uint8_t
+seqno_sub(uint8_t a, uint8_t b)
+{
+  if(a >= SEQNO_SPACE / 2 && b >= SEQNO_SPACE / 2) {
+    return (a - b) & (SEQNO_SPACE / 2 - 1);
+  }
+  return (a - b) & SEQNO_MASK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_duplicate(struct collect_conn *tc)
+{
+  struct source *s;
+  uint8_t back;
+
+  s = source_find(tc, packetbuf_addr(PACKETBUF_ADDR_ESENDER));
+  if(s == NULL) {
+    return 0;
+  }
+  back = seqno_sub(s->last, packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID));
+  if(back < SEQNO_WINDOW && (s->window & ((uint32_t)1 << back))) {
+    s->stats.duplicates++;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 add_packet_to_recent_packets(struct collect_conn *tc)
 {
+  struct source *s;
+  uint8_t seqno, ahead, back;
+
   /* Remember that we have seen this packet for later, but only if
      it has a length that is larger than zero. Packets with size
      zero are keepalive or proactive link estimate probes, so we do
      not record them in our history. */
-  if(packetbuf_datalen() > sizeof(struct data_msg_hdr)) {
-    recent_packets[recent_packet_ptr].eseqno =
-      packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID);
-    linkaddr_copy(&recent_packets[recent_packet_ptr].originator,
-                  packetbuf_addr(PACKETBUF_ADDR_ESENDER));
-    recent_packets[recent_packet_ptr].conn = tc;
-    recent_packet_ptr = (recent_packet_ptr + 1) % NUM_RECENT_PACKETS;
+  if(packetbuf_datalen() <= sizeof(struct data_msg_hdr)) {
+    return;
+  }
+
+  seqno = packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID);
+  s = source_find(tc, packetbuf_addr(PACKETBUF_ADDR_ESENDER));
+  if(s == NULL) {
+    s = source_new(tc, packetbuf_addr(PACKETBUF_ADDR_ESENDER));
+    s->last = seqno;
+    s->window = 1;
+  } else {
+    ahead = seqno_sub(seqno, s->last);
+    back = seqno_sub(s->last, seqno);
+    if(seqno < SEQNO_SPACE / 2 && s->last >= SEQNO_SPACE / 2 &&
+       back >= SEQNO_WINDOW) {
+      /* Once past the wrap, originators only use the upper half of
+         the sequence number space, so this originator has rebooted. */
+      s->last = seqno;
+      s->window = 1;
+    } else if(ahead != 0 && ahead < back) {
+      /* A new packet: slide the window. The packets that were skipped
+         count as lost until they show up. */
+      s->window = ahead < 32 ? (s->window << ahead) | 1 : 1;
+      s->stats.lost += ahead - 1;
+      s->last = seqno;
+    } else if(back < SEQNO_WINDOW) {
+      /* A packet that arrived out of order. */
+      if((s->window & ((uint32_t)1 << back)) == 0) {
+        s->window |= (uint32_t)1 << back;
+        if(s->stats.lost > 0) {
+          s->stats.lost--;
+        }
+      }
+    } else {
+      /* Too old to be compared with the window: start over. */
+      s->last = seqno;
+      s->window = 1;
+    }
+  }
+  s->stats.received++;
+  s->lru = ++source_clock;
+}
+/*---------------------------------------------------------------------------*/
+#if COLLECT_BATCH_SIZE > 0
+static void
+batch_flush(struct collect_conn *tc)
+{
+  int i, len;
+
+  ctimer_stop(&tc->batch_timer);
+  len = tc->batch_len;
+  if(len == 0) {
+    return;
+  }
+  /* Reset the batch before the callback so that packets that arrive
+     in the meantime start a new one. */
+  tc->batch_len = 0;
+  if(tc->cb->recv_batch != NULL) {
+    tc->cb->recv_batch(tc, tc->batch, len);
+  }
+  for(i = 0; i < len; i++) {
+    queuebuf_free(tc->batch[i].q);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+batch_timeout(void *ptr)
+{
+  batch_flush(ptr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+batch_add(struct collect_conn *tc)
+{
+  struct collect_packet *p;
+  struct queuebuf *q;
+
+  q = queuebuf_new_from_packetbuf();
+  if(q == NULL) {
+    return 0;
+  }
+  p = &tc->batch[tc->batch_len++];
+  p->q = q;
+  linkaddr_copy(&p->originator, packetbuf_addr(PACKETBUF_ADDR_ESENDER));
+  p->seqno = packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID);
+  p->hops = packetbuf_attr(PACKETBUF_ATTR_HOPS);
+
+  if(tc->batch_len == COLLECT_BATCH_SIZE ||
+     queuebuf_numfree() < BATCH_MIN_FREE_QUEUEBUFS) {
+    batch_flush(tc);
+  } else if(tc->batch_len == 1) {
+    ctimer_set(&tc->batch_timer, BATCH_DELAY, batch_timeout, tc);
+  }
+  return 1;
+}
+#endif /* COLLECT_BATCH_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+static void
+sink_deliver(struct collect_conn *tc)
+{
+#if COLLECT_BATCH_SIZE > 0
+  if(tc->cb->recv_batch != NULL) {
+    if(batch_add(tc)) {
+      return;
+    }
+    PRINTF("%d.%d: collect: no queuebuf for batch, delivering directly\n",
+           linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
+  }
+#endif /* COLLECT_BATCH_SIZE > 0 */
+  if(tc->cb->recv != NULL) {
+    tc->cb->recv(packetbuf_addr(PACKETBUF_ADDR_ESENDER),
+                 packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
+                 packetbuf_attr(PACKETBUF_ATTR_HOPS));
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -925,7 +1189,6 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
 {
   struct collect_conn *tc = (struct collect_conn *)
     ((char *)c - offsetof(struct collect_conn, unicast_conn));
-  int i;
   struct data_msg_hdr hdr;
   uint8_t ackflags = 0;
   struct collect_neighbor *n;
@@ -972,23 +1235,19 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
       ackflags |= ACK_FLAGS_CONGESTED;
     }
 
-    for(i = 0; i < NUM_RECENT_PACKETS; i++) {
-      if(recent_packets[i].conn == tc &&
-         recent_packets[i].eseqno == packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID) &&
-         linkaddr_cmp(&recent_packets[i].originator,
-                      packetbuf_addr(PACKETBUF_ADDR_ESENDER))) {
-        /* This is a duplicate of a packet we recently received, so we
-           just send an ACK. */
-        PRINTF("%d.%d: found duplicate packet from %d.%d with seqno %d, via %d.%d\n",
-               linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
-               recent_packets[i].originator.u8[0], recent_packets[i].originator.u8[1],
-               packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
-               packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[0],
-               packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[1]);
-        send_ack(tc, &ack_to, ackflags);
-        stats.duprecv++;
-        return;
-      }
+    if(is_duplicate(tc)) {
+      /* This is a duplicate of a packet we recently received, so we
+         just send an ACK. */
+      PRINTF("%d.%d: found duplicate packet from %d.%d with seqno %d, via %d.%d\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+             packetbuf_addr(PACKETBUF_ADDR_ESENDER)->u8[0],
+             packetbuf_addr(PACKETBUF_ADDR_ESENDER)->u8[1],
+             packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
+             packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[0],
+             packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[1]);
+      send_ack(tc, &ack_to, ackflags);
+      stats.duprecv++;
+      return;
     }
 
     /* If we are the sink, the packet has reached its final
@@ -1023,10 +1282,8 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
 
       packetbuf_hdrreduce(sizeof(struct data_msg_hdr));
       /* Call receive function. */
-      if(packetbuf_datalen() > 0 && tc->cb->recv != NULL) {
-        tc->cb->recv(packetbuf_addr(PACKETBUF_ADDR_ESENDER),
-                     packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
-                     packetbuf_attr(PACKETBUF_ATTR_HOPS));
+      if(packetbuf_datalen() > 0) {
+        sink_deliver(tc);
       }
       return;
     } else if(packetbuf_attr(PACKETBUF_ATTR_TTL) > 1 &&
@@ -1306,6 +1563,9 @@ collect_open(struct collect_conn *tc, uint16_t channels,
   tc->is_router = is_router;
   tc->seqno = 10;
   tc->eseqno = 0;
+#if COLLECT_BATCH_SIZE > 0
+  tc->batch_len = 0;
+#endif /* COLLECT_BATCH_SIZE > 0 */
   LIST_STRUCT_INIT(tc, send_queue_list);
   collect_neighbor_list_new(&tc->neighbor_list);
   tc->send_queue.list = &(tc->send_queue_list);
@@ -1386,6 +1646,10 @@ collect_close(struct collect_conn *tc)
   while(packetqueue_first(&tc->send_queue) != NULL) {
     packetqueue_dequeue(&tc->send_queue);
   }
+#if COLLECT_BATCH_SIZE > 0
+  batch_flush(tc);
+#endif /* COLLECT_BATCH_SIZE > 0 */
+  sources_remove_conn(tc);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -1406,6 +1670,9 @@ collect_set_sink(struct collect_conn *tc, int should_be_sink)
     ctimer_stop(&tc->retransmission_timer);
   } else {
     tc->rtmetric = RTMETRIC_MAX;
+#if COLLECT_BATCH_SIZE > 0
+    batch_flush(tc);
+#endif /* COLLECT_BATCH_SIZE > 0 */
   }
 #if COLLECT_ANNOUNCEMENTS
   announcement_set_value(&tc->announcement, tc->rtmetric);
@@ -1544,6 +1811,21 @@ collect_purge(struct collect_conn *tc)
   linkaddr_copy(&tc->parent, &linkaddr_null);
 }
 /*---------------------------------------------------------------------------*/
+int
+collect_get_source_stats(struct collect_conn *tc,
+                         const linkaddr_t *originator,
+                         struct collect_source_stats *s)
+{
+  struct source *src;
+
+  src = source_find(tc, originator);
+  if(src == NULL) {
+    return 0;
+  }
+  memcpy(s, &src->stats, sizeof(struct collect_source_stats));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 void
 collect_print_stats(void)
 {
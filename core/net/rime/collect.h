@@ -100,9 +100,40 @@
                             { PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_BIT }, \
                             UNICAST_ATTRIBUTES
 
+/* COLLECT_CONF_BATCH_SIZE defines how many packets the sink hands to
+   the recv_batch callback at a time. Batching is off by default; with
+   0 the recv_batch callback is never called. */
+#ifdef COLLECT_CONF_BATCH_SIZE
+#define COLLECT_BATCH_SIZE COLLECT_CONF_BATCH_SIZE
+#else /* COLLECT_CONF_BATCH_SIZE */
+#define COLLECT_BATCH_SIZE 0
+#endif /* COLLECT_CONF_BATCH_SIZE */
+
+struct collect_conn;
+
+/* A packet received by the sink, as handed to the recv_batch
+   callback. The payload is in the queuebuf, see queuebuf_dataptr()
+   and queuebuf_datalen(). */
+struct collect_packet {
+  struct queuebuf *q;
+  linkaddr_t originator;
+  uint8_t seqno, hops;
+};
+
 struct collect_callbacks {
   void (* recv)(const linkaddr_t *originator, uint8_t seqno,
 		uint8_t hops);
+  /* If set, the sink collects received packets and hands them to
+     this callback up to COLLECT_BATCH_SIZE at a time, instead of
+     calling recv for each of them. The queuebufs are freed when the
+     callback returns. */
+  void (* recv_batch)(struct collect_conn *c,
+                      const struct collect_packet *packets, int count);
+};
+
+/* Per-originator counters kept for duplicate detection. */
+struct collect_source_stats {
+  uint16_t received, lost, duplicates;
 };
 
 /* COLLECT_CONF_ANNOUNCEMENTS defines if the Collect implementation
@@ -141,6 +172,12 @@ struct collect_conn {
   uint8_t is_router;
 
   clock_time_t send_time;
+
+#if COLLECT_BATCH_SIZE > 0
+  struct ctimer batch_timer;
+  struct collect_packet batch[COLLECT_BATCH_SIZE];
+  uint8_t batch_len;
+#endif /* COLLECT_BATCH_SIZE > 0 */
 };
 
 enum {
@@ -164,6 +201,10 @@ void collect_set_keepalive(struct collect_conn *c, clock_time_t period);
 
 void collect_print_stats(void);
 
+int collect_get_source_stats(struct collect_conn *c,
+                             const linkaddr_t *originator,
+                             struct collect_source_stats *stats);
+
 #define COLLECT_MAX_DEPTH (COLLECT_LINK_ESTIMATE_UNIT * 64 - 1)
 
 #endif /* COLLECT_H_ */
@@ -279,6 +279,21 @@
 #define RPL_WITH_PROBING 1
 #endif
 
+/*
+ * Keep the candidate parents of each DAG in min-heaps ordered by the
+ * path cost the objective function gives them, one for all candidates
+ * and one for those with fresh link statistics, so that choosing the
+ * preferred parent does not evaluate every parent again. Each parent
+ * is re-keyed when its rank, link metric or freshness changes. Worth
+ * enabling on nodes with many candidate parents; costs two pointers
+ * per neighbor and DAG and about twenty bytes per parent.
+ */
+#ifdef RPL_CONF_WITH_PARENT_HEAP
+#define RPL_WITH_PARENT_HEAP RPL_CONF_WITH_PARENT_HEAP
+#else
+#define RPL_WITH_PARENT_HEAP 0
+#endif
+
 /*
  * RPL probing interval.
  */
@@ -227,6 +227,165 @@ rpl_parent_is_reachable(rpl_parent_t *p) {
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_PARENT_HEAP
+/*
+ * Every DAG keeps its candidate parents in a binary min-heap on their
+ * key: the parents that do not announce an infinite rank, are reachable
+ * and are acceptable to the objective function. Those of them whose
+ * link statistics are fresh are also in a second heap. A parent is
+ * moved in or out of the heaps whenever rpl_update_parent_cost() is
+ * called for it. Only freshness expires on its own; expired parents
+ * are dropped from the top of the fresh heap when it is searched.
+ */
+/*---------------------------------------------------------------------------*/
+static void
+heap_set(struct rpl_parent_heap *h, int w, uint16_t i, rpl_parent_t *p)
+{
+  h->entries[i] = p;
+  p->heap_index[w] = i + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_sift_up(struct rpl_parent_heap *h, int w, uint16_t i)
+{
+  rpl_parent_t *p = h->entries[i];
+
+  while(i > 0 && h->entries[(i - 1) / 2]->heap_key > p->heap_key) {
+    heap_set(h, w, i, h->entries[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  heap_set(h, w, i, p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_sift_down(struct rpl_parent_heap *h, int w, uint16_t i)
+{
+  rpl_parent_t *p = h->entries[i];
+  uint16_t child;
+
+  while((child = 2 * i + 1) < h->size) {
+    if(child + 1 < h->size &&
+       h->entries[child + 1]->heap_key < h->entries[child]->heap_key) {
+      child++;
+    }
+    if(h->entries[child]->heap_key >= p->heap_key) {
+      break;
+    }
+    heap_set(h, w, i, h->entries[child]);
+    i = child;
+  }
+  heap_set(h, w, i, p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(struct rpl_parent_heap *h, int w, rpl_parent_t *p)
+{
+  uint16_t i;
+
+  if(p->heap_index[w] == 0) {
+    return;
+  }
+  i = p->heap_index[w] - 1;
+  p->heap_index[w] = 0;
+  if(i != --h->size) {
+    /* Fill the hole with the last parent and restore the order */
+    heap_set(h, w, i, h->entries[h->size]);
+    if(i > 0 && h->entries[(i - 1) / 2]->heap_key > h->entries[i]->heap_key) {
+      heap_sift_up(h, w, i);
+    } else {
+      heap_sift_down(h, w, i);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Insert the parent, or restore the order after its key has changed */
+static void
+heap_update(struct rpl_parent_heap *h, int w, rpl_parent_t *p,
+            uint32_t old_key)
+{
+  if(p->heap_index[w] == 0) {
+    heap_set(h, w, h->size++, p);
+    heap_sift_up(h, w, h->size - 1);
+  } else if(p->heap_key < old_key) {
+    heap_sift_up(h, w, p->heap_index[w] - 1);
+  } else {
+    heap_sift_down(h, w, p->heap_index[w] - 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+heaps_remove(rpl_parent_t *p)
+{
+  if(p->heap_dag != NULL) {
+    heap_remove(&p->heap_dag->parent_heaps[RPL_PARENT_HEAP_CANDIDATES],
+                RPL_PARENT_HEAP_CANDIDATES, p);
+    heap_remove(&p->heap_dag->parent_heaps[RPL_PARENT_HEAP_FRESH],
+                RPL_PARENT_HEAP_FRESH, p);
+    p->heap_dag = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Freshness as of the last rpl_update_parent_cost(), without lookups */
+static int
+parent_is_fresh_cached(rpl_parent_t *p)
+{
+  return clock_time() - p->fresh_since < p->fresh_for;
+}
+#endif /* RPL_WITH_PARENT_HEAP */
+/*---------------------------------------------------------------------------*/
+void
+rpl_update_parent_cost(rpl_parent_t *p)
+{
+#if RPL_WITH_PARENT_HEAP
+  rpl_dag_t *dag;
+  rpl_of_t *of;
+  uint32_t old_key;
+
+  if(p == NULL) {
+    return;
+  }
+  dag = p->dag;
+  if(p->heap_dag != dag) {
+    heaps_remove(p);
+  }
+  if(dag == NULL || dag->instance == NULL ||
+     (of = dag->instance->of) == NULL ||
+     p->rank == INFINITE_RANK || of->best_parent(NULL, p) == NULL) {
+    heaps_remove(p);
+    return;
+  }
+#ifndef UIP_CONF_ND6_SEND_NA
+  {
+  uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
+  /* Exclude links to a neighbor that is not reachable at a NUD level */
+  if(nbr == NULL || nbr->state != NBR_REACHABLE) {
+    heaps_remove(p);
+    return;
+  }
+  }
+#endif /* UIP_CONF_ND6_SEND_NA */
+
+  /* Cache what the heap walk needs: the costs and the freshness */
+  p->fresh_since = clock_time();
+  p->fresh_for = link_stats_fresh_for(rpl_get_parent_link_stats(p));
+
+  /* Ties on the path cost go to the best link, as in OF0 */
+  old_key = p->heap_key;
+  p->heap_key = ((uint32_t)of->parent_path_cost(p) << 16) |
+    of->parent_link_metric(p);
+  p->heap_dag = dag;
+  heap_update(&dag->parent_heaps[RPL_PARENT_HEAP_CANDIDATES],
+              RPL_PARENT_HEAP_CANDIDATES, p, old_key);
+  if(p->fresh_for > 0) {
+    heap_update(&dag->parent_heaps[RPL_PARENT_HEAP_FRESH],
+                RPL_PARENT_HEAP_FRESH, p, old_key);
+  } else {
+    heap_remove(&dag->parent_heaps[RPL_PARENT_HEAP_FRESH],
+                RPL_PARENT_HEAP_FRESH, p);
+  }
+#endif /* RPL_WITH_PARENT_HEAP */
+}
+/*---------------------------------------------------------------------------*/
 static void
 rpl_set_preferred_parent(rpl_dag_t *dag, rpl_parent_t *p)
 {
@@ -670,9 +829,24 @@ rpl_free_dag(rpl_dag_t *dag)
     if((dag->prefix_info.flags & UIP_ND6_RA_FLAG_AUTONOMOUS)) {
       check_prefix(&dag->prefix_info, NULL);
     }
+  }
 
-    remove_parents(dag, 0);
+  /* Also for a DAG that was never joined, as rpl_alloc_dag() may reuse
+   * its slot for another DAG while the parents still point to it. */
+  remove_parents(dag, 0);
+#if RPL_WITH_PARENT_HEAP
+  {
+    rpl_parent_t *p;
+
+    /* The slot is reset when reused, so no parent may stay in its heaps */
+    for(p = nbr_table_head(rpl_parents); p != NULL;
+        p = nbr_table_next(rpl_parents, p)) {
+      if(p->heap_dag == dag) {
+        heaps_remove(p);
+      }
+    }
   }
+#endif /* RPL_WITH_PARENT_HEAP */
   dag->used = 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -688,6 +862,13 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
   PRINT6ADDR(addr);
   PRINTF("\n");
   if(lladdr != NULL) {
+#if RPL_WITH_PARENT_HEAP
+    /* Adding clears an existing entry, so take it out of the heaps first */
+    p = nbr_table_get_from_lladdr(rpl_parents, (linkaddr_t *)lladdr);
+    if(p != NULL) {
+      heaps_remove(p);
+    }
+#endif /* RPL_WITH_PARENT_HEAP */
     /* Add parent in rpl_parents - again this is due to DIO */
     p = nbr_table_add_lladdr(rpl_parents, (linkaddr_t *)lladdr,
                              NBR_TABLE_REASON_RPL_DIO, dio);
@@ -700,6 +881,7 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
 #if RPL_WITH_MC
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_WITH_MC */
+      rpl_update_parent_cost(p);
     }
   }
 
@@ -845,44 +1027,86 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
   return best_dag;
 }
 /*---------------------------------------------------------------------------*/
+#if !RPL_WITH_PARENT_HEAP
+static int
+parent_is_candidate(rpl_dag_t *dag, rpl_parent_t *p, int fresh_only)
+{
+  /* Exclude parents from other DAGs or announcing an infinite rank */
+  if(p->dag != dag || p->rank == INFINITE_RANK) {
+    return 0;
+  }
+
+  if(fresh_only && !rpl_parent_is_fresh(p)) {
+    /* Filter out non-fresh parents if fresh_only is set */
+    return 0;
+  }
+
+#ifndef UIP_CONF_ND6_SEND_NA
+  {
+  uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
+  /* Exclude links to a neighbor that is not reachable at a NUD level */
+  if(nbr == NULL || nbr->state != NBR_REACHABLE) {
+    return 0;
+  }
+  }
+#endif /* UIP_CONF_ND6_SEND_NA */
+
+  return 1;
+}
+#endif /* !RPL_WITH_PARENT_HEAP */
+/*---------------------------------------------------------------------------*/
 static rpl_parent_t *
 best_parent(rpl_dag_t *dag, int fresh_only)
 {
   rpl_parent_t *p;
   rpl_of_t *of;
   rpl_parent_t *best = NULL;
+#if RPL_WITH_PARENT_HEAP
+  struct rpl_parent_heap *h;
+#endif /* RPL_WITH_PARENT_HEAP */
 
   if(dag == NULL || dag->instance == NULL || dag->instance->of == NULL) {
     return NULL;
   }
 
   of = dag->instance->of;
-  /* Search for the best parent according to the OF */
-  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
-
-    /* Exclude parents from other DAGs or announcing an infinite rank */
-    if(p->dag != dag || p->rank == INFINITE_RANK) {
-      continue;
-    }
-
-    if(fresh_only && !rpl_parent_is_fresh(p)) {
-      /* Filter out non-fresh parents if fresh_only is set */
-      continue;
-    }
-
-#ifndef UIP_CONF_ND6_SEND_NA
-    {
-    uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
-    /* Exclude links to a neighbor that is not reachable at a NUD level */
-    if(nbr == NULL || nbr->state != NBR_REACHABLE) {
-      continue;
-    }
+#if RPL_WITH_PARENT_HEAP
+  /*
+   * The heaps only hold candidates, so the best one is at the top. In
+   * the fresh heap, drop the parents whose freshness has run out since
+   * they were last updated; a link update puts them back.
+   */
+  if(fresh_only) {
+    h = &dag->parent_heaps[RPL_PARENT_HEAP_FRESH];
+    while(h->size > 0 && !parent_is_fresh_cached(h->entries[0])) {
+      heap_remove(h, RPL_PARENT_HEAP_FRESH, h->entries[0]);
     }
-#endif /* UIP_CONF_ND6_SEND_NA */
+  } else {
+    h = &dag->parent_heaps[RPL_PARENT_HEAP_CANDIDATES];
+  }
+  if(h->size > 0) {
+    best = h->entries[0];
+  }
 
-    /* Now we have an acceptable parent, check if it is the new best */
+  /* Let the OF decide between it and the current preferred parent */
+  p = dag->preferred_parent;
+  if(p != NULL && p != best && p->heap_dag == dag &&
+     p->heap_index[fresh_only ? RPL_PARENT_HEAP_FRESH :
+                   RPL_PARENT_HEAP_CANDIDATES] != 0 &&
+     (!fresh_only || parent_is_fresh_cached(p))) {
     best = of->best_parent(best, p);
+  } else if(best != NULL) {
+    best = of->best_parent(NULL, best);
   }
+#else /* RPL_WITH_PARENT_HEAP */
+  /* Search for the best parent according to the OF */
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    if(parent_is_candidate(dag, p, fresh_only)) {
+      /* Now we have an acceptable parent, check if it is the new best */
+      best = of->best_parent(best, p);
+    }
+  }
+#endif /* RPL_WITH_PARENT_HEAP */
 
   return best;
 }
@@ -895,7 +1119,11 @@ rpl_select_parent(rpl_dag_t *dag)
 
   if(best != NULL) {
 #if RPL_WITH_PROBING
+#if RPL_WITH_PARENT_HEAP
+    if(parent_is_fresh_cached(best)) {
+#else /* RPL_WITH_PARENT_HEAP */
     if(rpl_parent_is_fresh(best)) {
+#endif /* RPL_WITH_PARENT_HEAP */
       rpl_set_preferred_parent(dag, best);
     } else {
       /* The best is not fresh. Look for the best fresh now. */
@@ -932,6 +1160,9 @@ rpl_remove_parent(rpl_parent_t *parent)
 
   rpl_nullify_parent(parent);
 
+#if RPL_WITH_PARENT_HEAP
+  heaps_remove(parent);
+#endif /* RPL_WITH_PARENT_HEAP */
   nbr_table_remove(rpl_parents, parent);
 }
 /*---------------------------------------------------------------------------*/
@@ -992,6 +1223,7 @@ rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent)
   PRINTF("\n");
 
   parent->dag = dag_dst;
+  rpl_update_parent_cost(parent);
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -1145,6 +1377,8 @@ rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
   /* Copy prefix information from the DIO into the DAG object. */
   memcpy(&dag->prefix_info, &dio->prefix_info, sizeof(rpl_prefix_t));
 
+  /* The parent was added before the objective function was known */
+  rpl_update_parent_cost(p);
   rpl_set_preferred_parent(dag, p);
   instance->of->update_metric_container(instance);
   dag->rank = rpl_rank_via_parent(p);
@@ -1360,6 +1594,9 @@ rpl_process_parent_event(rpl_instance_t *instance, rpl_parent_t *p)
 
   return_value = 1;
 
+  /* The rank or the link metric of the parent may have changed */
+  rpl_update_parent_cost(p);
+
   if(RPL_IS_STORING(instance)
       && uip_ds6_route_is_nexthop(rpl_get_parent_ipaddr(p))
       && !rpl_parent_is_reachable(p) && instance->mop > RPL_MOP_NON_STORING) {
@@ -131,6 +131,7 @@ rpl_verify_hbh_header(int uip_ext_opt_offset)
     /* A rank error was signalled, attempt to repair it by updating
      * the sender's rank from ext header */
     sender->rank = sender_rank;
+    rpl_update_parent_cost(sender);
     if(RPL_IS_NON_STORING(instance)) {
       /* Select DAG and preferred parent only in non-storing mode. In storing mode,
        * a parent switch would result in an immediate No-path DAO transmission, dropping
@@ -322,11 +323,60 @@ count_matching_bytes(const void *p1, const void *p2, size_t n)
   return n;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_NS_SRH_CACHE_SIZE
+/*
+ * Source routing headers built by the root, indexed by destination
+ * node. An entry is valid as long as the topology version of rpl-ns
+ * is unchanged, i.e., until a DAO changes a parent or a node expires.
+ */
+struct srh_cache_entry {
+  const rpl_ns_node_t *dest;
+  uint32_t version;
+  uip_ipaddr_t next_hop;
+  /* Length of the header, 0 if the destination is a child of the root */
+  uint8_t ext_len;
+  uint8_t hdr[RPL_NS_SRH_CACHE_ENTRY_LEN];
+};
+static struct srh_cache_entry srh_cache[RPL_NS_SRH_CACHE_SIZE];
+
+static struct srh_cache_entry *
+srh_cache_slot(const rpl_ns_node_t *dest)
+{
+  /* Nodes are allocated from an array, so consecutive nodes get
+     consecutive slots */
+  return &srh_cache[((uintptr_t)dest / sizeof(rpl_ns_node_t))
+                    % RPL_NS_SRH_CACHE_SIZE];
+}
+#endif /* RPL_NS_SRH_CACHE_SIZE */
+/*---------------------------------------------------------------------------*/
+/*
+ * Makes room for an ext_len bytes long routing header after the IPv6
+ * header. The caller adds ext_len to uip_ext_len once the header is
+ * written, as UIP_RH_BUF depends on it.
+ */
+static void
+open_srh_header(uint8_t ext_len)
+{
+  uint8_t temp_len;
+
+  /* Move existing ext headers and payload uip_ext_len further */
+  memmove(uip_buf + uip_l2_l3_hdr_len + ext_len,
+      uip_buf + uip_l2_l3_hdr_len, uip_len - UIP_IPH_LEN);
+
+  /* In-place update of IPv6 length field */
+  temp_len = UIP_IP_BUF->len[1];
+  UIP_IP_BUF->len[1] += ext_len;
+  if(UIP_IP_BUF->len[1] < temp_len) {
+    UIP_IP_BUF->len[0]++;
+  }
+
+  uip_len += ext_len;
+}
+/*---------------------------------------------------------------------------*/
 static int
 insert_srh_header(void)
 {
   /* Implementation of RFC6554 */
-  uint8_t temp_len;
   uint8_t path_len;
   uint8_t ext_len;
   uint8_t cmpri, cmpre; /* ComprI and ComprE fields of the RPL Source Routing Header */
@@ -337,6 +387,9 @@ insert_srh_header(void)
   rpl_ns_node_t *node;
   rpl_dag_t *dag;
   uip_ipaddr_t node_addr;
+#if RPL_NS_SRH_CACHE_SIZE
+  struct srh_cache_entry *cached;
+#endif /* RPL_NS_SRH_CACHE_SIZE */
 
   PRINTF("RPL: SRH creating source routing header with destination ");
   PRINT6ADDR(&UIP_IP_BUF->destipaddr);
@@ -358,6 +411,28 @@ insert_srh_header(void)
     return 1;
   }
 
+#if RPL_NS_SRH_CACHE_SIZE
+  cached = srh_cache_slot(dest_node);
+  if(cached->dest == dest_node &&
+     cached->version == rpl_ns_topology_version()) {
+    if(cached->ext_len == 0) {
+      PRINTF("RPL: SRH no need to insert SRH (cached)\n");
+      return 1;
+    }
+    if(uip_len + cached->ext_len > UIP_BUFSIZE) {
+      PRINTF("RPL: Packet too long: impossible to add source routing header (%u bytes)\n", cached->ext_len);
+      return 1;
+    }
+    open_srh_header(cached->ext_len);
+    memcpy(UIP_RH_BUF, cached->hdr, cached->ext_len);
+    UIP_RH_BUF->next = UIP_IP_BUF->proto;
+    UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+    uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &cached->next_hop);
+    uip_ext_len += cached->ext_len;
+    return 1;
+  }
+#endif /* RPL_NS_SRH_CACHE_SIZE */
+
   root_node = rpl_ns_get_node(dag, &dag->dag_id);
   if(root_node == NULL) {
     PRINTF("RPL: SRH root node not found\n");
@@ -378,6 +453,11 @@ insert_srh_header(void)
 
   if(node == root_node) {
     PRINTF("RPL: SRH no need to insert SRH\n");
+#if RPL_NS_SRH_CACHE_SIZE
+    cached->dest = dest_node;
+    cached->version = rpl_ns_topology_version();
+    cached->ext_len = 0;
+#endif /* RPL_NS_SRH_CACHE_SIZE */
     return 1;
   }
 
@@ -413,9 +493,7 @@ insert_srh_header(void)
     return 1;
   }
 
-  /* Move existing ext headers and payload uip_ext_len further */
-  memmove(uip_buf + uip_l2_l3_hdr_len + ext_len,
-      uip_buf + uip_l2_l3_hdr_len, uip_len - UIP_IPH_LEN);
+  open_srh_header(ext_len);
   memset(uip_buf + uip_l2_l3_hdr_len, 0, ext_len);
 
   /* Insert source routing header */
@@ -449,15 +527,17 @@ insert_srh_header(void)
   rpl_ns_get_node_global_addr(&node_addr, node);
   uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &node_addr);
 
-  /* In-place update of IPv6 length field */
-  temp_len = UIP_IP_BUF->len[1];
-  UIP_IP_BUF->len[1] += ext_len;
-  if(UIP_IP_BUF->len[1] < temp_len) {
-    UIP_IP_BUF->len[0]++;
+#if RPL_NS_SRH_CACHE_SIZE
+  if(ext_len <= RPL_NS_SRH_CACHE_ENTRY_LEN) {
+    cached->dest = dest_node;
+    cached->version = rpl_ns_topology_version();
+    cached->ext_len = ext_len;
+    memcpy(cached->hdr, UIP_RH_BUF, ext_len);
+    uip_ipaddr_copy(&cached->next_hop, &node_addr);
   }
+#endif /* RPL_NS_SRH_CACHE_SIZE */
 
   uip_ext_len += ext_len;
-  uip_len += ext_len;
 
   return 1;
 }
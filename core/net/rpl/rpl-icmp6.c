@@ -121,19 +121,41 @@ find_route_entry_by_dao_ack(uint8_t seq)
 #endif /* RPL_WITH_DAO_ACK */
 
 #if RPL_WITH_STORING
-/* prepare for forwarding of DAO */
-static uint8_t
-prepare_for_dao_fwd(uint8_t sequence, uip_ds6_route_t *rep)
-{
-  /* not pending - or pending but not a retransmission */
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-
-  /* set DAO pending and sequence numbers */
-  rep->state.dao_seqno_in = sequence;
-  rep->state.dao_seqno_out = dao_sequence;
-  RPL_ROUTE_SET_DAO_PENDING(rep);
-  return dao_sequence;
-}
+/* What a received DAO leads to, accumulated over its targets */
+struct dao_input_state {
+  uint8_t is_root;
+  uint8_t learned_from;
+  uint8_t has_parent;
+  uint8_t nbr_added;
+  uint8_t aggregate;  /* Targets go to the aggregation queue */
+  uint8_t can_ack;    /* All routes known already, or we are the root */
+  uint8_t status;     /* Status of the DAO-ACK to send back */
+  uint8_t seqno_out;  /* Sequence number when forwarded as it is */
+  uint8_t forwarded;  /* Targets forwarded to the preferred parent */
+};
+
+/* Unicast targets of a received DAO, whose routes are added as a batch */
+static uip_ipaddr_t dao_prefixes[RPL_DAO_MAX_TARGETS];
+static uint8_t dao_prefix_lens[RPL_DAO_MAX_TARGETS];
+static uint8_t dao_lifetimes[RPL_DAO_MAX_TARGETS];
+static uint16_t dao_target_pos[RPL_DAO_MAX_TARGETS];
+static uip_ds6_route_t *dao_routes[RPL_DAO_MAX_TARGETS];
+
+#if RPL_DAO_AGGREGATION_WINDOW
+/* Targets held until they are sent to the preferred parent together */
+struct dao_fwd_target {
+  uip_ipaddr_t prefix;
+  uint8_t prefix_len;
+  uint8_t lifetime;
+  uint8_t seqno_in;
+  uint8_t seqno_out;  /* Sequence number it was forwarded with before */
+  uint8_t retransmission;
+};
+static struct dao_fwd_target dao_fwd[RPL_DAO_MAX_TARGETS];
+static uint8_t dao_fwd_count;
+static rpl_instance_t *dao_fwd_instance;
+static struct ctimer dao_fwd_timer;
+#endif /* RPL_DAO_AGGREGATION_WINDOW */
 #endif /* RPL_WITH_STORING */
 /*---------------------------------------------------------------------------*/
 static int
@@ -630,6 +652,300 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_STORING
+/* Lifetime of the target option at pos: that of the next transit option */
+static uint8_t
+target_lifetime(unsigned char *buffer, int pos, int buffer_length,
+                uint8_t lifetime)
+{
+  while(pos < buffer_length) {
+    if(buffer[pos] == RPL_OPTION_PAD1) {
+      pos++;
+      continue;
+    }
+    if(buffer[pos] == RPL_OPTION_TRANSIT) {
+      return buffer[pos + 5];
+    }
+    pos += 2 + buffer[pos + 1];
+  }
+  return lifetime;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_DAO_AGGREGATION_WINDOW
+/*
+ * Targets go in the same DAO if they are both new, or retransmitted
+ * by the child with the same outgoing sequence number as before.
+ */
+static int
+same_dao(const struct dao_fwd_target *a, const struct dao_fwd_target *b)
+{
+  return a->retransmission == b->retransmission &&
+    (!a->retransmission || a->seqno_out == b->seqno_out);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_fwd_flush(void)
+{
+  rpl_instance_t *instance;
+  uip_ipaddr_t *parent_ipaddr;
+  uip_ds6_route_t *rep;
+  unsigned char *buffer;
+  struct dao_fwd_target *t;
+  uint8_t sent[RPL_DAO_MAX_TARGETS];
+  uint8_t sequence;
+  int max_len;
+  int pos;
+  int i;
+  int next;
+  int first;
+  int count;
+  int n;
+
+  ctimer_stop(&dao_fwd_timer);
+  count = dao_fwd_count;
+  dao_fwd_count = 0;
+  instance = dao_fwd_instance;
+  if(count == 0 || instance == NULL || !instance->used ||
+     instance->current_dag->preferred_parent == NULL) {
+    return;
+  }
+  parent_ipaddr = rpl_get_parent_ipaddr(instance->current_dag->preferred_parent);
+  if(parent_ipaddr == NULL) {
+    return;
+  }
+
+  buffer = UIP_ICMP_PAYLOAD;
+  max_len = UIP_BUFSIZE - uip_l2_l3_icmp_hdr_len;
+  memset(sent, 0, sizeof(sent));
+  for(first = 0; first < count; first++) {
+    if(sent[first]) {
+      continue;
+    }
+    /* A retransmission keeps the sequence number it was forwarded with,
+       as in the non-aggregated path */
+    if(dao_fwd[first].retransmission) {
+      sequence = dao_fwd[first].seqno_out;
+    } else {
+      RPL_LOLLIPOP_INCREMENT(dao_sequence);
+      sequence = dao_sequence;
+    }
+
+    pos = 0;
+    buffer[pos++] = instance->instance_id;
+    buffer[pos++] = 0;
+    buffer[pos++] = 0; /* reserved */
+    buffer[pos++] = sequence;
+#if RPL_DAO_SPECIFY_DAG
+    buffer[1] |= RPL_DAO_D_FLAG;
+    memcpy(buffer + pos, &instance->current_dag->dag_id, sizeof(uip_ipaddr_t));
+    pos += sizeof(uip_ipaddr_t);
+#endif /* RPL_DAO_SPECIFY_DAG */
+
+    /* The targets are sorted by lifetime: each run of targets with the
+       same lifetime shares a transit option */
+    n = 0;
+    for(i = first; i < count; i = next) {
+      for(next = i + 1; next < count; next++) {
+        if(!sent[next] && same_dao(&dao_fwd[first], &dao_fwd[next])) {
+          break;
+        }
+      }
+      t = &dao_fwd[i];
+      if(n > 0 && pos + 4 + 16 + 6 > max_len) {
+        break;
+      }
+#if RPL_WITH_DAO_ACK
+      if(t->lifetime != RPL_ZERO_LIFETIME) {
+        buffer[1] |= RPL_DAO_K_FLAG;
+      }
+#endif /* RPL_WITH_DAO_ACK */
+      buffer[pos++] = RPL_OPTION_TARGET;
+      buffer[pos++] = 2 + ((t->prefix_len + 7) / CHAR_BIT);
+      buffer[pos++] = 0; /* reserved */
+      buffer[pos++] = t->prefix_len;
+      memcpy(buffer + pos, &t->prefix, (t->prefix_len + 7) / CHAR_BIT);
+      pos += (t->prefix_len + 7) / CHAR_BIT;
+      if(next == count || dao_fwd[next].lifetime != t->lifetime ||
+         pos + 4 + 16 + 6 + 6 > max_len) {
+        buffer[pos++] = RPL_OPTION_TRANSIT;
+        buffer[pos++] = 4;
+        buffer[pos++] = 0; /* flags - ignored */
+        buffer[pos++] = 0; /* path control - ignored */
+        buffer[pos++] = 0; /* path seq - ignored */
+        buffer[pos++] = t->lifetime;
+      }
+      sent[i] = 1;
+      n++;
+
+      /* The DAO-ACK for this DAO goes back to the sender of the target */
+      rep = uip_ds6_route_lookup(&t->prefix);
+      if(rep != NULL && rep->length == t->prefix_len) {
+        rep->state.dao_seqno_in = t->seqno_in;
+        rep->state.dao_seqno_out = sequence;
+        RPL_ROUTE_SET_DAO_PENDING(rep);
+      }
+    }
+
+    PRINTF("RPL: Sending an aggregated DAO with %d targets, sequence number %u, to ",
+           n, sequence);
+    PRINT6ADDR(parent_ipaddr);
+    PRINTF("\n");
+    uip_icmp6_send(parent_ipaddr, ICMP6_RPL, RPL_CODE_DAO, pos);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_fwd_timeout(void *ptr)
+{
+  dao_fwd_flush();
+}
+/*---------------------------------------------------------------------------*/
+/* Queue a target for the preferred parent; the caller makes sure that
+   there is room */
+static void
+dao_fwd_add(rpl_instance_t *instance, uip_ds6_route_t *rep,
+            uip_ipaddr_t *prefix, uint8_t prefix_len, uint8_t lifetime,
+            uint8_t seqno_in)
+{
+  struct dao_fwd_target *t;
+  int i;
+
+  dao_fwd_instance = instance;
+
+  /* A newer DAO for the same target replaces the queued one */
+  for(i = 0; i < dao_fwd_count; i++) {
+    if(dao_fwd[i].prefix_len == prefix_len &&
+       uip_ipaddr_cmp(&dao_fwd[i].prefix, prefix)) {
+      memmove(&dao_fwd[i], &dao_fwd[i + 1],
+              (dao_fwd_count - i - 1) * sizeof(dao_fwd[0]));
+      dao_fwd_count--;
+      break;
+    }
+  }
+
+  for(i = dao_fwd_count; i > 0 && dao_fwd[i - 1].lifetime > lifetime; i--) {
+    dao_fwd[i] = dao_fwd[i - 1];
+  }
+  t = &dao_fwd[i];
+  uip_ipaddr_copy(&t->prefix, prefix);
+  t->prefix_len = prefix_len;
+  t->lifetime = lifetime;
+  t->seqno_in = seqno_in;
+  /* if this is pending and we get the same seq no it is a retrans */
+  t->retransmission = rep != NULL && lifetime != RPL_ZERO_LIFETIME &&
+    RPL_ROUTE_IS_DAO_PENDING(rep) && rep->state.dao_seqno_in == seqno_in;
+  t->seqno_out = rep != NULL ? rep->state.dao_seqno_out : 0;
+  if(dao_fwd_count++ == 0) {
+    ctimer_set(&dao_fwd_timer, RPL_DAO_AGGREGATION_WINDOW,
+               dao_fwd_timeout, NULL);
+  }
+}
+#endif /* RPL_DAO_AGGREGATION_WINDOW */
+/*---------------------------------------------------------------------------*/
+/* Forward a target of a received DAO to our preferred parent */
+static void
+forward_target(rpl_instance_t *instance, struct dao_input_state *state,
+               uip_ds6_route_t *rep, uip_ipaddr_t *prefix, uint8_t prefixlen,
+               uint8_t lifetime, uint8_t sequence)
+{
+#if RPL_DAO_AGGREGATION_WINDOW
+  if(state->aggregate) {
+    dao_fwd_add(instance, rep, prefix, prefixlen, lifetime, sequence);
+    state->forwarded++;
+    return;
+  }
+#endif /* RPL_DAO_AGGREGATION_WINDOW */
+
+  if(state->forwarded == 0) {
+    /* if this is pending and we get the same seq no it is a retrans */
+    if(rep != NULL && lifetime != RPL_ZERO_LIFETIME &&
+       RPL_ROUTE_IS_DAO_PENDING(rep) && rep->state.dao_seqno_in == sequence) {
+      /* keep the same seq-no as before for parent also */
+      state->seqno_out = rep->state.dao_seqno_out;
+    } else {
+      RPL_LOLLIPOP_INCREMENT(dao_sequence);
+      state->seqno_out = dao_sequence;
+    }
+  }
+  if(rep != NULL) {
+    /* set DAO pending and sequence numbers */
+    rep->state.dao_seqno_in = sequence;
+    rep->state.dao_seqno_out = state->seqno_out;
+    RPL_ROUTE_SET_DAO_PENDING(rep);
+  }
+  state->forwarded++;
+}
+/*---------------------------------------------------------------------------*/
+/* Add the routes of a batch of unicast targets from the same DAO */
+static void
+dao_input_routes(rpl_dag_t *dag, uip_ipaddr_t *dao_sender_addr,
+                 uint8_t sequence, int count, struct dao_input_state *state)
+{
+  rpl_instance_t *instance;
+  uip_ds6_route_t *rep;
+  unsigned char *buffer;
+  int i;
+
+  instance = dag->instance;
+  buffer = UIP_ICMP_PAYLOAD;
+  PRINTF("RPL: Adding %d DAO routes\n", count);
+
+  /* Update and add neighbor - if no room - fail. */
+  if(!state->nbr_added &&
+     rpl_icmp6_update_nbr_table(dao_sender_addr, NBR_TABLE_REASON_RPL_DAO, instance) == NULL) {
+    PRINTF("RPL: Out of Memory, dropping DAO from ");
+    PRINT6ADDR(dao_sender_addr);
+    PRINTF(", ");
+    PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+    PRINTF("\n");
+    memset(dao_routes, 0, sizeof(dao_routes));
+  } else {
+    state->nbr_added = 1;
+    if(rpl_add_routes(dag, dao_prefixes, dao_prefix_lens, count,
+                      dao_sender_addr, dao_routes) < count) {
+      RPL_STAT(rpl_stats.mem_overflows++);
+      PRINTF("RPL: Could not add a route after receiving a DAO\n");
+    }
+  }
+
+  for(i = 0; i < count; i++) {
+    rep = dao_routes[i];
+    if(rep == NULL) {
+      /* signal the failure to add the node, and do not forward it */
+      state->status = state->is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
+        RPL_DAO_ACK_UNABLE_TO_ACCEPT;
+      buffer[dao_target_pos[i]] = RPL_OPTION_PADN;
+      continue;
+    }
+
+    /* set lifetime and clear NOPATH bit */
+    rep->state.lifetime = RPL_LIFETIME(instance, dao_lifetimes[i]);
+    RPL_ROUTE_CLEAR_NOPATH_RECEIVED(rep);
+
+    if(state->learned_from != RPL_ROUTE_FROM_UNICAST_DAO) {
+      state->can_ack = 0;
+      continue;
+    }
+
+    /*
+     * check if this route is already installed and we can ack now!
+     * not pending - and same seq-no means that we can ack.
+     * (e.g. the route is installed already so it will not take any
+     * more room that it already takes - so should be ok!)
+     */
+    if(!state->is_root &&
+       (RPL_ROUTE_IS_DAO_PENDING(rep) || rep->state.dao_seqno_in != sequence)) {
+      state->can_ack = 0;
+    }
+
+    if(state->has_parent) {
+      forward_target(instance, state, rep, &dao_prefixes[i],
+                     dao_prefix_lens[i], dao_lifetimes[i], sequence);
+    }
+  }
+}
+#endif /* RPL_WITH_STORING */
+/*---------------------------------------------------------------------------*/
 static void
 dao_input_storing(void)
 {
@@ -654,10 +970,9 @@ dao_input_storing(void)
   int pos;
   int len;
   int i;
-  int learned_from;
+  int count;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
-  int is_root;
+  struct dao_input_state state;
 
   prefixlen = 0;
   parent = NULL;
@@ -680,7 +995,12 @@ dao_input_storing(void)
   sequence = buffer[pos++];
 
   dag = instance->current_dag;
-  is_root = (dag->rank == ROOT_RANK(instance));
+  memset(&state, 0, sizeof(state));
+  state.is_root = (dag->rank == ROOT_RANK(instance));
+  state.can_ack = 1;
+  state.status = RPL_DAO_ACK_UNCONDITIONAL_ACCEPT;
+  state.has_parent = dag->preferred_parent != NULL &&
+    rpl_get_parent_ipaddr(dag->preferred_parent) != NULL;
 
   /* Is the DAG ID present? */
   if(flags & RPL_DAO_D_FLAG) {
@@ -691,16 +1011,16 @@ dao_input_storing(void)
     pos += 16;
   }
 
-  learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
+  state.learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
                  RPL_ROUTE_FROM_MULTICAST_DAO : RPL_ROUTE_FROM_UNICAST_DAO;
 
   /* Destination Advertisement Object */
   PRINTF("RPL: Received a (%s) DAO with sequence number %u from ",
-      learned_from == RPL_ROUTE_FROM_UNICAST_DAO? "unicast": "multicast", sequence);
+      state.learned_from == RPL_ROUTE_FROM_UNICAST_DAO? "unicast": "multicast", sequence);
   PRINT6ADDR(&dao_sender_addr);
   PRINTF("\n");
 
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
+  if(state.learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
     /* Check whether this is a DAO forwarding loop. */
     parent = rpl_find_parent(dag, &dao_sender_addr);
     /* check if this is a new DAO registration with an "illegal" rank */
@@ -711,6 +1031,7 @@ dao_input_storing(void)
           DAG_RANK(parent->rank, instance), DAG_RANK(dag->rank, instance));
       parent->rank = INFINITE_RANK;
       parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_update_parent_cost(parent);
       return;
     }
 
@@ -719,11 +1040,32 @@ dao_input_storing(void)
       PRINTF("RPL: Loop detected when receiving a unicast DAO from our parent\n");
       parent->rank = INFINITE_RANK;
       parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_update_parent_cost(parent);
       return;
     }
   }
 
-  /* Check if there are any RPL options present. */
+#if RPL_DAO_AGGREGATION_WINDOW
+  /* Aggregate the targets if they all fit in the queue, otherwise
+     forward the DAO as it is */
+  if(state.has_parent) {
+    count = 0;
+    for(i = pos; i < buffer_length; i += len) {
+      len = buffer[i] == RPL_OPTION_PAD1 ? 1 : 2 + buffer[i + 1];
+      count += buffer[i] == RPL_OPTION_TARGET;
+    }
+    state.aggregate = dao_fwd_count + count <= RPL_DAO_MAX_TARGETS &&
+      (dao_fwd_count == 0 || dao_fwd_instance == instance);
+  }
+#endif /* RPL_DAO_AGGREGATION_WINDOW */
+
+  /*
+   * Handle every target option. The lifetime of a target is that of
+   * the transit option following it, which may be shared by several
+   * targets. Routes are added RPL_DAO_MAX_TARGETS at a time. Targets
+   * that are not forwarded are overwritten with padding.
+   */
+  count = 0;
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -733,167 +1075,112 @@ dao_input_storing(void)
       len = 2 + buffer[i + 1];
     }
 
-    switch(subopt_type) {
-    case RPL_OPTION_TARGET:
-      /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
-      break;
-    case RPL_OPTION_TRANSIT:
+    if(subopt_type == RPL_OPTION_TRANSIT) {
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
       lifetime = buffer[i + 5];
       /* The parent address is also ignored. */
-      break;
+      continue;
+    }
+    if(subopt_type != RPL_OPTION_TARGET) {
+      continue;
     }
-  }
 
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
+    /* Handle the target option. */
+    prefixlen = buffer[i + 3];
+    memset(&prefix, 0, sizeof(prefix));
+    memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+    lifetime = target_lifetime(buffer, i + len, buffer_length, lifetime);
+
+    PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+            (unsigned)lifetime, (unsigned)prefixlen);
+    PRINT6ADDR(&prefix);
+    PRINTF("\n");
 
 #if RPL_WITH_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+    if(uip_is_addr_mcast_global(&prefix)) {
+      mcast_group = uip_mcast6_route_add(&prefix);
+      if(mcast_group) {
+        mcast_group->dag = dag;
+        mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+      }
+      if(state.learned_from == RPL_ROUTE_FROM_UNICAST_DAO && state.has_parent) {
+        forward_target(instance, &state, NULL, &prefix, prefixlen, lifetime,
+                       sequence);
+      }
+      continue;
     }
-    goto fwd_dao;
-  }
 #endif
 
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       !RPL_ROUTE_IS_NOPATH_RECEIVED(rep) &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      RPL_ROUTE_SET_NOPATH_RECEIVED(rep);
-      rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
-
-      /* We forward the incoming No-Path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        uint8_t out_seq;
-        out_seq = prepare_for_dao_fwd(sequence, rep);
-
-        PRINTF("RPL: Forwarding No-path DAO to parent - out_seq:%d",
-	       out_seq);
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    if(lifetime == RPL_ZERO_LIFETIME) {
+      PRINTF("RPL: No-Path DAO received\n");
+      /* No-Path DAO received; invoke the route purging routine. */
+      rep = uip_ds6_route_lookup(&prefix);
+      if(rep != NULL &&
+         !RPL_ROUTE_IS_NOPATH_RECEIVED(rep) &&
+         rep->length == prefixlen &&
+         uip_ds6_route_nexthop(rep) != NULL &&
+         uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
+        PRINTF("RPL: Setting expiration timer for prefix ");
+        PRINT6ADDR(&prefix);
         PRINTF("\n");
-
-        buffer = UIP_ICMP_PAYLOAD;
-        buffer[3] = out_seq; /* add an outgoing seq no before fwd */
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+        RPL_ROUTE_SET_NOPATH_RECEIVED(rep);
+        rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
+
+        /* We forward the incoming No-Path DAO to our parent, if we have
+           one. */
+        if(state.has_parent) {
+          forward_target(instance, &state, rep, &prefix, prefixlen,
+                         RPL_ZERO_LIFETIME, sequence);
+          continue;
+        }
       }
+      buffer[i] = RPL_OPTION_PADN;
+      continue;
     }
-    /* independent if we remove or not - ACK the request */
-    if(flags & RPL_DAO_K_FLAG) {
-      /* indicate that we accepted the no-path DAO */
-      uip_clear_buf();
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-                     RPL_DAO_ACK_UNCONDITIONAL_ACCEPT);
-    }
-    return;
-  }
-
-  PRINTF("RPL: Adding DAO route\n");
 
-  /* Update and add neighbor - if no room - fail. */
-  if((nbr = rpl_icmp6_update_nbr_table(&dao_sender_addr, NBR_TABLE_REASON_RPL_DAO, instance)) == NULL) {
-    PRINTF("RPL: Out of Memory, dropping DAO from ");
-    PRINT6ADDR(&dao_sender_addr);
-    PRINTF(", ");
-    PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-    PRINTF("\n");
-    if(flags & RPL_DAO_K_FLAG) {
-      /* signal the failure to add the node */
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-		     is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
-		     RPL_DAO_ACK_UNABLE_TO_ACCEPT);
+    uip_ipaddr_copy(&dao_prefixes[count], &prefix);
+    dao_prefix_lens[count] = prefixlen;
+    dao_lifetimes[count] = lifetime;
+    dao_target_pos[count] = i;
+    if(++count == RPL_DAO_MAX_TARGETS) {
+      dao_input_routes(dag, &dao_sender_addr, sequence, count, &state);
+      count = 0;
     }
-    return;
   }
-
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
-    if(flags & RPL_DAO_K_FLAG) {
-      /* signal the failure to add the node */
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-		     is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
-		     RPL_DAO_ACK_UNABLE_TO_ACCEPT);
-    }
-    return;
+  if(count > 0) {
+    dao_input_routes(dag, &dao_sender_addr, sequence, count, &state);
   }
 
-  /* set lifetime and clear NOPATH bit */
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  RPL_ROUTE_CLEAR_NOPATH_RECEIVED(rep);
-
-#if RPL_WITH_MULTICAST
-fwd_dao:
-#endif
-
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    int should_ack = 0;
-
-    if(flags & RPL_DAO_K_FLAG) {
-      /*
-       * check if this route is already installed and we can ack now!
-       * not pending - and same seq-no means that we can ack.
-       * (e.g. the route is installed already so it will not take any
-       * more room that it already takes - so should be ok!)
-       */
-      if((!RPL_ROUTE_IS_DAO_PENDING(rep) &&
-          rep->state.dao_seqno_in == sequence) ||
-          dag->rank == ROOT_RANK(instance)) {
-        should_ack = 1;
-      }
-    }
-
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      uint8_t out_seq = 0;
-      /* if this is pending and we get the same seq no it is a retrans */
-      if(RPL_ROUTE_IS_DAO_PENDING(rep) &&
-         rep->state.dao_seqno_in == sequence) {
-        /* keep the same seq-no as before for parent also */
-        out_seq = rep->state.dao_seqno_out;
-      } else {
-        out_seq = prepare_for_dao_fwd(sequence, rep);
-      }
+  if(state.forwarded > 0 && !state.aggregate) {
+    PRINTF("RPL: Forwarding DAO to parent ");
+    PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    PRINTF(" in seq: %d out seq: %d\n", sequence, state.seqno_out);
 
-      PRINTF("RPL: Forwarding DAO to parent ");
-      PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-      PRINTF(" in seq: %d out seq: %d\n", sequence, out_seq);
+    buffer[3] = state.seqno_out; /* add an outgoing seq no before fwd */
+    uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
+                   ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+  }
 
-      buffer = UIP_ICMP_PAYLOAD;
-      buffer[3] = out_seq; /* add an outgoing seq no before fwd */
-      uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                     ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-    }
-    if(should_ack) {
+  if(flags & RPL_DAO_K_FLAG) {
+    if(state.status >= RPL_DAO_ACK_UNABLE_TO_ACCEPT) {
+      uip_clear_buf();
+      dao_ack_output(instance, &dao_sender_addr, sequence, state.status);
+    } else if(state.can_ack) {
       PRINTF("RPL: Sending DAO ACK\n");
       uip_clear_buf();
       dao_ack_output(instance, &dao_sender_addr, sequence,
                      RPL_DAO_ACK_UNCONDITIONAL_ACCEPT);
     }
   }
+
+#if RPL_DAO_AGGREGATION_WINDOW
+  if(dao_fwd_count == RPL_DAO_MAX_TARGETS) {
+    uip_clear_buf();
+    dao_fwd_flush();
+  }
+#endif /* RPL_DAO_AGGREGATION_WINDOW */
 #endif /* RPL_WITH_STORING */
 }
 /*---------------------------------------------------------------------------*/
@@ -1060,6 +1347,7 @@ handle_dao_retransmission(void *ptr)
     if(RPL_IS_STORING(instance) && instance->of->dao_ack_callback) {
       /* Inform the objective function about the timeout. */
       instance->of->dao_ack_callback(parent, RPL_DAO_ACK_TIMEOUT);
+      rpl_update_parent_cost(parent);
     }
 
     /* Perform local repair and hope to find another parent. */
@@ -1296,6 +1584,7 @@ dao_ack_input(void)
     /* Inform objective function on status of the DAO ACK */
     if(RPL_IS_STORING(instance) && instance->of->dao_ack_callback) {
       instance->of->dao_ack_callback(parent, status);
+      rpl_update_parent_cost(parent);
     }
 
 #if RPL_REPAIR_ON_DAO_NACK
@@ -1309,30 +1598,54 @@ dao_ack_input(void)
 #endif
 
   } else if(RPL_IS_STORING(instance)) {
-    /* this DAO ACK should be forwarded to another recently registered route */
+    /* this DAO ACK should be forwarded to the recently registered routes
+       it acknowledges - an aggregated DAO may hold targets of several
+       nodes */
     uip_ds6_route_t *re;
+    uip_ds6_route_t *other;
+    uip_ds6_route_t *next;
     uip_ipaddr_t *nexthop;
-    if((re = find_route_entry_by_dao_ack(sequence)) != NULL) {
+    uint8_t seqno_in;
+    int forwarded;
+
+    forwarded = 0;
+    while((re = find_route_entry_by_dao_ack(sequence)) != NULL) {
       /* pick the recorded seq no from that node and forward DAO ACK - and
          clear the pending flag*/
       RPL_ROUTE_CLEAR_DAO_PENDING(re);
-
       nexthop = uip_ds6_route_nexthop(re);
+      seqno_in = re->state.dao_seqno_in;
+
+      /* The other targets of the same DAO from that node share the ACK */
+      for(other = uip_ds6_route_head(); other != NULL; other = next) {
+        next = uip_ds6_route_next(other);
+        if(RPL_ROUTE_IS_DAO_PENDING(other) &&
+           other->state.dao_seqno_out == sequence &&
+           other->state.dao_seqno_in == seqno_in &&
+           uip_ds6_route_nexthop(other) == nexthop) {
+          RPL_ROUTE_CLEAR_DAO_PENDING(other);
+          if(status >= RPL_DAO_ACK_UNABLE_TO_ACCEPT) {
+            uip_ds6_route_rm(other);
+          }
+        }
+      }
+
       if(nexthop == NULL) {
         PRINTF("RPL: No next hop to fwd DAO ACK to\n");
       } else {
         PRINTF("RPL: Fwd DAO ACK to:");
         PRINT6ADDR(nexthop);
         PRINTF("\n");
-        buffer[2] = re->state.dao_seqno_in;
-        uip_icmp6_send(nexthop, ICMP6_RPL, RPL_CODE_DAO_ACK, 4);
+        dao_ack_output(instance, nexthop, seqno_in, status);
       }
 
       if(status >= RPL_DAO_ACK_UNABLE_TO_ACCEPT) {
         /* this node did not get in to the routing tables above... - remove */
         uip_ds6_route_rm(re);
       }
-    } else {
+      forwarded++;
+    }
+    if(forwarded == 0) {
       PRINTF("RPL: No route entry found to forward DAO ACK (seqno %u)\n", sequence);
     }
   }
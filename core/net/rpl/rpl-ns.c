@@ -63,6 +63,12 @@ static int num_nodes;
 LIST(nodelist);
 MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
 
+/* Nodes hashed by link identifier */
+static rpl_ns_node_t *node_hash[RPL_NS_HASH_SIZE];
+
+/* Incremented when a parent changes or a node is removed */
+static uint32_t topology_version;
+
 /*---------------------------------------------------------------------------*/
 int
 rpl_ns_num_nodes(void)
@@ -81,11 +87,37 @@ node_matches_address(const rpl_dag_t *dag, const rpl_ns_node_t *node, const uip_
       && !memcmp(((const unsigned char *)addr) + 8, node->link_identifier, 8);
 }
 /*---------------------------------------------------------------------------*/
+static unsigned
+hash_link_identifier(const unsigned char *id)
+{
+  return ((((unsigned)id[4] << 8) | id[5]) ^
+          (((unsigned)id[6] << 8) | id[7])) % RPL_NS_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(rpl_ns_node_t *node)
+{
+  rpl_ns_node_t **l;
+
+  l = &node_hash[hash_link_identifier(node->link_identifier)];
+  for(; *l != NULL; l = &(*l)->hash_next) {
+    if(*l == node) {
+      *l = node->hash_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 rpl_ns_node_t *
 rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
 {
   rpl_ns_node_t *l;
-  for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+
+  if(addr == NULL) {
+    return NULL;
+  }
+  l = node_hash[hash_link_identifier(((const unsigned char *)addr) + 8)];
+  for(; l != NULL; l = l->hash_next) {
     /* Compare prefix and node identifier */
     if(node_matches_address(dag, l, addr)) {
       return l;
@@ -94,12 +126,11 @@ rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
-int
-rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+static int
+node_is_reachable(const rpl_ns_node_t *node, const rpl_ns_node_t *root_node)
 {
   int max_depth = RPL_NS_LINK_NUM;
-  rpl_ns_node_t *node = rpl_ns_get_node(dag, addr);
-  rpl_ns_node_t *root_node = rpl_ns_get_node(dag, dag != NULL ? &dag->dag_id : NULL);
+
   while(node != NULL && node != root_node && max_depth > 0) {
     node = node->parent;
     max_depth--;
@@ -107,6 +138,13 @@ rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
   return node != NULL && node == root_node;
 }
 /*---------------------------------------------------------------------------*/
+int
+rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return node_is_reachable(rpl_ns_get_node(dag, addr),
+                           rpl_ns_get_node(dag, dag != NULL ? &dag->dag_id : NULL));
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t *parent)
 {
@@ -123,6 +161,8 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
   rpl_ns_node_t *child_node = rpl_ns_get_node(dag, child);
   rpl_ns_node_t *parent_node = rpl_ns_get_node(dag, parent);
   rpl_ns_node_t *old_parent_node;
+  rpl_ns_node_t *root_node;
+  unsigned hash;
 
   if(parent != NULL) {
     /* No node for the parent, add one with infinite lifetime */
@@ -142,22 +182,29 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
       return NULL;
     }
     child_node->parent = NULL;
+    child_node->dag = dag;
+    memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
     list_add(nodelist, child_node);
+    hash = hash_link_identifier(child_node->link_identifier);
+    child_node->hash_next = node_hash[hash];
+    node_hash[hash] = child_node;
     num_nodes++;
   }
 
-  /* Initialize node */
-  child_node->dag = dag;
+  old_parent_node = child_node->parent;
+  if(child_node->dag != dag) {
+    child_node->dag = dag;
+    topology_version++;
+  }
   child_node->lifetime = lifetime;
-  memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
 
+  root_node = rpl_ns_get_node(dag, dag != NULL ? &dag->dag_id : NULL);
   /* Is the node reachable before the update? */
-  if(rpl_ns_is_node_reachable(dag, child)) {
-    old_parent_node = child_node->parent;
+  if(node_is_reachable(child_node, root_node)) {
     /* Update node */
     child_node->parent = parent_node;
     /* Has the node become unreachable? May happen if we create a loop. */
-    if(!rpl_ns_is_node_reachable(dag, child)) {
+    if(!node_is_reachable(child_node, root_node)) {
       /* The new parent makes the node unreachable, restore old parent.
        * We will take the update next time, with chances we know more of
        * the topology and the loop is gone. */
@@ -167,6 +214,10 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
     child_node->parent = parent_node;
   }
 
+  if(child_node->parent != old_parent_node) {
+    topology_version++;
+  }
+
   return child_node;
 }
 /*---------------------------------------------------------------------------*/
@@ -176,6 +227,8 @@ rpl_ns_init(void)
   num_nodes = 0;
   memb_init(&nodememb);
   list_init(nodelist);
+  memset(node_hash, 0, sizeof(node_hash));
+  topology_version++;
 }
 /*---------------------------------------------------------------------------*/
 rpl_ns_node_t *
@@ -203,6 +256,7 @@ void
 rpl_ns_periodic(void)
 {
   rpl_ns_node_t *l;
+  rpl_ns_node_t *next;
   /* First pass, decrement lifetime for all nodes with non-infinite lifetime */
   for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
     /* Don't touch infinite lifetime nodes */
@@ -211,7 +265,8 @@ rpl_ns_periodic(void)
     }
   }
   /* Second pass, for all expire nodes, deallocate them iff no child points to them */
-  for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+  for(l = list_head(nodelist); l != NULL; l = next) {
+    next = list_item_next(l);
     if(l->lifetime == 0) {
       rpl_ns_node_t *l2;
       for(l2 = list_head(nodelist); l2 != NULL; l2 = list_item_next(l2)) {
@@ -220,11 +275,21 @@ rpl_ns_periodic(void)
         }
       }
       /* No child found, deallocate node */
-      list_remove(nodelist, l);
-      memb_free(&nodememb, l);
-      num_nodes--;
+      if(l2 == NULL) {
+        list_remove(nodelist, l);
+        hash_remove(l);
+        memb_free(&nodememb, l);
+        num_nodes--;
+        topology_version++;
+      }
     }
   }
 }
+/*---------------------------------------------------------------------------*/
+uint32_t
+rpl_ns_topology_version(void)
+{
+  return topology_version;
+}
 
 #endif /* RPL_WITH_NON_STORING */
@@ -49,6 +49,27 @@
 #define RPL_NS_LINK_NUM 32
 #endif /* RPL_NS_CONF_LINK_NUM */
 
+/* Number of buckets of the hash index over the nodes */
+#ifdef RPL_NS_CONF_HASH_SIZE
+#define RPL_NS_HASH_SIZE RPL_NS_CONF_HASH_SIZE
+#else /* RPL_NS_CONF_HASH_SIZE */
+#define RPL_NS_HASH_SIZE RPL_NS_LINK_NUM
+#endif /* RPL_NS_CONF_HASH_SIZE */
+
+/* Number of source routing headers cached by the root, 0 to disable */
+#ifdef RPL_NS_CONF_SRH_CACHE_SIZE
+#define RPL_NS_SRH_CACHE_SIZE RPL_NS_CONF_SRH_CACHE_SIZE
+#else /* RPL_NS_CONF_SRH_CACHE_SIZE */
+#define RPL_NS_SRH_CACHE_SIZE 0
+#endif /* RPL_NS_CONF_SRH_CACHE_SIZE */
+
+/* Longest source routing header that is cached, in bytes */
+#ifdef RPL_NS_CONF_SRH_CACHE_ENTRY_LEN
+#define RPL_NS_SRH_CACHE_ENTRY_LEN RPL_NS_CONF_SRH_CACHE_ENTRY_LEN
+#else /* RPL_NS_CONF_SRH_CACHE_ENTRY_LEN */
+#define RPL_NS_SRH_CACHE_ENTRY_LEN 64
+#endif /* RPL_NS_CONF_SRH_CACHE_ENTRY_LEN */
+
 typedef struct rpl_ns_node {
   struct rpl_ns_node *next;
   uint32_t lifetime;
@@ -56,6 +77,7 @@ typedef struct rpl_ns_node {
   /* Store only IPv6 link identifiers as all nodes in the DAG share the same prefix */
   unsigned char link_identifier[8];
   struct rpl_ns_node *parent;
+  struct rpl_ns_node *hash_next;
 } rpl_ns_node_t;
 
 int rpl_ns_num_nodes(void);
@@ -68,5 +90,7 @@ rpl_ns_node_t *rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
 int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
 void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, rpl_ns_node_t *node);
 void rpl_ns_periodic(void);
+/* Changes whenever a route may have changed, see rpl_ns_update_node() */
+uint32_t rpl_ns_topology_version(void);
 
 #endif /* RPL_NS_H */
@@ -142,6 +142,25 @@
 #define RPL_DAO_RETRANSMISSION_TIMEOUT  (5 * CLOCK_SECOND)
 #endif /* RPL_CONF_DAO_RETRANSMISSION_TIMEOUT */
 
+/* In storing mode, a router holds the targets of the DAOs it forwards
+   for RPL_DAO_AGGREGATION_WINDOW and sends them together to its
+   preferred parent. 0 forwards each DAO as soon as it is received. */
+#ifdef RPL_CONF_DAO_AGGREGATION_WINDOW
+#define RPL_DAO_AGGREGATION_WINDOW RPL_CONF_DAO_AGGREGATION_WINDOW
+#else
+#define RPL_DAO_AGGREGATION_WINDOW      0
+#endif /* RPL_CONF_DAO_AGGREGATION_WINDOW */
+
+/* Targets of a received DAO that are added to the routing table in
+   one batch, and most targets sent in one aggregated DAO */
+#ifdef RPL_CONF_DAO_MAX_TARGETS
+#define RPL_DAO_MAX_TARGETS RPL_CONF_DAO_MAX_TARGETS
+#elif RPL_DAO_AGGREGATION_WINDOW
+#define RPL_DAO_MAX_TARGETS             8
+#else
+#define RPL_DAO_MAX_TARGETS             1
+#endif /* RPL_CONF_DAO_MAX_TARGETS */
+
 /* Special value indicating immediate removal. */
 #define RPL_ZERO_LIFETIME               0
 
@@ -369,6 +388,7 @@ rpl_parent_t *rpl_find_parent_any_dag(rpl_instance_t *instance, uip_ipaddr_t *ad
 void rpl_nullify_parent(rpl_parent_t *);
 void rpl_remove_parent(rpl_parent_t *);
 void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent);
+void rpl_update_parent_cost(rpl_parent_t *parent);
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
 void rpl_recalculate_ranks(void);
@@ -378,6 +398,9 @@ void rpl_remove_routes(rpl_dag_t *dag);
 void rpl_remove_routes_by_nexthop(uip_ipaddr_t *nexthop, rpl_dag_t *dag);
 uip_ds6_route_t *rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix,
                                int prefix_len, uip_ipaddr_t *next_hop);
+int rpl_add_routes(rpl_dag_t *dag, uip_ipaddr_t *prefixes,
+                   const uint8_t *prefix_lens, int count,
+                   uip_ipaddr_t *next_hop, uip_ds6_route_t **routes);
 void rpl_purge_routes(void);
 
 /* Objective function. */
@@ -249,6 +249,35 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
   return rep;
 }
 /*---------------------------------------------------------------------------*/
+int
+rpl_add_routes(rpl_dag_t *dag, uip_ipaddr_t *prefixes,
+               const uint8_t *prefix_lens, int count,
+               uip_ipaddr_t *next_hop, uip_ds6_route_t **routes)
+{
+  int added;
+  int i;
+
+  added = uip_ds6_route_add_batch(prefixes, prefix_lens, count, next_hop, routes);
+  if(added < count) {
+    PRINTF("RPL: No space for %d of %d route entries\n", count - added, count);
+  }
+
+  for(i = 0; i < count; i++) {
+    if(routes[i] != NULL) {
+      routes[i]->state.dag = dag;
+      routes[i]->state.lifetime = RPL_LIFETIME(dag->instance,
+                                               dag->instance->default_lifetime);
+      RPL_ROUTE_CLEAR_NOPATH_RECEIVED(routes[i]);
+    }
+  }
+
+  PRINTF("RPL: Added %d routes via ", added);
+  PRINT6ADDR(next_hop);
+  PRINTF("\n");
+
+  return added;
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
 {
@@ -267,6 +296,7 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_link_neighbor_callback triggering update\n");
         parent->flags |= RPL_PARENT_FLAG_UPDATED;
+        rpl_update_parent_cost(parent);
       }
     }
   }
@@ -294,6 +324,7 @@ rpl_ipv6_neighbor_callback(uip_ds6_nbr_t *nbr)
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_ipv6_neighbor_callback infinite rank\n");
         p->flags |= RPL_PARENT_FLAG_UPDATED;
+        rpl_update_parent_cost(p);
       }
     }
   }
@@ -119,9 +119,28 @@ struct rpl_parent {
   rpl_rank_t rank;
   uint8_t dtsn;
   uint8_t flags;
+#if RPL_WITH_PARENT_HEAP
+  struct rpl_dag *heap_dag; /* DAG whose heaps hold the parent */
+  uint32_t heap_key;   /* Path cost and link metric, as ordered in the heaps */
+  clock_time_t fresh_since; /* Link statistics fresh from fresh_since */
+  clock_time_t fresh_for;   /* for fresh_for ticks, see link_stats_fresh_for() */
+  uint16_t heap_index[2]; /* Position in the heaps plus one, 0 if not in it */
+#endif /* RPL_WITH_PARENT_HEAP */
 };
 typedef struct rpl_parent rpl_parent_t;
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_PARENT_HEAP
+/* Binary min-heap of parents, ordered on their heap_key */
+struct rpl_parent_heap {
+  rpl_parent_t *entries[NBR_TABLE_MAX_NEIGHBORS];
+  uint16_t size;
+};
+
+/* The candidate parents of a DAG, and those of them with fresh links */
+#define RPL_PARENT_HEAP_CANDIDATES 0
+#define RPL_PARENT_HEAP_FRESH      1
+#endif /* RPL_WITH_PARENT_HEAP */
+/*---------------------------------------------------------------------------*/
 /* RPL DIO prefix suboption */
 struct rpl_prefix {
   uip_ipaddr_t prefix;
@@ -146,6 +165,9 @@ struct rpl_dag {
   struct rpl_instance *instance;
   rpl_prefix_t prefix_info;
   uint32_t lifetime;
+#if RPL_WITH_PARENT_HEAP
+  struct rpl_parent_heap parent_heaps[2];
+#endif /* RPL_WITH_PARENT_HEAP */
 };
 typedef struct rpl_dag rpl_dag_t;
 typedef struct rpl_instance rpl_instance_t;
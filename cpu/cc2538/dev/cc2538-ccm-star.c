@@ -79,8 +79,8 @@ set_key(const uint8_t *key)
 }
 /*---------------------------------------------------------------------------*/
 static void
-aead(const uint8_t *nonce, uint8_t *m, uint8_t m_len, const uint8_t *a,
-     uint8_t a_len, uint8_t *result, uint8_t mic_len, int forward)
+aead(const uint8_t *nonce, uint8_t *m, uint16_t m_len, const uint8_t *a,
+     uint16_t a_len, uint8_t *result, uint8_t mic_len, int forward)
 {
   uint16_t cdata_len;
   uint8_t crypto_enabled, ret;
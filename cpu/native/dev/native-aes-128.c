@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         AES-128 driver for the native platform.
+ */
+
+#include "dev/native-aes-128.h"
+#include "lib/aes-128-ttable.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <wmmintrin.h>
+#include <string.h>
+
+#define AESNI __attribute__((target("aes,sse2")))
+
+struct key_schedule {
+  uint8_t key[AES_128_KEY_LENGTH];
+  __m128i rk[11];
+};
+
+static struct key_schedule key_cache[NATIVE_AES_128_KEY_CACHE_SIZE];
+static uint16_t key_cache_used;
+static uint16_t key_cache_next;
+static const __m128i *rk;
+static const uint8_t zero_key[AES_128_KEY_LENGTH];
+
+/* 0 = not checked yet, 1 = AES-NI, 2 = table-driven fallback */
+static uint8_t mode;
+#define MODE_AESNI    1
+#define MODE_FALLBACK 2
+
+/*---------------------------------------------------------------------------*/
+static void
+check_cpu(void)
+{
+  __builtin_cpu_init();
+  mode = __builtin_cpu_supports("aes") ? MODE_AESNI : MODE_FALLBACK;
+}
+/*---------------------------------------------------------------------------*/
+static AESNI __m128i
+expand_step(__m128i k, __m128i assist)
+{
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+  return _mm_xor_si128(k, assist);
+}
+/* The round constant of aeskeygenassist must be an immediate */
+#define EXPAND(i, rcon) \
+  w[i] = expand_step(w[i - 1], _mm_aeskeygenassist_si128(w[i - 1], rcon))
+/*---------------------------------------------------------------------------*/
+static AESNI void
+expand_key(__m128i *w, const uint8_t *key)
+{
+  w[0] = _mm_loadu_si128((const __m128i *)key);
+  EXPAND(1, 0x01);
+  EXPAND(2, 0x02);
+  EXPAND(3, 0x04);
+  EXPAND(4, 0x08);
+  EXPAND(5, 0x10);
+  EXPAND(6, 0x20);
+  EXPAND(7, 0x40);
+  EXPAND(8, 0x80);
+  EXPAND(9, 0x1b);
+  EXPAND(10, 0x36);
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  struct key_schedule *ks;
+  uint16_t i;
+
+  if(!mode) {
+    check_cpu();
+  }
+  if(mode == MODE_FALLBACK) {
+    aes_128_ttable_driver.set_key(key);
+    return;
+  }
+
+  for(i = 0; i < key_cache_used; i++) {
+    if(memcmp(key_cache[i].key, key, AES_128_KEY_LENGTH) == 0) {
+      rk = key_cache[i].rk;
+      return;
+    }
+  }
+
+  ks = &key_cache[key_cache_next];
+  key_cache_next = (key_cache_next + 1) % NATIVE_AES_128_KEY_CACHE_SIZE;
+  if(key_cache_used < NATIVE_AES_128_KEY_CACHE_SIZE) {
+    key_cache_used++;
+  }
+  memcpy(ks->key, key, AES_128_KEY_LENGTH);
+  expand_key(ks->rk, key);
+  rk = ks->rk;
+}
+/*---------------------------------------------------------------------------*/
+static void
+forget_key(const uint8_t *key)
+{
+  uint16_t i;
+
+  if(mode != MODE_AESNI) {
+    aes_128_ttable_driver.forget_key(key);
+    return;
+  }
+
+  for(i = 0; i < key_cache_used; i++) {
+    if(memcmp(key_cache[i].key, key, AES_128_KEY_LENGTH) == 0) {
+      break;
+    }
+  }
+  if(i == key_cache_used) {
+    return;
+  }
+  if(rk == key_cache[i].rk) {
+    rk = NULL;
+  }
+
+  /* Move the last entry into the hole and refill the freed one next */
+  key_cache_used--;
+  if(i != key_cache_used) {
+    memcpy(&key_cache[i], &key_cache[key_cache_used], sizeof(key_cache[i]));
+    if(rk == key_cache[key_cache_used].rk) {
+      rk = key_cache[i].rk;
+    }
+  }
+  memset(&key_cache[key_cache_used], 0, sizeof(key_cache[key_cache_used]));
+  key_cache_next = key_cache_used;
+}
+/*---------------------------------------------------------------------------*/
+static AESNI void
+encrypt_aesni(uint8_t *state)
+{
+  __m128i s;
+  uint8_t round;
+
+  s = _mm_xor_si128(_mm_loadu_si128((__m128i *)state), rk[0]);
+  for(round = 1; round < 10; round++) {
+    s = _mm_aesenc_si128(s, rk[round]);
+  }
+  s = _mm_aesenclast_si128(s, rk[10]);
+  _mm_storeu_si128((__m128i *)state, s);
+}
+/*---------------------------------------------------------------------------*/
+/* Both blocks are in flight at once, hiding the latency of aesenc */
+static AESNI void
+encrypt2_aesni(uint8_t *block1, uint8_t *block2)
+{
+  __m128i s1, s2;
+  uint8_t round;
+
+  s1 = _mm_xor_si128(_mm_loadu_si128((__m128i *)block1), rk[0]);
+  s2 = _mm_xor_si128(_mm_loadu_si128((__m128i *)block2), rk[0]);
+  for(round = 1; round < 10; round++) {
+    s1 = _mm_aesenc_si128(s1, rk[round]);
+    s2 = _mm_aesenc_si128(s2, rk[round]);
+  }
+  s1 = _mm_aesenclast_si128(s1, rk[10]);
+  s2 = _mm_aesenclast_si128(s2, rk[10]);
+  _mm_storeu_si128((__m128i *)block1, s1);
+  _mm_storeu_si128((__m128i *)block2, s2);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *state)
+{
+  if(!mode || (mode == MODE_AESNI && !rk)) {
+    /* Encrypting before set_key behaves as with an all-zero key */
+    set_key(zero_key);
+  }
+  if(mode == MODE_AESNI) {
+    encrypt_aesni(state);
+  } else {
+    aes_128_ttable_driver.encrypt(state);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt2(uint8_t *block1, uint8_t *block2)
+{
+  if(!mode || (mode == MODE_AESNI && !rk)) {
+    set_key(zero_key);
+  }
+  if(mode == MODE_AESNI) {
+    encrypt2_aesni(block1, block2);
+  } else {
+    aes_128_ttable_driver.encrypt2(block1, block2);
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver native_aes_128_driver = {
+  set_key,
+  encrypt,
+  encrypt2,
+  forget_key
+};
+/*---------------------------------------------------------------------------*/
+#else /* defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) */
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  aes_128_ttable_driver.set_key(key);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *state)
+{
+  aes_128_ttable_driver.encrypt(state);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt2(uint8_t *block1, uint8_t *block2)
+{
+  aes_128_ttable_driver.encrypt2(block1, block2);
+}
+/*---------------------------------------------------------------------------*/
+static void
+forget_key(const uint8_t *key)
+{
+  aes_128_ttable_driver.forget_key(key);
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver native_aes_128_driver = {
+  set_key,
+  encrypt,
+  encrypt2,
+  forget_key
+};
+/*---------------------------------------------------------------------------*/
+#endif /* defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ *         SSE2 (and AVX2, when enabled with -mavx2) version of the
+ *         Internet checksum for the native platform.
+ */
+
+#include "net/ip/uip.h"
+#include "net/ip/uip-chksum.h"
+
+#if UIP_ARCH_CHKSUM_ADD && defined(__SSE2__)
+
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif /* __AVX2__ */
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+/*
+ * The 16-bit words are zero-extended into 32-bit lanes and added
+ * without carry handling. A lane gets at most two words per 16 (or
+ * 32) bytes, so with len < 64 kbytes the lanes cannot overflow.
+ */
+uint16_t
+uip_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i vacc, vacc2, v;
+  uint32_t lanes[4];
+  uint64_t acc;
+  uint16_t t;
+
+  vacc = vacc2 = zero;
+
+#ifdef __AVX2__
+  {
+    const __m256i zero256 = _mm256_setzero_si256();
+    __m256i vacc256, v256;
+
+    vacc256 = zero256;
+    while(len >= 32) {
+      v256 = _mm256_loadu_si256((const __m256i *)data);
+      vacc256 = _mm256_add_epi32(vacc256,
+                                 _mm256_unpacklo_epi16(v256, zero256));
+      vacc256 = _mm256_add_epi32(vacc256,
+                                 _mm256_unpackhi_epi16(v256, zero256));
+      data += 32;
+      len -= 32;
+    }
+    vacc = _mm_add_epi32(_mm256_castsi256_si128(vacc256),
+                         _mm256_extracti128_si256(vacc256, 1));
+  }
+#endif /* __AVX2__ */
+
+  while(len >= 32) {
+    v = _mm_loadu_si128((const __m128i *)data);
+    vacc = _mm_add_epi32(vacc, _mm_unpacklo_epi16(v, zero));
+    vacc = _mm_add_epi32(vacc, _mm_unpackhi_epi16(v, zero));
+    v = _mm_loadu_si128((const __m128i *)(data + 16));
+    vacc2 = _mm_add_epi32(vacc2, _mm_unpacklo_epi16(v, zero));
+    vacc2 = _mm_add_epi32(vacc2, _mm_unpackhi_epi16(v, zero));
+    data += 32;
+    len -= 32;
+  }
+  vacc = _mm_add_epi32(vacc, vacc2);
+  if(len >= 16) {
+    v = _mm_loadu_si128((const __m128i *)data);
+    vacc = _mm_add_epi32(vacc, _mm_unpacklo_epi16(v, zero));
+    vacc = _mm_add_epi32(vacc, _mm_unpackhi_epi16(v, zero));
+    data += 16;
+    len -= 16;
+  }
+
+  _mm_storeu_si128((__m128i *)lanes, vacc);
+  acc = (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+  while(len >= 2) {
+    memcpy(&t, data, 2);
+    acc += t;
+    data += 2;
+    len -= 2;
+  }
+  if(len == 1) {
+    t = 0;
+    *(uint8_t *)&t = *data;
+    acc += t;
+  }
+
+  while(acc >> 16) {
+    acc = (acc & 0xffff) + (acc >> 16);
+  }
+
+  /* Return sum in host byte order. */
+  return uip_chksum_add16(sum, uip_ntohs((uint16_t)acc));
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_ARCH_CHKSUM_ADD && __SSE2__ */
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ *         Throughput benchmark for the IP64 translation path.
+ *
+ *         Pre-generated traces of IPv6 and IPv4 packets, for a range
+ *         of flow counts and packet sizes, are fed through
+ *         ip64_6to4() and ip64_4to6(), and the number of packets per
+ *         second and nanoseconds per packet are reported. The
+ *         address mapping lookups, the Internet checksum and the
+ *         DNS64 rewriting are also timed on their own, to show where
+ *         the time goes. Run with TARGET=native.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "ip64.h"
+#include "ip64-addrmap.h"
+#include "ip64-dns64.h"
+#include "net/ip/uip-chksum.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS 200000
+#endif /* ITERATIONS */
+
+/* The trace cycles through TRACE_LEN packets, spread over the flows */
+#define TRACE_LEN  IP64_ADDRMAP_CONF_ENTRIES
+#define MAX_PACKET (40 + 1280)
+
+static const uint16_t flow_counts[] = { 1, 16, 256, IP64_ADDRMAP_CONF_ENTRIES };
+static const uint16_t packet_sizes[] = { 64, 512, 1280 };
+
+#define IPV6_HDRLEN 40
+#define IPV4_HDRLEN 20
+#define TCP_HDRLEN  20
+#define UDP_HDRLEN   8
+
+#define DNS_PORT 53
+
+static uint8_t trace6[TRACE_LEN][MAX_PACKET];
+static uint8_t trace4[TRACE_LEN][MAX_PACKET];
+static uint16_t trace6_len[TRACE_LEN];
+static uint16_t trace4_len[TRACE_LEN];
+static uint8_t out[UIP_BUFSIZE];
+
+static volatile uint32_t sink;
+
+PROCESS(ip64_benchmark_process, "IP64 benchmark");
+AUTOSTART_PROCESSES(&ip64_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *what, unsigned flows, unsigned size,
+       unsigned long n, uint64_t ns)
+{
+  printf("%-22s flows %5u size %5u: %9lu pkt/s %7lu ns/pkt\n",
+         what, flows, size,
+         (unsigned long)(ns ? n * 1000000000ULL / ns : 0),
+         (unsigned long)(ns / n));
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+transport_chksum(const uint8_t *addrs, uint16_t addrslen, uint8_t proto,
+                 const uint8_t *data, uint16_t len)
+{
+  uint16_t sum;
+
+  sum = uip_chksum_add(len + proto, addrs, addrslen);
+  sum = uip_chksum_add(sum, data, len);
+  return (uint16_t)~sum;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Build an IPv6 packet from flow number flow towards an IPv4 host,
+ * with a transport layer of len bytes. Returns the packet length.
+ */
+static uint16_t
+make_ipv6_packet(uint8_t *p, uint16_t flow, uint8_t proto, uint16_t len)
+{
+  uint16_t c, i;
+  uint8_t *t;
+
+  memset(p, 0, IPV6_HDRLEN);
+  p[0] = 0x60;
+  p[4] = len >> 8;
+  p[5] = len & 0xff;
+  p[6] = proto;
+  p[7] = 64;
+  /* Source fd00::1:<flow>, destination ::ffff:10.1.<flow> */
+  p[8] = 0xfd;
+  p[21] = 1;
+  p[22] = flow >> 8;
+  p[23] = flow & 0xff;
+  p[34] = p[35] = 0xff;
+  p[36] = 10;
+  p[37] = 1;
+  p[38] = flow >> 8;
+  p[39] = flow & 0xff;
+
+  t = &p[IPV6_HDRLEN];
+  for(i = 0; i < len; i++) {
+    t[i] = i * 7 + flow;
+  }
+  /* Source port 40000 + flow; the destination port is 80 for TCP and
+     DNS_PORT for UDP */
+  t[0] = (40000 + flow) >> 8;
+  t[1] = (40000 + flow) & 0xff;
+  t[2] = 0;
+  if(proto == UIP_PROTO_TCP) {
+    t[3] = 80;
+    t[12] = TCP_HDRLEN << 2;
+    t[13] = 0x10;     /* ACK */
+    t[16] = t[17] = 0;
+    c = uip_htons(transport_chksum(&p[8], 32, proto, t, len));
+    memcpy(&t[16], &c, 2);
+  } else {
+    t[3] = DNS_PORT;
+    t[4] = len >> 8;
+    t[5] = len & 0xff;
+    t[6] = t[7] = 0;
+    c = uip_htons(transport_chksum(&p[8], 32, proto, t, len));
+    memcpy(&t[6], &c, 2);
+  }
+  return IPV6_HDRLEN + len;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Turn a translated IPv4 packet into the reply from the IPv4 host by
+ * swapping the addresses and the ports. The checksums stay valid, as
+ * the one's complement sum does not depend on the order of the words.
+ */
+static void
+make_ipv4_reply(uint8_t *p)
+{
+  uint8_t tmp[4];
+
+  memcpy(tmp, &p[12], 4);
+  memcpy(&p[12], &p[16], 4);
+  memcpy(&p[16], tmp, 4);
+  memcpy(tmp, &p[IPV4_HDRLEN], 2);
+  memcpy(&p[IPV4_HDRLEN], &p[IPV4_HDRLEN + 2], 2);
+  memcpy(&p[IPV4_HDRLEN + 2], tmp, 2);
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark_flows(uint16_t flows, uint16_t size)
+{
+  unsigned long i;
+  uint64_t t;
+  int n;
+  uip_ip4addr_t ip4addr;
+  struct ip64_addrmap_entry *m;
+  uint16_t mapped_ports[TRACE_LEN];
+
+  ip64_addrmap_init();
+
+  for(i = 0; i < TRACE_LEN; i++) {
+    trace6_len[i] = make_ipv6_packet(trace6[i], i % flows, UIP_PROTO_TCP,
+                                     size);
+  }
+
+  /* The first pass creates the address mappings. */
+  t = now_ns();
+  for(i = 0; i < flows; i++) {
+    n = ip64_6to4(trace6[i], trace6_len[i], trace4[i]);
+    if(n <= 0) {
+      printf("ip64_6to4 failed for flow %lu\n", i);
+      return;
+    }
+    trace4_len[i] = n;
+  }
+  report("6to4 new flow", flows, size, flows, now_ns() - t);
+
+  for(i = 0; i < TRACE_LEN; i++) {
+    trace4_len[i] = ip64_6to4(trace6[i], trace6_len[i], trace4[i]);
+    make_ipv4_reply(trace4[i]);
+    mapped_ports[i] = (trace4[i][IPV4_HDRLEN + 2] << 8) +
+      trace4[i][IPV4_HDRLEN + 3];
+  }
+  if(ip64_4to6(trace4[0], trace4_len[0], out) == 0) {
+    printf("ip64_4to6 failed\n");
+    return;
+  }
+
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    sink += ip64_6to4(trace6[i % TRACE_LEN], trace6_len[i % TRACE_LEN], out);
+  }
+  report("ip64_6to4", flows, size, ITERATIONS, now_ns() - t);
+
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    sink += ip64_4to6(trace4[i % TRACE_LEN], trace4_len[i % TRACE_LEN], out);
+  }
+  report("ip64_4to6", flows, size, ITERATIONS, now_ns() - t);
+
+  /* Per-function breakdown */
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    const uint8_t *p = trace6[i % TRACE_LEN];
+    memcpy(&ip4addr, &p[36], 4);
+    m = ip64_addrmap_lookup((const uip_ip6addr_t *)&p[8],
+                            (p[40] << 8) + p[41], &ip4addr, 80,
+                            UIP_PROTO_TCP);
+    sink += (m != NULL);
+  }
+  report("  addrmap_lookup", flows, size, ITERATIONS, now_ns() - t);
+
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    m = ip64_addrmap_lookup_port(mapped_ports[i % TRACE_LEN], UIP_PROTO_TCP);
+    sink += (m != NULL);
+  }
+  report("  addrmap_lookup_port", flows, size, ITERATIONS, now_ns() - t);
+
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    sink += uip_chksum_add(0, &trace6[i % TRACE_LEN][IPV6_HDRLEN], size);
+  }
+  report("  full checksum", flows, size, ITERATIONS, now_ns() - t);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Build a DNS query for the AAAA record of www.example.com into the
+ * UDP payload at p. Returns the length of the query.
+ */
+static uint16_t
+make_dns_query(uint8_t *p)
+{
+  static const uint8_t query[] = {
+    0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+    0x00, 28, 0x00, 0x01
+  };
+
+  memcpy(p, query, sizeof(query));
+  return sizeof(query);
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark_dns64(void)
+{
+  static const uint8_t answer[] = {
+    0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04,
+    93, 184, 216, 34
+  };
+  uint8_t *q6, *r4;
+  uint16_t len, qlen, c;
+  unsigned long i;
+  uint64_t t;
+
+  ip64_addrmap_init();
+
+  /* Build the query and translate it once to set up the mapping. */
+  q6 = trace6[0];
+  make_ipv6_packet(q6, 0, UIP_PROTO_UDP, UDP_HDRLEN);
+  qlen = make_dns_query(&q6[IPV6_HDRLEN + UDP_HDRLEN]);
+  len = make_ipv6_packet(q6, 0, UIP_PROTO_UDP, UDP_HDRLEN + qlen);
+  make_dns_query(&q6[IPV6_HDRLEN + UDP_HDRLEN]);
+  /* make_ipv6_packet() filled the payload with a pattern before we
+     put the query there, so compute the UDP checksum again. */
+  q6[IPV6_HDRLEN + 6] = q6[IPV6_HDRLEN + 7] = 0;
+  c = uip_htons(transport_chksum(&q6[8], 32, UIP_PROTO_UDP,
+                                 &q6[IPV6_HDRLEN], UDP_HDRLEN + qlen));
+  memcpy(&q6[IPV6_HDRLEN + 6], &c, 2);
+  trace6_len[0] = len;
+
+  r4 = trace4[0];
+  trace4_len[0] = ip64_6to4(q6, len, r4);
+  if(trace4_len[0] == 0) {
+    printf("ip64_6to4 failed for the DNS query\n");
+    return;
+  }
+
+  /* Turn the translated query into a response with one A record. */
+  make_ipv4_reply(r4);
+  r4[IPV4_HDRLEN + UDP_HDRLEN + 2] |= 0x80;
+  r4[IPV4_HDRLEN + UDP_HDRLEN + 7] = 1;
+  memcpy(&r4[trace4_len[0]], answer, sizeof(answer));
+  trace4_len[0] += sizeof(answer);
+  len = trace4_len[0] - IPV4_HDRLEN;
+  r4[2] = trace4_len[0] >> 8;
+  r4[3] = trace4_len[0] & 0xff;
+  r4[IPV4_HDRLEN + 4] = len >> 8;
+  r4[IPV4_HDRLEN + 5] = len & 0xff;
+  r4[10] = r4[11] = 0;
+  c = uip_htons((uint16_t)~uip_chksum_add(0, r4, IPV4_HDRLEN));
+  memcpy(&r4[10], &c, 2);
+  r4[IPV4_HDRLEN + 6] = r4[IPV4_HDRLEN + 7] = 0;
+  c = uip_htons(transport_chksum(&r4[12], 8, UIP_PROTO_UDP,
+                                 &r4[IPV4_HDRLEN], len));
+  memcpy(&r4[IPV4_HDRLEN + 6], &c, 2);
+
+  if(ip64_4to6(r4, trace4_len[0], out) == 0) {
+    printf("ip64_4to6 failed for the DNS response\n");
+    return;
+  }
+
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    sink += ip64_6to4(q6, trace6_len[0], out);
+  }
+  report("ip64_6to4 DNS64", 1, trace6_len[0], ITERATIONS, now_ns() - t);
+
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    sink += ip64_4to6(r4, trace4_len[0], out);
+  }
+  report("ip64_4to6 DNS64", 1, trace4_len[0], ITERATIONS, now_ns() - t);
+
+  /* ip64_6to4() and ip64_4to6() copy the payload before they call
+     the DNS64 functions, so we do the same. */
+  memcpy(&out[IPV4_HDRLEN + UDP_HDRLEN], &q6[IPV6_HDRLEN + UDP_HDRLEN], qlen);
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    ip64_dns64_6to4(&q6[IPV6_HDRLEN + UDP_HDRLEN], qlen,
+                    &out[IPV4_HDRLEN + UDP_HDRLEN], qlen);
+  }
+  report("  ip64_dns64_6to4", 1, trace6_len[0], ITERATIONS, now_ns() - t);
+
+  memcpy(&out[IPV6_HDRLEN + UDP_HDRLEN], &r4[IPV4_HDRLEN + UDP_HDRLEN],
+         len - UDP_HDRLEN);
+  t = now_ns();
+  for(i = 0; i < ITERATIONS; i++) {
+    sink += ip64_dns64_4to6(&r4[IPV4_HDRLEN + UDP_HDRLEN],
+                            len - UDP_HDRLEN,
+                            &out[IPV6_HDRLEN + UDP_HDRLEN],
+                            len - UDP_HDRLEN);
+  }
+  report("  ip64_dns64_4to6", 1, trace4_len[0], ITERATIONS, now_ns() - t);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ip64_benchmark_process, ev, data)
+{
+  static uip_ip4addr_t ip4addr;
+  static uip_ip6addr_t ip6addr;
+  int i, j;
+
+  PROCESS_BEGIN();
+
+  ip64_init();
+  uip_ipaddr(&ip4addr, 192, 168, 1, 2);
+  ip64_set_hostaddr(&ip4addr);
+  uip_ipaddr(&ip4addr, 255, 255, 255, 0);
+  ip64_set_netmask(&ip4addr);
+  uip_ip6addr(&ip6addr, 0xfd00, 0, 0, 0, 0, 0, 0, 1);
+  ip64_set_ipv6_address(&ip6addr);
+
+  printf("IP64 benchmark, %lu packets per test\n",
+         (unsigned long)ITERATIONS);
+
+  for(i = 0; i < sizeof(flow_counts) / sizeof(flow_counts[0]); i++) {
+    for(j = 0; j < sizeof(packet_sizes) / sizeof(packet_sizes[0]); j++) {
+      benchmark_flows(flow_counts[i], packet_sizes[j]);
+    }
+  }
+  benchmark_dns64();
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -52,7 +52,32 @@
 #define PRINTF(...)
 #endif
 
-#define MAX_CALLBACKS 16
+/* The number of packets that may be in transit on the slip-radios */
+#ifdef BORDER_ROUTER_RDC_CONF_MAX_CALLBACKS
+#define MAX_CALLBACKS BORDER_ROUTER_RDC_CONF_MAX_CALLBACKS
+#else
+#define MAX_CALLBACKS 64
+#endif
+
+/* The session id sent to the slip-radios is one byte. It holds the
+   slot in callbacks[] and, in the remaining range, the generation of
+   the slot, so that a late report for a slot that has since been
+   reused is not taken for the new packet. */
+#if MAX_CALLBACKS > 256
+#error "BORDER_ROUTER_RDC_CONF_MAX_CALLBACKS must not exceed 256"
+#endif
+#define GENERATIONS (256 / MAX_CALLBACKS)
+
+/* A session that a radio has not reported on in this time may be reused */
+#define SESSION_TIMEOUT (4 * CLOCK_SECOND)
+
+/* The number of neighbors to remember the slip-radio of */
+#ifdef BORDER_ROUTER_RDC_CONF_NEIGHBORS
+#define NEIGHBORS BORDER_ROUTER_RDC_CONF_NEIGHBORS
+#else
+#define NEIGHBORS 64
+#endif
+
 static int callback_pos;
 
 /* a structure for calling back when packet data is coming back
@@ -62,39 +87,161 @@ struct tx_callback {
   void *ptr;
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+  clock_time_t time;
+  /* The number of radios that have not yet reported on the packet */
+  uint8_t pending;
+  uint8_t status;
+  uint8_t tx;
+  /* Incremented each time the slot is reused, modulo GENERATIONS */
+  uint8_t generation;
 };
 
 static struct tx_callback callbacks[MAX_CALLBACKS];
+
+/* The slip-radio that a neighbor was last heard on */
+struct radio_neighbor {
+  linkaddr_t addr;
+  uint8_t radio;
+  uint8_t used;
+};
+
+static struct radio_neighbor neighbors[NEIGHBORS];
+/*---------------------------------------------------------------------------*/
+static struct radio_neighbor *
+neighbor_entry(const linkaddr_t *addr)
+{
+  unsigned h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + addr->u8[i];
+  }
+  return &neighbors[h % NEIGHBORS];
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_set(const linkaddr_t *addr, int radio)
+{
+  struct radio_neighbor *n;
+
+  n = neighbor_entry(addr);
+  linkaddr_copy(&n->addr, addr);
+  n->radio = radio;
+  n->used = 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * The radio to send to a neighbor on. A neighbor that has not been
+ * heard from gets the radio with the fewest packets queued.
+ */
+static int
+neighbor_radio(const linkaddr_t *addr)
+{
+  struct radio_neighbor *n;
+  int i, best;
+
+  if(slip_radio_count() <= 1) {
+    return 0;
+  }
+
+  n = neighbor_entry(addr);
+  if(n->used && linkaddr_cmp(&n->addr, addr)) {
+    return n->radio;
+  }
+
+  best = 0;
+  for(i = 1; i < slip_radio_count(); i++) {
+    if(slip_radio_queued(i) < slip_radio_queued(best)) {
+      best = i;
+    }
+  }
+  neighbor_set(addr, best);
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * A neighbor did not ack on its radio. Try the next radio for the
+ * following packets until the neighbor is heard from again.
+ */
+static void
+neighbor_noack(const linkaddr_t *addr)
+{
+  struct radio_neighbor *n;
+
+  n = neighbor_entry(addr);
+  if(slip_radio_count() > 1 && n->used && linkaddr_cmp(&n->addr, addr)) {
+    n->radio = (n->radio + 1) % slip_radio_count();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+session_done(struct tx_callback *callback)
+{
+  packetbuf_clear();
+  packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
+  if(callback->status == MAC_TX_NOACK) {
+    neighbor_noack(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  }
+  mac_call_sent_callback(callback->cback, callback->ptr,
+                         callback->status, callback->tx);
+}
 /*---------------------------------------------------------------------------*/
 void packet_sent(uint8_t sessionid, uint8_t status, uint8_t tx)
 {
-  if(sessionid < MAX_CALLBACKS) {
+  if(sessionid / MAX_CALLBACKS < GENERATIONS) {
     struct tx_callback *callback;
-    callback = &callbacks[sessionid];
-    packetbuf_clear();
-    packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
-    mac_call_sent_callback(callback->cback, callback->ptr, status, tx);
+    callback = &callbacks[sessionid % MAX_CALLBACKS];
+    if(callback->pending == 0 ||
+       callback->generation != sessionid / MAX_CALLBACKS) {
+      PRINTF("*** ERROR: no packet in transit for session id %d\n", sessionid);
+      return;
+    }
+    /* A broadcast is sent on every radio, report the best outcome */
+    if(callback->status != MAC_TX_OK) {
+      callback->status = status;
+    }
+    if(tx > callback->tx) {
+      callback->tx = tx;
+    }
+    if(--callback->pending == 0) {
+      session_done(callback);
+    }
   } else {
     PRINTF("*** ERROR: too high session id %d\n", sessionid);
   }
 }
 /*---------------------------------------------------------------------------*/
 static int
-setup_callback(mac_callback_t sent, void *ptr)
+setup_callback(mac_callback_t sent, void *ptr, int pending)
 {
   struct tx_callback *callback;
-  int tmp = callback_pos;
-  callback = &callbacks[callback_pos];
+  int i, sid;
+
+  for(i = 0; i < MAX_CALLBACKS; i++) {
+    sid = (callback_pos + i) % MAX_CALLBACKS;
+    callback = &callbacks[sid];
+    if(callback->pending == 0 ||
+       clock_time() - callback->time > SESSION_TIMEOUT) {
+      break;
+    }
+  }
+  if(i == MAX_CALLBACKS) {
+    return -1;
+  }
+
   callback->cback = sent;
   callback->ptr = ptr;
   packetbuf_attr_copyto(callback->attrs, callback->addrs);
+  callback->time = clock_time();
+  callback->pending = pending;
+  callback->status = MAC_TX_ERR;
+  callback->tx = 0;
+  callback->generation = (callback->generation + 1) % GENERATIONS;
 
-  callback_pos++;
-  if(callback_pos >= MAX_CALLBACKS) {
-    callback_pos = 0;
-  }
+  callback_pos = (sid + 1) % MAX_CALLBACKS;
 
-  return tmp;
+  return sid;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -103,7 +250,8 @@ send_packet(mac_callback_t sent, void *ptr)
   int size;
   /* 3 bytes per packet attribute is required for serialization */
   uint8_t buf[PACKETBUF_NUM_ATTRS * 3 + PACKETBUF_SIZE + 3];
-  uint8_t sid;
+  const linkaddr_t *receiver;
+  int sid, radio, count, i;
 
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
 
@@ -124,17 +272,39 @@ send_packet(mac_callback_t sent, void *ptr)
     if(size < 0 || size + packetbuf_totlen() + 3 > sizeof(buf)) {
       PRINTF("br-rdc: send failed, too large header\n");
       mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+      return;
+    }
+
+    /* Broadcasts go out on every radio, unicasts on the neighbor's radio */
+    receiver = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+    if(linkaddr_cmp(receiver, &linkaddr_null)) {
+      radio = 0;
+      count = slip_radio_count();
     } else {
-      sid = setup_callback(sent, ptr);
+      radio = neighbor_radio(receiver);
+      count = slip_radio_count() > 0 ? 1 : 0;
+    }
 
+    if(count == 0 || (sid = setup_callback(sent, ptr, count)) < 0) {
+      PRINTF("br-rdc: send failed, no free session\n");
+      mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
+    } else {
       buf[0] = '!';
       buf[1] = 'S';
-      buf[2] = sid; /* sequence or session number for this packet */
+      /* sequence or session number for this packet */
+      buf[2] = sid + MAX_CALLBACKS * callbacks[sid].generation;
 
       /* Copy packet data */
       memcpy(&buf[3 + size], packetbuf_hdrptr(), packetbuf_totlen());
 
-      write_to_slip(buf, packetbuf_totlen() + size + 3);
+      for(i = radio; i < radio + count; i++) {
+        if(!write_to_slip_radio(i, buf, packetbuf_totlen() + size + 3)) {
+          PRINTF("br-rdc: send failed, slip-radio %d busy\n", i);
+          if(--callbacks[sid].pending == 0) {
+            mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
+          }
+        }
+      }
     }
   }
 }
@@ -154,6 +324,9 @@ packet_input(void)
   if(NETSTACK_FRAMER.parse() < 0) {
     PRINTF("br-rdc: failed to parse %u\n", packetbuf_datalen());
   } else {
+    if(slip_radio_count() > 1) {
+      neighbor_set(packetbuf_addr(PACKETBUF_ADDR_SENDER), slip_radio_input());
+    }
     NETSTACK_MAC.input();
   }
 }
@@ -180,6 +353,8 @@ static void
 init(void)
 {
   callback_pos = 0;
+  memset(callbacks, 0, sizeof(callbacks));
+  memset(neighbors, 0, sizeof(neighbors));
 }
 /*---------------------------------------------------------------------------*/
 const struct rdc_driver border_router_rdc_driver = {
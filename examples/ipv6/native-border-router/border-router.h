@@ -41,9 +41,20 @@
 #include "net/ip/uip.h"
 #include <stdio.h>
 
+/* Maximum number of slip-radios */
+#ifdef SLIP_DEV_CONF_RADIOS
+#define SLIP_DEV_RADIOS SLIP_DEV_CONF_RADIOS
+#else
+#define SLIP_DEV_RADIOS 4
+#endif
+
 int border_router_cmd_handler(const uint8_t *data, int len);
 int slip_config_handle_arguments(int argc, char **argv);
-void write_to_slip(const uint8_t *buf, int len);
+int write_to_slip(const uint8_t *buf, int len);
+int write_to_slip_radio(int radio, const uint8_t *buf, int len);
+int slip_radio_count(void);
+int slip_radio_input(void);
+int slip_radio_queued(int radio);
 
 void border_router_set_prefix_64(const uip_ipaddr_t *prefix_64);
 void border_router_set_mac(const uint8_t *data);
@@ -52,7 +63,7 @@ void border_router_print_stat(void);
 
 void tun_init(void);
 
-int slip_init(void);
+void slip_init(void);
 int slip_set_fd(int maxfd, fd_set *rset, fd_set *wset);
 void slip_handle_fd(fd_set *rset, fd_set *wset);
 
@@ -46,12 +46,15 @@
 #include <sys/ioctl.h>
 #include <err.h>
 #include "contiki.h"
+#include "border-router.h"
 
 int slip_config_verbose = 0;
 const char *slip_config_ipaddr;
 int slip_config_flowcontrol = 0;
 int slip_config_timestamp = 0;
 const char *slip_config_siodev = NULL;
+const char *slip_config_siodevs[SLIP_DEV_RADIOS];
+int slip_config_radios = 0;
 const char *slip_config_host = NULL;
 const char *slip_config_port = NULL;
 char slip_config_tundev[32] = { "" };
@@ -88,11 +91,15 @@ slip_config_handle_arguments(int argc, char **argv)
       break;
 
     case 's':
+      if(slip_config_radios == SLIP_DEV_RADIOS) {
+        errx(1, "at most %d slip-radios", SLIP_DEV_RADIOS);
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	slip_config_siodev = optarg + 5;
+	slip_config_siodevs[slip_config_radios++] = optarg + 5;
       } else {
-	slip_config_siodev = optarg;
+	slip_config_siodevs[slip_config_radios++] = optarg;
       }
+      slip_config_siodev = slip_config_siodevs[0];
       break;
 
     case 't':
@@ -135,6 +142,7 @@ fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default 115200)\n
 fprintf(stderr," -H             Hardware CTS/RTS flow control (default disabled)\n");
 fprintf(stderr," -L             Log output format (adds time stamps)\n");
 fprintf(stderr," -s siodev      Serial device (default /dev/ttyUSB0)\n");
+fprintf(stderr,"                Repeat to use up to %d slip-radios\n", SLIP_DEV_RADIOS);
 fprintf(stderr," -a host        Connect via TCP to server at <host>\n");
 fprintf(stderr," -p port        Connect via TCP to server at <host>:<port>\n");
 fprintf(stderr," -t tundev      Name of interface (default tun0)\n");
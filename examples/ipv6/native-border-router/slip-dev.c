@@ -54,11 +54,14 @@
 #include "net/netstack.h"
 #include "net/packetbuf.h"
 #include "cmd.h"
+#include "border-router.h"
 #include "border-router-cmds.h"
 
 extern int slip_config_verbose;
 extern int slip_config_flowcontrol;
 extern const char *slip_config_siodev;
+extern const char *slip_config_siodevs[SLIP_DEV_RADIOS];
+extern int slip_config_radios;
 extern const char *slip_config_host;
 extern const char *slip_config_port;
 extern uint16_t slip_config_basedelay;
@@ -70,15 +73,37 @@ extern speed_t slip_config_b_rate;
 #define SEND_DELAY 0
 #endif
 
-int devopen(const char *dev, int flags);
+/* Size of the output buffer of each slip-radio */
+#ifdef SLIP_DEV_CONF_BUFFER_SIZE
+#define SLIP_BUFFER_SIZE SLIP_DEV_CONF_BUFFER_SIZE
+#else
+#define SLIP_BUFFER_SIZE 8192
+#endif
 
-static FILE *inslip;
+int devopen(const char *dev, int flags);
 
 /* for statistics */
 long slip_sent = 0;
 long slip_received = 0;
 
-int slipfd = 0;
+/* A slip-radio connected over a TTY or a TCP connection */
+struct slip_radio {
+  int fd;
+  FILE *inslip;
+  const char *name;
+
+  unsigned char inbuf[2048];
+  int inbufptr;
+
+  unsigned char buf[SLIP_BUFFER_SIZE];
+  int end, begin, packet_end, packet_count;
+  struct timer send_delay_timer;
+};
+
+static struct slip_radio radios[SLIP_DEV_RADIOS];
+static int radio_count;
+/* The radio that the packet being input came from */
+static int input_radio;
 
 //#define PROGRESS(s) fprintf(stderr, s)
 #define PROGRESS(s) do { } while(0)
@@ -169,15 +194,33 @@ slip_packet_input(unsigned char *data, int len)
   NETSTACK_RDC.input();
 }
 /*---------------------------------------------------------------------------*/
+int
+slip_radio_input(void)
+{
+  return input_radio;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_radio_count(void)
+{
+  return radio_count;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_radio_queued(int radio)
+{
+  return radios[radio].packet_count;
+}
+/*---------------------------------------------------------------------------*/
 /*
- * Read from serial, when we have a packet call slip_packet_input. No output
- * buffering, input buffered by stdio.
+ * Read from the serial line of a radio, when we have a packet call
+ * slip_packet_input. Input buffered by stdio.
  */
-void
-serial_input(FILE *inslip)
+static void
+serial_input(struct slip_radio *r)
 {
-  static unsigned char inbuf[2048];
-  static int inbufptr = 0;
+  FILE *inslip = r->inslip;
+  unsigned char *inbuf = r->inbuf;
   int ret,i;
   unsigned char c;
 
@@ -188,9 +231,9 @@ serial_input(FILE *inslip)
 #endif
 
  read_more:
-  if(inbufptr >= sizeof(inbuf)) {
-     fprintf(stderr, "*** dropping large %d byte packet\n", inbufptr);
-     inbufptr = 0;
+  if(r->inbufptr >= sizeof(r->inbuf)) {
+     fprintf(stderr, "*** dropping large %d byte packet\n", r->inbufptr);
+     r->inbufptr = 0;
   }
   ret = fread(&c, 1, 1, inslip);
 #ifdef linux
@@ -206,28 +249,29 @@ serial_input(FILE *inslip)
   slip_received++;
   switch(c) {
   case SLIP_END:
-    if(inbufptr > 0) {
+    if(r->inbufptr > 0) {
       if(inbuf[0] == '!') {
 	command_context = CMD_CONTEXT_RADIO;
-	cmd_input(inbuf, inbufptr);
+	input_radio = r - radios;
+	cmd_input(inbuf, r->inbufptr);
       } else if(inbuf[0] == '?') {
 #define DEBUG_LINE_MARKER '\r'
       } else if(inbuf[0] == DEBUG_LINE_MARKER) {
-	fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(inbuf, inbufptr)) {
+	fwrite(inbuf + 1, r->inbufptr - 1, 1, stdout);
+      } else if(is_sensible_string(inbuf, r->inbufptr)) {
         if(slip_config_verbose == 1) {   /* strings already echoed below for verbose>1 */
-          fwrite(inbuf, inbufptr, 1, stdout);
+          fwrite(inbuf, r->inbufptr, 1, stdout);
         }
       } else {
         if(slip_config_verbose > 2) {
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
+          printf("Packet from SLIP of length %d - write TUN\n", r->inbufptr);
           if(slip_config_verbose > 4) {
 #if WIRESHARK_IMPORT_FORMAT
             printf("0000");
-	    for(i = 0; i < inbufptr; i++) printf(" %02x", inbuf[i]);
+	    for(i = 0; i < r->inbufptr; i++) printf(" %02x", inbuf[i]);
 #else
             printf("         ");
-            for(i = 0; i < inbufptr; i++) {
+            for(i = 0; i < r->inbufptr; i++) {
               printf("%02x", inbuf[i]);
               if((i & 3) == 3) printf(" ");
               if((i & 15) == 15) printf("\n         ");
@@ -236,9 +280,10 @@ serial_input(FILE *inslip)
             printf("\n");
           }
         }
-	slip_packet_input(inbuf, inbufptr);
+	input_radio = r - radios;
+	slip_packet_input(inbuf, r->inbufptr);
       }
-      inbufptr = 0;
+      r->inbufptr = 0;
     }
     break;
 
@@ -260,7 +305,7 @@ serial_input(FILE *inslip)
     }
     /* FALLTHROUGH */
   default:
-    inbuf[inbufptr++] = c;
+    inbuf[r->inbufptr++] = c;
 
     /* Echo lines as they are received for verbose=2,3,5+ */
     /* Echo all printable characters for verbose==4 */
@@ -269,9 +314,9 @@ serial_input(FILE *inslip)
 	fwrite(&c, 1, 1, stdout);
       }
     } else if(slip_config_verbose >= 2) {
-      if(c == '\n' && is_sensible_string(inbuf, inbufptr)) {
-        fwrite(inbuf, inbufptr, 1, stdout);
-        inbufptr = 0;
+      if(c == '\n' && is_sensible_string(inbuf, r->inbufptr)) {
+        fwrite(inbuf, r->inbufptr, 1, stdout);
+        r->inbufptr = 0;
       }
     }
     break;
@@ -280,84 +325,93 @@ serial_input(FILE *inslip)
   goto read_more;
 }
 
-unsigned char slip_buf[2048];
-int slip_end, slip_begin, slip_packet_end, slip_packet_count;
-static struct timer send_delay_timer;
-/* delay between slip packets */
 static clock_time_t send_delay = SEND_DELAY;
 /*---------------------------------------------------------------------------*/
 static void
-slip_send(int fd, unsigned char c)
+slip_send(struct slip_radio *r, unsigned char c)
 {
-  if(slip_end >= sizeof(slip_buf)) {
-    err(1, "slip_send overflow");
-  }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  r->buf[r->end] = c;
+  r->end++;
   slip_sent++;
   if(c == SLIP_END) {
     /* Full packet received. */
-    slip_packet_count++;
-    if(slip_packet_end == 0) {
-      slip_packet_end = slip_end;
+    r->packet_count++;
+    if(r->packet_end == 0) {
+      r->packet_end = r->end;
     }
   }
 }
 /*---------------------------------------------------------------------------*/
-int
-slip_empty()
+static int
+slip_empty(struct slip_radio *r)
 {
-  return slip_packet_end == 0;
+  return r->packet_end == 0;
 }
 /*---------------------------------------------------------------------------*/
-void
-slip_flushbuf(int fd)
+/*
+ * Write queued packets to the radio. Without a delay between packets
+ * everything queued goes out in a single write.
+ */
+static void
+slip_flushbuf(struct slip_radio *r)
 {
-  int n;
+  int n, done;
 
-  if(slip_empty()) {
+  if(slip_empty(r)) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, slip_packet_end - slip_begin);
+  n = write(r->fd, r->buf + r->begin,
+            (send_delay > 0 ? r->packet_end : r->end) - r->begin);
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueue is full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_packet_end) {
-      slip_packet_count--;
-      if(slip_end > slip_packet_end) {
-        memcpy(slip_buf, slip_buf + slip_packet_end,
-               slip_end - slip_packet_end);
+    r->begin += n;
+    if(r->begin >= r->packet_end) {
+      /* Count the packets written completely */
+      for(done = 0, n = r->packet_end - 1; n < r->begin; n++) {
+        if(r->buf[n] == SLIP_END) {
+          done++;
+        }
       }
-      slip_end -= slip_packet_end;
-      slip_begin = slip_packet_end = 0;
-      if(slip_end > 0) {
+      r->packet_count -= done;
+      if(r->end > r->begin) {
+        memmove(r->buf, r->buf + r->begin, r->end - r->begin);
+      }
+      r->end -= r->begin;
+      r->begin = r->packet_end = 0;
+      if(r->end > 0) {
         /* Find end of next slip packet */
-        for(n = 1; n < slip_end; n++) {
-          if(slip_buf[n] == SLIP_END) {
-            slip_packet_end = n + 1;
+        for(n = 0; n < r->end; n++) {
+          if(r->buf[n] == SLIP_END) {
+            r->packet_end = n + 1;
             break;
           }
         }
         /* a delay between slip packets to avoid losing data */
         if(send_delay > 0) {
-          timer_set(&send_delay_timer, send_delay);
+          timer_set(&r->send_delay_timer, send_delay);
         }
       }
     }
   }
 }
 /*---------------------------------------------------------------------------*/
-static void
-write_to_serial(int outfd, const uint8_t *inbuf, int len)
+static int
+write_to_serial(struct slip_radio *r, const uint8_t *inbuf, int len)
 {
   const uint8_t *p = inbuf;
   int i;
 
+  /* Make sure that the packet fits even if every byte is escaped */
+  if(r->end + 2 * len + 1 > sizeof(r->buf)) {
+    PROGRESS("D");
+    return 0;
+  }
+
   if(slip_config_verbose > 2) {
 #ifdef __CYGWIN__
     printf("Packet from WPCAP of length %d - write SLIP\n", len);
@@ -383,34 +437,43 @@ write_to_serial(int outfd, const uint8_t *inbuf, int len)
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
+  /* slip_send(r, SLIP_END); */
 
   for(i = 0; i < len; i++) {
     switch(p[i]) {
     case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
+      slip_send(r, SLIP_ESC);
+      slip_send(r, SLIP_ESC_END);
       break;
     case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
+      slip_send(r, SLIP_ESC);
+      slip_send(r, SLIP_ESC_ESC);
       break;
     default:
-      slip_send(outfd, p[i]);
+      slip_send(r, p[i]);
       break;
     }
   }
-  slip_send(outfd, SLIP_END);
+  slip_send(r, SLIP_END);
   PROGRESS("t");
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
-/* writes an 802.15.4 packet to slip-radio */
-void
-write_to_slip(const uint8_t *buf, int len)
+/* writes an 802.15.4 packet to the given slip-radio */
+int
+write_to_slip_radio(int radio, const uint8_t *buf, int len)
 {
-  if(slipfd > 0) {
-    write_to_serial(slipfd, buf, len);
+  if(radio < 0 || radio >= radio_count) {
+    return 0;
   }
+  return write_to_serial(&radios[radio], buf, len);
+}
+/*---------------------------------------------------------------------------*/
+/* writes an 802.15.4 packet or a command to the first slip-radio */
+int
+write_to_slip(const uint8_t *buf, int len)
+{
+  return write_to_slip_radio(0, buf, len);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -459,88 +522,124 @@ stty_telos(int fd)
   if(tcflush(fd, TCIOFLUSH) == -1) err(1, "tcflush");
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * The same callback is registered for the file descriptor of every radio.
+ * handle_fd clears the descriptors it has served so that each radio is
+ * only served once per select.
+ */
 static int
 set_fd(fd_set *rset, fd_set *wset)
 {
-  /* Anything to flush? */
-  if(!slip_empty() && (send_delay == 0 || timer_expired(&send_delay_timer))) {
-    FD_SET(slipfd, wset);
-  }
+  struct slip_radio *r;
 
-  FD_SET(slipfd, rset);	/* Read from slip ASAP! */
+  for(r = radios; r < &radios[radio_count]; r++) {
+    /* Anything to flush? */
+    if(!slip_empty(r) &&
+       (send_delay == 0 || timer_expired(&r->send_delay_timer))) {
+      FD_SET(r->fd, wset);
+    }
+
+    FD_SET(r->fd, rset);	/* Read from slip ASAP! */
+  }
   return 1;
 }
 /*---------------------------------------------------------------------------*/
 static void
 handle_fd(fd_set *rset, fd_set *wset)
 {
-  if(FD_ISSET(slipfd, rset)) {
-    serial_input(inslip);
-  }
+  struct slip_radio *r;
 
-  if(FD_ISSET(slipfd, wset)) {
-    slip_flushbuf(slipfd);
+  for(r = radios; r < &radios[radio_count]; r++) {
+    if(FD_ISSET(r->fd, rset)) {
+      FD_CLR(r->fd, rset);
+      serial_input(r);
+    }
+
+    if(FD_ISSET(r->fd, wset)) {
+      FD_CLR(r->fd, wset);
+      slip_flushbuf(r);
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
 static const struct select_callback slip_callback = { set_fd, handle_fd };
 /*---------------------------------------------------------------------------*/
+static void
+radio_open(const char *siodev)
+{
+  struct slip_radio *r = &radios[radio_count];
+
+  r->fd = devopen(siodev, O_RDWR | O_NONBLOCK);
+  if(r->fd == -1) {
+    err(1, "can't open siodev ``/dev/%s''", siodev);
+  }
+  r->name = siodev;
+  radio_count++;
+}
+/*---------------------------------------------------------------------------*/
 void
 slip_init(void)
 {
+  struct slip_radio *r;
+  int i;
+
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
 
   if(slip_config_host != NULL) {
     if(slip_config_port == NULL) {
       slip_config_port = "60001";
     }
-    slipfd = connect_to_server(slip_config_host, slip_config_port);
-    if(slipfd == -1) {
+    radios[0].fd = connect_to_server(slip_config_host, slip_config_port);
+    if(radios[0].fd == -1) {
       err(1, "can't connect to ``%s:%s''", slip_config_host, slip_config_port);
     }
+    radios[0].name = slip_config_host;
+    radio_count = 1;
 
   } else if(slip_config_siodev != NULL) {
     if(strcmp(slip_config_siodev, "null") == 0) {
       /* Disable slip */
       return;
     }
-    slipfd = devopen(slip_config_siodev, O_RDWR | O_NONBLOCK);
-    if(slipfd == -1) {
-      err(1, "can't open siodev ``/dev/%s''", slip_config_siodev);
+    for(i = 0; i < slip_config_radios; i++) {
+      radio_open(slip_config_siodevs[i]);
     }
 
   } else {
     static const char *siodevs[] = {
       "ttyUSB0", "cuaU0", "ucom0" /* linux, fbsd6, fbsd5 */
     };
-    int i;
     for(i = 0; i < 3; i++) {
       slip_config_siodev = siodevs[i];
-      slipfd = devopen(slip_config_siodev, O_RDWR | O_NONBLOCK);
-      if(slipfd != -1) {
+      radios[0].fd = devopen(slip_config_siodev, O_RDWR | O_NONBLOCK);
+      if(radios[0].fd != -1) {
 	break;
       }
     }
-    if(slipfd == -1) {
+    if(radios[0].fd == -1) {
       err(1, "can't open siodev");
     }
+    radios[0].name = slip_config_siodev;
+    radio_count = 1;
   }
 
-  select_set_callback(slipfd, &slip_callback);
+  for(r = radios; r < &radios[radio_count]; r++) {
+    select_set_callback(r->fd, &slip_callback);
 
-  if(slip_config_host != NULL) {
-    fprintf(stderr, "********SLIP opened to ``%s:%s''\n", slip_config_host,
-	    slip_config_port);
-  } else {
-    fprintf(stderr, "********SLIP started on ``/dev/%s''\n", slip_config_siodev);
-    stty_telos(slipfd);
-  }
+    if(slip_config_host != NULL) {
+      fprintf(stderr, "********SLIP opened to ``%s:%s''\n", slip_config_host,
+	      slip_config_port);
+    } else {
+      fprintf(stderr, "********SLIP started on ``/dev/%s''\n", r->name);
+      stty_telos(r->fd);
+    }
 
-  timer_set(&send_delay_timer, 0);
-  slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) {
-    err(1, "main: fdopen");
+    timer_set(&r->send_delay_timer, 0);
+    slip_send(r, SLIP_END);
+    r->inslip = fdopen(r->fd, "r");
+    if(r->inslip == NULL) {
+      err(1, "main: fdopen");
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -69,6 +69,13 @@ extern const char *slip_config_ipaddr;
 extern char slip_config_tundev[32];
 extern uint16_t slip_config_basedelay;
 
+/* The maximum number of packets read from tun at a time */
+#ifdef TUN_BRIDGE_CONF_BATCH
+#define TUN_BATCH TUN_BRIDGE_CONF_BATCH
+#else
+#define TUN_BATCH 8
+#endif
+
 #ifndef __CYGWIN__
 static int tunfd;
 
@@ -208,6 +215,7 @@ tun_init()
 
   tunfd = tun_alloc(slip_config_tundev);
   if(tunfd == -1) err(1, "main: open");
+  fcntl(tunfd, F_SETFL, O_NONBLOCK);
 
   select_set_callback(tunfd, &tun_select_callback);
 
@@ -237,8 +245,12 @@ int
 tun_input(unsigned char *data, int maxlen)
 {
   int size;
-  if((size = read(tunfd, data, maxlen)) == -1)
+  if((size = read(tunfd, data, maxlen)) == -1) {
+    if(errno == EAGAIN) {
+      return 0;
+    }
     err(1, "tun_input: read");
+  }
   return size;
 }
 
@@ -291,20 +303,27 @@ handle_fd(fd_set *rset, fd_set *wset)
   }
 
   if(delaymsec==0) {
-    int size;
+    int size, i;
 
     if(FD_ISSET(tunfd, rset)) {
-      size = tun_input(&uip_buf[UIP_LLH_LEN], sizeof(uip_buf));
-      /* printf("TUN data incoming read:%d\n", size); */
-      uip_len = size;
-      tcpip_input();
-
-      if(slip_config_basedelay) {
-        struct timeval tv;
-      	gettimeofday(&tv, NULL) ;
-      	delaymsec=slip_config_basedelay;
-      	delaystartsec =tv.tv_sec;
-      	delaystartmsec=tv.tv_usec/1000;
+      /* Drain a batch of packets, or one if they are to be delayed */
+      for(i = 0; i < TUN_BATCH; i++) {
+        size = tun_input(&uip_buf[UIP_LLH_LEN], sizeof(uip_buf));
+        if(size <= 0) {
+          break;
+        }
+        /* printf("TUN data incoming read:%d\n", size); */
+        uip_len = size;
+        tcpip_input();
+
+        if(slip_config_basedelay) {
+          struct timeval tv;
+          gettimeofday(&tv, NULL) ;
+          delaymsec=slip_config_basedelay;
+          delaystartsec =tv.tv_sec;
+          delaystartmsec=tv.tv_usec/1000;
+          break;
+        }
       }
     }
   }
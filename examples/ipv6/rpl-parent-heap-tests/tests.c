@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Checks the parent heaps of RPL_CONF_WITH_PARENT_HEAP.
+ *
+ *         DIOs from virtual parents are fed through uip_input(). After
+ *         every step the heaps of each DAG are checked for consistency,
+ *         and the parent they select is compared with the one the
+ *         linear scan over all parents would pick.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#include "net/ipv6/uip-icmp6.h"
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+#include "net/link-stats.h"
+#include "net/packetbuf.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if !RPL_WITH_PARENT_HEAP
+#error "These tests need RPL_CONF_WITH_PARENT_HEAP"
+#endif
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_ICMP_BUF ((struct uip_icmp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+#define IPV6_HDRLEN 40
+#define ICMP_HDRLEN 4
+
+/* DIO flags, as in rpl-icmp6.c */
+#define DIO_GROUNDED  0x80
+#define DIO_MOP_SHIFT 3
+
+/* The virtual parents of each DAG */
+#define DAG_A_PARENTS 1
+#define DAG_B_PARENTS 20
+#define DAG_C_PARENTS 40
+#define PARENTS_PER_DAG 8
+
+static uip_ipaddr_t dag_a_id;
+static uip_ipaddr_t dag_b_id;
+static uip_ipaddr_t dag_c_id;
+
+/*---------------------------------------------------------------------------*/
+/* The link-layer address of virtual parent i, which is never 0 */
+static void
+parent_lladdr(linkaddr_t *lladdr, int i)
+{
+  memset(lladdr, 0, sizeof(*lladdr));
+  lladdr->u8[0] = 0x02;
+  lladdr->u8[LINKADDR_SIZE - 1] = i;
+}
+/*---------------------------------------------------------------------------*/
+static rpl_parent_t *
+find_parent(int i)
+{
+  linkaddr_t lladdr;
+
+  parent_lladdr(&lladdr, i);
+  return nbr_table_get_from_lladdr(rpl_parents, &lladdr);
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds a DIO for the given DAG from parent i through uip_input() */
+static void
+input_dio(const uip_ipaddr_t *dag_id, int i, uint16_t rank)
+{
+  static uip_ipaddr_t all_rpl_nodes;
+  linkaddr_t lladdr;
+  uint8_t *p;
+
+  uip_create_linklocal_rplnodes_mcast(&all_rpl_nodes);
+  parent_lladdr(&lladdr, i);
+
+  p = &uip_buf[UIP_LLH_LEN];
+  memset(p, 0, IPV6_HDRLEN + ICMP_HDRLEN);
+  p += IPV6_HDRLEN + ICMP_HDRLEN;
+  *p++ = RPL_DEFAULT_INSTANCE;
+  *p++ = RPL_LOLLIPOP_INIT;
+  *p++ = rank >> 8;
+  *p++ = rank & 0xff;
+  *p++ = DIO_GROUNDED | (RPL_MOP_DEFAULT << DIO_MOP_SHIFT);
+  *p++ = RPL_LOLLIPOP_INIT;
+  *p++ = 0;
+  *p++ = 0;
+  memcpy(p, dag_id, 16);
+  p += 16;
+  /* DAG configuration option */
+  *p++ = RPL_OPTION_DAG_CONF;
+  *p++ = 14;
+  *p++ = 0;
+  *p++ = RPL_DIO_INTERVAL_DOUBLINGS;
+  *p++ = RPL_DIO_INTERVAL_MIN;
+  *p++ = RPL_DIO_REDUNDANCY;
+  *p++ = RPL_MAX_RANKINC >> 8;
+  *p++ = RPL_MAX_RANKINC & 0xff;
+  *p++ = RPL_MIN_HOPRANKINC >> 8;
+  *p++ = RPL_MIN_HOPRANKINC & 0xff;
+  *p++ = RPL_OF_OCP >> 8;
+  *p++ = RPL_OF_OCP & 0xff;
+  *p++ = 0;
+  *p++ = RPL_DEFAULT_LIFETIME;
+  *p++ = RPL_DEFAULT_LIFETIME_UNIT >> 8;
+  *p++ = RPL_DEFAULT_LIFETIME_UNIT & 0xff;
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[1] = p - &uip_buf[UIP_LLH_LEN + IPV6_HDRLEN];
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = 255;
+  uip_create_linklocal_prefix(&UIP_IP_BUF->srcipaddr);
+  uip_ds6_set_addr_iid(&UIP_IP_BUF->srcipaddr, (uip_lladdr_t *)&lladdr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &all_rpl_nodes);
+  UIP_ICMP_BUF->type = ICMP6_RPL;
+  UIP_ICMP_BUF->icode = RPL_CODE_DIO;
+  uip_len = p - &uip_buf[UIP_LLH_LEN];
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  uip_ext_len = 0;
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &lladdr);
+  link_stats_input_callback(&lladdr);
+  uip_input();
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+/* Reports numtx transmissions to parent i, as the MAC layer does */
+static void
+link_sent(int i, int status, int numtx)
+{
+  linkaddr_t lladdr;
+
+  parent_lladdr(&lladdr, i);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &lladdr);
+  uip_ds6_link_neighbor_callback(status, numtx);
+}
+/*---------------------------------------------------------------------------*/
+/* The candidate test of the linear scan, before the heaps were added */
+static int
+is_candidate(rpl_dag_t *dag, rpl_parent_t *p)
+{
+  uip_ds6_nbr_t *nbr;
+
+  if(p->dag != dag || p->rank == INFINITE_RANK ||
+     dag->instance->of->best_parent(NULL, p) == NULL) {
+    return 0;
+  }
+  nbr = rpl_get_nbr(p);
+  return nbr != NULL && nbr->state == NBR_REACHABLE;
+}
+/*---------------------------------------------------------------------------*/
+/* Whether the heap is ordered, indexed and holds exactly the candidates */
+static int
+heap_is_valid(rpl_dag_t *dag, int w)
+{
+  struct rpl_parent_heap *h;
+  rpl_parent_t *p;
+  uint16_t i;
+  uint16_t n;
+
+  h = &dag->parent_heaps[w];
+  for(i = 0; i < h->size; i++) {
+    p = h->entries[i];
+    if(p == NULL || p->heap_dag != dag || p->heap_index[w] != i + 1 ||
+       (i > 0 && h->entries[(i - 1) / 2]->heap_key > p->heap_key)) {
+      return 0;
+    }
+  }
+
+  n = 0;
+  for(p = nbr_table_head(rpl_parents); p != NULL;
+      p = nbr_table_next(rpl_parents, p)) {
+    if(p->heap_dag == dag && p->heap_index[w] != 0) {
+      n++;
+    }
+    if(w == RPL_PARENT_HEAP_CANDIDATES &&
+       is_candidate(dag, p) != (p->heap_dag == dag && p->heap_index[w] != 0)) {
+      return 0;
+    }
+  }
+  return n == h->size;
+}
+/*---------------------------------------------------------------------------*/
+/* The parent the linear scan over all parents picks */
+static rpl_parent_t *
+linear_best(rpl_dag_t *dag)
+{
+  rpl_parent_t *p;
+  rpl_parent_t *best = NULL;
+
+  for(p = nbr_table_head(rpl_parents); p != NULL;
+      p = nbr_table_next(rpl_parents, p)) {
+    if(is_candidate(dag, p)) {
+      best = dag->instance->of->best_parent(best, p);
+    }
+  }
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+/* The parent the heap picks: its top, or the preferred parent if close */
+static rpl_parent_t *
+heap_best(rpl_dag_t *dag)
+{
+  struct rpl_parent_heap *h;
+  rpl_parent_t *best;
+
+  h = &dag->parent_heaps[RPL_PARENT_HEAP_CANDIDATES];
+  best = h->size > 0 ? h->entries[0] : NULL;
+  if(dag->preferred_parent != NULL && is_candidate(dag, dag->preferred_parent)) {
+    best = dag->instance->of->best_parent(best, dag->preferred_parent);
+  }
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *name)
+{
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  rpl_parent_t *p;
+  int ok;
+  int i;
+
+  ok = 1;
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  for(i = 0; instance != NULL && i < RPL_MAX_DAG_PER_INSTANCE; i++) {
+    dag = &instance->dag_table[i];
+    if(!dag->used) {
+      continue;
+    }
+    if(!heap_is_valid(dag, RPL_PARENT_HEAP_CANDIDATES) ||
+       !heap_is_valid(dag, RPL_PARENT_HEAP_FRESH) ||
+       linear_best(dag) != heap_best(dag)) {
+      ok = 0;
+    }
+  }
+
+  /* No parent may stay in the heaps of a DAG that has been freed */
+  for(p = nbr_table_head(rpl_parents); p != NULL;
+      p = nbr_table_next(rpl_parents, p)) {
+    if(p->heap_dag != NULL && !p->heap_dag->used) {
+      ok = 0;
+    }
+  }
+
+  printf("%s: %s\n", name, ok ? "Success" : "Failure");
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_parents_removed(const char *name, int first)
+{
+  int ok;
+  int i;
+
+  ok = 1;
+  for(i = 0; i < PARENTS_PER_DAG; i++) {
+    if(find_parent(first + i) != NULL) {
+      ok = 0;
+    }
+  }
+  printf("%s: %s\n", name, ok ? "Success" : "Failure");
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_tests(void)
+{
+  rpl_instance_t *instance;
+  rpl_dag_t *dag_b;
+  int i;
+
+  /* Distinct ranks, so that no two parents have the same cost */
+  for(i = 0; i < PARENTS_PER_DAG; i++) {
+    input_dio(&dag_a_id, DAG_A_PARENTS + i,
+              RPL_MIN_HOPRANKINC * 2 + 37 * ((i * 5) % PARENTS_PER_DAG));
+  }
+  check("add parents");
+
+  for(i = 0; i < PARENTS_PER_DAG; i++) {
+    input_dio(&dag_a_id, DAG_A_PARENTS + i,
+              RPL_MIN_HOPRANKINC * 2 + 41 * ((i * 3) % PARENTS_PER_DAG));
+  }
+  check("rank changes");
+
+  /* Transmissions change the link metric of some parents */
+  link_sent(DAG_A_PARENTS + 1, MAC_TX_NOACK, 4);
+  link_sent(DAG_A_PARENTS + 2, MAC_TX_OK, 3);
+  link_sent(DAG_A_PARENTS + 5, MAC_TX_OK, 1);
+  rpl_recalculate_ranks();
+  check("link metric changes");
+
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  if(instance == NULL || instance->current_dag == NULL) {
+    printf("did not join the DAG: Failure\n");
+    return;
+  }
+
+  /* Poison a parent, then remove the preferred one; the next DIO
+   * makes the node select a new preferred parent */
+  input_dio(&dag_a_id, DAG_A_PARENTS + 3, INFINITE_RANK);
+  check("infinite rank");
+  rpl_remove_parent(instance->current_dag->preferred_parent);
+  check("remove preferred parent");
+  input_dio(&dag_a_id, DAG_A_PARENTS + 6, RPL_MIN_HOPRANKINC * 2 + 3);
+  check("select new preferred parent");
+
+  /* A secondary DAG, worse than the one the node has joined */
+  for(i = 0; i < PARENTS_PER_DAG / 2; i++) {
+    input_dio(&dag_b_id, DAG_B_PARENTS + i,
+              RPL_MIN_HOPRANKINC * 6 + 29 * i);
+  }
+  check("add secondary DAG");
+  dag_b = find_parent(DAG_B_PARENTS) != NULL ?
+    find_parent(DAG_B_PARENTS)->dag : NULL;
+  if(dag_b == NULL || dag_b->joined) {
+    printf("secondary DAG: Failure\n");
+    return;
+  }
+
+  /* Free it without having joined, as rpl_purge_dags() does */
+  rpl_free_dag(dag_b);
+  check("free secondary DAG");
+  check_parents_removed("parents of freed DAG", DAG_B_PARENTS);
+
+  /* Its slot is reused by a better DAG, which the node joins */
+  for(i = 0; i < PARENTS_PER_DAG / 2; i++) {
+    input_dio(&dag_c_id, DAG_C_PARENTS + i,
+              RPL_MIN_HOPRANKINC + 31 * i);
+  }
+  check("join new DAG");
+
+  /* The DAG the node has left is kept, and so are its heaps */
+  for(i = 0; i < PARENTS_PER_DAG; i++) {
+    link_sent(DAG_A_PARENTS + i, MAC_TX_OK, 2);
+  }
+  for(i = 0; i < PARENTS_PER_DAG / 2; i++) {
+    link_sent(DAG_C_PARENTS + i, MAC_TX_OK, 1);
+  }
+  rpl_recalculate_ranks();
+  check("update parents of both DAGs");
+
+  /* Leave the new DAG by freeing the whole instance */
+  rpl_free_instance(instance);
+  check("free instance");
+  check_parents_removed("parents of freed instance", DAG_A_PARENTS);
+  input_dio(&dag_a_id, DAG_A_PARENTS + 4, RPL_MIN_HOPRANKINC * 3);
+  check("rejoin");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(rpl_parent_heap_tests_process, "RPL parent heap tests process");
+AUTOSTART_PROCESSES(&rpl_parent_heap_tests_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rpl_parent_heap_tests_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  uip_ip6addr(&dag_a_id, 0xfd00, 0, 0, 0, 0, 0, 0, 0xa);
+  uip_ip6addr(&dag_b_id, 0xfd00, 0, 0, 0, 0, 0, 0, 0xb);
+  uip_ip6addr(&dag_c_id, 0xfd00, 0, 0, 0, 0, 0, 0, 0xc);
+
+  run_tests();
+  printf("DONE\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
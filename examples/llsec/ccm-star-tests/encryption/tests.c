@@ -44,6 +44,7 @@
 #include "lib/ccm-star.h"
 #include "net/llsec/ccm-star-packetbuf.h"
 #include "net/mac/frame802154.h"
+#include "lib/crc16.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -127,6 +128,122 @@ test_sec_lvl_6()
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Round trip of a message that fills most of the 8-bit length range */
+static void
+test_long_message(uint8_t m_len, uint8_t mic_len)
+{
+  uint8_t key[16] = { 0xC0 , 0xC1 , 0xC2 , 0xC3 ,
+                      0xC4 , 0xC5 , 0xC6 , 0xC7 ,
+                      0xC8 , 0xC9 , 0xCA , 0xCB ,
+                      0xCC , 0xCD , 0xCE , 0xCF };
+  uint8_t nonce[13];
+  uint8_t a[8];
+  uint8_t m[255];
+  uint8_t mic[MIC_LEN];
+  uint8_t check[MIC_LEN];
+  uint16_t i;
+
+  printf("Testing %u-byte message with %u-byte MIC ... ", m_len, mic_len);
+
+  memset(nonce, 0xA5, sizeof(nonce));
+  memset(a, 0x5A, sizeof(a));
+  for(i = 0; i < m_len; i++) {
+    m[i] = i;
+  }
+
+  CCM_STAR.set_key(key);
+  CCM_STAR.aead(nonce, m, m_len, a, sizeof(a), mic, mic_len, 1);
+  CCM_STAR.aead(nonce, m, m_len, a, sizeof(a), check, mic_len, 0);
+
+  for(i = 0; i < m_len; i++) {
+    if(m[i] != i) {
+      break;
+    }
+  }
+  if(i == m_len && memcmp(mic, check, mic_len) == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Known answers for lengths beyond 8 bits. The oracles were computed
+ * with OpenSSL's AES-128-CCM. Instead of the whole ciphertext, only its
+ * CRC-16 is compared.
+ */
+static void
+test_known_answer(uint16_t a_len, uint16_t m_len, uint8_t mic_len,
+    const uint8_t *oracle_mic, uint16_t oracle_crc)
+{
+  static uint8_t a[300];
+  static uint8_t m[300];
+  uint8_t key[16] = { 0xC0 , 0xC1 , 0xC2 , 0xC3 ,
+                      0xC4 , 0xC5 , 0xC6 , 0xC7 ,
+                      0xC8 , 0xC9 , 0xCA , 0xCB ,
+                      0xCC , 0xCD , 0xCE , 0xCF };
+  uint8_t nonce[13];
+  uint8_t mic[16];
+  uint8_t check[16];
+  uint16_t crc;
+  uint16_t i;
+
+  printf("Testing %u-byte header and %u-byte message with %u-byte MIC ... ",
+      a_len, m_len, mic_len);
+
+  memset(nonce, 0xA5, sizeof(nonce));
+  for(i = 0; i < a_len; i++) {
+    a[i] = 0x5A ^ i;
+  }
+  for(i = 0; i < m_len; i++) {
+    m[i] = i;
+  }
+
+  CCM_STAR.set_key(key);
+  CCM_STAR.aead(nonce, m, m_len, a, a_len, mic, mic_len, 1);
+  crc = crc16_data(m, m_len, 0);
+  CCM_STAR.aead(nonce, m, m_len, a, a_len, check, mic_len, 0);
+
+  for(i = 0; i < m_len; i++) {
+    if(m[i] != (uint8_t)i) {
+      break;
+    }
+  }
+  if(i == m_len
+      && crc == oracle_crc
+      && (!mic_len
+          || (memcmp(mic, oracle_mic, mic_len) == 0
+              && memcmp(check, oracle_mic, mic_len) == 0))) {
+    printf("Success\n");
+  } else {
+    printf("Failure\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_long_lengths(void)
+{
+  static const uint8_t mic_8_256[8] = { 0x8F , 0x8D , 0x2C , 0x4B ,
+                                        0x01 , 0xDD , 0xC0 , 0x25 };
+  static const uint8_t mic_8_300[8] = { 0x18 , 0xE4 , 0x5C , 0xF5 ,
+                                        0x2B , 0xE1 , 0xE7 , 0x43 };
+  static const uint8_t mic_256_16[8] = { 0x48 , 0x22 , 0xFA , 0x05 ,
+                                         0x0E , 0x1B , 0x91 , 0x77 };
+  static const uint8_t mic_300_0[8] = { 0xBB , 0xBE , 0xC6 , 0xAF ,
+                                        0x6F , 0x6D , 0x5C , 0x7B };
+  static const uint8_t mic_0_300[16] = { 0xBF , 0x4F , 0x9A , 0x62 ,
+                                         0x2E , 0xF9 , 0x40 , 0x09 ,
+                                         0xB7 , 0x6E , 0xDD , 0xA3 ,
+                                         0x8D , 0x40 , 0x8A , 0x5F };
+
+  test_known_answer(8, 256, 8, mic_8_256, 0x886F);
+  test_known_answer(8, 300, 8, mic_8_300, 0x3CE5);
+  test_known_answer(8, 300, 0, NULL, 0x3CE5);
+  test_known_answer(256, 16, 8, mic_256_16, 0x8266);
+  test_known_answer(300, 0, 8, mic_300_0, 0x0000);
+  test_known_answer(0, 300, 16, mic_0_300, 0x3CE5);
+}
+/*---------------------------------------------------------------------------*/
 PROCESS(ccm_star_tests_process, "CCM* tests process");
 AUTOSTART_PROCESSES(&ccm_star_tests_process);
 /*---------------------------------------------------------------------------*/
@@ -135,6 +252,10 @@ PROCESS_THREAD(ccm_star_tests_process, ev, data)
   PROCESS_BEGIN();
   
   test_sec_lvl_6();
+  test_long_message(240, MIC_LEN);
+  test_long_message(240, 0);
+  test_long_message(255, MIC_LEN);
+  test_long_lengths();
   
   PROCESS_END();
 }
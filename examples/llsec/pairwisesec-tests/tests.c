@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Exchanges frames secured by pairwisesec between two nodes.
+ *
+ *         Both nodes run in the same process: before each step the
+ *         link-layer address is switched to the node that sends or
+ *         receives, and the frame is handed over as raw bytes.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/linkaddr.h"
+#include "net/nbr-table.h"
+#include "net/mac/framer.h"
+#include "net/llsec/anti-replay.h"
+#include "net/llsec/pairwisesec/pairwisesec.h"
+#include <stdio.h>
+#include <string.h>
+
+static const linkaddr_t node_a = {{ 0x00 , 0x12 , 0x4B , 0x00 ,
+                                    0x00 , 0x00 , 0x00 , 0x0A }};
+static const linkaddr_t node_b = {{ 0x00 , 0x12 , 0x4B , 0x00 ,
+                                    0x00 , 0x00 , 0x00 , 0x0B }};
+static const uint8_t key_ab[16] = { 0xC0 , 0xC1 , 0xC2 , 0xC3 ,
+                                    0xC4 , 0xC5 , 0xC6 , 0xC7 ,
+                                    0xC8 , 0xC9 , 0xCA , 0xCB ,
+                                    0xCC , 0xCD , 0xCE , 0xCF };
+static const uint8_t other_key[16] = { 0xD0 , 0xD1 , 0xD2 , 0xD3 ,
+                                       0xD4 , 0xD5 , 0xD6 , 0xD7 ,
+                                       0xD8 , 0xD9 , 0xDA , 0xDB ,
+                                       0xDC , 0xDD , 0xDE , 0xDF };
+static const char payload[] = "pairwisesec test payload";
+
+static uint8_t frame[PACKETBUF_SIZE];
+static int frame_len;
+static uint8_t saved_frame[PACKETBUF_SIZE];
+static int saved_frame_len;
+
+/*---------------------------------------------------------------------------*/
+/* Secures a frame from "from" to "to"; returns 0 if there is no key */
+static int
+send_frame(const linkaddr_t *from, const linkaddr_t *to)
+{
+  linkaddr_set_node_addr((linkaddr_t *)from);
+  packetbuf_clear();
+  packetbuf_copyfrom(payload, sizeof(payload));
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, to);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, from);
+  pairwisesec_framer.length();
+  anti_replay_set_counter();
+  if(pairwisesec_framer.create() < 0) {
+    return 0;
+  }
+  frame_len = packetbuf_totlen();
+  memcpy(frame, packetbuf_hdrptr(), frame_len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Hands the last frame to "to"; returns 1 if it was accepted */
+static int
+receive_frame(const linkaddr_t *to)
+{
+  linkaddr_set_node_addr((linkaddr_t *)to);
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), frame, frame_len);
+  packetbuf_set_datalen(frame_len);
+  if(pairwisesec_framer.parse() < 0) {
+    return 0;
+  }
+  return packetbuf_datalen() == sizeof(payload)
+      && memcmp(packetbuf_dataptr(), payload, sizeof(payload)) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save_frame(void)
+{
+  memcpy(saved_frame, frame, frame_len);
+  saved_frame_len = frame_len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore_frame(void)
+{
+  memcpy(frame, saved_frame, saved_frame_len);
+  frame_len = saved_frame_len;
+}
+/*---------------------------------------------------------------------------*/
+/* Installs keys for (or removes them from) a table's worth of neighbors */
+static void
+fill_neighbor_table(int install)
+{
+  linkaddr_t addr;
+  int i;
+
+  for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS; i++) {
+    linkaddr_copy(&addr, &node_a);
+    addr.u8[1] = 0x80 + i;
+    if(install) {
+      pairwisesec_set_key(&addr, other_key);
+    } else {
+      pairwisesec_remove_key(&addr);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *name, int ok)
+{
+  printf("%s: %s\n", name, ok ? "Success" : "Failure");
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_tests(void)
+{
+  /* Each node installs the key shared with the other */
+  pairwisesec_set_key(&node_b, key_ab);
+  pairwisesec_set_key(&node_a, key_ab);
+
+  check("unicast a to b",
+        send_frame(&node_a, &node_b) && receive_frame(&node_b));
+  check("unicast b to a",
+        send_frame(&node_b, &node_a) && receive_frame(&node_a));
+  check("replay rejected", !receive_frame(&node_a));
+
+  send_frame(&node_a, &node_b);
+  frame[frame_len - 1] ^= 0x01;
+  check("forgery rejected", !receive_frame(&node_b));
+
+  check("broadcast",
+        send_frame(&node_a, &linkaddr_null) && receive_frame(&node_b));
+
+  /* b now expects a different key from a */
+  pairwisesec_set_key(&node_a, other_key);
+  check("wrong key rejected",
+        send_frame(&node_a, &node_b) && !receive_frame(&node_b));
+
+  pairwisesec_remove_key(&node_a);
+  check("removed key rejected", !send_frame(&node_b, &node_a)
+        && send_frame(&node_a, &node_b) && !receive_frame(&node_b));
+
+  /* Installing a key again must not reset the anti-replay information */
+  pairwisesec_set_key(&node_a, key_ab);
+  check("key installed again",
+        send_frame(&node_a, &node_b) && receive_frame(&node_b));
+  save_frame();
+  pairwisesec_remove_key(&node_a);
+  pairwisesec_set_key(&node_a, key_ab);
+  restore_frame();
+  check("replay after key removal rejected", !receive_frame(&node_b));
+
+  pairwisesec_set_key(&node_a, other_key);
+  pairwisesec_set_key(&node_a, key_ab);
+  restore_frame();
+  check("replay after key replacement rejected", !receive_frame(&node_b));
+
+  check("new frame after re-keying",
+        send_frame(&node_a, &node_b) && receive_frame(&node_b));
+
+  /* Keys for more neighbors than fit must not evict node a */
+  save_frame();
+  pairwisesec_remove_key(&node_a);
+  fill_neighbor_table(1);
+  fill_neighbor_table(0);
+  pairwisesec_set_key(&node_a, key_ab);
+  restore_frame();
+  check("replay after neighbor table overflow rejected",
+        !receive_frame(&node_b));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(pairwisesec_tests_process, "pairwisesec tests process");
+AUTOSTART_PROCESSES(&pairwisesec_tests_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(pairwisesec_tests_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  run_tests();
+  printf("DONE\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
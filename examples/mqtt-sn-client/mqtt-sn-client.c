@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         An MQTT-SN client that publishes a counter and listens for
+ *         commands.
+ *
+ *         Every PUBLISH_INTERVAL the client publishes a reading with QoS 0
+ *         and, every fourth time, a status message with QoS 1. Messages on
+ *         the command topic are printed. Between publications the client
+ *         sleeps, and the gateway buffers commands for it.
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "mqtt-sn.h"
+#include <stdio.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#ifdef MQTT_SN_CLIENT_CONF_GATEWAY
+#define GATEWAY MQTT_SN_CLIENT_CONF_GATEWAY
+#else
+#define GATEWAY "fd00::1"
+#endif
+
+#define PUBLISH_INTERVAL   (30 * CLOCK_SECOND)
+#define RECONNECT_INTERVAL (10 * CLOCK_SECOND)
+#define KEEP_ALIVE         60
+#define SLEEP_DURATION     60
+
+#define READING_TOPIC      "contiki/reading"
+#define STATUS_TOPIC       "contiki/status"
+#define COMMAND_TOPIC      "contiki/cmd"
+/*---------------------------------------------------------------------------*/
+PROCESS(mqtt_sn_client_process, "MQTT-SN client");
+AUTOSTART_PROCESSES(&mqtt_sn_client_process);
+/*---------------------------------------------------------------------------*/
+static struct mqtt_sn_connection conn;
+static char client_id[] = "contiki-mqtt-sn";
+static struct etimer et;
+static uint16_t counter;
+static uint8_t subscribed;
+/*---------------------------------------------------------------------------*/
+static void
+event_callback(struct mqtt_sn_connection *c, mqtt_sn_event_t event,
+               void *data)
+{
+  struct mqtt_sn_message *msg;
+  struct mqtt_sn_ack_event *ack;
+
+  switch(event) {
+  case MQTT_SN_EVENT_CONNECTED:
+    printf("Connected to %s\n", GATEWAY);
+    if(!subscribed) {
+      mqtt_sn_subscribe(c, NULL, COMMAND_TOPIC, MQTT_SN_QOS_LEVEL_1);
+    }
+    break;
+  case MQTT_SN_EVENT_SUBACK:
+    ack = data;
+    subscribed = ack->return_code == 0;
+    printf("Subscribed to %s: %u\n", COMMAND_TOPIC, ack->return_code);
+    break;
+  case MQTT_SN_EVENT_PUBLISH:
+    msg = data;
+    printf("Command on %s: %.*s\n", msg->topic ? msg->topic : "?",
+           msg->payload_length, (const char *)msg->payload);
+    break;
+  case MQTT_SN_EVENT_PUBACK:
+    ack = data;
+    printf("Status %u acknowledged\n", ack->mid);
+    break;
+  case MQTT_SN_EVENT_ASLEEP:
+    printf("Asleep\n");
+    break;
+  case MQTT_SN_EVENT_DISCONNECTED:
+    printf("Disconnected\n");
+    subscribed = 0;
+    break;
+  default:
+    printf("Event 0x%02x\n", event);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+publish(void)
+{
+  char buf[24];
+  int len;
+
+  counter++;
+  len = snprintf(buf, sizeof(buf), "%u", counter);
+  mqtt_sn_publish(&conn, NULL, READING_TOPIC, (uint8_t *)buf, len,
+                  MQTT_SN_QOS_LEVEL_0, MQTT_SN_RETAIN_OFF);
+
+  if(counter % 4 == 0) {
+    len = snprintf(buf, sizeof(buf), "up, %u readings", counter);
+    mqtt_sn_publish(&conn, NULL, STATUS_TOPIC, (uint8_t *)buf, len,
+                    MQTT_SN_QOS_LEVEL_1, MQTT_SN_RETAIN_ON);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mqtt_sn_client_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  mqtt_sn_register(&conn, &mqtt_sn_client_process, client_id,
+                   event_callback);
+  etimer_set(&et, RECONNECT_INTERVAL);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+    if(conn.state == MQTT_SN_CONN_STATE_NOT_CONNECTED ||
+       conn.state == MQTT_SN_CONN_STATE_ASLEEP) {
+      /* Connecting also ends the sleep of a sleeping client */
+      mqtt_sn_connect(&conn, GATEWAY, MQTT_SN_DEFAULT_PORT, KEEP_ALIVE);
+      etimer_set(&et, RECONNECT_INTERVAL);
+    } else if(mqtt_sn_connected(&conn)) {
+      publish();
+      /* Send the readings and the status, then sleep until the next round */
+      mqtt_sn_sleep(&conn, SLEEP_DURATION);
+      etimer_set(&et, PUBLISH_INTERVAL);
+    } else {
+      etimer_set(&et, RECONNECT_INTERVAL);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Example of how the sink of the collect primitive receives
+ *         packets in batches and keeps per-source statistics.
+ *
+ *         Build with COLLECT_CONF_BATCH_SIZE > 0, as project-conf.h
+ *         in this directory does, for recv_batch to be used. It has a
+ *         directory of its own so that the setting does not change
+ *         collect for the other rime examples.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/rime/rime.h"
+#include "net/rime/collect.h"
+#include "net/queuebuf.h"
+
+#include <stdio.h>
+
+static struct collect_conn tc;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(example_collect_batch_process, "Test collect batch process");
+AUTOSTART_PROCESSES(&example_collect_batch_process);
+/*---------------------------------------------------------------------------*/
+static void
+print_source_stats(struct collect_conn *c, const linkaddr_t *originator)
+{
+  struct collect_source_stats stats;
+
+  if(collect_get_source_stats(c, originator, &stats)) {
+    printf("  %d.%d: received %u, lost %u, duplicates %u\n",
+           originator->u8[0], originator->u8[1],
+           stats.received, stats.lost, stats.duplicates);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv_batch(struct collect_conn *c, const struct collect_packet *packets,
+           int count)
+{
+  int i;
+
+  printf("Sink got %d messages\n", count);
+  for(i = 0; i < count; i++) {
+    printf("  from %d.%d, seqno %d, hops %d: len %d '%s'\n",
+           packets[i].originator.u8[0], packets[i].originator.u8[1],
+           packets[i].seqno, packets[i].hops,
+           queuebuf_datalen(packets[i].q),
+           (char *)queuebuf_dataptr(packets[i].q));
+  }
+  for(i = 0; i < count; i++) {
+    print_source_stats(c, &packets[i].originator);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv(const linkaddr_t *originator, uint8_t seqno, uint8_t hops)
+{
+  /* Without batching, or when no queuebuf was free for the batch */
+  printf("Sink got message from %d.%d, seqno %d, hops %d: len %d '%s'\n",
+         originator->u8[0], originator->u8[1],
+         seqno, hops,
+         packetbuf_datalen(),
+         (char *)packetbuf_dataptr());
+  print_source_stats(&tc, originator);
+}
+/*---------------------------------------------------------------------------*/
+static const struct collect_callbacks callbacks = { recv, recv_batch };
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(example_collect_batch_process, ev, data)
+{
+  static struct etimer periodic;
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  collect_open(&tc, 130, COLLECT_ROUTER, &callbacks);
+
+  if(linkaddr_node_addr.u8[0] == 1 &&
+     linkaddr_node_addr.u8[1] == 0) {
+    printf("I am sink\n");
+    collect_set_sink(&tc, 1);
+  }
+
+  /* Allow some time for the network to settle. */
+  etimer_set(&et, 120 * CLOCK_SECOND);
+  PROCESS_WAIT_UNTIL(etimer_expired(&et));
+
+  while(1) {
+
+    /* Send a packet every 10 seconds. */
+    if(etimer_expired(&periodic)) {
+      etimer_set(&periodic, CLOCK_SECOND * 10);
+      etimer_set(&et, random_rand() % (CLOCK_SECOND * 10));
+    }
+
+    PROCESS_WAIT_EVENT();
+
+    if(etimer_expired(&et)) {
+      printf("Sending\n");
+      packetbuf_clear();
+      packetbuf_set_datalen(sprintf(packetbuf_dataptr(),
+                                    "%s", "Hello") + 1);
+      collect_send(&tc, 15);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
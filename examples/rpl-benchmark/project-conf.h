@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+/* Room for the largest simulated DAG, see MAX_NODES in rpl-benchmark.c */
+#undef UIP_CONF_MAX_ROUTES
+#define UIP_CONF_MAX_ROUTES            10000
+#undef NBR_TABLE_CONF_MAX_NEIGHBORS
+#define NBR_TABLE_CONF_MAX_NEIGHBORS   10016
+#define RPL_NS_CONF_LINK_NUM           10001
+
+/* Both modes of operation, so that the root can run either */
+#define RPL_CONF_WITH_STORING          1
+#define RPL_CONF_WITH_NON_STORING      1
+
+/* DAO-ACKs complete the convergence of the root and are input to a node */
+#define RPL_CONF_WITH_DAO_ACK          1
+
+/* Set to 0 to compare with the linear parent scan */
+#define RPL_CONF_WITH_PARENT_HEAP      1
+
+/* Set to a number of clock ticks to aggregate the DAOs a router forwards */
+#ifndef RPL_CONF_DAO_AGGREGATION_WINDOW
+#define RPL_CONF_DAO_AGGREGATION_WINDOW 0
+#endif
+
+/* For counting the DAOs sent by a router */
+#define UIP_CONF_STATISTICS            1
+
+#endif /* PROJECT_CONF_H_ */
@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2016, TUMeshNet contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Scalability benchmark for RPL.
+ *
+ *         Synthetic DAO, DIO and DAO-ACK messages from up to
+ *         MAX_NODES virtual nodes are fed through uip_input() into
+ *         the RPL engine, without any radio. As a root, in storing
+ *         and in non-storing mode, the network is brought up from the
+ *         first DIO of the root, with the DAO of every node and the
+ *         DAO-ACK for it, until the routes of all nodes are installed;
+ *         the time for that, the control messages it takes and the time
+ *         to refresh the routes are measured. As a node, the
+ *         time to process DIOs from a growing number of candidate
+ *         parents and DAO-ACKs from the preferred parent is measured,
+ *         and as a router the number of DAOs it forwards.
+ *         Each run reports the cost per message and the memory held
+ *         by the routing state. Run with TARGET=native.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#include "net/ipv6/uip-ds6-route.h"
+#include "net/ipv6/uip-icmp6.h"
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+#include "net/link-stats.h"
+#include "net/packetbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_NODES 10000
+
+static const uint16_t node_counts[] = { 100, 1000, MAX_NODES };
+/* Candidate parents of a node; every DIO is checked against all of them */
+static const uint16_t parent_counts[] = { 10, 100, 1000 };
+
+/* Number of children of the root that forward the DAOs in storing mode */
+#define STORING_CHILDREN 8
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_ICMP_BUF ((struct uip_icmp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+#define IPV6_HDRLEN 40
+#define ICMP_HDRLEN 4
+
+/* DIO flags, as in rpl-icmp6.c */
+#define DIO_GROUNDED  0x80
+#define DIO_MOP_SHIFT 3
+
+#define MAX_MESSAGE 128
+
+static uint8_t messages[MAX_NODES][MAX_MESSAGE];
+static uint8_t message_len[MAX_NODES];
+static linkaddr_t message_lladdr[MAX_NODES];
+/* The tree of the root benchmark: parent and depth of each node */
+static int16_t node_parent[MAX_NODES];
+static uint8_t node_depth[MAX_NODES];
+static uint8_t node_has_children[MAX_NODES];
+static uip_ipaddr_t root_addr;
+static uip_ipaddr_t prefix;
+
+PROCESS(rpl_benchmark_process, "RPL benchmark");
+AUTOSTART_PROCESSES(&rpl_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *what, unsigned nodes, unsigned long n, uint64_t ns)
+{
+  printf("%-24s nodes %5u: %9lu msg/s %8lu ns/msg %8.2f ms total\n",
+         what, nodes,
+         (unsigned long)(ns ? n * 1000000000ULL / ns : 0),
+         (unsigned long)(n ? ns / n : 0), ns / 1e6);
+}
+/*---------------------------------------------------------------------------*/
+static void
+report_memory(const char *what, unsigned long entries, unsigned long size)
+{
+  printf("  %-22s %7lu entries x %4lu bytes = %9lu bytes\n",
+         what, entries, size, entries * size);
+}
+/*---------------------------------------------------------------------------*/
+/* The link-layer address of virtual node i, which is never 0 */
+static void
+node_lladdr(linkaddr_t *lladdr, int i)
+{
+  memset(lladdr, 0, sizeof(*lladdr));
+  lladdr->u8[0] = 0x02;
+  lladdr->u8[LINKADDR_SIZE - 3] = 0x10 + ((i >> 16) & 0xff);
+  lladdr->u8[LINKADDR_SIZE - 2] = i >> 8;
+  lladdr->u8[LINKADDR_SIZE - 1] = i & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static void
+node_addr(uip_ipaddr_t *addr, const uip_ipaddr_t *prefix, int i)
+{
+  linkaddr_t lladdr;
+
+  node_lladdr(&lladdr, i);
+  uip_ipaddr_copy(addr, prefix);
+  uip_ds6_set_addr_iid(addr, (uip_lladdr_t *)&lladdr);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write an ICMPv6 RPL message with the given payload into messages[n],
+ * including the IPv6 header and the checksum.
+ */
+static void
+make_message(int n, const uip_ipaddr_t *src, const uip_ipaddr_t *dst,
+             uint8_t code, const uint8_t *payload, uint8_t len)
+{
+  uint8_t *p;
+
+  p = &uip_buf[UIP_LLH_LEN];
+  memset(p, 0, IPV6_HDRLEN + ICMP_HDRLEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[1] = ICMP_HDRLEN + len;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, src);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, dst);
+  UIP_ICMP_BUF->type = ICMP6_RPL;
+  UIP_ICMP_BUF->icode = code;
+  memcpy(p + IPV6_HDRLEN + ICMP_HDRLEN, payload, len);
+  uip_len = IPV6_HDRLEN + ICMP_HDRLEN + len;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  memcpy(messages[n], p, uip_len);
+  message_len[n] = uip_len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_message(int n)
+{
+  memcpy(&uip_buf[UIP_LLH_LEN], messages[n], message_len[n]);
+  uip_len = message_len[n];
+  uip_ext_len = 0;
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &message_lladdr[n]);
+  /* What the MAC layer does for every received frame */
+  link_stats_input_callback(&message_lladdr[n]);
+  uip_input();
+  /* Drop whatever the input produced; there is nobody to send it to. */
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+/* Feed messages 0 ... count - 1 through uip_input() and report the time */
+static uint64_t
+input_messages(int count)
+{
+  uint64_t t;
+  int i;
+
+  t = now_ns();
+  for(i = 0; i < count; i++) {
+    input_message(i);
+  }
+  return now_ns() - t;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * A DAO for node i to dst. In non-storing mode it is sent by the node
+ * itself and names its parent in the transit option; in storing mode
+ * it is forwarded by one of the children of the receiver. Either way it
+ * arrives over the link from one of those children.
+ */
+static void
+make_dao(int n, int i, int parent, uint8_t mop, uint8_t sequence,
+         uint8_t flags, const uip_ipaddr_t *dst)
+{
+  uint8_t payload[4 + 20 + 22];
+  uip_ipaddr_t target;
+  uip_ipaddr_t parent_addr;
+  uip_ipaddr_t src;
+  uint8_t *p;
+
+  node_addr(&target, &prefix, i);
+  if(parent < 0) {
+    uip_ipaddr_copy(&parent_addr, &root_addr);
+  } else {
+    node_addr(&parent_addr, &prefix, parent);
+  }
+
+  p = payload;
+  *p++ = RPL_DEFAULT_INSTANCE;
+  *p++ = flags;
+  *p++ = 0;
+  *p++ = sequence;
+  /* Target option */
+  *p++ = RPL_OPTION_TARGET;
+  *p++ = 18;
+  *p++ = 0;
+  *p++ = 128;
+  memcpy(p, &target, 16);
+  p += 16;
+  /* Transit option with a lifetime of RPL_DEFAULT_LIFETIME units */
+  *p++ = RPL_OPTION_TRANSIT;
+  *p++ = 20;
+  *p++ = 0;
+  *p++ = 0;
+  *p++ = sequence;
+  *p++ = RPL_DEFAULT_LIFETIME;
+  memcpy(p, &parent_addr, 16);
+  p += 16;
+
+  if(mop == RPL_MOP_NON_STORING) {
+    uip_ipaddr_copy(&src, &target);
+  } else {
+    uip_create_linklocal_prefix(&src);
+    node_addr(&src, &src, MAX_NODES + i % STORING_CHILDREN);
+  }
+  node_lladdr(&message_lladdr[n], MAX_NODES + i % STORING_CHILDREN);
+  make_message(n, &src, dst, RPL_CODE_DAO, payload, p - payload);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+count_routing_entries(uint8_t mop)
+{
+  if(mop == RPL_MOP_NON_STORING) {
+    return rpl_ns_num_nodes();
+  }
+  return uip_ds6_route_num_routes();
+}
+/*---------------------------------------------------------------------------*/
+/* A random tree: the parent of node i is the root or an earlier node */
+static void
+make_tree(int nodes)
+{
+  int i;
+
+  memset(node_has_children, 0, sizeof(node_has_children));
+  for(i = 0; i < nodes; i++) {
+    if(i < STORING_CHILDREN || rand() % 8 == 0) {
+      node_parent[i] = -1;
+      node_depth[i] = 1;
+    } else {
+      node_parent[i] = rand() % i;
+      node_depth[i] = node_depth[node_parent[i]] + 1;
+      node_has_children[node_parent[i]] = 1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Bring up the DAG from the first DIO of the root. The DIO reaches the
+ * nodes one hop further in each round, and every node that hears it
+ * sends a DAO, which the root answers with a DAO-ACK. The routers on
+ * the way forward the DAOs and the DAO-ACKs, so one that travels over
+ * d hops costs d transmissions; the nodes with children send a DIO.
+ * Only the messages of the root are real, the others are counted.
+ */
+static void
+converge(uint8_t mop, int nodes)
+{
+  rpl_instance_t *instance;
+  unsigned long messages_sent;
+  unsigned long acks;
+  unsigned long entries;
+  uint64_t t;
+  uint64_t converged;
+  int depth;
+  int more;
+  int i;
+
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  converged = 0;
+  messages_sent = 0;
+
+  t = now_ns();
+  acks = uip_stat.icmp.sent;
+  dio_output(instance, NULL);
+  for(depth = 1, more = 1; more; depth++) {
+    more = 0;
+    for(i = 0; i < nodes; i++) {
+      if(node_depth[i] == depth - 1 && node_has_children[i]) {
+        /* The DIO of a router of the previous round */
+        messages_sent++;
+      } else if(node_depth[i] == depth) {
+        input_message(i);
+        /* The DAO on its way up and the DAO-ACK from the root down */
+        messages_sent += 2 * depth - 1;
+        more = 1;
+        entries = count_routing_entries(mop);
+        if(converged == 0 &&
+           (mop == RPL_MOP_NON_STORING ? entries - 1 : entries) >= nodes) {
+          converged = now_ns() - t;
+        }
+      }
+    }
+  }
+  /* The DIO and the DAO-ACKs sent by the root */
+  messages_sent += uip_stat.icmp.sent - acks;
+
+  if(converged == 0) {
+    printf("  not converged\n");
+  } else {
+    printf("  converged in %.2f ms, %lu control messages\n",
+           converged / 1e6, messages_sent);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark_root(uint8_t mop, int nodes)
+{
+  rpl_dag_t *dag;
+  unsigned long entries;
+  int i;
+  const char *name;
+
+  name = mop == RPL_MOP_NON_STORING ? "non-storing" : "storing";
+
+  uip_ds6_addr_add(&root_addr, 0, ADDR_MANUAL);
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, &root_addr);
+  if(dag == NULL) {
+    printf("rpl_set_root failed\n");
+    return;
+  }
+  rpl_set_prefix(dag, &prefix, 64);
+  dag->instance->mop = mop;
+
+  srand(nodes);
+  make_tree(nodes);
+  for(i = 0; i < nodes; i++) {
+    make_dao(i, i, node_parent[i], mop, 1, RPL_DAO_K_FLAG, &root_addr);
+  }
+
+  printf("Root, %s mode\n", name);
+  converge(mop, nodes);
+  entries = count_routing_entries(mop);
+
+  for(i = 0; i < nodes; i++) {
+    make_dao(i, i, (i < STORING_CHILDREN || rand() % 8 == 0) ?
+             -1 : rand() % i, mop, 2, 0, &root_addr);
+  }
+  report("  DAO, refresh/reparent", nodes, nodes, input_messages(nodes));
+
+  if(mop == RPL_MOP_NON_STORING) {
+    report_memory("rpl-ns nodes", entries, sizeof(rpl_ns_node_t));
+  } else {
+    report_memory("uip-ds6 routes", entries, sizeof(uip_ds6_route_t));
+  }
+  report_memory("uip-ds6 neighbors", uip_ds6_nbr_num(), sizeof(uip_ds6_nbr_t));
+}
+/*---------------------------------------------------------------------------*/
+/* A DIO from candidate parent i with the given rank */
+static void
+make_dio(int n, int i, uint16_t rank)
+{
+  static uip_ipaddr_t all_rpl_nodes;
+  uint8_t payload[24 + 16 + 32];
+  uip_ipaddr_t src;
+  uint8_t *p;
+
+  uip_create_linklocal_rplnodes_mcast(&all_rpl_nodes);
+
+  p = payload;
+  *p++ = RPL_DEFAULT_INSTANCE;
+  *p++ = RPL_LOLLIPOP_INIT;
+  *p++ = rank >> 8;
+  *p++ = rank & 0xff;
+  *p++ = DIO_GROUNDED | (RPL_MOP_DEFAULT << DIO_MOP_SHIFT);
+  *p++ = RPL_LOLLIPOP_INIT;
+  *p++ = 0;
+  *p++ = 0;
+  memcpy(p, &root_addr, 16);
+  p += 16;
+  /* DAG configuration option */
+  *p++ = RPL_OPTION_DAG_CONF;
+  *p++ = 14;
+  *p++ = 0;
+  *p++ = RPL_DIO_INTERVAL_DOUBLINGS;
+  *p++ = RPL_DIO_INTERVAL_MIN;
+  *p++ = RPL_DIO_REDUNDANCY;
+  *p++ = RPL_MAX_RANKINC >> 8;
+  *p++ = RPL_MAX_RANKINC & 0xff;
+  *p++ = RPL_MIN_HOPRANKINC >> 8;
+  *p++ = RPL_MIN_HOPRANKINC & 0xff;
+  *p++ = RPL_OF_OCP >> 8;
+  *p++ = RPL_OF_OCP & 0xff;
+  *p++ = 0;
+  *p++ = RPL_DEFAULT_LIFETIME;
+  *p++ = RPL_DEFAULT_LIFETIME_UNIT >> 8;
+  *p++ = RPL_DEFAULT_LIFETIME_UNIT & 0xff;
+  /* Prefix information option */
+  *p++ = RPL_OPTION_PREFIX_INFO;
+  *p++ = 30;
+  *p++ = 64;
+  *p++ = UIP_ND6_RA_FLAG_AUTONOMOUS;
+  memset(p, 0xff, 8);
+  p += 8;
+  memset(p, 0, 4);
+  p += 4;
+  memcpy(p, &prefix, 16);
+  p += 16;
+
+  node_lladdr(&message_lladdr[n], i);
+  uip_create_linklocal_prefix(&src);
+  node_addr(&src, &src, i);
+  make_message(n, &src, &all_rpl_nodes, RPL_CODE_DIO, payload, p - payload);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+count_parents(void)
+{
+  rpl_parent_t *p;
+  unsigned long n;
+
+  n = 0;
+  for(p = nbr_table_head(rpl_parents); p != NULL;
+      p = nbr_table_next(rpl_parents, p)) {
+    n++;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark_node(int nodes)
+{
+  rpl_instance_t *instance;
+  rpl_parent_t *parent;
+  uip_ipaddr_t *parent_addr;
+  uip_ipaddr_t dst;
+  uint8_t payload[4];
+  int i;
+
+  srand(nodes);
+  for(i = 0; i < nodes; i++) {
+    make_dio(i, i, RPL_MIN_HOPRANKINC * (1 + rand() % 8));
+  }
+
+  printf("Node, storing mode\n");
+  report("  DIO, new parents", nodes, nodes, input_messages(nodes));
+
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  if(instance == NULL || instance->current_dag == NULL) {
+    printf("  did not join the DAG\n");
+    return;
+  }
+
+  for(i = 0; i < nodes; i++) {
+    make_dio(i, i, RPL_MIN_HOPRANKINC * (1 + rand() % 8));
+  }
+  report("  DIO, rank changes", nodes, nodes, input_messages(nodes));
+
+  /* DAO-ACKs from the preferred parent for our current DAO */
+  parent = instance->current_dag->preferred_parent;
+  parent_addr = rpl_get_parent_ipaddr(parent);
+  if(parent_addr == NULL) {
+    printf("  no preferred parent\n");
+    return;
+  }
+  payload[0] = RPL_DEFAULT_INSTANCE;
+  payload[1] = 0;
+  payload[2] = instance->my_dao_seqno;
+  payload[3] = 0;
+  uip_create_linklocal_prefix(&dst);
+  uip_ds6_set_addr_iid(&dst, &uip_lladdr);
+  for(i = 0; i < nodes; i++) {
+    make_message(i, parent_addr, &dst, RPL_CODE_DAO_ACK, payload, 4);
+    linkaddr_copy(&message_lladdr[i],
+                  (const linkaddr_t *)rpl_get_parent_lladdr(parent));
+  }
+  report("  DAO-ACK", nodes, nodes, input_messages(nodes));
+
+  report_memory("rpl parents", count_parents(), sizeof(rpl_parent_t));
+  report_memory("uip-ds6 neighbors", uip_ds6_nbr_num(), sizeof(uip_ds6_nbr_t));
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * A router with STORING_CHILDREN children forwards the DAOs of nodes
+ * below them to its preferred parent, aggregated or not depending on
+ * RPL_CONF_DAO_AGGREGATION_WINDOW. The second round repeats the same
+ * DAOs, as children do when they retransmit.
+ */
+static void
+benchmark_router(uint8_t mop, int nodes)
+{
+  rpl_instance_t *instance;
+  uip_ipaddr_t addr;
+  unsigned long sent;
+  int round;
+  int i;
+
+  for(i = 0; i < 3; i++) {
+    make_dio(i, i, RPL_MIN_HOPRANKINC * (1 + i));
+  }
+  input_messages(3);
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  if(instance == NULL || instance->current_dag == NULL ||
+     instance->current_dag->preferred_parent == NULL) {
+    printf("Router: did not join the DAG\n");
+    return;
+  }
+
+  uip_create_linklocal_prefix(&addr);
+  uip_ds6_set_addr_iid(&addr, &uip_lladdr);
+  for(i = 0; i < nodes; i++) {
+    make_dao(i, 16 + i, -1, RPL_MOP_STORING_NO_MULTICAST, 1, 0, &addr);
+  }
+
+  printf("Router, storing mode, aggregation window %u ticks\n",
+         (unsigned)RPL_DAO_AGGREGATION_WINDOW);
+  for(round = 0; round < 2; round++) {
+    sent = uip_stat.icmp.sent;
+    report(round ? "  DAO, retransmitted" : "  DAO, forwarded",
+           nodes, nodes, input_messages(nodes));
+    printf("  %lu DAOs sent to the preferred parent\n",
+           (unsigned long)(uip_stat.icmp.sent - sent));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Each run starts from a fresh RPL state in a child process, as there
+ * is no way to tear down a DAG with all its routes and neighbors.
+ */
+static void
+run(void (*f)(uint8_t, int), uint8_t mop, int nodes)
+{
+  pid_t pid;
+
+  fflush(stdout);
+  pid = fork();
+  if(pid == 0) {
+    f(mop, nodes);
+    fflush(stdout);
+    _exit(0);
+  } else if(pid > 0) {
+    waitpid(pid, NULL, 0);
+  } else {
+    perror("fork");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_node(uint8_t mop, int nodes)
+{
+  benchmark_node(nodes);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rpl_benchmark_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  uip_ip6addr(&prefix, 0xfd00, 0, 0, 0, 0, 0, 0, 0);
+  node_addr(&root_addr, &prefix, 0xffff);
+
+  printf("RPL benchmark, sizeof(uip_ds6_route_t) %u, sizeof(rpl_ns_node_t) %u\n",
+         (unsigned)sizeof(uip_ds6_route_t), (unsigned)sizeof(rpl_ns_node_t));
+
+  for(i = 0; i < sizeof(node_counts) / sizeof(node_counts[0]); i++) {
+    run(benchmark_root, RPL_MOP_STORING_NO_MULTICAST, node_counts[i]);
+  }
+  for(i = 0; i < sizeof(node_counts) / sizeof(node_counts[0]); i++) {
+    run(benchmark_root, RPL_MOP_NON_STORING, node_counts[i]);
+  }
+  for(i = 0; i < sizeof(parent_counts) / sizeof(parent_counts[0]); i++) {
+    run(run_node, 0, parent_counts[i]);
+  }
+  for(i = 0; i < sizeof(node_counts) / sizeof(node_counts[0]) - 1; i++) {
+    run(benchmark_router, 0, node_counts[i]);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -74,6 +74,11 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_LOGGING         0
 #define UIP_CONF_UDP_CHECKSUMS   1
 
+/* Sum checksums with the SSE2 version in cpu/native/uip-chksum-arch.c */
+#if defined(__SSE2__) && !defined(UIP_ARCH_CHKSUM_ADD)
+#define UIP_ARCH_CHKSUM_ADD      1
+#endif /* __SSE2__ */
+
 #ifndef NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE
 #define NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE 8
 #endif /* NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE */
@@ -270,4 +275,9 @@ int strcasecmp(const char*, const char*);
 #include PROJECT_CONF_H
 #endif /* PROJECT_CONF_H */
 
+/* AES-NI when available, see cpu/native/dev/native-aes-128.c */
+#ifndef AES_128_CONF
+#define AES_128_CONF native_aes_128_driver
+#endif /* AES_128_CONF */
+
 #endif /* CONTIKI_CONF_H_ */
@@ -172,7 +172,7 @@ do {&#xD;
     if(msg.contains('Success')) {&#xD;
         successes++;&#xD;
     }&#xD;
-} while(successes &lt; 5);&#xD;
+} while(successes &lt; 14);&#xD;
 &#xD;
 log.testOK();</script>
       <active>true</active>
@@ -48,6 +48,7 @@
 #include <signal.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -66,17 +67,15 @@ speed_t b_rate = BAUDRATE;
 int verbose = 1;
 const char *ipaddr;
 const char *netmask;
-int slipfd = 0;
+int tap = 0;
 uint16_t basedelay=0,delaymsec=0;
 uint32_t startsec,startmsec,delaystartsec,delaystartmsec;
 int timestamp = 0, flowcontrol=0, showprogress=0, flowcontrol_xonxoff=0;
 
 int ssystem(const char *fmt, ...)
      __attribute__((__format__ (__printf__, 1, 2)));
-void write_to_serial(int outfd, void *inbuf, int len);
-
-void slip_send(int fd, unsigned char c);
-void slip_send_char(int fd, unsigned char c);
+struct radio;
+void write_to_serial(struct radio *r, void *inbuf, int len);
 
 #define PROGRESS(s) if(showprogress) fprintf(stderr, s)
 
@@ -165,262 +164,460 @@ is_sensible_string(const unsigned char *s, int len)
 }
 
 /*
- * Read from serial, when we have a packet write it to tun. No output
- * buffering, input buffered by stdio.
+ * A serial radio, or a TCP connection to one, bridged to the tun
+ * interface. Several radios may be bridged to the same interface.
+ */
+#define MAX_RADIOS     8
+#define MAX_PACKET     2000
+/* Encoded frames queued for output on each radio */
+#define SLIP_QUEUE_LEN 16
+
+struct slip_frame {
+  unsigned char buf[2 * MAX_PACKET + 1];
+  int len;
+};
+
+struct radio {
+  const char *siodev;
+  int fd;
+  /* SLIP input, decoded a block at a time */
+  unsigned char inbuf[MAX_PACKET];
+  int inbufptr;
+  int escaped;                  /* The last byte read was SLIP_ESC */
+  int dropping;                 /* Discard input up to the next SLIP_END */
+  /* SLIP output, a queue of encoded frames written with writev() */
+  struct slip_frame out[SLIP_QUEUE_LEN];
+  int out_head;
+  int out_count;
+  int out_offset;               /* Bytes of out[out_head] already written */
+  /* Statistics */
+  unsigned long serial_rx_bytes;
+  unsigned long rx_packets, rx_bytes, rx_dropped;
+  unsigned long tx_packets, tx_bytes, tx_dropped;
+};
+
+struct radio radios[MAX_RADIOS];
+int nradios;
+
+/*
+ * Escape code for each byte value that has to be escaped on output,
+ * and the decoded value of each byte that follows SLIP_ESC on input.
  */
+static unsigned char slip_esc[256];
+static unsigned char slip_unesc[256];
+/* Bytes that end a run of plain bytes in the SLIP input */
+static unsigned char slip_special[256];
+
 void
-serial_to_tun(FILE *inslip, int outfd)
+slip_init(void)
 {
-  static union {
-    unsigned char inbuf[2000];
-  } uip;
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
+  int c;
 
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
-  goto after_fread;
-#endif
+  for(c = 0; c < 256; c++) {
+    slip_unesc[c] = c;
+  }
+  slip_unesc[SLIP_ESC_END] = SLIP_END;
+  slip_unesc[SLIP_ESC_ESC] = SLIP_ESC;
+  slip_unesc[SLIP_ESC_XON] = XON;
+  slip_unesc[SLIP_ESC_XOFF] = XOFF;
 
- read_more:
-  if(inbufptr >= sizeof(uip.inbuf)) {
-     if(timestamp) stamptime();
-     fprintf(stderr, "*** dropping large %d byte packet\n",inbufptr);
-	 inbufptr = 0;
+  slip_esc[SLIP_END] = SLIP_ESC_END;
+  slip_esc[SLIP_ESC] = SLIP_ESC_ESC;
+  if(flowcontrol_xonxoff) {
+    slip_esc[XON] = SLIP_ESC_XON;
+    slip_esc[XOFF] = SLIP_ESC_XOFF;
   }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_to_tun: read");
+
+  slip_special[SLIP_END] = 1;
+  slip_special[SLIP_ESC] = 1;
+  /* Lines are echoed as they are received for verbose=2,3,5+ */
+  if((verbose==2) || (verbose==3) || (verbose>4)) {
+    slip_special['\n'] = 1;
+  }
+}
+
+/*
+ * Radio learned for each IPv6 source address seen on the SLIP side,
+ * so that packets from tun go to the radio that can reach their
+ * destination. Packets to unknown and multicast destinations go to
+ * all radios.
+ */
+#define ROUTE_TABLE_SIZE 1024
+
+struct route {
+  struct in6_addr addr;
+  struct radio *radio;
+};
+static struct route routes[ROUTE_TABLE_SIZE];
+
+static struct route *
+route_entry(const unsigned char *addr)
+{
+  unsigned h;
+  int i;
+
+  h = 0;
+  for(i = 8; i < 16; i++) {
+    h = h * 31 + addr[i];
   }
-  if(ret == 0) {
-    clearerr(inslip);
+  return &routes[h % ROUTE_TABLE_SIZE];
+}
+
+void
+route_learn(struct radio *r, const unsigned char *ip6, int len)
+{
+  struct route *e;
+
+  if(tap || nradios == 1 || len < 40 || (ip6[0] >> 4) != 6) {
     return;
   }
-  PROGRESS(".");
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(uip.inbuf[0] == '!') {
-	if(uip.inbuf[1] == 'M') {
-	  /* Read gateway MAC address and autoconfigure tap0 interface */
-	  char macs[24];
-	  int i, pos;
-	  for(i = 0, pos = 0; i < 16; i++) {
-	    macs[pos++] = uip.inbuf[2 + i];
-	    if((i & 1) == 1 && i < 14) {
-	      macs[pos++] = ':';
-	    }
-	  }
-          if(timestamp) stamptime();
-	  macs[pos] = '\0';
-//	  printf("*** Gateway's MAC address: %s\n", macs);
-	  fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s down", tundev);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s up", tundev);
-	}
-      } else if(uip.inbuf[0] == '?') {
-	if(uip.inbuf[1] == 'P') {
-          /* Prefix info requested */
-          struct in6_addr addr;
-	  int i;
-	  char *s = strchr(ipaddr, '/');
-	  if(s != NULL) {
-	    *s = '\0';
-	  }
-          inet_pton(AF_INET6, ipaddr, &addr);
-          if(timestamp) stamptime();
-          fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-		 ipaddr,
-		 addr.s6_addr[0], addr.s6_addr[1],
-		 addr.s6_addr[2], addr.s6_addr[3],
-		 addr.s6_addr[4], addr.s6_addr[5],
-		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
-        }
-#define DEBUG_LINE_MARKER '\r'
-      } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {
-	fwrite(uip.inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(uip.inbuf, inbufptr)) {
-        if(verbose==1) {   /* strings already echoed below for verbose>1 */
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(verbose>2) {
-          if (timestamp) stamptime();
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if (verbose>4) {
-#if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	        for(i = 0; i < inbufptr; i++) printf(" %02x",uip.inbuf[i]);
-#else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", uip.inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
-        }
-	if(write(outfd, uip.inbuf, inbufptr) != inbufptr) {
-	  err(1, "serial_to_tun: write");
-	}
-      }
-      inbufptr = 0;
-    }
-    break;
-
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
-    }
+  e = route_entry(ip6 + 8);
+  memcpy(&e->addr, ip6 + 8, sizeof(e->addr));
+  e->radio = r;
+}
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
-    case SLIP_ESC_XON:
-      c = XON;
-      break;
-    case SLIP_ESC_XOFF:
-      c = XOFF;
-      break;
-    }
-    /* FALLTHROUGH */
-  default:
-    uip.inbuf[inbufptr++] = c;
-
-    /* Echo lines as they are received for verbose=2,3,5+ */
-    /* Echo all printable characters for verbose==4 */
-    if((verbose==2) || (verbose==3) || (verbose>4)) {
-      if(c=='\n') {
-        if(is_sensible_string(uip.inbuf, inbufptr)) {
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-          inbufptr=0;
-        }
-      }
-    } else if(verbose==4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
-        if(c=='\n') if(timestamp) stamptime();
-      }
-    }
+struct radio *
+route_lookup(const unsigned char *ip6, int len)
+{
+  struct route *e;
 
-    break;
+  if(tap || len < 40 || (ip6[0] >> 4) != 6 || ip6[24] == 0xff) {
+    return NULL;
   }
+  e = route_entry(ip6 + 24);
+  if(e->radio != NULL && memcmp(&e->addr, ip6 + 24, sizeof(e->addr)) == 0) {
+    return e->radio;
+  }
+  return NULL;
+}
+
+void
+print_radio_stats(void)
+{
+  struct radio *r;
 
-  goto read_more;
+  for(r = radios; r < &radios[nradios]; r++) {
+    if (timestamp) stamptime();
+    fprintf(stderr, "*** %s: in %lu packets %lu bytes (%lu serial bytes, "
+            "%lu dropped), out %lu frames %lu serial bytes (%lu dropped)\n",
+            r->siodev, r->rx_packets, r->rx_bytes, r->serial_rx_bytes,
+            r->rx_dropped, r->tx_packets, r->tx_bytes, r->tx_dropped);
+  }
 }
 
-unsigned char slip_buf[2000];
-int slip_end, slip_begin;
+/*
+ * Start a new frame at the tail of the output queue of radio r, or
+ * return NULL if the queue is full.
+ */
+struct slip_frame *
+slip_frame_new(struct radio *r)
+{
+  struct slip_frame *f;
 
+  if(r->out_count == SLIP_QUEUE_LEN) {
+    r->tx_dropped++;
+    PROGRESS("Q");
+    return NULL;
+  }
+  f = &r->out[(r->out_head + r->out_count) % SLIP_QUEUE_LEN];
+  f->len = 0;
+  return f;
+}
+
+/* Escape len bytes at p into frame f, copying runs of plain bytes */
 void
-slip_send_char(int fd, unsigned char c)
+slip_encode(struct slip_frame *f, const unsigned char *p, int len)
 {
-  switch(c) {
-  case SLIP_END:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_END);
-    break;
-  case SLIP_ESC:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_ESC);
-    break;
-  case XON:
-    if(flowcontrol_xonxoff) {
-      slip_send(fd, SLIP_ESC);
-      slip_send(fd, SLIP_ESC_XON);
-    } else {
-      slip_send(fd, c);
+  const unsigned char *end = p + len;
+  const unsigned char *run;
+  unsigned char *out = f->buf + f->len;
+
+  while(p < end) {
+    run = p;
+    while(p < end && slip_esc[*p] == 0) {
+      p++;
     }
-    break;
-  case XOFF:
-    if(flowcontrol_xonxoff) {
-      slip_send(fd, SLIP_ESC);
-      slip_send(fd, SLIP_ESC_XOFF);
-    } else {
-      slip_send(fd, c);
+    memcpy(out, run, p - run);
+    out += p - run;
+    if(p < end) {
+      *out++ = SLIP_ESC;
+      *out++ = slip_esc[*p++];
     }
-    break;
-  default:
-    slip_send(fd, c);
-    break;
   }
+  f->len = out - f->buf;
 }
 
+/* End frame f with SLIP_END and queue it for output */
 void
-slip_send(int fd, unsigned char c)
+slip_frame_queue(struct radio *r, struct slip_frame *f)
 {
-  if(slip_end >= sizeof(slip_buf)) {
-    err(1, "slip_send overflow");
-  }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  f->buf[f->len++] = SLIP_END;
+  r->out_count++;
 }
 
 int
-slip_empty()
+slip_empty(struct radio *r)
 {
-  return slip_end == 0;
+  return r->out_count == 0;
 }
 
 void
-slip_flushbuf(int fd)
+slip_flushbuf(struct radio *r)
 {
-  int n;
+  struct iovec iov[SLIP_QUEUE_LEN];
+  struct slip_frame *f;
+  int i, n;
 
-  if(slip_empty()) {
+  if(slip_empty(r)) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, (slip_end - slip_begin));
+  for(i = 0; i < r->out_count; i++) {
+    f = &r->out[(r->out_head + i) % SLIP_QUEUE_LEN];
+    iov[i].iov_base = f->buf;
+    iov[i].iov_len = f->len;
+  }
+  iov[0].iov_base = (unsigned char *)iov[0].iov_base + r->out_offset;
+  iov[0].iov_len -= r->out_offset;
+
+  n = writev(r->fd, iov, r->out_count);
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueueis full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_end) {
-      slip_begin = slip_end = 0;
+    r->tx_bytes += n;
+    while(n > 0) {
+      f = &r->out[r->out_head];
+      if(n < f->len - r->out_offset) {
+        r->out_offset += n;
+        break;
+      }
+      n -= f->len - r->out_offset;
+      r->out_offset = 0;
+      r->out_head = (r->out_head + 1) % SLIP_QUEUE_LEN;
+      r->out_count--;
+      r->tx_packets++;
+    }
+  }
+}
+
+/* Queue a SLIP frame with the len bytes at p on radio r */
+void
+slip_send_frame(struct radio *r, const void *p, int len)
+{
+  struct slip_frame *f;
+
+  f = slip_frame_new(r);
+  if(f != NULL) {
+    if(len > 0) {
+      slip_encode(f, p, len);
+    }
+    slip_frame_queue(r, f);
+  }
+}
+
+/*
+ * Handle the SLIP frame received from radio r: a command, a debug
+ * message or a packet for tun.
+ */
+void
+serial_packet(struct radio *r, int outfd)
+{
+  int i;
+
+  if(r->inbuf[0] == '!') {
+    if(r->inbuf[1] == 'M') {
+      /* Read gateway MAC address and autoconfigure tap0 interface */
+      char macs[24];
+      int i, pos;
+      for(i = 0, pos = 0; i < 16; i++) {
+        macs[pos++] = r->inbuf[2 + i];
+        if((i & 1) == 1 && i < 14) {
+          macs[pos++] = ':';
+        }
+      }
+      if(timestamp) stamptime();
+      macs[pos] = '\0';
+//      printf("*** Gateway's MAC address: %s\n", macs);
+      fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s down", tundev);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s up", tundev);
+    }
+  } else if(r->inbuf[0] == '?') {
+    if(r->inbuf[1] == 'P') {
+      /* Prefix info requested */
+      struct in6_addr addr;
+      unsigned char reply[2 + 8];
+      char *s = strchr(ipaddr, '/');
+      if(s != NULL) {
+        *s = '\0';
+      }
+      inet_pton(AF_INET6, ipaddr, &addr);
+      if(timestamp) stamptime();
+      fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+             ipaddr,
+             addr.s6_addr[0], addr.s6_addr[1],
+             addr.s6_addr[2], addr.s6_addr[3],
+             addr.s6_addr[4], addr.s6_addr[5],
+             addr.s6_addr[6], addr.s6_addr[7]);
+      reply[0] = '!';
+      reply[1] = 'P';
+      memcpy(reply + 2, addr.s6_addr, 8);
+      slip_send_frame(r, reply, sizeof(reply));
+    }
+#define DEBUG_LINE_MARKER '\r'
+  } else if(r->inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(r->inbuf + 1, r->inbufptr - 1, 1, stdout);
+  } else if(is_sensible_string(r->inbuf, r->inbufptr)) {
+    if(verbose==1) {   /* strings already echoed below for verbose>1 */
+      if (timestamp) stamptime();
+      fwrite(r->inbuf, r->inbufptr, 1, stdout);
+    }
+  } else {
+    if(verbose>2) {
+      if (timestamp) stamptime();
+      printf("Packet from SLIP %s of length %d - write TUN\n",
+             r->siodev, r->inbufptr);
+      if (verbose>4) {
+#if WIRESHARK_IMPORT_FORMAT
+        printf("0000");
+            for(i = 0; i < r->inbufptr; i++) printf(" %02x",r->inbuf[i]);
+#else
+        printf("         ");
+        for(i = 0; i < r->inbufptr; i++) {
+          printf("%02x", r->inbuf[i]);
+          if((i & 3) == 3) printf(" ");
+          if((i & 15) == 15) printf("\n         ");
+        }
+#endif
+        printf("\n");
+      }
+    }
+    if(write(outfd, r->inbuf, r->inbufptr) != r->inbufptr) {
+      err(1, "serial_to_tun: write");
+    }
+    route_learn(r, r->inbuf, r->inbufptr);
+    r->rx_packets++;
+    r->rx_bytes += r->inbufptr;
+  }
+}
+
+/* Append n decoded bytes to the frame being received from radio r */
+void
+serial_append(struct radio *r, const unsigned char *p, int n)
+{
+  int i;
+
+  if(r->dropping) {
+    return;
+  }
+  if(r->inbufptr + n > sizeof(r->inbuf)) {
+     if(timestamp) stamptime();
+     fprintf(stderr, "*** dropping large %d byte packet\n", r->inbufptr + n);
+     r->rx_dropped++;
+     r->inbufptr = 0;
+     r->dropping = 1;
+     return;
+  }
+  memcpy(r->inbuf + r->inbufptr, p, n);
+  r->inbufptr += n;
+
+  /* Echo lines as they are received for verbose=2,3,5+ */
+  /* Echo all printable characters for verbose==4 */
+  if((verbose==2) || (verbose==3) || (verbose>4)) {
+    /* A newline always ends a run, see slip_special[] */
+    if(p[n - 1]=='\n') {
+      if(is_sensible_string(r->inbuf, r->inbufptr)) {
+        if (timestamp) stamptime();
+        fwrite(r->inbuf, r->inbufptr, 1, stdout);
+        r->inbufptr=0;
+      }
+    }
+  } else if(verbose==4) {
+    for(i = 0; i < n; i++) {
+      if(p[i] == 0 || p[i] == '\r' || p[i] == '\n' || p[i] == '\t' ||
+         (p[i] >= ' ' && p[i] <= '~')) {
+	fwrite(&p[i], 1, 1, stdout);
+        if(p[i]=='\n') if(timestamp) stamptime();
+      }
     }
   }
 }
 
+/*
+ * Read a block from the serial port of radio r and decode it, writing
+ * complete packets to tun. Runs of bytes that need no unescaping are
+ * copied as they are.
+ */
 void
-write_to_serial(int outfd, void *inbuf, int len)
+serial_to_tun(struct radio *r, int outfd)
+{
+  unsigned char buf[4096];
+  const unsigned char *p, *end, *run;
+  int ret;
+
+  ret = read(r->fd, buf, sizeof(buf));
+  if(ret == -1 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
+  PROGRESS(".");
+  r->serial_rx_bytes += ret;
+
+  p = buf;
+  end = buf + ret;
+  while(p < end) {
+    if(r->escaped) {
+      r->escaped = 0;
+      serial_append(r, &slip_unesc[*p++], 1);
+      continue;
+    }
+
+    run = p;
+    while(p < end && !slip_special[*p]) {
+      p++;
+    }
+    if(p > run) {
+      serial_append(r, run, p - run);
+    }
+    if(p == end) {
+      break;
+    }
+
+    switch(*p++) {
+    case SLIP_END:
+      if(r->inbufptr > 0 && !r->dropping) {
+        serial_packet(r, outfd);
+      }
+      r->inbufptr = 0;
+      r->dropping = 0;
+      break;
+    case SLIP_ESC:
+      r->escaped = 1;
+      break;
+    default:
+      /* A newline, when lines are echoed */
+      serial_append(r, p - 1, 1);
+      break;
+    }
+  }
+}
+
+void
+write_to_serial(struct radio *r, void *inbuf, int len)
 {
   u_int8_t *p = inbuf;
   int i;
 
   if(verbose>2) {
     if (timestamp) stamptime();
-    printf("Packet from TUN of length %d - write SLIP\n", len);
+    printf("Packet from TUN of length %d - write SLIP %s\n", len, r->siodev);
     if (verbose>4) {
 #if WIRESHARK_IMPORT_FORMAT
       printf("0000");
@@ -440,58 +637,93 @@ write_to_serial(int outfd, void *inbuf, int len)
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
-
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    case XON:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XON);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    case XOFF:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XOFF);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
-    }
-  }
-  slip_send(outfd, SLIP_END);
+  slip_send_frame(r, p, len);
   PROGRESS("t");
 }
 
+/*
+ * A packet read from tun is held back here until every radio that it
+ * goes to has room for it, instead of being dropped by a full radio.
+ */
+static unsigned char tun_held[MAX_PACKET];
+static int tun_held_len;
+
+/*
+ * Can radio r take another packet? With a delay between outgoing
+ * packets, only one packet at a time is queued for slip output.
+ */
+int
+radio_ready(struct radio *r)
+{
+  if(basedelay) {
+    return slip_empty(r);
+  }
+  return r->out_count < SLIP_QUEUE_LEN;
+}
 
 /*
- * Read from tun, write to slip.
+ * Can we take another packet from tun? Only if no packet is held back,
+ * or if the radios of the held packet have room for it now.
  */
 int
-tun_to_serial(int infd, int outfd)
+tun_ready(void)
 {
-  struct {
-    unsigned char inbuf[2000];
-  } uip;
-  int size;
+  struct radio *r;
 
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  if(tun_held_len == 0) {
+    return 1;
+  }
+  r = route_lookup(tun_held, tun_held_len);
+  if(r != NULL) {
+    return radio_ready(r);
+  }
+  for(r = radios; r < &radios[nradios]; r++) {
+    if(!radio_ready(r)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Read from tun, write to slip. Reads packets until tun has no more or
+ * a packet has to wait for its radios, and returns the size of the
+ * last one sent.
+ */
+int
+tun_to_serial(int infd)
+{
+  struct radio *r;
+  int size = 0;
+
+  do {
+    if(tun_held_len == 0) {
+      if((tun_held_len = read(infd, tun_held, MAX_PACKET)) == -1) {
+        tun_held_len = 0;
+        if(errno == EAGAIN) {
+          break;
+        }
+        err(1, "tun_to_serial: read");
+      }
+      if(tun_held_len == 0) {
+        break;
+      }
+    }
+    if(!tun_ready()) {
+      break;
+    }
 
-  write_to_serial(outfd, uip.inbuf, size);
+    size = tun_held_len;
+    tun_held_len = 0;
+    r = route_lookup(tun_held, size);
+    if(r != NULL) {
+      write_to_serial(r, tun_held, size);
+    } else {
+      for(r = radios; r < &radios[nradios]; r++) {
+        write_to_serial(r, tun_held, size);
+      }
+    }
+  } while(!basedelay);
   return size;
 }
 
@@ -638,6 +870,7 @@ sigcleanup(int signo)
 }
 
 static int got_sigalarm;
+static int got_sigusr1;
 
 void
 sigalarm(int signo)
@@ -646,6 +879,13 @@ sigalarm(int signo)
   return;
 }
 
+void
+sigusr1(int signo)
+{
+  got_sigusr1 = 1;
+  return;
+}
+
 void
 sigalarm_reset()
 {
@@ -749,15 +989,13 @@ main(int argc, char **argv)
   int tunfd, maxfd;
   int ret;
   fd_set rset, wset;
-  FILE *inslip;
-  const char *siodev = NULL;
+  struct timeval no_wait, *timeout;
+  struct radio *r;
   const char *host = NULL;
   const char *port = NULL;
   const char *prog;
   int baudrate = -2;
   int ipa_enable = 0;
-  int tap = 0;
-  slipfd = 0;
 
   prog = argv[0];
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
@@ -791,10 +1029,13 @@ main(int argc, char **argv)
       break;
 
     case 's':
+      if(nradios == MAX_RADIOS) {
+        errx(1, "at most %d serial devices", MAX_RADIOS);
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	siodev = optarg + 5;
+	radios[nradios++].siodev = optarg + 5;
       } else {
-	siodev = optarg;
+	radios[nradios++].siodev = optarg;
       }
       break;
 
@@ -849,6 +1090,7 @@ fprintf(stderr," -I             Inquire IP address\n");
 fprintf(stderr," -X             Software XON/XOFF flow control (default disabled)\n");
 fprintf(stderr," -L             Log output format (adds time stamps)\n");
 fprintf(stderr," -s siodev      Serial device (default /dev/ttyUSB0)\n");
+fprintf(stderr,"                Repeat to bridge up to %d radios to the interface\n", MAX_RADIOS);
 fprintf(stderr," -M             Interface MTU (default and min: 1280)\n");
 fprintf(stderr," -T             Make tap interface (default is tun interface)\n");
 fprintf(stderr," -t tundev      Name of interface (default tap0 or tun0)\n");
@@ -865,6 +1107,7 @@ fprintf(stderr,"                Actual delay is basedelay*(#6LowPAN fragments) m
 fprintf(stderr,"                -d is equivalent to -d10.\n");
 fprintf(stderr," -a serveraddr  \n");
 fprintf(stderr," -p serverport  \n");
+fprintf(stderr,"Send SIGUSR1 to print per-radio packet counts.\n");
 exit(1);
       break;
     }
@@ -884,6 +1127,10 @@ exit(1);
     }
   }
 
+  if(host != NULL && nradios > 1) {
+    errx(1, "only one radio with -a serveraddr");
+  }
+
   if(host != NULL) {
     struct addrinfo hints, *servinfo, *p;
     int rv;
@@ -903,14 +1150,14 @@ exit(1);
 
     /* loop through all the results and connect to the first we can */
     for(p = servinfo; p != NULL; p = p->ai_next) {
-      if((slipfd = socket(p->ai_family, p->ai_socktype,
+      if((radios[0].fd = socket(p->ai_family, p->ai_socktype,
                           p->ai_protocol)) == -1) {
         perror("client: socket");
         continue;
       }
 
-      if(connect(slipfd, p->ai_addr, p->ai_addrlen) == -1) {
-        close(slipfd);
+      if(connect(radios[0].fd, p->ai_addr, p->ai_addrlen) == -1) {
+        close(radios[0].fd);
         perror("client: connect");
         continue;
       }
@@ -921,7 +1168,9 @@ exit(1);
       err(1, "can't connect to ``%s:%s''", host, port);
     }
 
-    fcntl(slipfd, F_SETFL, O_NONBLOCK);
+    fcntl(radios[0].fd, F_SETFL, O_NONBLOCK);
+    radios[0].siodev = host;
+    nradios = 1;
 
     inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
               s, sizeof(s));
@@ -931,10 +1180,12 @@ exit(1);
     freeaddrinfo(servinfo);
 
   } else {
-    if(siodev != NULL) {
-      slipfd = devopen(siodev, O_RDWR | O_NONBLOCK);
-      if(slipfd == -1) {
-	err(1, "can't open siodev ``/dev/%s''", siodev);
+    if(nradios > 0) {
+      for(r = radios; r < &radios[nradios]; r++) {
+        r->fd = devopen(r->siodev, O_RDWR | O_NONBLOCK);
+        if(r->fd == -1) {
+          err(1, "can't open siodev ``/dev/%s''", r->siodev);
+        }
       }
     } else {
       static const char *siodevs[] = {
@@ -942,26 +1193,31 @@ exit(1);
       };
       int i;
       for(i = 0; i < 3; i++) {
-        siodev = siodevs[i];
-        slipfd = devopen(siodev, O_RDWR | O_NONBLOCK);
-        if(slipfd != -1) {
+        radios[0].siodev = siodevs[i];
+        radios[0].fd = devopen(radios[0].siodev, O_RDWR | O_NONBLOCK);
+        if(radios[0].fd != -1) {
           break;
         }
       }
-      if(slipfd == -1) {
+      if(radios[0].fd == -1) {
         err(1, "can't open siodev");
       }
+      nradios = 1;
     }
-    if (timestamp) stamptime();
-    fprintf(stderr, "********SLIP started on ``/dev/%s''\n", siodev);
-    stty_telos(slipfd);
+    for(r = radios; r < &radios[nradios]; r++) {
+      if (timestamp) stamptime();
+      fprintf(stderr, "********SLIP started on ``/dev/%s''\n", r->siodev);
+      stty_telos(r->fd);
+    }
+  }
+  slip_init();
+  for(r = radios; r < &radios[nradios]; r++) {
+    slip_send_frame(r, NULL, 0);
   }
-  slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) err(1, "main: fdopen");
 
   tunfd = tun_alloc(tundev, tap);
   if(tunfd == -1) err(1, "main: open /dev/tun");
+  fcntl(tunfd, F_SETFL, O_NONBLOCK);
   if (timestamp) stamptime();
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           tap ? "tap" : "tun", tundev);
@@ -971,6 +1227,7 @@ exit(1);
   signal(SIGTERM, sigcleanup);
   signal(SIGINT, sigcleanup);
   signal(SIGALRM, sigalarm);
+  signal(SIGUSR1, sigusr1);
   ifconf(tundev, ipaddr);
 
   while(1) {
@@ -980,38 +1237,51 @@ exit(1);
 
     if(got_sigalarm && ipa_enable) {
       /* Send "?IPA". */
-      slip_send(slipfd, '?');
-      slip_send(slipfd, 'I');
-      slip_send(slipfd, 'P');
-      slip_send(slipfd, 'A');
-      slip_send(slipfd, SLIP_END);
+      for(r = radios; r < &radios[nradios]; r++) {
+        slip_send_frame(r, "?IPA", 4);
+      }
       got_sigalarm = 0;
     }
 
-    if(!slip_empty()) {		/* Anything to flush? */
-      FD_SET(slipfd, &wset);
+    if(got_sigusr1) {
+      print_radio_stats();
+      got_sigusr1 = 0;
     }
 
-    FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
-    if(slipfd > maxfd) maxfd = slipfd;
+    for(r = radios; r < &radios[nradios]; r++) {
+      if(!slip_empty(r)) {	/* Anything to flush? */
+        FD_SET(r->fd, &wset);
+      }
 
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
+      FD_SET(r->fd, &rset);	/* Read from slip ASAP! */
+      if(r->fd > maxfd) maxfd = r->fd;
+    }
+
+    /* Only read from tun while no packet is held back. A held packet
+       that its radios have room for now is sent without waiting. */
+    timeout = NULL;
+    if(tun_held_len == 0) {
       FD_SET(tunfd, &rset);
       if(tunfd > maxfd) maxfd = tunfd;
+    } else if(tun_ready()) {
+      no_wait.tv_sec = 0;
+      no_wait.tv_usec = 0;
+      timeout = &no_wait;
     }
 
-    ret = select(maxfd + 1, &rset, &wset, NULL, NULL);
+    ret = select(maxfd + 1, &rset, &wset, NULL, timeout);
     if(ret == -1 && errno != EINTR) {
       err(1, "select");
-    } else if(ret > 0) {
-      if(FD_ISSET(slipfd, &rset)) {
-        serial_to_tun(inslip, tunfd);
-      }
+    } else if(ret >= 0) {
+      for(r = radios; r < &radios[nradios]; r++) {
+        if(FD_ISSET(r->fd, &rset)) {
+          serial_to_tun(r, tunfd);
+        }
 
-      if(FD_ISSET(slipfd, &wset)) {
-	slip_flushbuf(slipfd);
-	if(ipa_enable) sigalarm_reset();
+        if(FD_ISSET(r->fd, &wset)) {
+          slip_flushbuf(r);
+          if(ipa_enable) sigalarm_reset();
+        }
       }
 
       /* Optional delay between outgoing packets */
@@ -1026,9 +1296,11 @@ exit(1);
       }
       if(delaymsec==0) {
         int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
-          size=tun_to_serial(tunfd, slipfd);
-          slip_flushbuf(slipfd);
+        if((FD_ISSET(tunfd, &rset) || tun_held_len > 0) && tun_ready()) {
+          size=tun_to_serial(tunfd);
+          for(r = radios; r < &radios[nradios]; r++) {
+            slip_flushbuf(r);
+          }
           if(ipa_enable) sigalarm_reset();
           if(basedelay) {
             struct timeval tv;